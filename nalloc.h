@@ -0,0 +1,191 @@
+#ifndef NALLOC_H
+#define NALLOC_H
+
+// Nalloc v1.0 by Neil Cooper 18th October 2026
+// Allocators for objects that are created and destroyed on hot paths, to avoid the cost of the
+// general purpose heap (and contention on it between threads):
+//   Narena:          Bump allocator. Allocating is a pointer increment; nothing is freed until
+//                    reset(), which frees everything at once. Each thread has its own arena,
+//                    from Narena::forThread(), so no locking is needed.
+//   NarenaAllocator: STL allocator that takes its memory from an Narena, for containers that
+//                    are built up, used and then thrown away together.
+//   NblockPool:      Fixed-size blocks kept on a free list, so freed blocks are reused rather
+//                    than going back to the heap. Thread safe. NblockPool::shared() gives a
+//                    process-wide pool per block size.
+//   NobjectPool:     Constructs and destroys objects of one type in an NblockPool.
+
+#include <stddef.h>
+#include <new>          // for placement new
+#include <utility>      // for std::forward()
+#include <vector>
+
+#include "nspinlock.h"
+
+class Narena
+{
+public:
+    typedef struct
+        {
+        size_t              bytesInUse;     // Allocated since the last reset()
+        size_t              bytesReserved;  // Held in chunks
+        unsigned long long  allocations;    // Total allocate() calls
+        unsigned long long  chunksAllocated;// Times the arena has had to go to the heap
+        } ARENA_METRICS;
+
+    explicit Narena( const size_t theChunkSize = 65536 );
+    // theChunkSize: Size of each block taken from the heap. Bigger allocations get a chunk of their own.
+
+    virtual ~Narena();
+
+    void* allocate( const size_t theSize, const size_t theAlignment = alignof( max_align_t ) );
+    // Returns theSize bytes aligned to theAlignment (a power of 2). Valid until reset().
+
+    void reset();
+    // Frees everything allocated from the arena. Keeps the first chunk for reuse.
+
+    ARENA_METRICS getMetrics() const { return m_metrics; }
+
+    static Narena& forThread();
+    // The calling thread's own arena, created on first use and freed when the thread exits.
+
+private:
+    Narena( const Narena& );              // Not copyable
+    Narena& operator=( const Narena& );
+
+    void newChunk( const size_t theMinimumSize );
+
+    std::vector< char* >    m_chunks;
+    size_t                  m_chunkSize;
+    size_t                  m_firstChunkSize;
+    char*                   m_next;     // Next free byte in the current (last) chunk
+    char*                   m_end;
+    ARENA_METRICS           m_metrics;
+};
+
+
+template< class T >
+class NarenaAllocator
+{
+public:
+    typedef T           value_type;
+    typedef T*          pointer;
+    typedef const T*    const_pointer;
+    typedef T&          reference;
+    typedef const T&    const_reference;
+    typedef size_t      size_type;
+    typedef ptrdiff_t   difference_type;
+
+    template< class U > struct rebind { typedef NarenaAllocator< U > other; };
+
+    NarenaAllocator() : m_arena( &Narena::forThread() ) {}
+    // Uses the constructing thread's arena, so the container must only be used by that thread.
+
+    explicit NarenaAllocator( Narena& theArena ) : m_arena( &theArena ) {}
+
+    template< class U > NarenaAllocator( const NarenaAllocator< U >& theOther ) : m_arena( theOther.getArena() ) {}
+
+    T* allocate( const size_t theCount ) { return static_cast< T* >( m_arena->allocate( theCount * sizeof( T ), alignof( T ) ) ); }
+
+    void deallocate( T*, const size_t ) {}
+    // Nothing to do: the memory is freed when the arena is reset.
+
+    Narena* getArena() const { return m_arena; }
+
+private:
+    Narena*     m_arena;
+};
+
+template< class T, class U >
+bool operator==( const NarenaAllocator< T >& theFirst, const NarenaAllocator< U >& theSecond )
+    { return theFirst.getArena() == theSecond.getArena(); }
+
+template< class T, class U >
+bool operator!=( const NarenaAllocator< T >& theFirst, const NarenaAllocator< U >& theSecond )
+    { return theFirst.getArena() != theSecond.getArena(); }
+
+
+class NblockPool
+{
+public:
+    typedef struct
+        {
+        size_t              blocksInUse;
+        size_t              blocksFree;     // On the free list, ready for reuse
+        unsigned long long  allocations;    // Total allocate() calls
+        unsigned long long  chunksAllocated;// Times the pool has had to go to the heap
+        } POOL_METRICS;
+
+    explicit NblockPool( const size_t theBlockSize, const size_t theBlocksPerChunk = 64 );
+    // theBlockSize: Size of every block. Blocks are aligned for any type.
+    // theBlocksPerChunk: Blocks taken from the heap at a time when the free list is empty.
+
+    virtual ~NblockPool();
+    // Frees all the pool's memory, including any blocks still in use.
+
+    void* allocate();
+    void free( void* theBlock );
+
+    size_t getBlockSize() const { return m_blockSize; }
+
+    POOL_METRICS getMetrics();
+
+    static NblockPool& shared( const size_t theBlockSize );
+    // A process-wide pool for theBlockSize byte blocks, created on first use and never freed.
+
+private:
+    NblockPool( const NblockPool& );              // Not copyable
+    NblockPool& operator=( const NblockPool& );
+
+    typedef struct FREE_BLOCK
+        {
+        struct FREE_BLOCK*  next;
+        } FREE_BLOCK;
+
+    size_t                  m_blockSize;
+    size_t                  m_blocksPerChunk;
+    std::vector< char* >    m_chunks;
+    FREE_BLOCK*             m_freeList;
+    POOL_METRICS            m_metrics;
+    Nspinlock               m_owner;    // Owns all of the above. Only held for a few instructions.
+};
+
+
+template< class T >
+class NobjectPool
+{
+public:
+    explicit NobjectPool( const size_t theObjectsPerChunk = 64 ) : m_pool( sizeof( T ), theObjectsPerChunk ) {}
+
+    template< typename ...Args >
+    T* create( Args&&... theArgs )
+        {
+        void* block = m_pool.allocate();
+        try
+            {
+            return new ( block ) T( std::forward< Args >( theArgs )... );
+            }
+        catch ( ... )
+            {
+            m_pool.free( block );
+            throw;
+            }
+        }
+    // As new T( theArgs... ), but from the pool.
+
+    void destroy( T* theObject )
+        {
+        if ( theObject )
+            {
+            theObject->~T();
+            m_pool.free( theObject );
+            }
+        }
+    // As delete theObject, for objects from create().
+
+    NblockPool::POOL_METRICS getMetrics() { return m_pool.getMetrics(); }
+
+private:
+    NblockPool  m_pool;
+};
+
+#endif
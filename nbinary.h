@@ -1,10 +1,43 @@
 #ifndef NBINARY_H
 #define NBINARY_H
 
-//  Nbinary v1.1 by Neil Cooper 11th July 2013
-//  String-based arbitrary length binary object.
+//  Nbinary v2.1 by Neil Cooper 11th July 2013
+//  Arbitrary length binary object.
+//  v2.0 19th October 2026: Stored as packed 64 bit words rather than a string of '0' and '1'
+//  characters, so conversions and bit operations go a word at a time. The string interface is
+//  kept: getAsBinary() builds the string on request, and operator[] returns an NbinaryBit, which
+//  reads and assigns '0' and '1' like the char& it replaces.
+//  v2.1 19th October 2026: Bitwise, shift, add, subtract and comparison operators, a word at a
+//  time at any length, and bit fields at any offset and width. getAsInt() no longer silently
+//  drops bits above 64.
+
+#include <stdint.h>
 
 #include <string>
+#include <vector>
+
+class Nbinary;
+
+class NbinaryBit
+{
+public:
+    operator char() const { return ( *m_word & m_mask ) ? '1' : '0'; }
+    // '0' or '1'
+
+    NbinaryBit& operator = ( const char theBit );
+    // theBit: '0' or '1' ( or 0 or 1 ).
+
+    NbinaryBit& operator = ( const NbinaryBit& theOther ) { return *this = (char)theOther; }
+
+private:
+    friend class Nbinary;
+    NbinaryBit( uint64_t& theWord, const uint64_t theMask ) : m_word( &theWord ), m_mask( theMask ) {}
+
+    uint64_t*   m_word;
+    uint64_t    m_mask;
+};
+// Reference to one bit of an Nbinary, as returned by its operator[].
+
 
 class Nbinary
 {
@@ -56,8 +89,11 @@ public:
     // Return:
     //    String is value only (no leading "0x").
 
-    virtual unsigned long long getAsInt() const;
+    virtual unsigned long long getAsInt( const bool allowTruncate = false ) const;
     // Returns integer containing stored value.
+    // Parameters:
+    //  allowTruncate:  If allowTruncate is false and the stored value has bits set above the
+    //                  lowest 64, an exception will be thrown. Otherwise they are dropped.
     // Return:
     //    Integer containing stored value.
 
@@ -94,21 +130,79 @@ public:
     // Return:
     //    Length in bits of stored value.
 
+    bool getBit( const size_t position ) const;
+    void setBit( const size_t position, const bool value = true );
+    // Bit 'position' counting from the least significant, i.e. the bit worth 2^position.
+    // That's operator[]( length() - 1 - position ). Out of range positions throw.
+
+    size_t countOnes() const;
+    // Number of bits set.
+
+    const std::vector< uint64_t >& getWords() const { return m_words; }
+    // The stored value 64 bits at a time, least significant first. Bits above length() are 0.
+
+    unsigned long long getBits( const size_t position, const unsigned int width ) const;
+    void setBits( const size_t position, const unsigned int width, const unsigned long long value );
+    // The bit field of width bits ( 1 to 64 ) with its least significant bit at position, as an
+    // integer. setBits() ignores bits of value above width. Fields beyond length() throw.
+
+    Nbinary getField( const size_t position, const size_t width ) const;
+    void setField( const size_t position, const Nbinary& value );
+    // As above for fields of any width. setField() sets value.length() bits.
+
     Nbinary& operator = ( const std::string& value );
 
     Nbinary& operator = ( const unsigned long long value );
 
     bool operator == (const Nbinary& other ) const;
-
-    const char operator[] ( const int index ) const;
-    char& operator[] ( const int index );
-    // Array-style operator to access individual bits of the stored value.
+    bool operator != ( const Nbinary& other ) const { return !( *this == other ); }
+    // Equal if the same length and value, so "0b011" != "0b11".
+
+    bool operator <  ( const Nbinary& other ) const { return compare( other ) < 0; }
+    bool operator >  ( const Nbinary& other ) const { return compare( other ) > 0; }
+    bool operator <= ( const Nbinary& other ) const { return compare( other ) <= 0; }
+    bool operator >= ( const Nbinary& other ) const { return compare( other ) >= 0; }
+    int compare( const Nbinary& other ) const;
+    // By value, whatever the lengths. compare() returns < 0, 0 or > 0.
+
+    Nbinary& operator &= ( const Nbinary& other );
+    Nbinary& operator |= ( const Nbinary& other );
+    Nbinary& operator ^= ( const Nbinary& other );
+    Nbinary& operator += ( const Nbinary& other );
+    Nbinary& operator -= ( const Nbinary& other );
+    Nbinary operator & ( const Nbinary& other ) const;
+    Nbinary operator | ( const Nbinary& other ) const;
+    Nbinary operator ^ ( const Nbinary& other ) const;
+    Nbinary operator + ( const Nbinary& other ) const;
+    Nbinary operator - ( const Nbinary& other ) const;
+    // The shorter operand is taken as left-padded with 0's, and the result is the length of the
+    // longer. Like a register of that many bits, + and - wrap around: + drops a carry out of
+    // the top, and a - b for b > a gives 2^length - ( b - a ).
+
+    Nbinary operator ~ () const;
+    // Every bit of length() inverted.
+
+    Nbinary& operator <<= ( const size_t bits );
+    Nbinary& operator >>= ( const size_t bits );
+    Nbinary operator << ( const size_t bits ) const;
+    Nbinary operator >> ( const size_t bits ) const;
+    // The length stays the same: bits shifted out are lost and 0's shifted in.
+
+    char operator[] ( const int index ) const;
+    NbinaryBit operator[] ( const int index );
+    // Array-style operator to access individual bits of the stored value, index 0 being the
+    // leftmost ( most significant ), as in getAsBinary().
     // N.B: Value is represented in ASCII so uses '0' and '1' instead of literal 0 and 1
 
 private:
-    size_t getMinBitLength( const unsigned long long value );
-
-    std::string m_value;
+    static size_t getMinBitLength( const unsigned long long value );
+    void resize( const size_t lengthInbits );
+    void setByDigits( const std::string& digits, const unsigned int bitsPerDigit );
+    void growTo( const size_t lengthInbits );
+    void checkField( const size_t position, const size_t width ) const;
+
+    std::vector< uint64_t > m_words;    // Least significant first. Bits above m_length are 0.
+    size_t                  m_length;   // In bits
 };
 
 #endif
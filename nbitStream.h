@@ -0,0 +1,364 @@
+#ifndef NBITSTREAM_H
+#define NBITSTREAM_H
+
+// NbitStream v1.0 by Neil Cooper 19th October 2026
+// Reads and writes bit fields of 1 to 64 bits at any bit offset in a byte buffer, for packed
+// binary protocols such as CAN payloads and serial frames, straight from and to the buffer with
+// no allocation. Each field is one unaligned 64 bit load ( plus a byte when it straddles 9
+// bytes ) and a shift, with loads near the end of the buffer only touching bytes inside it.
+//   NbitStream:    Read or write the field at a given offset.
+//   NbitReader:    Read fields one after another, e.g. a frame header then its payload.
+//   NbitWriter:    Write fields one after another.
+//   NbitField:     A field's offset, width, bit order and type fixed at compile time, e.g.
+//                      typedef NbitField< 12, 4 > GEAR;
+//                      uint64_t gear = GEAR::read( frame, length );
+//                  Given a fixed size array, the compiler checks the field fits in it.
+// Bit orders:
+//   LSB_FIRST:     "Intel" or little endian. Bit n is bit n % 8 of byte n / 8, and a field's
+//                  least significant bit comes first.
+//   MSB_FIRST:     "Motorola" or big endian. Bit n is bit 7 - n % 8 of byte n / 8, counting
+//                  from the first bit sent on the wire, and a field's most significant bit comes
+//                  first. ( DBC files number Motorola start bits differently: convert to this. )
+// Fields that run past the end of the buffer throw.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>     // for memcpy()
+
+#include <type_traits>
+
+#include "nerror.h"
+
+namespace NBITSTREAM
+{
+inline uint64_t toLittle( const uint64_t theWord )
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return theWord;
+#else
+    return __builtin_bswap64( theWord );
+#endif
+}
+
+inline uint64_t toBig( const uint64_t theWord )
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return __builtin_bswap64( theWord );
+#else
+    return theWord;
+#endif
+}
+
+inline uint64_t load( const uint8_t* theBuffer )
+{
+    uint64_t word;
+    memcpy( &word, theBuffer, 8 );      // One unaligned load
+    return word;
+}
+
+inline void store( uint8_t* theBuffer, const uint64_t theWord )
+{
+    memcpy( theBuffer, &theWord, 8 );
+}
+
+// The 8 bytes from theByte as a little or big endian number, with 0's for bytes past the end.
+// Near the end, the buffer's last 8 bytes are loaded and shifted rather than copying fewer
+// bytes, which would cost a store forwarding stall on every field in the last bytes of a frame.
+inline uint64_t loadLittle( const uint8_t* theBuffer, const size_t theLength, const size_t theByte )
+{
+    if ( theByte + 8 <= theLength )
+        return toLittle( load( theBuffer + theByte ) );
+    if ( theLength >= 8 )
+        return toLittle( load( theBuffer + theLength - 8 ) ) >> ( ( theByte + 8 - theLength ) * 8 );
+    uint64_t word = 0;
+    memcpy( &word, theBuffer + theByte, theLength - theByte );
+    return toLittle( word );
+}
+
+inline uint64_t loadBig( const uint8_t* theBuffer, const size_t theLength, const size_t theByte )
+{
+    if ( theByte + 8 <= theLength )
+        return toBig( load( theBuffer + theByte ) );
+    if ( theLength >= 8 )
+        return toBig( load( theBuffer + theLength - 8 ) ) << ( ( theByte + 8 - theLength ) * 8 );
+    uint64_t word = 0;
+    memcpy( &word, theBuffer + theByte, theLength - theByte );
+    return toBig( word );
+}
+
+// Stores the 8 bytes from theByte that are inside the buffer.
+inline void storeLittle( uint8_t* theBuffer, const size_t theLength, const size_t theByte, const uint64_t theWord )
+{
+    if ( theByte + 8 <= theLength )
+        store( theBuffer + theByte, toLittle( theWord ) );
+    else if ( theLength >= 8 )
+        {
+        unsigned int before = ( theByte + 8 - theLength ) * 8;     // Bits of the last 8 bytes before theByte
+        uint64_t last = toLittle( load( theBuffer + theLength - 8 ) );
+        store( theBuffer + theLength - 8, toLittle( ( last & ( ~0ULL >> ( 64 - before ) ) ) | ( theWord << before ) ) );
+        }
+    else
+        {
+        uint64_t word = toLittle( theWord );
+        memcpy( theBuffer + theByte, &word, theLength - theByte );
+        }
+}
+
+inline void storeBig( uint8_t* theBuffer, const size_t theLength, const size_t theByte, const uint64_t theWord )
+{
+    if ( theByte + 8 <= theLength )
+        store( theBuffer + theByte, toBig( theWord ) );
+    else if ( theLength >= 8 )
+        {
+        unsigned int before = ( theByte + 8 - theLength ) * 8;
+        uint64_t last = toBig( load( theBuffer + theLength - 8 ) );
+        store( theBuffer + theLength - 8, toBig( ( last & ( ~0ULL << ( 64 - before ) ) ) | ( theWord >> before ) ) );
+        }
+    else
+        {
+        uint64_t word = toBig( theWord );
+        memcpy( theBuffer + theByte, &word, theLength - theByte );
+        }
+}
+
+inline uint64_t mask( const unsigned int theWidth )
+{
+    return ~0ULL >> ( 64 - theWidth );
+}
+
+// Unchecked: the field must be inside the buffer and theWidth 1 to 64.
+inline uint64_t readLsbFirst( const uint8_t* theBuffer, const size_t theLength, const size_t thePosition, const unsigned int theWidth )
+{
+    size_t byte = thePosition / 8;
+    unsigned int shift = thePosition % 8;
+    uint64_t value = loadLittle( theBuffer, theLength, byte ) >> shift;
+    if ( shift + theWidth > 64 )
+        value |= (uint64_t)theBuffer[ byte + 8 ] << ( 64 - shift );
+    return value & mask( theWidth );
+}
+
+inline uint64_t readMsbFirst( const uint8_t* theBuffer, const size_t theLength, const size_t thePosition, const unsigned int theWidth )
+{
+    size_t byte = thePosition / 8;
+    unsigned int shift = thePosition % 8;
+    uint64_t value = loadBig( theBuffer, theLength, byte ) << shift;
+    if ( shift + theWidth > 64 )
+        value |= theBuffer[ byte + 8 ] >> ( 8 - shift );
+    return value >> ( 64 - theWidth );
+}
+
+inline void writeLsbFirst( uint8_t* theBuffer, const size_t theLength, const size_t thePosition, const unsigned int theWidth, uint64_t theValue )
+{
+    size_t byte = thePosition / 8;
+    unsigned int shift = thePosition % 8;
+    uint64_t fieldMask = mask( theWidth );
+    theValue &= fieldMask;
+
+    uint64_t word = loadLittle( theBuffer, theLength, byte );
+    word = ( word & ~( fieldMask << shift ) ) | ( theValue << shift );
+    storeLittle( theBuffer, theLength, byte, word );
+    if ( shift + theWidth > 64 )
+        theBuffer[ byte + 8 ] = ( theBuffer[ byte + 8 ] & ~( fieldMask >> ( 64 - shift ) ) ) | ( theValue >> ( 64 - shift ) );
+}
+
+inline void writeMsbFirst( uint8_t* theBuffer, const size_t theLength, const size_t thePosition, const unsigned int theWidth, uint64_t theValue )
+{
+    size_t byte = thePosition / 8;
+    unsigned int shift = thePosition % 8;
+    uint64_t fieldMask = mask( theWidth );
+    theValue &= fieldMask;
+
+    uint64_t word = loadBig( theBuffer, theLength, byte );
+    if ( shift + theWidth <= 64 )
+        {
+        unsigned int below = 64 - shift - theWidth;
+        word = ( word & ~( fieldMask << below ) ) | ( theValue << below );
+        storeBig( theBuffer, theLength, byte, word );
+        }
+    else
+        {
+        // The field's last few bits go in the top of the ninth byte
+        unsigned int over = shift + theWidth - 64;
+        word = ( word & ~( fieldMask >> over ) ) | ( theValue >> over );
+        storeBig( theBuffer, theLength, byte, word );
+        uint8_t overMask = 0xFF << ( 8 - over );
+        theBuffer[ byte + 8 ] = ( theBuffer[ byte + 8 ] & ~overMask ) | ( ( theValue << ( 8 - over ) ) & overMask );
+        }
+}
+
+inline int64_t signExtend( const uint64_t theValue, const unsigned int theWidth )
+{
+    return (int64_t)( theValue << ( 64 - theWidth ) ) >> ( 64 - theWidth );
+}
+}
+
+
+class NbitStream
+{
+public:
+    typedef enum
+        {
+        LSB_FIRST,      // Intel, little endian
+        MSB_FIRST       // Motorola, big endian
+        } BIT_ORDER;
+
+    static uint64_t read( const void*     theBuffer,
+                          const size_t    theLength,
+                          const size_t    thePosition,
+                          const unsigned  theWidth,
+                          const BIT_ORDER theOrder = LSB_FIRST )
+    {
+        check( theLength, thePosition, theWidth );
+        return ( theOrder == LSB_FIRST ) ? NBITSTREAM::readLsbFirst( (const uint8_t*)theBuffer, theLength, thePosition, theWidth )
+                                         : NBITSTREAM::readMsbFirst( (const uint8_t*)theBuffer, theLength, thePosition, theWidth );
+    }
+    // The field of theWidth bits ( 1 to 64 ) at bit thePosition of theBuffer, theLength bytes long.
+
+    static int64_t readSigned( const void*     theBuffer,
+                               const size_t    theLength,
+                               const size_t    thePosition,
+                               const unsigned  theWidth,
+                               const BIT_ORDER theOrder = LSB_FIRST )
+    {
+        return NBITSTREAM::signExtend( read( theBuffer, theLength, thePosition, theWidth, theOrder ), theWidth );
+    }
+    // As read(), for a two's complement field.
+
+    static void write( void*           theBuffer,
+                       const size_t    theLength,
+                       const size_t    thePosition,
+                       const unsigned  theWidth,
+                       const uint64_t  theValue,
+                       const BIT_ORDER theOrder = LSB_FIRST )
+    {
+        check( theLength, thePosition, theWidth );
+        if ( theOrder == LSB_FIRST )
+            NBITSTREAM::writeLsbFirst( (uint8_t*)theBuffer, theLength, thePosition, theWidth, theValue );
+        else
+            NBITSTREAM::writeMsbFirst( (uint8_t*)theBuffer, theLength, thePosition, theWidth, theValue );
+    }
+    // Sets the field to the low theWidth bits of theValue ( signed values too ), leaving the bits
+    // around it as they were.
+
+    static void check( const size_t theLength, const size_t thePosition, const unsigned theWidth )
+    {
+        if ( ( theWidth < 1 ) || ( theWidth > 64 ) || ( thePosition > theLength * 8 ) || ( theWidth > theLength * 8 - thePosition ) )
+            ERROR( "NbitStream: A ", theWidth, " bit field at bit ", thePosition, " doesn't fit in ", theLength, " bytes" );
+    }
+    // Throws unless a field of theWidth bits ( 1 to 64 ) at thePosition fits in theLength bytes.
+};
+
+
+class NbitReader
+{
+public:
+    NbitReader( const void* theBuffer, const size_t theLength, const NbitStream::BIT_ORDER theOrder = NbitStream::LSB_FIRST )
+        : m_buffer( (const uint8_t*)theBuffer ), m_length( theLength ), m_position( 0 ), m_order( theOrder ) {}
+
+    uint64_t read( const unsigned theWidth )
+    {
+        uint64_t value = NbitStream::read( m_buffer, m_length, m_position, theWidth, m_order );
+        m_position += theWidth;
+        return value;
+    }
+    int64_t readSigned( const unsigned theWidth ) { return NBITSTREAM::signExtend( read( theWidth ), theWidth ); }
+    // The next theWidth bits ( 1 to 64 ).
+
+    void skip( const size_t theBits ) { m_position += theBits; }
+    void setPosition( const size_t thePosition ) { m_position = thePosition; }
+    size_t getPosition() const { return m_position; }
+    size_t getRemaining() const { return ( m_position < m_length * 8 ) ? m_length * 8 - m_position : 0; }
+    // In bits
+
+private:
+    const uint8_t*          m_buffer;
+    size_t                  m_length;   // In bytes
+    size_t                  m_position; // In bits
+    NbitStream::BIT_ORDER   m_order;
+};
+
+
+class NbitWriter
+{
+public:
+    NbitWriter( void* theBuffer, const size_t theLength, const NbitStream::BIT_ORDER theOrder = NbitStream::LSB_FIRST )
+        : m_buffer( (uint8_t*)theBuffer ), m_length( theLength ), m_position( 0 ), m_order( theOrder ) {}
+
+    void write( const unsigned theWidth, const uint64_t theValue )
+    {
+        NbitStream::write( m_buffer, m_length, m_position, theWidth, theValue, m_order );
+        m_position += theWidth;
+    }
+    // Writes the low theWidth bits ( 1 to 64 ) of theValue as the next field.
+
+    void skip( const size_t theBits ) { m_position += theBits; }
+    void setPosition( const size_t thePosition ) { m_position = thePosition; }
+    size_t getPosition() const { return m_position; }
+    size_t getRemaining() const { return ( m_position < m_length * 8 ) ? m_length * 8 - m_position : 0; }
+    // In bits
+
+private:
+    uint8_t*                m_buffer;
+    size_t                  m_length;
+    size_t                  m_position;
+    NbitStream::BIT_ORDER   m_order;
+};
+
+
+template< size_t POSITION, unsigned int WIDTH, NbitStream::BIT_ORDER ORDER = NbitStream::LSB_FIRST, typename TYPE = uint64_t >
+class NbitField
+{
+public:
+    // A field of WIDTH bits at bit POSITION, read and written as TYPE. Signed TYPEs are sign
+    // extended from the field's top bit. TYPE may also be bool or an enum.
+
+    static const size_t END = POSITION + WIDTH;
+    // Bits a buffer needs to hold the field.
+
+    static TYPE read( const void* theBuffer, const size_t theLength )
+    {
+        NbitStream::check( theLength, POSITION, WIDTH );
+        return get( (const uint8_t*)theBuffer, theLength );
+    }
+
+    template< size_t LENGTH >
+    static TYPE read( const uint8_t ( &theBuffer )[ LENGTH ] )
+    {
+        static_assert( END <= LENGTH * 8, "NbitField: Field doesn't fit in the buffer" );
+        return get( theBuffer, LENGTH );
+    }
+
+    static void write( void* theBuffer, const size_t theLength, const TYPE theValue )
+    {
+        NbitStream::check( theLength, POSITION, WIDTH );
+        set( (uint8_t*)theBuffer, theLength, theValue );
+    }
+
+    template< size_t LENGTH >
+    static void write( uint8_t ( &theBuffer )[ LENGTH ], const TYPE theValue )
+    {
+        static_assert( END <= LENGTH * 8, "NbitField: Field doesn't fit in the buffer" );
+        set( theBuffer, LENGTH, theValue );
+    }
+
+private:
+    static_assert( ( WIDTH >= 1 ) && ( WIDTH <= 64 ), "NbitField: WIDTH must be 1 to 64 bits" );
+    static_assert( WIDTH <= ( std::is_same< TYPE, bool >::value ? 1 : sizeof( TYPE ) * 8 ), "NbitField: TYPE is too small for WIDTH bits" );
+
+    static TYPE get( const uint8_t* theBuffer, const size_t theLength )
+    {
+        uint64_t value = ( ORDER == NbitStream::LSB_FIRST ) ? NBITSTREAM::readLsbFirst( theBuffer, theLength, POSITION, WIDTH )
+                                                             : NBITSTREAM::readMsbFirst( theBuffer, theLength, POSITION, WIDTH );
+        return std::is_signed< TYPE >::value ? (TYPE)NBITSTREAM::signExtend( value, WIDTH ) : (TYPE)value;
+    }
+
+    static void set( uint8_t* theBuffer, const size_t theLength, const TYPE theValue )
+    {
+        if ( ORDER == NbitStream::LSB_FIRST )
+            NBITSTREAM::writeLsbFirst( theBuffer, theLength, POSITION, WIDTH, (uint64_t)theValue );
+        else
+            NBITSTREAM::writeMsbFirst( theBuffer, theLength, POSITION, WIDTH, (uint64_t)theValue );
+    }
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef NCPUSET_H
+#define NCPUSET_H
+
+// NcpuSet v1.0 by Neil Cooper 18th October 2026
+// A set of CPUs, for thread and process affinity. Stored as a bitmask laid out as a cpu_set_t,
+// sized for the highest CPU in the set rather than a fixed 64 or 1024 CPUs, so it can be handed
+// straight to sched_setaffinity() and friends.
+// CPUs can be given as a list in the same format as taskset -c and /sys/devices/system/cpu,
+// e.g. "0-3,8,10-11", or as a bitmask ( "0x0F", "0b1111" or an integer ), LSB = CPU 0.
+
+#include <sched.h>
+
+#include <string>
+#include <vector>
+
+class NcpuSet
+{
+public:
+    NcpuSet();
+    // Empty set
+
+    NcpuSet( const unsigned long long theMask );
+    // CPUs 0-63 from a bitmask, LSB = CPU 0.
+
+    NcpuSet( const std::string& theCpus );
+    NcpuSet( const char* theCpus );
+    // From a list ( "0-3,8" ) or a "0x" or "0b" prefixed bitmask of any length. Throws if theCpus
+    // isn't one of those, or lists a CPU above 1048575.
+
+    static NcpuSet all();
+    // Every CPU the system has been configured with.
+
+    static NcpuSet current();
+    // The calling thread's affinity.
+
+    static unsigned int getCpuCount();
+    // Number of CPUs the system has been configured with. CPUs are numbered from 0 to this - 1.
+
+    void set( const unsigned int theCpu );
+    void clear( const unsigned int theCpu );
+    void clearAll();
+    bool isSet( const unsigned int theCpu ) const;
+
+    unsigned int count() const;
+    bool isEmpty() const;
+
+    int first() const;
+    // Lowest CPU in the set, or -1 if empty.
+
+    int next( const unsigned int theCpu ) const;
+    // Lowest CPU in the set above theCpu, or -1 if none.
+    // for ( int cpu = cpus.first(); cpu != -1; cpu = cpus.next( cpu ) ) visits each CPU.
+
+    NcpuSet& operator |= ( const NcpuSet& theOther );    // Union
+    NcpuSet& operator &= ( const NcpuSet& theOther );    // Intersection
+    NcpuSet& operator -= ( const NcpuSet& theOther );    // Difference
+    NcpuSet operator | ( const NcpuSet& theOther ) const;
+    NcpuSet operator & ( const NcpuSet& theOther ) const;
+    NcpuSet operator - ( const NcpuSet& theOther ) const;
+
+    bool operator == ( const NcpuSet& theOther ) const;
+    bool operator != ( const NcpuSet& theOther ) const { return !( *this == theOther ); }
+
+    std::string getAsString() const;
+    // As a list, e.g. "0-3,8". Empty set = "".
+
+    unsigned long long getAsInt() const;
+    // CPUs 0-63 as a bitmask, for code written for a 64 bit mask. Higher CPUs are ignored.
+
+    const cpu_set_t* getNative() const { return reinterpret_cast< const cpu_set_t* >( &m_words[0] ); }
+    size_t getNativeSize() const { return m_words.size() * sizeof( unsigned long ); }
+    // For sched_setaffinity(), pthread_setaffinity_np() etc, with the CPU_*_S() macros.
+
+    cpu_set_t* prepareNative( const unsigned int theCpus );
+    // Empties the set and sizes it for theCpus CPUs, returning it to be filled in by
+    // sched_getaffinity(), pthread_getaffinity_np() etc. Its size is then getNativeSize().
+
+private:
+    static const unsigned int BITS_PER_WORD = sizeof( unsigned long ) * 8;
+
+    void setByBitmask( const std::string& theDigits, const unsigned int theBitsPerDigit );
+    void setByList( const std::string& theList );
+
+    std::vector< unsigned long >    m_words;    // Same layout as cpu_set_t. Never empty.
+};
+
+#endif
@@ -1,11 +1,31 @@
 #ifndef NCRC_H
 #define NCRC_H
 
-// Ncrc v1.2 by Neil Cooper 31st October 2017
+// Ncrc v1.7 by Neil Cooper 31st October 2017
 // Implements easy-to-use CRC helper functions.
+// v1.3 19th October 2026: computeMemoryCrc32 picks the fastest implementation the CPU supports
+// when first called: carry-less multiply folding ( x86 PCLMULQDQ, or VPCLMULQDQ with AVX-512 ),
+// the ARMv8 CRC32 instructions, or slicing-by-16 tables. All give identical results.
+// It is now thread safe.
+// v1.4 19th October 2026: CRC-32C and CRC-64, with the same streaming interface and the same
+// choice of implementations.
+// v1.5 19th October 2026: Ncrc template for any CRC up to 64 bits in the Rocksoft model, with
+// tables generated at compile time. computeCrc keeps the register in an integer up to 64 bits.
+// v1.6 19th October 2026: Combining the CRCs of consecutive blocks, for every CRC here, and
+// CRC-32, CRC-32C and CRC-64 of memory and files computed in parallel on an NthreadPool.
+// v1.7 19th October 2026: computeFileCrc32 for a path or file descriptor, mapping the file or
+// reading it with O_DIRECT, without going through stdio.
+
+#include <stdint.h>
+
+#include <string>
+#include <type_traits>
+#include <vector>
 
 #include "nbinary.h"
 
+class NthreadPool;
+
 unsigned long computeMemoryCrc32(   const unsigned char* theBuffer,
                                     const size_t         theBufferLength,
                                     const unsigned long  thePreviousCrc32 = 0 );
@@ -19,6 +39,66 @@ unsigned long computeMemoryCrc32(   const unsigned char* theBuffer,
     //    Calculated CRC-32.
 
 
+unsigned long computeMemoryCrc32c(  const unsigned char* theBuffer,
+                                    const size_t         theBufferLength,
+                                    const unsigned long  thePreviousCrc32c = 0 );
+    // As computeMemoryCrc32, for CRC-32C ( Castagnoli ), as used by iSCSI, SCTP, ext4 and
+    // others. The SSE4.2 and ARMv8 CRC32 instructions compute this one directly.
+
+
+unsigned long long computeMemoryCrc64(  const unsigned char*     theBuffer,
+                                        const size_t             theBufferLength,
+                                        const unsigned long long thePreviousCrc64 = 0 );
+    // As computeMemoryCrc32, for the 64 bit CRC on the ECMA-182 polynomial, reflected and
+    // inverted like CRC-32. Known as CRC-64/XZ, as used by xz and Go's crc64.ECMA.
+    // "123456789" gives 0x995DC9BBDF1939FA.
+
+
+unsigned long combineCrc32( const unsigned long theCrc32A, const unsigned long theCrc32B, const unsigned long long theLengthB );
+unsigned long combineCrc32c( const unsigned long theCrc32cA, const unsigned long theCrc32cB, const unsigned long long theLengthB );
+unsigned long long combineCrc64( const unsigned long long theCrc64A, const unsigned long long theCrc64B, const unsigned long long theLengthB );
+    // Given the CRCs of two blocks A and B computed separately, and B's length in bytes, returns
+    // the CRC of A followed by B, as if B had been computed with thePreviousCrc set to A's CRC.
+    // Takes a few microseconds whatever the length, so blocks can be computed out of order or in
+    // parallel and put together afterwards.
+
+
+unsigned long computeMemoryCrc32(   const unsigned char* theBuffer,
+                                    const size_t         theBufferLength,
+                                    NthreadPool&         thePool,
+                                    const unsigned long  thePreviousCrc32 = 0 );
+unsigned long computeMemoryCrc32c(  const unsigned char* theBuffer,
+                                    const size_t         theBufferLength,
+                                    NthreadPool&         thePool,
+                                    const unsigned long  thePreviousCrc32c = 0 );
+unsigned long long computeMemoryCrc64(  const unsigned char*     theBuffer,
+                                        const size_t             theBufferLength,
+                                        NthreadPool&             thePool,
+                                        const unsigned long long thePreviousCrc64 = 0 );
+    // As above, with the buffer split between thePool's threads and the calling thread, and the
+    // pieces' CRCs combined. Buffers under a megabyte are done by the calling thread alone.
+    // Uses Nparallel, so is safe to call from a job running on thePool.
+
+
+const char* getCrc32Implementation();
+    // Name of the implementation computeMemoryCrc32 uses, e.g. "pclmul".
+
+std::vector< std::string > getCrc32Implementations();
+    // Names of the implementations this CPU supports, fastest first.
+
+bool setCrc32Implementation( const char* theName );
+    // Makes computeMemoryCrc32 use the named implementation, for testing and benchmarking.
+    // "" or NULL goes back to the fastest. Returns false if the CPU doesn't support theName.
+
+const char* getCrc32cImplementation();
+std::vector< std::string > getCrc32cImplementations();
+bool setCrc32cImplementation( const char* theName );
+const char* getCrc64Implementation();
+std::vector< std::string > getCrc64Implementations();
+bool setCrc64Implementation( const char* theName );
+    // The same for computeMemoryCrc32c and computeMemoryCrc64.
+
+
 bool computeFileCrc32(  FILE*                theFile,
                         unsigned long*       theCrc32,
                         const unsigned long  theChunkSize = 8192 );
@@ -31,6 +111,36 @@ bool computeFileCrc32(  FILE*                theFile,
     // Return:
     //    true on success, false on file error.
 
+bool computeFileCrc32(  FILE*                theFile,
+                        unsigned long*       theCrc32,
+                        NthreadPool&         thePool,
+                        const unsigned long  theChunkSize = 1024 * 1024 );
+    // As above, with thePool's threads each reading and computing chunks of the file, for
+    // multi-gigabyte files. The file is read from its current position to the end with pread(),
+    // and left positioned at the end. Anything but a regular file is read serially as above, as
+    // are files that report a size of 0, such as those in /proc.
+
+
+typedef enum
+    {
+    CRC_FILE_MAPPED,    // mmap() a window at a time, with MADV_SEQUENTIAL read-ahead.
+    CRC_FILE_DIRECT     // O_DIRECT reads into aligned buffers, a thread reading the next buffer
+                        // while the last is CRCed. Doesn't fill the page cache with the file.
+    } CRC_FILE_ACCESS;
+
+bool computeFileCrc32(  const char*           thePath,
+                        unsigned long*        theCrc32,
+                        const CRC_FILE_ACCESS theAccess = CRC_FILE_MAPPED );
+bool computeFileCrc32(  const int             theFd,
+                        unsigned long*        theCrc32,
+                        const CRC_FILE_ACCESS theAccess = CRC_FILE_MAPPED );
+    // As above, for the file at thePath, or from theFd's current position to the end, leaving
+    // it at the end. Files that can't be mapped ( pipes, /proc etc ) and file systems without
+    // O_DIRECT are read through the same double buffering without it. For CRC_FILE_DIRECT, O_DIRECT is
+    // set on theFd while the file is read. A mapped file truncated while it is being read gets
+    // the process a SIGBUS, so use CRC_FILE_DIRECT for files that others may be writing.
+    // Return: true on success, false on file error, with errno set.
+
 
 void computeCrc(    const Nbinary& data,
                     const Nbinary& poly,
@@ -45,6 +155,194 @@ void computeCrc(    const Nbinary& data,
     //                                   but conventionally is always 1.
     //    initial: starting CRC value.
     //    result:  Returned CRC.
+    // Widths up to 64 bits are computed in an integer register. For whole bytes in a fixed
+    // CRC, Ncrc below is far faster.
+
+
+namespace NCRC
+{
+// Compile time helpers for Ncrc. C++11 constexpr functions are a single return statement.
+constexpr uint64_t reflect( const uint64_t theValue, const unsigned int theBits )
+{
+    return theBits ? ( ( theValue & 1 ) << ( theBits - 1 ) ) | reflect( theValue >> 1, theBits - 1 ) : 0;
+}
+
+constexpr uint64_t shiftReflected( const uint64_t theRegister, const uint64_t thePoly, const unsigned int theBits )
+{
+    return theBits ? shiftReflected( ( theRegister & 1 ) ? ( theRegister >> 1 ) ^ thePoly : theRegister >> 1, thePoly, theBits - 1 ) : theRegister;
+}
+
+constexpr uint64_t shiftNormal( const uint64_t theRegister, const uint64_t thePoly, const unsigned int theWidth, const unsigned int theBits )
+{
+    return theBits ? shiftNormal( ( ( theRegister << 1 ) ^ ( ( ( theRegister >> ( theWidth - 1 ) ) & 1 ) ? thePoly : 0 ) ) & ( ~0ULL >> ( 64 - theWidth ) ),
+                                  thePoly, theWidth, theBits - 1 )
+                   : theRegister;
+}
+
+uint64_t multiplyModP( const uint64_t theA, const uint64_t theB, const uint64_t thePoly, const unsigned int theWidth );
+uint64_t xPowerModP( const uint64_t thePower, const uint64_t thePoly, const unsigned int theWidth );
+// For combining CRCs. Polynomials of theWidth bits in normal form, thePoly without its x^theWidth term.
+
+template< unsigned int... N > struct INDICES {};
+template< unsigned int COUNT, unsigned int... N > struct MAKE_INDICES : MAKE_INDICES< COUNT - 1, COUNT - 1, N... > {};
+template< unsigned int... N > struct MAKE_INDICES< 0, N... > { typedef INDICES< N... > type; };
+}
+
+
+template< unsigned int WIDTH, uint64_t POLY, uint64_t INIT, bool REFIN, bool REFOUT, uint64_t XOROUT >
+class Ncrc
+{
+public:
+    // A CRC of WIDTH bits ( 1 to 64 ) in the Rocksoft model, as used by the CRC catalogue at
+    // reveng.sourceforge.io: POLY in normal form without its x^WIDTH term, INIT the register's
+    // starting value, REFIN true if each byte is taken LSB first, REFOUT true if the register
+    // is reflected before XOROUT is applied to it.
+    // The tables are built by the compiler. Long buffers are done 8 bytes at a time.
+    // See the typedefs below for the common ones.
+
+    static const unsigned int SHIFT = ( !REFIN && ( WIDTH < 8 ) ) ? 8 - WIDTH : 0;
+    static const unsigned int BITS = WIDTH + SHIFT;
+    // Registers that aren't reflected are kept at least a byte wide, with the CRC in the top bits.
+
+    typedef typename std::conditional< ( BITS <= 8 ), uint8_t,
+            typename std::conditional< ( BITS <= 16 ), uint16_t,
+            typename std::conditional< ( BITS <= 32 ), uint32_t, uint64_t >::type >::type >::type VALUE;
+    // Smallest type holding the CRC
+
+    Ncrc() : m_register( initialRegister() ) {}
+
+    void update( const void* theBuffer, const size_t theLength ) { m_register = process( m_register, (const unsigned char*)theBuffer, theLength ); }
+    // Adds theBuffer to the CRC, for data that arrives in pieces.
+
+    VALUE getValue() const { return finalise( m_register ); }
+    // CRC of everything so far.
+
+    void reset() { m_register = initialRegister(); }
+
+    static VALUE compute( const void* theBuffer, const size_t theLength ) { return finalise( process( initialRegister(), (const unsigned char*)theBuffer, theLength ) ); }
+    // CRC of one buffer.
+
+    static constexpr VALUE check() { return finalise( bytewise( initialRegister(), "123456789", 9 ) ); }
+    // The catalogue's check value, worked out by the compiler.
+
+    static VALUE combine( const VALUE theCrcA, const VALUE theCrcB, const uint64_t theLengthB )
+    {
+        // A's register, less what INIT contributes, carried on over theLengthB zero bytes
+        return fromNormal( toNormal( theCrcB ) ^ NCRC::multiplyModP( toNormal( theCrcA ) ^ ( INIT & WIDTH_MASK ),
+                                                                     NCRC::xPowerModP( theLengthB * 8, POLY, WIDTH ), POLY, WIDTH ) );
+    }
+    // The CRC of A followed by B, from their CRCs and B's length in bytes.
+
+private:
+    static_assert( ( WIDTH >= 1 ) && ( WIDTH <= 64 ), "Ncrc: WIDTH must be 1 to 64 bits" );
+
+    static constexpr uint64_t MASK = ~0ULL >> ( 64 - BITS );
+    static constexpr uint64_t WIDTH_MASK = ~0ULL >> ( 64 - WIDTH );
+    static constexpr uint64_t TABLE_POLY = REFIN ? NCRC::reflect( POLY, WIDTH ) : POLY << SHIFT;
+
+    typedef struct
+        {
+        VALUE   slice[ 8 ][ 256 ];
+        } TABLES;
+    // slice[0] is for a byte at a time, slice[k][n] the register after n followed by k zero bytes.
+
+    static const TABLES m_tables;
+
+    static constexpr VALUE initialRegister() { return REFIN ? NCRC::reflect( INIT, WIDTH ) : INIT << SHIFT; }
+
+    static constexpr VALUE byteEntry( const uint64_t theByte )
+    {
+        return REFIN ? NCRC::shiftReflected( theByte, TABLE_POLY, 8 )
+                     : NCRC::shiftNormal( theByte << ( BITS - 8 ), TABLE_POLY, BITS, 8 );
+    }
+
+    static constexpr VALUE shiftByte( const VALUE theRegister, const unsigned char theByte, const VALUE ( &theTable )[ 256 ] )
+    {
+        return REFIN ? theTable[ ( theRegister ^ theByte ) & 0xFF ] ^ ( (uint64_t)theRegister >> 8 )
+                     : theTable[ ( ( theRegister >> ( BITS - 8 ) ) ^ theByte ) & 0xFF ] ^ ( ( (uint64_t)theRegister << 8 ) & MASK );
+    }
+
+    static constexpr VALUE zeroByte( const VALUE theRegister )
+    {
+        return REFIN ? byteEntry( theRegister & 0xFF ) ^ ( (uint64_t)theRegister >> 8 )
+                     : byteEntry( theRegister >> ( BITS - 8 ) ) ^ ( ( (uint64_t)theRegister << 8 ) & MASK );
+    }
+
+    static constexpr VALUE entry( const unsigned int theSlice, const unsigned int theByte )
+    {
+        return theSlice ? zeroByte( entry( theSlice - 1, theByte ) ) : byteEntry( theByte );
+    }
+
+    template< unsigned int... N >
+    static constexpr TABLES makeTables( NCRC::INDICES< N... > )
+    {
+        return TABLES { { { entry( 0, N )... }, { entry( 1, N )... }, { entry( 2, N )... }, { entry( 3, N )... },
+                          { entry( 4, N )... }, { entry( 5, N )... }, { entry( 6, N )... }, { entry( 7, N )... } } };
+    }
+
+    static constexpr VALUE bytewise( const VALUE theRegister, const char* theBuffer, const size_t theLength )
+    {
+        return theLength ? bytewise( shiftByte( theRegister, *theBuffer, m_tables.slice[0] ), theBuffer + 1, theLength - 1 ) : theRegister;
+    }
+
+    static VALUE process( VALUE theRegister, const unsigned char* theBuffer, size_t theLength )
+    {
+        const TABLES& t = m_tables;
+        for ( ; theLength >= 8; theBuffer += 8, theLength -= 8 )
+            {
+            // Each byte, with the register added to the first of them, looked up independently
+            uint64_t v = REFIN ? (uint64_t)theRegister : (uint64_t)theRegister << ( 64 - BITS );
+            for ( int i = 0; i < 8; i++ )
+                v ^= (uint64_t)theBuffer[i] << ( REFIN ? i * 8 : 56 - ( i * 8 ) );
+
+            VALUE r = 0;
+            for ( int i = 0; i < 8; i++ )
+                r ^= t.slice[ 7 - i ][ ( v >> ( REFIN ? i * 8 : 56 - ( i * 8 ) ) ) & 0xFF ];
+            theRegister = r;
+            }
+
+        for ( ; theLength; theLength--, theBuffer++ )
+            theRegister = shiftByte( theRegister, *theBuffer, t.slice[0] );
+        return theRegister;
+    }
+
+    static constexpr VALUE finalise( const VALUE theRegister )
+    {
+        return ( ( REFIN == REFOUT ) ? theRegister >> SHIFT : NCRC::reflect( theRegister >> SHIFT, WIDTH ) ) ^ ( XOROUT & WIDTH_MASK );
+    }
+
+    // The CRC as it would be in an unreflected register, and back
+    static uint64_t toNormal( const VALUE theCrc ) { return REFOUT ? NCRC::reflect( theCrc ^ ( XOROUT & WIDTH_MASK ), WIDTH ) : theCrc ^ ( XOROUT & WIDTH_MASK ); }
+    static VALUE fromNormal( const uint64_t theNormal ) { return ( REFOUT ? NCRC::reflect( theNormal, WIDTH ) : theNormal ) ^ ( XOROUT & WIDTH_MASK ); }
+
+    VALUE   m_register;
+};
+
+template< unsigned int WIDTH, uint64_t POLY, uint64_t INIT, bool REFIN, bool REFOUT, uint64_t XOROUT >
+constexpr typename Ncrc< WIDTH, POLY, INIT, REFIN, REFOUT, XOROUT >::TABLES Ncrc< WIDTH, POLY, INIT, REFIN, REFOUT, XOROUT >::m_tables =
+    Ncrc< WIDTH, POLY, INIT, REFIN, REFOUT, XOROUT >::makeTables( typename NCRC::MAKE_INDICES< 256 >::type() );
+
+// From the CRC catalogue, with what uses them
+typedef Ncrc< 8,  0x07,               0x00,               false, false, 0x00 >               Ncrc8Smbus;         // SMBus PEC, ATM HEC
+typedef Ncrc< 8,  0x1D,               0xFF,               false, false, 0xFF >               Ncrc8SaeJ1850;      // SAE J1850, AUTOSAR
+typedef Ncrc< 8,  0x2F,               0xFF,               false, false, 0xFF >               Ncrc8Autosar;       // AUTOSAR E2E profile 2
+typedef Ncrc< 8,  0x31,               0x00,               true,  true,  0x00 >               Ncrc8Maxim;         // Dallas/Maxim 1-Wire
+typedef Ncrc< 15, 0x4599,             0x0000,             false, false, 0x0000 >             Ncrc15Can;          // Classic CAN
+typedef Ncrc< 16, 0x1021,             0xFFFF,             false, false, 0x0000 >             Ncrc16Ibm3740;      // a.k.a. CRC-16/CCITT-FALSE
+typedef Ncrc< 16, 0x1021,             0x0000,             false, false, 0x0000 >             Ncrc16Xmodem;
+typedef Ncrc< 16, 0x1021,             0x0000,             true,  true,  0x0000 >             Ncrc16Kermit;       // a.k.a. CRC-16/CCITT
+typedef Ncrc< 16, 0x1021,             0xFFFF,             true,  true,  0xFFFF >             Ncrc16IbmSdlc;      // HDLC, X.25
+typedef Ncrc< 16, 0x8005,             0x0000,             true,  true,  0x0000 >             Ncrc16Arc;
+typedef Ncrc< 16, 0x8005,             0xFFFF,             true,  true,  0x0000 >             Ncrc16Modbus;
+typedef Ncrc< 17, 0x1685B,            0x00000,            false, false, 0x00000 >            Ncrc17CanFd;        // CAN FD up to 16 data bytes
+typedef Ncrc< 21, 0x102899,           0x000000,           false, false, 0x000000 >           Ncrc21CanFd;        // CAN FD over 16 data bytes
+typedef Ncrc< 24, 0x864CFB,           0xB704CE,           false, false, 0x000000 >           Ncrc24OpenPgp;
+typedef Ncrc< 32, 0x04C11DB7,         0xFFFFFFFF,         true,  true,  0xFFFFFFFF >         Ncrc32IsoHdlc;      // As computeMemoryCrc32
+typedef Ncrc< 32, 0x04C11DB7,         0xFFFFFFFF,         false, false, 0xFFFFFFFF >         Ncrc32Bzip2;
+typedef Ncrc< 32, 0x1EDC6F41,         0xFFFFFFFF,         true,  true,  0xFFFFFFFF >         Ncrc32Iscsi;        // As computeMemoryCrc32c
+typedef Ncrc< 64, 0x42F0E1EBA9EA3693, 0x0000000000000000, false, false, 0x0000000000000000 > Ncrc64Ecma182;
+typedef Ncrc< 64, 0x42F0E1EBA9EA3693, 0xFFFFFFFFFFFFFFFF, true,  true,  0xFFFFFFFFFFFFFFFF > Ncrc64Xz;           // As computeMemoryCrc64
+// For CAN, which CRCs a frame's bits rather than whole bytes, use computeCrc.
 
 // Useful note to remember: If the data you perform a CRC on already has a previously
 // computed and valid CRC appended to it, the resultant CRC will always be 0.
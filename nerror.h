@@ -266,9 +266,27 @@ public:
     template <typename ...Msgs>
     static std::string Compose( Msgs&&... msgs )
         {
-        std::ostringstream* mBuf = new std::ostringstream;
-        std::string msg = compose2( *mBuf, msgs... );
-        delete mBuf;
+        // Each thread reuses one stream, as setting up an ostringstream costs more than
+        // formatting a typical message. A message composed while formatting another one
+        // (i.e. from inside an operator<<) gets a stream of its own.
+        std::ostringstream* msgBuf = claimComposeBuffer();
+        if ( !msgBuf )
+            {
+            std::ostringstream nestedBuf;
+            return compose2( nestedBuf, msgs... );
+            }
+
+        std::string msg;
+        try
+            {
+            msg = compose2( *msgBuf, msgs... );
+            }
+        catch ( ... )
+            {
+            releaseComposeBuffer();
+            throw;
+            }
+        releaseComposeBuffer();
         return msg;
         }
 
@@ -298,6 +316,12 @@ private:
         }
 
     static std::string compose2( std::ostringstream& msgBuf );
+
+    static std::ostringstream* claimComposeBuffer();
+    // The calling thread's stream for Compose(), or NULL if it's already composing a message.
+    static void releaseComposeBuffer();
+    // Clears the stream for the thread's next message.
+
     static bool m_useSysLog;
 };
 
@@ -1,18 +1,41 @@
 #ifndef NEVENT_H
 #define NEVENT_H
 
-// Nevent v2.3 by Neil Cooper 13th Nov 2014
-// Implements an easy-to-use pthread mutex based event object.
-
-#include <pthread.h>  // for pthread_mutex_t and pthread_cond_t
+// Nevent v3.4 by Neil Cooper 18th October 2026
+// Implements an easy-to-use Win32-like event object.
+// The event state and the number of waiting threads share one atomic word, so signalling an
+// event nobody is waiting on, or waiting on an event that is already signalled, is a single
+// atomic operation with no system call. Threads that do have to wait sleep on a futex (on
+// systems without futexes, a shared pthread condition stands in for one).
+// Timed waits run on the monotonic clock, so changes to the system time don't affect them.
+// Like Win32's WaitForMultipleObjects(), a thread can wait for any or all of several events, and
+// an event can provide an eventfd to sit in a poll()/epoll set alongside sockets.
+// While a multiple wait or an eventfd is watching an event, signalling it takes a lock.
+// Counting events can count up to 2^32 - 1, and up to 65535 threads may wait on an event.
+// When built with NLIB_LOCK_PROFILING, events record how often and how long threads waited for
+// them (see nlockProfile.h).
+// A wait can be given an NstopToken, to return early when its thread is asked to stop.
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
 #include "ntime.h"
 
+#ifdef NLIB_LOCK_PROFILING
+#include "nlockProfile.h"
+#endif
+
+class NstopToken;
+
 class Nevent
 {
 public:
     Nevent( const bool           theCountingEventFlag = false,
             const unsigned long  theInitialState = 0,
-            const bool           theManualResetFlag = false   );
+            const bool           theManualResetFlag = false,
+            const std::string&   theName = ""                 );
+    // theName: Identifies the event in lock profiling. Empty = kind and address.
 
     virtual ~Nevent();
 
@@ -40,29 +63,80 @@ public:
     //                  0 = infinite ( i.e. don't return until signalled ).
     //  Return: false if timeout occurred. Always returns true if theTimeout == 0.
 
+    bool wait( const Ndeadline& theDeadline );
+    //  As above, but waits until theDeadline (an infinite deadline waits forever).
+    //  Use when waiting in a loop, so that the loop as a whole times out.
+
+    bool wait( const Ntime theTimeout, const NstopToken& theStopToken );
+    bool wait( const Ndeadline& theDeadline, const NstopToken& theStopToken );
+    //  As above, but also returns (false) as soon as a stop is requested through theStopToken.
+
+    bool tryWait();
+    //  As wait() but never blocks. Return: true if the event was signalled (and has been reset
+    //  or decremented as wait() would), false if not.
+
+    int getFd();
+    //  Returns an eventfd that polls readable while the event is signalled, for use with
+    //  poll()/epoll alongside other fds. Call tryWait() when it is readable: it may occasionally
+    //  be readable when the event has already been taken by another thread.
+    //  Created on first call and closed when the event is destroyed.
+
+    static int waitAny( const std::vector< Nevent* >& theEvents, const Ntime theTimeout = 0 );
+    static int waitAny( const std::vector< Nevent* >& theEvents, const Ndeadline& theDeadline );
+    //  Waits for any of theEvents to be signalled, and takes that one event as wait() would.
+    //  Return: Index in theEvents of the event taken (the first, if several are signalled),
+    //          or -1 if the timeout occurred.
+
+    static bool waitAll( const std::vector< Nevent* >& theEvents, const Ntime theTimeout = 0 );
+    static bool waitAll( const std::vector< Nevent* >& theEvents, const Ndeadline& theDeadline );
+    //  Waits until all of theEvents are signalled at once, then takes them all as wait() would.
+    //  If another thread takes one of them while they are being taken, the ones already taken
+    //  are signalled again and the wait carries on. Each event should only appear once.
+    //  Return: false if the timeout occurred.
+
 
 private:
+   Nevent( const Nevent& );              // Not copyable
+   Nevent& operator=( const Nevent& );
 
-   void changeBoolEventState( const bool theState );
+   typedef std::atomic< uint32_t > WATCHER;  // Futex word a multiple wait sleeps on
 
-   void changeCountingEventState( const long theChange );
+   bool tryConsume();
 
-   void resetCountingEventState();
+   static bool tryConsumeAll( const std::vector< Nevent* >& theEvents );
 
-   pthread_mutex_t   m_accessMutex;
-   pthread_cond_t    m_condition;
-   bool              m_isCountingEvent;
-   bool              m_isManualReset;
+   bool getSignalledState( const uint64_t theState, uint64_t* theSignalledState );
 
-   union
-      {
-      bool           m_boolEvent;
-      unsigned long  m_countingEvent;
-      } m_eventUnion;
-};
+   void signalWatched();
+
+   static void addWatcher( const std::vector< Nevent* >& theEvents, WATCHER* theWatcher );
 
+   static void removeWatcher( const std::vector< Nevent* >& theEvents, WATCHER* theWatcher );
 
+   uint32_t* getFutexWord();
+
+#ifdef NLIB_LOCK_PROFILING
+   static unsigned long long profileNow() { return NlockProfile::now(); }
+   void profileTaken( const unsigned long long theWaitStartNs ) { m_profile.acquired( theWaitStartNs ); }
+#else
+   static unsigned long long profileNow() { return 0; }
+   void profileTaken( const unsigned long long ) {}
 #endif
 
+   // Bits 0-31: event state (0/1 or count). This half is also the futex word waiters sleep on.
+   // Bits 32-47: number of threads in wait() (or about to be).
+   // Bits 48-63: number of multiple waits and eventfds watching the event. signal() has to
+   //             take the watcher lock to notify these, so they share the word with the state
+   //             to stop it changing under a watcher that is registering.
+   std::atomic< uint64_t >  m_state;
+   bool                     m_isCountingEvent;
+   bool                     m_isManualReset;
+   std::vector< WATCHER* >  m_watchers;   // Owned by the watcher lock
+   std::atomic< int >       m_fd;
+#ifdef NLIB_LOCK_PROFILING
+   NlockProfile             m_profile;
+#endif
+};
 
 
+#endif
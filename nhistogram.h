@@ -0,0 +1,148 @@
+#ifndef NHISTOGRAM_H
+#define NHISTOGRAM_H
+
+// Nhistogram v1.0 by Neil Cooper 19th October 2026
+// Histograms of latencies ( or any other unsigned 64 bit values ) that keep their percentiles,
+// in the style of HdrHistogram: a fixed number of buckets, exact at small values and then
+// log-linear, so every value is recorded to within a fixed relative precision however large it
+// is. Recording is an index calculation and an increment, with no allocation or locking.
+//   Nhistogram:            Recorded into by one thread at a time. Merges, gives percentiles,
+//                          and serialises to a compact string to send to a collector.
+//   NconcurrentHistogram:  Recorded into by any number of threads without locks or contention:
+//                          each thread records into its own Nhistogram-like shard, and
+//                          getSnapshot() merges them.
+// NthreadPool, Nsocket, Npsql and Nsqlite can record their timings into NconcurrentHistograms
+// directly; see their setLatencyHistogram... () methods.
+
+#include <pthread.h>
+#include <stdint.h>
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "nspinlock.h"
+#include "ntime.h"
+
+class Nhistogram
+{
+    friend class NconcurrentHistogram;
+
+public:
+    static const unsigned int DEFAULT_PRECISION = 7;
+    static const unsigned int MAX_PRECISION = 12;
+
+    explicit Nhistogram( const unsigned int thePrecision = DEFAULT_PRECISION );
+    // thePrecision: Bits kept below a value's top bit, 1 to MAX_PRECISION. Values are recorded
+    // to within 1 part in 2^thePrecision ( 0.8% by default ), and exactly below 2^(thePrecision+1).
+    // Takes ( 65 - thePrecision ) * 2^thePrecision counts of 8 bytes: 58KB by default.
+
+    void record( const uint64_t theValue, const uint64_t theCount = 1 )
+    {
+        m_counts[ getIndex( theValue, m_precision ) ] += theCount;
+        m_count += theCount;
+        if ( theValue < m_min )
+            m_min = theValue;
+        if ( theValue > m_max )
+            m_max = theValue;
+    }
+
+    void recordElapsed( const Ntimestamp& theStart, const Ntimestamp::CLOCK theClock = Ntimestamp::MONOTONIC )
+    {
+        record( theStart.getElapsed( theClock ).getAsNs() );
+    }
+    // Records the ns since theStart, which came from Ntimestamp::now( theClock ).
+
+    void merge( const Nhistogram& theHistogram );
+    // Adds theHistogram's counts to this one's. Histograms of a different precision are merged
+    // to the lower of the two precisions.
+
+    void reset();
+
+    uint64_t getCount() const { return m_count; }
+    uint64_t getMin() const { return m_count ? m_min : 0; }
+    uint64_t getMax() const { return m_max; }
+    double getMean() const;
+    // Exact for min and max. The mean counts each value as the middle of its bucket.
+
+    uint64_t getPercentile( const double thePercentile ) const;
+    // The value thePercentile % ( 0 to 100 ) of recorded values are at or below, to the
+    // histogram's precision: e.g. getPercentile( 99.9 ). 0 if nothing has been recorded.
+
+    unsigned int getPrecision() const { return m_precision; }
+
+    void dump( std::ostream& theStream ) const;
+    // Writes the count, min, mean, p50, p90, p99, p99.9 and max on one line.
+
+    std::string serialise() const;
+    // The histogram in a compact binary form: only buckets with counts are written, as a gap
+    // from the last one and a count, in LEB128 varints. Typically a few hundred bytes.
+
+    void deserialise( const std::string& theData );
+    // Replaces the histogram with one from serialise(), e.g. in a collector, which can then
+    // merge() it into its totals. Throws if theData isn't a serialised histogram.
+
+    static size_t getIndex( const uint64_t theValue, const unsigned int thePrecision )
+    {
+        // Values up to 2^(precision+1) have a bucket each. Above that, a value's bucket is its
+        // top precision+1 bits, after the buckets of all the shorter values.
+        unsigned int top = 63 - __builtin_clzll( theValue | 1 );
+        unsigned int shift = ( top > thePrecision ) ? top - thePrecision : 0;
+        return ( (size_t)shift << thePrecision ) + ( theValue >> shift );
+    }
+
+    static uint64_t getLowestValue( const size_t theIndex, const unsigned int thePrecision );
+    static uint64_t getHighestValue( const size_t theIndex, const unsigned int thePrecision );
+    // The range of values recorded in bucket theIndex.
+
+private:
+    std::vector< uint64_t > m_counts;
+    unsigned int            m_precision;
+    uint64_t                m_count;
+    uint64_t                m_min;
+    uint64_t                m_max;
+};
+
+
+class NconcurrentHistogram
+{
+public:
+    explicit NconcurrentHistogram( const unsigned int thePrecision = Nhistogram::DEFAULT_PRECISION );
+    // As Nhistogram's. Each thread that records takes that much memory again, held until the
+    // histogram is destroyed. A thread's shard is reused by later threads that reuse its id.
+
+    ~NconcurrentHistogram();
+
+    void record( const uint64_t theValue );
+
+    void recordElapsed( const Ntimestamp& theStart, const Ntimestamp::CLOCK theClock = Ntimestamp::MONOTONIC )
+    {
+        record( theStart.getElapsed( theClock ).getAsNs() );
+    }
+
+    Nhistogram getSnapshot() const;
+    // Everything recorded so far by all threads. Values being recorded while the snapshot is
+    // taken may or may not be in it.
+
+private:
+    NconcurrentHistogram( const NconcurrentHistogram& );              // Not copyable
+    NconcurrentHistogram& operator=( const NconcurrentHistogram& );
+
+    typedef struct
+        {
+        pthread_t                   thread;
+        std::atomic< uint64_t >*    counts;     // Only written by thread, so relaxed loads and stores
+        std::atomic< uint64_t >     min;
+        std::atomic< uint64_t >     max;
+        } SHARD;
+
+    SHARD* getShard();
+    SHARD* findShard();
+
+    unsigned int            m_precision;
+    uint64_t                m_id;           // Never reused, unlike addresses, for threads' shard caches
+    std::vector< SHARD* >   m_shards;
+    mutable Nspinlock       m_shardsOwner;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef NLOCKPROFILE_H
+#define NLOCKPROFILE_H
+
+// NlockProfile v1.0 by Neil Cooper 18th October 2026
+// Lock contention profiling for Nmutex and Nevent, to find which locks are hot.
+// Only built in when NLIB_LOCK_PROFILING is defined (cmake -DLOCK_PROFILING=ON). The library
+// and everything that includes nmutex.h or nevent.h must be built with the same setting, as it
+// changes the size of those classes. Without it, Nmutex and Nevent contain no profiling code
+// or data at all, and the static methods below report nothing.
+// While profiling, each Nmutex and Nevent records how often it was taken, how often a thread
+// had to wait for it, the total and longest wait, and (for Nmutex) the total time it was held.
+// Every profiled lock is listed in a global registry that can be dumped at any time, or when
+// the process receives a signal (e.g. kill -USR1 <pid>).
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <signal.h>     // for SIGUSR1
+
+class NlockProfile
+{
+public:
+    typedef struct
+        {
+        std::string         name;           // As given to the lock's constructor, or kind@address
+        unsigned long long  acquisitions;   // Times the lock was taken
+        unsigned long long  contentions;    // Times a thread had to wait to take it
+        unsigned long long  totalWaitNs;
+        unsigned long long  maxWaitNs;
+        unsigned long long  totalHoldNs;    // Nmutex only
+        } LOCK_STATS;
+
+    NlockProfile( const char* theKind, const void* theLock, const std::string& theName );
+    // Registers a lock. theKind and theLock name it if theName is empty.
+
+    ~NlockProfile();
+
+    void acquired( const unsigned long long theWaitStartNs );
+    // Records that the lock was taken. theWaitStartNs: when the thread started waiting, or 0
+    // if it got the lock without waiting.
+
+    void held();
+    void released();
+    // Record when a lock that has an owner was locked and unlocked, for hold time. Only to be
+    // called by the thread holding the lock.
+
+    static unsigned long long now();
+    // Monotonic clock in ns.
+
+    static std::vector< LOCK_STATS > getStats( const size_t theCount = 0 );
+    // Returns the theCount most contended locks (0 = all), most contended first.
+
+    static void dump( std::ostream& theStream, const size_t theCount = 10 );
+    // Writes the theCount most contended locks to theStream as a table.
+
+    static void dumpOnSignal( const int theSignal = SIGUSR1, const size_t theCount = 10 );
+    // From now on, theSignal makes the process dump the theCount most contended locks to stderr.
+    // The dump is written by a helper thread, as a signal handler can't safely do it.
+
+private:
+    NlockProfile( const NlockProfile& );              // Not copyable
+    NlockProfile& operator=( const NlockProfile& );
+
+    static void* dumpThreadProc( void* theParam );
+    static void signalHandler( int theSignal );
+
+    std::string                         m_name;
+    std::atomic< unsigned long long >   m_acquisitions;
+    std::atomic< unsigned long long >   m_contentions;
+    std::atomic< unsigned long long >   m_totalWaitNs;
+    std::atomic< unsigned long long >   m_maxWaitNs;
+    std::atomic< unsigned long long >   m_totalHoldNs;
+    unsigned long long                  m_holdStartNs;  // Only used by the thread holding the lock
+    unsigned int                        m_holdDepth;    // Likewise. For recursive mutexes.
+};
+
+#endif
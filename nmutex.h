@@ -1,12 +1,20 @@
 #ifndef NMUTEX_H
 #define NMUTEX_H
 
-// nmutex v1.1 by Neil Cooper 14th Nov 2014
+// nmutex v1.3 by Neil Cooper 18th October 2026
 // Implements an easy-to-use pthread-based mutex object.
+// When built with NLIB_LOCK_PROFILING, mutexes record how often and how long threads waited for
+// them and how long they were held (see nlockProfile.h).
+// NlockGuard locks any of the Nlib locks (Nmutex, Nspinlock, NrwLock for writing) for the
+// lifetime of the guard, so it is unlocked however the scope is left.
 
 #include <string>        // for std::string
 #include <pthread.h>    // for pthread_mutex_t and pthread_cond_t
 
+#ifdef NLIB_LOCK_PROFILING
+#include "nlockProfile.h"
+#endif
+
 class Nmutex
 {
 public:
@@ -19,6 +27,9 @@ public:
     //  The owning thread must call Release the same number of times before
     //  the mutex returns to the unlocked state.
     //  RECURSIVE best approximates WIN32 behaviour
+    //  ADAPTIVE behaves as FAST, but a thread that finds the mutex locked spins for a short
+    //  while before sleeping, which suits very short critical sections under contention.
+    //  Where the platform has no adaptive mutex, ADAPTIVE is the same as FAST.
 
 
 #if defined ( __CYGWIN__ ) || defined( __ANDROID__ ) 
@@ -26,7 +37,8 @@ public:
         {
         FAST            = PTHREAD_MUTEX_NORMAL,
         ERRORCHECK	= PTHREAD_MUTEX_ERRORCHECK,
-        RECURSIVE	= PTHREAD_MUTEX_RECURSIVE
+        RECURSIVE	= PTHREAD_MUTEX_RECURSIVE,
+        ADAPTIVE        = PTHREAD_MUTEX_NORMAL
 
         }	MUTEX_TYPE;
 #else
@@ -34,13 +46,15 @@ public:
         {
         FAST            = PTHREAD_MUTEX_FAST_NP,
         ERRORCHECK	= PTHREAD_MUTEX_ERRORCHECK_NP,
-        RECURSIVE	= PTHREAD_MUTEX_RECURSIVE_NP
+        RECURSIVE	= PTHREAD_MUTEX_RECURSIVE_NP,
+        ADAPTIVE        = PTHREAD_MUTEX_ADAPTIVE_NP
 
         }	MUTEX_TYPE;
 #endif
 
 
-    Nmutex( MUTEX_TYPE theType = FAST );
+    Nmutex( MUTEX_TYPE theType = FAST, const std::string& theName = "" );
+    // theName: Identifies the mutex in lock profiling. Empty = kind and address.
     virtual ~Nmutex();
 
     void lock();
@@ -60,7 +74,28 @@ public:
     // Unlocks the mutex (which has been previously locked by the calling thread).
 
     private:
+    Nmutex( const Nmutex& );              // Not copyable
+    Nmutex& operator=( const Nmutex& );
+
     pthread_mutex_t	m_mutex;
+#ifdef NLIB_LOCK_PROFILING
+    NlockProfile    m_profile;
+#endif
+};
+
+
+template< class LOCK >
+class NlockGuard
+{
+public:
+    explicit NlockGuard( LOCK& theLock ) : m_lock( theLock ) { m_lock.lock(); }
+    ~NlockGuard() { m_lock.unlock(); }
+
+private:
+    NlockGuard( const NlockGuard& );
+    NlockGuard& operator=( const NlockGuard& );
+
+    LOCK&   m_lock;
 };
 
 #endif
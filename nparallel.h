@@ -0,0 +1,348 @@
+#ifndef NPARALLEL_H
+#define NPARALLEL_H
+
+// Nparallel v1.0 by Neil Cooper 18th October 2026
+// Implements data-parallel algorithms (for, reduce, scan, sort and merge) on top of an NthreadPool.
+// The range to process is split into chunks which are handed out dynamically to pool threads
+// and to the calling thread, which always takes part in the work. Helper jobs are only submitted
+// when a pool thread can take them immediately, so all algorithms are safe to call from inside
+// a job already running on the same pool (they just run with fewer helpers, possibly none).
+// If a user function throws, the first exception is rethrown in the calling thread once all
+// chunks already started have completed.
+//
+// Example usage:
+//    NthreadPool pool( 8 );
+//    std::vector<double> v( 1000000 );
+//    Nparallel::parallelFor( pool, 0, v.size(), [&]( size_t i ) { v[i] = sqrt( i ); } );
+//    double sum = Nparallel::parallelReduce( pool, 0, v.size(), 0.0,
+//                                            [&]( size_t b, size_t e, double s ) { while ( b < e ) s += v[b++]; return s; },
+//                                            []( double a, double b ) { return a + b; } );
+//    Nparallel::parallelSort( pool, v.begin(), v.end() );
+
+#include <stddef.h>   // for size_t
+
+#include <algorithm>  // for std::sort, std::merge, std::inplace_merge, std::lower_bound
+#include <functional> // for std::less
+#include <iterator>   // for std::iterator_traits
+#include <vector>
+
+#include "nthreadPool.h"
+
+class Nparallel
+{
+public:
+    typedef void ( *CHUNK_PROC )( const size_t theBegin, const size_t theEnd, void* theParam );
+    // Type of function run for each chunk of a range. Processes indexes [theBegin, theEnd).
+
+    static void forChunks( NthreadPool& thePool,
+                           const size_t theBegin,
+                           const size_t theEnd,
+                           CHUNK_PROC   theChunkProc,
+                           void*        theParam = NULL,
+                           const size_t theGrainSize = 0 );
+    // Run theChunkProc over [theBegin, theEnd) split into chunks of theGrainSize indexes.
+    // Returns when every chunk has completed.
+    // theGrainSize: Indexes per chunk. 0 = choose automatically from the pool size.
+
+    static size_t getChunkCount( NthreadPool& thePool, const size_t theLength, const size_t theGrainSize = 0 );
+    // Returns the number of chunks forChunks() would split a range of theLength indexes into.
+
+    template <typename FUNC>
+    static void parallelFor( NthreadPool& thePool,
+                             const size_t theBegin,
+                             const size_t theEnd,
+                             FUNC         theFunc,
+                             const size_t theGrainSize = 0 )
+    // Calls theFunc( i ) for every i in [theBegin, theEnd).
+        {
+        forChunks( thePool, theBegin, theEnd, indexTrampoline<FUNC>, (void*)&theFunc, theGrainSize );
+        }
+
+    template <typename FUNC>
+    static void parallelForRange( NthreadPool& thePool,
+                                  const size_t theBegin,
+                                  const size_t theEnd,
+                                  FUNC         theFunc,
+                                  const size_t theGrainSize = 0 )
+    // Calls theFunc( chunkBegin, chunkEnd ) for each chunk of [theBegin, theEnd).
+    // Cheaper than parallelFor() when the per-index work is tiny.
+        {
+        forChunks( thePool, theBegin, theEnd, rangeTrampoline<FUNC>, (void*)&theFunc, theGrainSize );
+        }
+
+    template <typename T, typename FUNC, typename COMBINE>
+    static T parallelReduce( NthreadPool& thePool,
+                             const size_t theBegin,
+                             const size_t theEnd,
+                             const T&     theIdentity,
+                             FUNC         theFunc,
+                             COMBINE      theCombine,
+                             const size_t theGrainSize = 0 )
+    // Reduces [theBegin, theEnd) to a single value.
+    // theFunc( chunkBegin, chunkEnd, theIdentity ) returns the reduction of one chunk.
+    // theCombine( a, b ) combines two partial results. Partial results are combined in index
+    // order, so theCombine need only be associative (not commutative).
+        {
+        size_t chunks = getChunkCount( thePool, theEnd - theBegin, theGrainSize );
+        std::vector<T> partials( chunks, theIdentity );
+        ReduceContext<T, FUNC> context = { theBegin, theEnd - theBegin, chunkSize( theEnd - theBegin, chunks ),
+                                           &theFunc, &partials, &theIdentity };
+
+        forChunks( thePool, 0, chunks, reduceTrampoline<T, FUNC>, (void*)&context, 1 );
+
+        T result = theIdentity;
+        for ( size_t i = 0; i < chunks; i++ )
+            result = theCombine( result, partials[i] );
+        return result;
+        }
+
+    template <typename ITER, typename OUTITER, typename OP>
+    static void parallelScan( NthreadPool& thePool,
+                              ITER         theFirst,
+                              ITER         theLast,
+                              OUTITER      theResult,
+                              OP           theOp,
+                              const size_t theGrainSize = 0 )
+    // Inclusive prefix scan: theResult[i] = theFirst[0] op theFirst[1] op ... op theFirst[i].
+    // Both iterators must be random access. theOp must be associative. theResult may equal theFirst.
+        {
+        typedef typename std::iterator_traits<ITER>::value_type VALUE;
+        size_t length = theLast - theFirst;
+        if ( !length )
+            return;
+
+        size_t chunks = getChunkCount( thePool, length, theGrainSize );
+        std::vector<VALUE> totals( chunks );
+        ScanContext<ITER, OUTITER, OP, VALUE> context = { theFirst, theResult, &theOp, &totals, length, chunkSize( length, chunks ) };
+
+        // Pass 1: scan each chunk independently and note its total.
+        forChunks( thePool, 0, chunks, scanTrampoline<ITER, OUTITER, OP, VALUE>, (void*)&context, 1 );
+
+        // Turn chunk totals into the carry into each chunk (tiny, so done serially).
+        for ( size_t i = 1; i < chunks; i++ )
+            totals[i] = theOp( totals[i - 1], totals[i] );
+
+        // Pass 2: apply the carry from all preceding chunks.
+        forChunks( thePool, 1, chunks, carryTrampoline<ITER, OUTITER, OP, VALUE>, (void*)&context, 1 );
+        }
+
+    template <typename ITER, typename COMPARE>
+    static void parallelSort( NthreadPool& thePool, ITER theFirst, ITER theLast, COMPARE theCompare, const size_t theGrainSize = 0 )
+    // Sorts [theFirst, theLast) (random access iterators). Not stable.
+        {
+        size_t length = theLast - theFirst;
+        size_t chunks = getChunkCount( thePool, length, theGrainSize );
+        if ( chunks < 2 )
+            {
+            std::sort( theFirst, theLast, theCompare );
+            return;
+            }
+
+        size_t size = chunkSize( length, chunks );
+        SortContext<ITER, COMPARE> context = { theFirst, &theCompare, length, size };
+        forChunks( thePool, 0, chunks, sortTrampoline<ITER, COMPARE>, (void*)&context, 1 );
+
+        // Merge neighbouring sorted runs pairwise until a single run remains.
+        while ( context.runLength < length )
+            {
+            size_t pairs = ( ( length + context.runLength - 1 ) / context.runLength + 1 ) / 2;
+            forChunks( thePool, 0, pairs, mergeRunsTrampoline<ITER, COMPARE>, (void*)&context, 1 );
+            context.runLength *= 2;
+            }
+        }
+
+    template <typename ITER>
+    static void parallelSort( NthreadPool& thePool, ITER theFirst, ITER theLast )
+        {
+        parallelSort( thePool, theFirst, theLast, std::less<typename std::iterator_traits<ITER>::value_type>() );
+        }
+
+    template <typename ITER1, typename ITER2, typename OUTITER, typename COMPARE>
+    static void parallelMerge( NthreadPool& thePool,
+                               ITER1        theFirst1,
+                               ITER1        theLast1,
+                               ITER2        theFirst2,
+                               ITER2        theLast2,
+                               OUTITER      theResult,
+                               COMPARE      theCompare,
+                               const size_t theGrainSize = 0 )
+    // Merges two sorted ranges into theResult, as std::merge (and equally stable).
+    // All iterators must be random access. The output must not overlap either input.
+        {
+        size_t length1 = theLast1 - theFirst1;
+        size_t chunks = getChunkCount( thePool, length1 + ( theLast2 - theFirst2 ), theGrainSize );
+        if ( chunks > length1 )
+            chunks = length1;
+        if ( chunks < 2 )
+            {
+            std::merge( theFirst1, theLast1, theFirst2, theLast2, theResult, theCompare );
+            return;
+            }
+
+        MergeContext<ITER1, ITER2, OUTITER, COMPARE> context = { theFirst1, theLast1, theFirst2, theLast2, theResult,
+                                                                 &theCompare, chunkSize( length1, chunks ) };
+        forChunks( thePool, 0, chunks, mergeTrampoline<ITER1, ITER2, OUTITER, COMPARE>, (void*)&context, 1 );
+        }
+
+    template <typename ITER1, typename ITER2, typename OUTITER>
+    static void parallelMerge( NthreadPool& thePool, ITER1 theFirst1, ITER1 theLast1, ITER2 theFirst2, ITER2 theLast2, OUTITER theResult )
+        {
+        parallelMerge( thePool, theFirst1, theLast1, theFirst2, theLast2, theResult,
+                       std::less<typename std::iterator_traits<ITER1>::value_type>() );
+        }
+
+private:
+    // Templates below just adapt the typed user functions to the untyped CHUNK_PROC engine.
+
+    static size_t chunkSize( const size_t theLength, const size_t theChunks )
+        { return theChunks ? ( theLength + theChunks - 1 ) / theChunks : theLength; }
+
+    template <typename FUNC>
+    static void indexTrampoline( const size_t theBegin, const size_t theEnd, void* theParam )
+        {
+        FUNC& func = *(FUNC*)theParam;
+        for ( size_t i = theBegin; i < theEnd; i++ )
+            func( i );
+        }
+
+    template <typename FUNC>
+    static void rangeTrampoline( const size_t theBegin, const size_t theEnd, void* theParam )
+        { ( *(FUNC*)theParam )( theBegin, theEnd ); }
+
+    template <typename T, typename FUNC>
+    struct ReduceContext
+        {
+        size_t          begin;
+        size_t          length;
+        size_t          chunkSize;
+        FUNC*           func;
+        std::vector<T>* partials;
+        const T*        identity;
+        };
+
+    template <typename T, typename FUNC>
+    static void reduceTrampoline( const size_t theBegin, const size_t theEnd, void* theParam )
+        {
+        ReduceContext<T, FUNC>& c = *(ReduceContext<T, FUNC>*)theParam;
+
+        for ( size_t chunk = theBegin; chunk < theEnd; chunk++ )
+            {
+            size_t b = std::min( chunk * c.chunkSize, c.length );
+            size_t e = std::min( b + c.chunkSize, c.length );
+            (*c.partials)[ chunk ] = ( *c.func )( c.begin + b, c.begin + e, *c.identity );
+            }
+        }
+
+    template <typename ITER, typename OUTITER, typename OP, typename VALUE>
+    struct ScanContext
+        {
+        ITER                first;
+        OUTITER             result;
+        OP*                 op;
+        std::vector<VALUE>* totals;
+        size_t              length;
+        size_t              chunkSize;
+        };
+
+    template <typename ITER, typename OUTITER, typename OP, typename VALUE>
+    static void scanTrampoline( const size_t theBegin, const size_t theEnd, void* theParam )
+        {
+        ScanContext<ITER, OUTITER, OP, VALUE>& c = *(ScanContext<ITER, OUTITER, OP, VALUE>*)theParam;
+        for ( size_t chunk = theBegin; chunk < theEnd; chunk++ )
+            {
+            size_t b = std::min( chunk * c.chunkSize, c.length );
+            size_t e = std::min( b + c.chunkSize, c.length );
+            if ( b >= e )
+                continue;
+            VALUE sum = c.first[ b ];
+            c.result[ b ] = sum;
+            for ( size_t i = b + 1; i < e; i++ )
+                {
+                sum = ( *c.op )( sum, c.first[ i ] );
+                c.result[ i ] = sum;
+                }
+            (*c.totals)[ chunk ] = sum;
+            }
+        }
+
+    template <typename ITER, typename OUTITER, typename OP, typename VALUE>
+    static void carryTrampoline( const size_t theBegin, const size_t theEnd, void* theParam )
+        {
+        ScanContext<ITER, OUTITER, OP, VALUE>& c = *(ScanContext<ITER, OUTITER, OP, VALUE>*)theParam;
+        for ( size_t chunk = theBegin; chunk < theEnd; chunk++ )
+            {
+            const VALUE& carry = (*c.totals)[ chunk - 1 ];
+            size_t e = std::min( ( chunk + 1 ) * c.chunkSize, c.length );
+            for ( size_t i = chunk * c.chunkSize; i < e; i++ )
+                c.result[ i ] = ( *c.op )( carry, c.result[ i ] );
+            }
+        }
+
+    template <typename ITER, typename COMPARE>
+    struct SortContext
+        {
+        ITER     first;
+        COMPARE* compare;
+        size_t   length;
+        size_t   runLength;
+        };
+
+    template <typename ITER, typename COMPARE>
+    static void sortTrampoline( const size_t theBegin, const size_t theEnd, void* theParam )
+        {
+        SortContext<ITER, COMPARE>& c = *(SortContext<ITER, COMPARE>*)theParam;
+        for ( size_t chunk = theBegin; chunk < theEnd; chunk++ )
+            {
+            size_t b = std::min( chunk * c.runLength, c.length );
+            size_t e = std::min( b + c.runLength, c.length );
+            std::sort( c.first + b, c.first + e, *c.compare );
+            }
+        }
+
+    template <typename ITER, typename COMPARE>
+    static void mergeRunsTrampoline( const size_t theBegin, const size_t theEnd, void* theParam )
+        {
+        SortContext<ITER, COMPARE>& c = *(SortContext<ITER, COMPARE>*)theParam;
+        for ( size_t pair = theBegin; pair < theEnd; pair++ )
+            {
+            size_t b = std::min( pair * 2 * c.runLength, c.length );
+            size_t m = std::min( b + c.runLength, c.length );
+            size_t e = std::min( m + c.runLength, c.length );
+            if ( m < e )
+                std::inplace_merge( c.first + b, c.first + m, c.first + e, *c.compare );
+            }
+        }
+
+    template <typename ITER1, typename ITER2, typename OUTITER, typename COMPARE>
+    struct MergeContext
+        {
+        ITER1    first1;
+        ITER1    last1;
+        ITER2    first2;
+        ITER2    last2;
+        OUTITER  result;
+        COMPARE* compare;
+        size_t   chunkSize;
+        };
+
+    template <typename ITER1, typename ITER2, typename OUTITER, typename COMPARE>
+    static void mergeTrampoline( const size_t theBegin, const size_t theEnd, void* theParam )
+        {
+        MergeContext<ITER1, ITER2, OUTITER, COMPARE>& c = *(MergeContext<ITER1, ITER2, OUTITER, COMPARE>*)theParam;
+        size_t length1 = c.last1 - c.first1;
+
+        for ( size_t chunk = theBegin; chunk < theEnd; chunk++ )
+            {
+            // Split the first range by position and the second by value, so that elements of
+            // the second range equal to a split value stay after it (keeps std::merge stability).
+            size_t b1 = std::min( chunk * c.chunkSize, length1 );
+            size_t e1 = std::min( b1 + c.chunkSize, length1 );
+            ITER2  b2 = b1 ? std::lower_bound( c.first2, c.last2, c.first1[ b1 ], *c.compare ) : c.first2;
+            ITER2  e2 = ( e1 < length1 ) ? std::lower_bound( c.first2, c.last2, c.first1[ e1 ], *c.compare ) : c.last2;
+
+            std::merge( c.first1 + b1, c.first1 + e1, b2, e2, c.result + ( b1 + ( b2 - c.first2 ) ), *c.compare );
+            }
+        }
+};
+
+#endif
@@ -38,7 +38,7 @@ public:
 
 #ifndef __ANDROID__
    static void setOurAffinity( const Nthread::CORE_AFFINITY allowedCores = Nthread::CORE_AFFINITY_ALL );
-//  Set core affinity for the calling process. 0 = All cores.
+//  Set core affinity for the calling process. Empty = All cores.
 #endif
 
 private:
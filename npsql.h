@@ -1,17 +1,19 @@
 #ifndef NPSQL_H
 #define NPSQL_H
 
-// Npsql v1.0 by Neil Cooper 8th March 2004
+// Npsql v1.1 by Neil Cooper 8th March 2004
 // Implements an easy-to-use generic postgreSQL database object.
 // class Npsql encapsulates a single open PostgreSql database.
 // Npsql throws exceptions of type NerrorException (defined in nerror.h)
 // if errors occur.
+// v1.1 19th October 2026: Added setLatencyHistogram().
 
 #include <string>
 #include <sstream>
 #include "nmutex.h"
 #include "npsqlResult.h"
 
+class NconcurrentHistogram;
 class Npsql
 {
 public:
@@ -86,6 +88,11 @@ public:
     //    Returns the stream pointer to notice stream set by DivertNotices(),
     //    or NULL if not already set
 
+
+    void setLatencyHistogram( NconcurrentHistogram* theHistogram );
+    //    Records how long each query takes, in ns, into theHistogram. NULL = don't record.
+    //    The histogram must outlive the database object or be unset first.
+
     // PostgreSQL doesnt store unsigned longs so we can get around that by
     // 2's complementing them manually with the following conversion functions
 
@@ -98,6 +105,7 @@ private:
     FILE*          m_notices;
     bool           m_initialised;
     bool           m_noticesEnabled;
+    NconcurrentHistogram* m_histogram;
     static Nmutex  m_notReentrant;
 
     bool waitForDb( std::string* theMessage );
@@ -0,0 +1,480 @@
+#ifndef NQUEUE_H
+#define NQUEUE_H
+
+// Nqueue v1.0 by Neil Cooper 18th October 2026
+// Lock-free queues for passing work between threads, as a faster alternative to an Nmutex
+// around a std::queue:
+//   NspscQueue< T >:   Bounded ring for exactly one producer thread and one consumer thread.
+//   NmpmcQueue< T >:   Bounded queue for any number of producers and consumers (Dmitry Vyukov's
+//                      design: each cell carries a sequence number, so producers and consumers
+//                      only contend on one counter each).
+//   NmpscQueue:        Unbounded intrusive queue for any number of producers and one consumer.
+//                      Items derive from NmpscQueue::NODE, so pushing never allocates.
+//   NblockingQueue:    Wraps any of the above so that pop() sleeps while the queue is empty and
+//                      (for bounded queues) push() sleeps while it is full. Sleeping is done on
+//                      counting Nevents, so it costs nothing extra while nobody has to sleep.
+// Bounded capacities are rounded up to a power of 2. The try methods never block: they return
+// false if the queue is full (push) or empty (pop).
+// Producer and consumer indices are padded onto separate cache lines so the two sides don't slow
+// each other down by sharing one. (Padded rather than aligned, so queues work with plain new.)
+
+#include <atomic>
+#include <stddef.h>
+#include <sched.h>      // for sched_yield()
+
+#include "nevent.h"
+#include "ntime.h"
+
+namespace NQUEUE
+{
+const size_t CACHE_LINE = 64;
+
+inline size_t roundUpToPowerOf2( size_t theValue )
+{
+    size_t power = 2;
+    while ( power < theValue )
+        power <<= 1;
+    return power;
+}
+}
+
+
+template< class T >
+class NspscQueue
+{
+public:
+    explicit NspscQueue( const size_t theCapacity );
+    ~NspscQueue() { delete[] m_items; }
+
+    bool tryPush( const T& theItem );
+    // Producer thread only.
+
+    bool tryPop( T& theItem );
+    // Consumer thread only.
+
+    size_t pushBatch( const T* theItems, const size_t theCount );
+    // Producer thread only. Pushes as many of theItems as there is room for, making them
+    // visible to the consumer together. Return: number pushed.
+
+    size_t popBatch( T* theItems, const size_t theCount );
+    // Consumer thread only. Pops up to theCount items. Return: number popped.
+
+    size_t size() const;
+    // Number of items in the queue. Only a snapshot if the other thread is active.
+
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    NspscQueue( const NspscQueue& );              // Not copyable
+    NspscQueue& operator=( const NspscQueue& );
+
+    T*                      m_items;
+    size_t                  m_mask;
+    char                    m_padding1[ NQUEUE::CACHE_LINE ];
+    std::atomic< size_t >   m_tail;         // Next slot to write. Written by producer.
+    size_t                  m_headCache;    // Producer's last view of m_head
+    char                    m_padding2[ NQUEUE::CACHE_LINE ];
+    std::atomic< size_t >   m_head;         // Next slot to read. Written by consumer.
+    size_t                  m_tailCache;    // Consumer's last view of m_tail
+    char                    m_padding3[ NQUEUE::CACHE_LINE ];
+};
+
+
+template< class T >
+class NmpmcQueue
+{
+public:
+    explicit NmpmcQueue( const size_t theCapacity );
+    ~NmpmcQueue() { delete[] m_cells; }
+
+    bool tryPush( const T& theItem );
+    bool tryPop( T& theItem );
+
+    size_t pushBatch( const T* theItems, const size_t theCount );
+    size_t popBatch( T* theItems, const size_t theCount );
+    // As tryPush()/tryPop() repeatedly, stopping when the queue is full/empty.
+    // Return: number of items pushed/popped.
+
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    NmpmcQueue( const NmpmcQueue& );              // Not copyable
+    NmpmcQueue& operator=( const NmpmcQueue& );
+
+    typedef struct
+        {
+        std::atomic< size_t >   sequence;   // == position: free to write, == position + 1: full
+        T                       item;
+        } CELL;
+
+    CELL*                   m_cells;
+    size_t                  m_mask;
+    char                    m_padding1[ NQUEUE::CACHE_LINE ];
+    std::atomic< size_t >   m_tail;         // Next position to write
+    char                    m_padding2[ NQUEUE::CACHE_LINE ];
+    std::atomic< size_t >   m_head;         // Next position to read
+    char                    m_padding3[ NQUEUE::CACHE_LINE ];
+};
+
+
+class NmpscQueue
+{
+public:
+    struct NODE
+        {
+        NODE() : next( NULL ) {}
+        NODE( const NODE& ) : next( NULL ) {}
+        NODE& operator=( const NODE& ) { return *this; }
+        std::atomic< NODE* >    next;
+        };
+    // Base class for items. A node can only be in one queue at a time. Copying an item doesn't
+    // copy its place in a queue, so items can be kept in containers.
+
+    explicit NmpscQueue( const size_t theCapacity = 0 ) : m_tail( &m_stub ), m_head( &m_stub ) {}
+    // theCapacity is ignored. It lets NblockingQueue construct any of the queues the same way.
+
+    bool tryPush( NODE* theNode );
+    // Any thread. Never fails (the queue is unbounded). Returns bool to match the other queues.
+
+    bool tryPop( NODE*& theNode );
+    // Consumer thread only. May briefly return false while a producer is part way through a
+    // push, even though the queue isn't empty.
+
+    size_t capacity() const { return 0; }
+    // 0 = unbounded.
+
+private:
+    NmpscQueue( const NmpscQueue& );              // Not copyable
+    NmpscQueue& operator=( const NmpscQueue& );
+
+    NODE                    m_stub;         // Keeps the queue non-empty
+    char                    m_padding1[ NQUEUE::CACHE_LINE ];
+    std::atomic< NODE* >    m_tail;         // Most recently pushed. Producers swap this.
+    char                    m_padding2[ NQUEUE::CACHE_LINE ];
+    NODE*                   m_head;         // Next to pop. Consumer only.
+    char                    m_padding3[ NQUEUE::CACHE_LINE ];
+};
+
+
+template< class QUEUE, class T >
+class NblockingQueue
+{
+public:
+    explicit NblockingQueue( const size_t theCapacity = 0 );
+    // theCapacity: For bounded queues. Ignored for NmpscQueue.
+
+    void push( const T& theItem );
+    // Pushes theItem, waiting for room if the queue is bounded and full.
+
+    bool pop( T& theItem, const Ntime theTimeout = 0 );
+    // Pops an item, waiting (optionally for the specified amount of time) for one if empty.
+    // Return: false if timeout occurred. Always returns true if theTimeout == 0.
+
+    bool tryPush( const T& theItem );
+    bool tryPop( T& theItem );
+
+    QUEUE& getQueue() { return m_queue; }
+
+private:
+    NblockingQueue( const NblockingQueue& );              // Not copyable
+    NblockingQueue& operator=( const NblockingQueue& );
+
+    void take( T& theItem );
+    void put( const T& theItem );
+
+    QUEUE   m_queue;
+    Nevent  m_items;    // Counts items that can be popped
+    Nevent  m_spaces;   // Counts free slots. Not used for unbounded queues.
+    bool    m_bounded;
+};
+
+
+// Templates, so defined here rather than in a .cxx.
+
+template< class T >
+NspscQueue< T >::NspscQueue( const size_t theCapacity ) :
+                                m_mask( NQUEUE::roundUpToPowerOf2( theCapacity ) - 1 ),
+                                m_tail( 0 ),
+                                m_headCache( 0 ),
+                                m_head( 0 ),
+                                m_tailCache( 0 )
+{
+    m_items = new T[ m_mask + 1 ];
+}
+
+
+template< class T >
+bool NspscQueue< T >::tryPush( const T& theItem )
+{
+    return pushBatch( &theItem, 1 ) == 1;
+}
+
+
+template< class T >
+bool NspscQueue< T >::tryPop( T& theItem )
+{
+    return popBatch( &theItem, 1 ) == 1;
+}
+
+
+template< class T >
+size_t NspscQueue< T >::pushBatch( const T* theItems, const size_t theCount )
+{
+    size_t tail = m_tail.load( std::memory_order_relaxed );
+    size_t room = m_mask + 1 - ( tail - m_headCache );
+
+    // Only look at the consumer's index (and pull its cache line over) when we seem to be full.
+    if ( room < theCount )
+        {
+        m_headCache = m_head.load( std::memory_order_acquire );
+        room = m_mask + 1 - ( tail - m_headCache );
+        }
+
+    size_t count = ( theCount < room ) ? theCount : room;
+    for ( size_t i = 0; i < count; i++ )
+        m_items[ ( tail + i ) & m_mask ] = theItems[i];
+
+    if ( count )
+        m_tail.store( tail + count, std::memory_order_release );
+    return count;
+}
+
+
+template< class T >
+size_t NspscQueue< T >::popBatch( T* theItems, const size_t theCount )
+{
+    size_t head = m_head.load( std::memory_order_relaxed );
+    size_t available = m_tailCache - head;
+
+    if ( available < theCount )
+        {
+        m_tailCache = m_tail.load( std::memory_order_acquire );
+        available = m_tailCache - head;
+        }
+
+    size_t count = ( theCount < available ) ? theCount : available;
+    for ( size_t i = 0; i < count; i++ )
+        theItems[i] = m_items[ ( head + i ) & m_mask ];
+
+    if ( count )
+        m_head.store( head + count, std::memory_order_release );
+    return count;
+}
+
+
+template< class T >
+size_t NspscQueue< T >::size() const
+{
+    return m_tail.load( std::memory_order_acquire ) - m_head.load( std::memory_order_acquire );
+}
+
+
+template< class T >
+NmpmcQueue< T >::NmpmcQueue( const size_t theCapacity ) :
+                                m_mask( NQUEUE::roundUpToPowerOf2( theCapacity ) - 1 ),
+                                m_tail( 0 ),
+                                m_head( 0 )
+{
+    m_cells = new CELL[ m_mask + 1 ];
+    for ( size_t i = 0; i <= m_mask; i++ )
+        m_cells[i].sequence.store( i, std::memory_order_relaxed );
+}
+
+
+template< class T >
+bool NmpmcQueue< T >::tryPush( const T& theItem )
+{
+    size_t position = m_tail.load( std::memory_order_relaxed );
+
+    for ( ;; )
+        {
+        CELL& cell = m_cells[ position & m_mask ];
+        size_t sequence = cell.sequence.load( std::memory_order_acquire );
+        ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)position;
+
+        if ( difference == 0 )
+            {
+            // Cell is free: claim the position. On failure position is reloaded, so try again.
+            if ( m_tail.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ) )
+                {
+                cell.item = theItem;
+                cell.sequence.store( position + 1, std::memory_order_release );
+                return true;
+                }
+            }
+        else if ( difference < 0 )
+            return false;   // Cell still holds the item from one lap ago, so we're full
+        else
+            position = m_tail.load( std::memory_order_relaxed );  // Another producer got it
+        }
+}
+
+
+template< class T >
+bool NmpmcQueue< T >::tryPop( T& theItem )
+{
+    size_t position = m_head.load( std::memory_order_relaxed );
+
+    for ( ;; )
+        {
+        CELL& cell = m_cells[ position & m_mask ];
+        size_t sequence = cell.sequence.load( std::memory_order_acquire );
+        ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)( position + 1 );
+
+        if ( difference == 0 )
+            {
+            if ( m_head.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ) )
+                {
+                theItem = cell.item;
+                // Free the cell for the producer one lap ahead.
+                cell.sequence.store( position + m_mask + 1, std::memory_order_release );
+                return true;
+                }
+            }
+        else if ( difference < 0 )
+            return false;   // Not written yet, so we're empty
+        else
+            position = m_head.load( std::memory_order_relaxed );
+        }
+}
+
+
+template< class T >
+size_t NmpmcQueue< T >::pushBatch( const T* theItems, const size_t theCount )
+{
+    size_t count = 0;
+    while ( ( count < theCount ) && tryPush( theItems[ count ] ) )
+        count++;
+    return count;
+}
+
+
+template< class T >
+size_t NmpmcQueue< T >::popBatch( T* theItems, const size_t theCount )
+{
+    size_t count = 0;
+    while ( ( count < theCount ) && tryPop( theItems[ count ] ) )
+        count++;
+    return count;
+}
+
+
+inline bool NmpscQueue::tryPush( NODE* theNode )
+{
+    theNode->next.store( NULL, std::memory_order_relaxed );
+    NODE* previous = m_tail.exchange( theNode, std::memory_order_acq_rel );
+    // Between the exchange and this store, the consumer can't see theNode yet.
+    previous->next.store( theNode, std::memory_order_release );
+    return true;
+}
+
+
+inline bool NmpscQueue::tryPop( NODE*& theNode )
+{
+    NODE* head = m_head;
+    NODE* next = head->next.load( std::memory_order_acquire );
+
+    if ( head == &m_stub )
+        {
+        if ( next == NULL )
+            return false;
+        // Step over the stub.
+        m_head = next;
+        head = next;
+        next = next->next.load( std::memory_order_acquire );
+        }
+
+    if ( next != NULL )
+        {
+        m_head = next;
+        theNode = head;
+        return true;
+        }
+
+    // head looks like the last node. Unless a producer has got in behind it, put the stub back
+    // after it so that head can be handed out without leaving the queue empty of nodes.
+    if ( head != m_tail.load( std::memory_order_acquire ) )
+        return false;   // A push is part way through
+
+    tryPush( &m_stub );
+
+    next = head->next.load( std::memory_order_acquire );
+    if ( next == NULL )
+        return false;   // Another push got in before the stub and is part way through
+
+    m_head = next;
+    theNode = head;
+    return true;
+}
+
+
+template< class QUEUE, class T >
+NblockingQueue< QUEUE, T >::NblockingQueue( const size_t theCapacity ) :
+                                m_queue( theCapacity ),
+                                m_items( true, 0 ),
+                                m_spaces( true, m_queue.capacity() ),
+                                m_bounded( m_queue.capacity() != 0 )
+{
+}
+
+
+template< class QUEUE, class T >
+void NblockingQueue< QUEUE, T >::push( const T& theItem )
+{
+    if ( m_bounded )
+        m_spaces.wait();
+    put( theItem );
+}
+
+
+template< class QUEUE, class T >
+bool NblockingQueue< QUEUE, T >::pop( T& theItem, const Ntime theTimeout )
+{
+    if ( !m_items.wait( theTimeout ) )
+        return false;
+    take( theItem );
+    return true;
+}
+
+
+template< class QUEUE, class T >
+bool NblockingQueue< QUEUE, T >::tryPush( const T& theItem )
+{
+    if ( m_bounded && !m_spaces.tryWait() )
+        return false;
+    put( theItem );
+    return true;
+}
+
+
+template< class QUEUE, class T >
+bool NblockingQueue< QUEUE, T >::tryPop( T& theItem )
+{
+    if ( !m_items.tryWait() )
+        return false;
+    take( theItem );
+    return true;
+}
+
+
+template< class QUEUE, class T >
+void NblockingQueue< QUEUE, T >::put( const T& theItem )
+{
+    // We hold a space, so this only fails while a consumer is part way through freeing one.
+    while ( !m_queue.tryPush( theItem ) )
+        sched_yield();
+    m_items.signal();
+}
+
+
+template< class QUEUE, class T >
+void NblockingQueue< QUEUE, T >::take( T& theItem )
+{
+    // We hold an item, so this only fails while a producer is part way through pushing one.
+    while ( !m_queue.tryPop( theItem ) )
+        sched_yield();
+    if ( m_bounded )
+        m_spaces.signal();
+}
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef NRWLOCK_H
+#define NRWLOCK_H
+
+// NrwLock v1.0 by Neil Cooper 18th October 2026
+// Implements an easy-to-use pthread-based reader-writer lock, for data that is read far more
+// often than it is changed. Any number of threads may hold it for reading at once.
+// The lock prefers writers: once a writer is waiting, new readers wait behind it, so a steady
+// stream of readers can't starve writers. For the same reason a thread must not take a read
+// lock it already holds again, as it could deadlock behind a waiting writer.
+// Use NreadGuard or NwriteGuard to hold it for a scope.
+//
+// Nseqlock< T > holds a small plain-old-data value (a few words, such as a timestamp and
+// position) that is read very often. Readers never write to shared memory, so they don't slow
+// each other down at all; a reader that overlaps a write simply reads again. Writers are
+// serialised by a spinlock, so writes must be short and fairly infrequent.
+
+#include <atomic>
+#include <type_traits>
+#include <string.h>     // for memcpy()
+#include <pthread.h>    // for pthread_rwlock_t
+
+#include "nmutex.h"      // for NlockGuard
+#include "nspinlock.h"
+
+class NrwLock
+{
+public:
+    NrwLock();
+    virtual ~NrwLock();
+
+    void readLock();
+    // Lock for reading. Blocks while a writer holds or is waiting for the lock.
+
+    bool tryReadLock();
+    // Behaves as readLock() except does not block.
+    // Return:
+    //    true = success, false = lock is held or wanted by a writer
+
+    void writeLock();
+    // Lock for writing. Blocks until no other thread holds the lock.
+
+    bool tryWriteLock();
+    // Behaves as writeLock() except does not block.
+    // Return:
+    //    true = success, false = lock is held
+
+    void unlock();
+    // Releases a read or write lock held by the calling thread.
+
+    void lock()     { writeLock(); }
+    // Same as writeLock(), so that NlockGuard< NrwLock > works.
+
+private:
+    NrwLock( const NrwLock& );              // Not copyable
+    NrwLock& operator=( const NrwLock& );
+
+    pthread_rwlock_t    m_lock;
+};
+
+
+class NreadGuard
+{
+public:
+    explicit NreadGuard( NrwLock& theLock ) : m_lock( theLock ) { m_lock.readLock(); }
+    ~NreadGuard() { m_lock.unlock(); }
+
+private:
+    NreadGuard( const NreadGuard& );
+    NreadGuard& operator=( const NreadGuard& );
+
+    NrwLock&    m_lock;
+};
+
+
+class NwriteGuard
+{
+public:
+    explicit NwriteGuard( NrwLock& theLock ) : m_lock( theLock ) { m_lock.writeLock(); }
+    ~NwriteGuard() { m_lock.unlock(); }
+
+private:
+    NwriteGuard( const NwriteGuard& );
+    NwriteGuard& operator=( const NwriteGuard& );
+
+    NrwLock&    m_lock;
+};
+
+
+template< class T >
+class Nseqlock
+{
+public:
+    explicit Nseqlock( const T& theValue = T() ) : m_sequence( 0 ) { store( theValue ); }
+
+    T read() const;
+    // Returns a consistent copy of the value, retrying if a write happened during the read.
+
+    void write( const T& theValue );
+    // Replaces the value. Readers never see it half written.
+
+private:
+    Nseqlock( const Nseqlock& );              // Not copyable
+    Nseqlock& operator=( const Nseqlock& );
+
+    static_assert( std::is_trivially_copyable< T >::value, "Nseqlock needs a plain-old-data type" );
+
+    static const size_t WORDS = ( sizeof( T ) + sizeof( unsigned long ) - 1 ) / sizeof( unsigned long );
+
+    void store( const T& theValue );
+
+    // The value is held in atomic words so that a read racing a write is well defined; the
+    // sequence number tells the reader whether what it read can be used.
+    std::atomic< unsigned int >   m_sequence;   // Odd while a write is in progress
+    std::atomic< unsigned long >  m_words[ WORDS ];
+    Nspinlock                     m_writer;
+};
+
+
+// Templates, so defined here rather than in a .cxx.
+
+template< class T >
+T Nseqlock< T >::read() const
+{
+    unsigned long words[ WORDS ];
+    unsigned int before;
+    unsigned int after;
+
+    do
+        {
+        before = m_sequence.load( std::memory_order_acquire );
+        for ( size_t i = 0; i < WORDS; i++ )
+            words[i] = m_words[i].load( std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_acquire );
+        after = m_sequence.load( std::memory_order_relaxed );
+        }
+    while ( ( before & 1 ) || ( before != after ) );
+
+    T value;
+    memcpy( &value, words, sizeof( T ) );
+    return value;
+}
+
+
+template< class T >
+void Nseqlock< T >::write( const T& theValue )
+{
+    NlockGuard< Nspinlock > writer( m_writer );
+    store( theValue );
+}
+
+
+template< class T >
+void Nseqlock< T >::store( const T& theValue )
+{
+    unsigned long words[ WORDS ] = {};
+    memcpy( words, &theValue, sizeof( T ) );
+
+    unsigned int sequence = m_sequence.load( std::memory_order_relaxed );
+    m_sequence.store( sequence + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+    for ( size_t i = 0; i < WORDS; i++ )
+        m_words[i].store( words[i], std::memory_order_relaxed );
+    m_sequence.store( sequence + 2, std::memory_order_release );
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef NSCHEDULER_H
+#define NSCHEDULER_H
+
+// Nscheduler v1.0 by Neil Cooper 18th October 2026
+// Runs jobs on an NthreadPool after a delay, either once or periodically, using a single timer
+// thread rather than a thread per timer.
+// Timers are kept in a hierarchical timer wheel (4 levels of 256 slots), so scheduling and
+// cancelling a job are O(1) however many jobs are scheduled. The timer thread sleeps on a
+// timerfd until the next job is due, or until distant jobs need moving down a level.
+// Periodic jobs are rescheduled from when they were due rather than from when they ran, so they
+// don't drift. If a periodic job's previous run hasn't finished when it is next due, that run is
+// skipped rather than started alongside it. Runs missed because the scheduler fell behind are
+// skipped rather than run back to back.
+// Jobs are dispatched with NthreadPool::submitJob(), so with a bounded pool the timer thread
+// waits for a free pool thread, delaying other jobs. An unbounded or elastic pool avoids this.
+
+#include <vector>
+#include <string>
+#include <time.h>
+
+#include "nmutex.h"
+#include "nevent.h"
+#include "nthread.h"
+#include "nthreadPool.h"
+#include "ntime.h"
+
+class Nscheduler
+{
+public:
+    typedef unsigned long long JOB_ID;
+    // Identifies a scheduled job. Never 0, so 0 can be used to mean "no job".
+
+    typedef struct
+        {
+        size_t              scheduledJobs;  // Jobs waiting for their next run now
+        size_t              runningJobs;    // Runs dispatched to the pool and not yet finished
+        unsigned long long  jobsScheduled;  // Total jobs ever scheduled
+        unsigned long long  runsStarted;    // Runs dispatched to the pool
+        unsigned long long  overruns;       // Periodic runs skipped because the previous run hadn't finished
+        unsigned long long  missedRuns;     // Periodic runs skipped because the scheduler fell behind
+        unsigned long long  wakeups;        // Times the timer thread has woken
+        } SCHEDULER_METRICS;
+
+    Nscheduler( NthreadPool&      thePool,
+                const Ntime       theResolution = 1,
+                const std::string theName = "" );
+    // thePool:       Pool jobs are run on. Must outlive the scheduler.
+    // theResolution: Length of a timer wheel tick. Delays and periods are rounded up to whole ticks.
+    // theName:       Name for the timer thread. Empty = use parent program name.
+
+    virtual ~Nscheduler();
+    // Cancels all scheduled jobs and waits for any runs already dispatched to finish.
+
+    JOB_ID scheduleOnce( NthreadPool::THREAD_PROC        theJobProc,
+                         void*                           theJobParam,
+                         const Ntime                     theDelay,
+                         const NthreadPool::JOB_PRIORITY thePriority = NthreadPool::NORMAL_PRIORITY );
+    // Runs theJobProc( theJobParam ) on the pool once, no sooner than theDelay from now.
+
+    JOB_ID schedulePeriodic( NthreadPool::THREAD_PROC        theJobProc,
+                             void*                           theJobParam,
+                             const Ntime                     thePeriod,
+                             const bool                      theRunNowFlag = false,
+                             const NthreadPool::JOB_PRIORITY thePriority = NthreadPool::NORMAL_PRIORITY );
+    // Runs theJobProc( theJobParam ) on the pool every thePeriod until cancelled.
+    // First run is after one period, or straight away if theRunNowFlag is true.
+
+    bool cancel( const JOB_ID theJob );
+    // Stops a job from running again. A run already dispatched to the pool is not interrupted.
+    // Return: true = cancelled, false = no such job (unknown, already cancelled, or a one shot
+    //         job that has already been dispatched).
+
+    SCHEDULER_METRICS getMetrics();
+
+private:
+    static const unsigned int LEVELS = 4;
+    static const unsigned int SLOT_BITS = 8;
+    static const unsigned int SLOTS = 1 << SLOT_BITS;
+    static const unsigned int SLOT_MASK = SLOTS - 1;
+    static const unsigned int SLOT_WORDS = SLOTS / 64;     // Words in a level's occupancy bitmap
+    static const unsigned int NODES_PER_BLOCK = 1024;
+
+    typedef struct JOB_NODE
+        {
+        struct JOB_NODE*            prev;       // Slot list links. Free list uses next only.
+        struct JOB_NODE*            next;
+        unsigned long long          expiry;     // Tick when next due
+        unsigned long long          period;     // In ticks. 0 = one shot.
+        NthreadPool::THREAD_PROC    proc;
+        void*                       param;
+        Nscheduler*                 scheduler;
+        unsigned int                index;      // Position in node blocks
+        unsigned int                generation; // Bumped each time the node is freed, so stale JOB_IDs don't match
+        unsigned int                slot;       // level * SLOTS + slot, while in the wheel
+        NthreadPool::JOB_PRIORITY   priority;
+        bool                        inWheel;
+        bool                        running;
+        bool                        cancelled;
+        } JOB_NODE;
+
+    static void* timerThreadProc( void* theScheduler );
+    static void runJob( void* theNode );
+
+    void runTimers();
+    JOB_ID schedule( NthreadPool::THREAD_PROC        theJobProc,
+                     void*                           theJobParam,
+                     const unsigned long long        theDelayNs,
+                     const unsigned long long        thePeriodTicks,
+                     const NthreadPool::JOB_PRIORITY thePriority );
+    JOB_NODE* allocNode();
+    void freeNode( JOB_NODE* theNode );
+    void insert( JOB_NODE* theNode );
+    void unlink( JOB_NODE* theNode );
+    void advance( const unsigned long long theNow, std::vector< JOB_NODE* >& theDue );
+    void cascade( const unsigned int theLevel, const unsigned int theSlot );
+    void expire( const unsigned int theSlot, std::vector< JOB_NODE* >& theDue );
+    void fire( JOB_NODE* theNode, std::vector< JOB_NODE* >& theDue );
+    unsigned int nextOccupiedSlot( const unsigned int theLevel, const unsigned int theStart );
+    unsigned long long nextEventTick();
+    void armTimer( const unsigned long long theTick );
+    unsigned long long getNowNs();
+
+    NthreadPool&                m_pool;
+    unsigned long long          m_resolutionNs;
+    timespec                    m_start;            // Tick 0, on CLOCK_MONOTONIC
+    unsigned long long          m_currentTick;      // Next tick the wheel will process
+    unsigned long long          m_armedTick;        // Tick the timerfd is set for
+    JOB_NODE                    m_wheel[ LEVELS ][ SLOTS ];      // List heads
+    unsigned long long          m_occupied[ LEVELS ][ SLOT_WORDS ];
+    size_t                      m_levelCount[ LEVELS ];
+    std::vector< JOB_NODE* >    m_blocks;
+    JOB_NODE*                   m_freeNodes;
+    Nmutex                      m_owner;            // Owns all of the above and the nodes
+    Nevent                      m_noneRunning;      // Manual reset. Signalled when no runs are dispatched.
+    SCHEDULER_METRICS           m_metrics;
+    int                         m_timerFd;
+    int                         m_stopFd;
+    Nthread*                    m_thread;
+};
+
+#endif
@@ -1,8 +1,9 @@
 #ifndef NSOCKET_H
 #define NSOCKET_H
 
-// Nsocket v1.5 by Neil Cooper 11th Nov 2014
+// Nsocket v1.6 by Neil Cooper 11th Nov 2014
 // Implements a client or server TCP socket connection.
+// v1.6 19th October 2026: Added setLatencyHistograms().
 // Unless otherwise specified, all methods returning bool: true=success, false=fail.
 // Fail indicates either:
 // * An unrecoverable internal system error has occurred.
@@ -15,8 +16,11 @@
 #include "nevent.h"
 #include "nmutex.h"
 #include "ntime.h"
+#include "nstopToken.h"
 #include "nthread.h"
 
+class NconcurrentHistogram;
+
 
 class Nsocket
 {
@@ -180,6 +184,10 @@ public:
 	//      theTimedOutFlag = pointer to boolean to set to true if timeout occurs before event.
 	//      theTimeout      = amount of time to wait before returning. Default is infinite.
 
+	void waitForSocketEvent( bool* theTimedOutFlag, const Ntime theTimeout, const NstopToken& theStopToken );
+	//  As above, but also returns as soon as a stop is requested through theStopToken.
+	//  (The timed out flag is not set in this case; check theStopToken.stopRequested() ).
+
 	bool readWillNotBlock();
 	//  Returns true only if there is data available or the remote end has closed.
 	//  (i.e. an ubuffered read of 1 byte will not block). The only way to differentiate between
@@ -218,6 +226,10 @@ public:
 	//  available to be read from the socket, as it does not include any data in the sockets own
 	//  buffer.
 
+	void setLatencyHistograms( NconcurrentHistogram* theReadHistogram, NconcurrentHistogram* theWriteHistogram = NULL );
+	//  Records how long each Read() and Write() call takes, in ns, into the given histograms.
+	//  NULL = don't record. The histograms must outlive the socket or be unset first.
+
 private:
 
 	NSOCKET_STATUS		m_status;
@@ -234,6 +246,8 @@ private:
 	Nmutex				m_socketReadbufferOwner;
 	int					m_closePipe[2];
 	bool					m_closePipeCreatedFlag;
+	NconcurrentHistogram*	m_readHistogram;
+	NconcurrentHistogram*	m_writeHistogram;
 
 	static void* autoBufferProc( void* theParam );
 
@@ -241,7 +255,8 @@ private:
                                 siginfo_t*	theSigInfo,
                                 void*	    theContext	);
 
-	void waitForRawSocketEvent( bool* theTimedOutFlag = NULL, const Ntime theTimeout = 0 );
+	void waitForRawSocketEvent( bool* theTimedOutFlag = NULL, const Ndeadline& theDeadline = Ndeadline(),
+	                            const NstopToken* theStopToken = NULL );
 
 	void rawRead(   void*               theBuffer,
 					const unsigned long	theLength,
@@ -1,6 +1,8 @@
 #pragma once
-// NsocketCan v1.0 by Neil Cooper 27th April 2022
+// NsocketCan v1.1 by Neil Cooper 27th April 2022
 // Encapsulates a SocketCAN socket.
+// v1.1 19th October 2026: Added rx() into a caller's buffer, to decode frames with NbitStream
+//                         without allocating.
 
 #include <string>
 #include <vector>
@@ -31,6 +33,8 @@ public:
 
     typedef std::vector<uint8_t> CAN_DATA;
 
+    static const size_t MAX_DATA_LENGTH = 8;
+
     typedef uint32_t CAN_ID;
 
     typedef std::vector< uint32_t > FILTER_LIST;
@@ -52,6 +56,9 @@ public:
 
     CAN_ID rx( CAN_DATA& data );
 
+    CAN_ID rx( uint8_t* data, size_t& length );
+    // Receives into data, which must hold MAX_DATA_LENGTH bytes, and sets length to the bytes received.
+
     void extractFlags(  const CAN_ID    canIdMsg,
                         uint32_t&       canId,
                         bool&           errorFrame,
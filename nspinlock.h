@@ -0,0 +1,94 @@
+#ifndef NSPINLOCK_H
+#define NSPINLOCK_H
+
+// Nspinlock v1.0 by Neil Cooper 18th October 2026
+// Implements a ticket spinlock for very short critical sections.
+// Each thread takes a ticket and spins until its number is served, so the lock is handed out in
+// the order it was asked for and no thread can be starved. Locking and unlocking never make a
+// system call, but a waiting thread burns CPU: holding an Nspinlock across anything that can
+// block or take long (I/O, allocation, another lock) will cost far more than an Nmutex.
+// A waiter that has spun for a while yields the CPU, so a preempted holder can still run on
+// an oversubscribed system.
+// Not recursive. Use NlockGuard< Nspinlock > (see nmutex.h) to hold it for a scope.
+
+#include <atomic>
+#include <sched.h>    // for sched_yield()
+
+class Nspinlock
+{
+public:
+    Nspinlock() : m_next( 0 ), m_serving( 0 ) {}
+
+    void lock();
+    // Lock the spinlock, spinning until it is this thread's turn.
+
+    bool tryLock();
+    // Lock the spinlock only if it is free and nobody is waiting for it.
+    // Return:
+    //    true = success, false = spinlock is already locked
+
+    void unlock();
+    // Unlocks the spinlock (which has been previously locked by the calling thread).
+
+private:
+    Nspinlock( const Nspinlock& );              // Not copyable
+    Nspinlock& operator=( const Nspinlock& );
+
+    static const unsigned int SPINS_BEFORE_YIELD = 128;
+
+    static void pause();
+
+    // Kept on separate cache lines so taking a ticket doesn't disturb the spinning waiters.
+    // Padded apart rather than aligned, so that Nspinlocks (and objects containing them) can
+    // be created with plain new.
+    std::atomic< unsigned int >  m_next;       // Next ticket to hand out
+    char                         m_padding[ 64 ];
+    std::atomic< unsigned int >  m_serving;    // Ticket that holds the lock
+};
+
+
+// Inline so that an uncontended lock and unlock are a couple of instructions each.
+
+inline void Nspinlock::pause()
+{
+#if defined( __i386__ ) || defined( __x86_64__ )
+    __builtin_ia32_pause();
+#elif defined( __aarch64__ ) || defined( __arm__ )
+    __asm__ __volatile__( "yield" );
+#endif
+}
+
+
+inline void Nspinlock::lock()
+{
+    unsigned int ticket = m_next.fetch_add( 1, std::memory_order_relaxed );
+    unsigned int spins = 0;
+
+    while ( m_serving.load( std::memory_order_acquire ) != ticket )
+        {
+        if ( ++spins < SPINS_BEFORE_YIELD )
+            pause();
+        else
+            {
+            sched_yield();
+            spins = 0;
+            }
+        }
+}
+
+
+inline bool Nspinlock::tryLock()
+{
+    unsigned int serving = m_serving.load( std::memory_order_acquire );
+    unsigned int free = serving;
+    return m_next.compare_exchange_strong( free, serving + 1, std::memory_order_acquire, std::memory_order_relaxed );
+}
+
+
+inline void Nspinlock::unlock()
+{
+    // Only the holder writes m_serving, so no read-modify-write is needed.
+    m_serving.store( m_serving.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+}
+
+#endif
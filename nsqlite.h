@@ -1,15 +1,18 @@
 #ifndef NSQLITE_H
 #define NSQLITE_H
 
-// Nsqlite v1.0 by Neil Cooper 14th January 2005
+// Nsqlite v1.1 by Neil Cooper 14th January 2005
 // Implements an easy-to-use generic SQLite version 3 database client.
 // class Nsqlite encapsulates a single open SQLite database.
 // Nsqlite throws exceptions of type NerrorException (see nerror.h)
 // if non-recoverable errors occur.
+// v1.1 19th October 2026: Added setLatencyHistogram().
 
 #include <sqlite3.h>
 #include "nsqliteResult.h"
 
+class NconcurrentHistogram;
+
 class Nsqlite
 {
 public:
@@ -37,8 +40,13 @@ public:
     //    Return:
     //        true = success, false = query failed
 
+    void setLatencyHistogram( NconcurrentHistogram* theHistogram );
+    //  Records how long each query takes, in ns, into theHistogram. NULL = don't record.
+    //  The histogram must outlive the database object or be unset first.
+
 private:
     sqlite3*  m_db;
+    NconcurrentHistogram* m_histogram;
 };
 
 
@@ -0,0 +1,42 @@
+#ifndef NSTOPTOKEN_H
+#define NSTOPTOKEN_H
+
+// NstopToken v1.0 by Neil Cooper 18th October 2026
+// Asks a thread to stop, cooperatively. The thread checks stopRequested() at convenient points,
+// and its blocking waits ( Nevent::wait(), Ntime::sleep(), Nsocket::waitForSocketEvent() ) can be
+// given the token so that they return as soon as a stop is requested, however long they were
+// going to wait. Unlike pthread_cancel(), the thread always stops at a point of its choosing
+// with its destructors run and its locks released.
+// Each Nthread has a token, which it passes to thread processes of type NTHREAD_STOPPABLE_PROC.
+
+#include <atomic>
+
+#include "nevent.h"
+
+class NstopToken
+{
+public:
+    NstopToken() : m_stopRequested( false ), m_stop( false, 0, true ) {}
+
+    void requestStop()
+        {
+        if ( !m_stopRequested.exchange( true ) )
+            m_stop.signal();
+        }
+    // Wakes anything waiting with the token. Can't be undone.
+
+    bool stopRequested() const { return m_stopRequested.load( std::memory_order_relaxed ); }
+
+    Nevent& getEvent() const { return m_stop; }
+    // Manual reset event signalled when a stop is requested, for Nevent::waitAny() and
+    // Nevent::getFd(). Don't signal or reset it directly.
+
+private:
+    NstopToken( const NstopToken& );              // Not copyable
+    NstopToken& operator=( const NstopToken& );
+
+    std::atomic< bool > m_stopRequested;
+    mutable Nevent      m_stop;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define NTCPSERVER_H
 
 #include <map>
+#include "nalloc.h"
 #include "nsocket.h"
 #include "nthread.h"
 
@@ -44,13 +45,17 @@ public:
     NtcpServer( NTCPSERVER_THREAD_PROC  theClientProcess,       // User-supplied client function
                 const unsigned short    thePort,                // TCP port to listen on
                 const char*             theIpAddress = NULL,    // Optional parameter for which NIC to use
-                void*                   theUserParam = NULL );  // Optional parameter to pass to client threads.
+                void*                   theUserParam = NULL,    // Optional parameter to pass to client threads.
+                const Nthread::THREAD_ATTRIBUTES& theClientThreadAttributes = Nthread::THREAD_ATTRIBUTES() );
     //  Constructs and immediately starts a TCP server according to the given parameters.
     //  Parameters:
     //    theClientProcess: User-supplied client function run for each icnoming connection
     //    thePort:          TCP port to listen on
     //    theIpAddress:     Optional IP address for multi-node systems indicating whic NIC to use.
     //    theUserParam:     Optional user-parameter to pass to client threads as CLIENT_PARAMS.userParam.
+    //    theClientThreadAttributes: How client threads are created. A server with many connections can
+    //                      save a lot of memory by giving them a smaller stackSize than the 8MB default.
+    //                      Every client thread is created with them, so stack must be NULL.
     //  NB. This constructor does not return until an error occurs, or the server terminates following another
     //  thread calling Stop().
 
@@ -63,7 +68,8 @@ public:
     void start( NTCPSERVER_THREAD_PROC  theClientProcess,
                 const unsigned short    thePort,
                 const char*             theIpAddress = NULL,
-                void*                   theUserParam = NULL );
+                void*                   theUserParam = NULL,
+                const Nthread::THREAD_ATTRIBUTES& theClientThreadAttributes = Nthread::THREAD_ATTRIBUTES() );
     //  (Re)Starts the TCP server according to the given parameters.
     //  This method is provided for use with instances created with the default contructor.
     //  NB. This method does not return until the server terminates following another
@@ -73,6 +79,7 @@ public:
     //    thePort:          TCP port to listen on
     //    theIpAddress:     Optional IP address for multi-node systems indicating whic NIC to use.
     //    theUserParam:     Optional user-parameter to pass to client threads as CLIENT_PARAMS.userParam.
+    //    theClientThreadAttributes: How client threads are created, as for the constructor.
 
 
     bool stop();
@@ -91,10 +98,12 @@ public:
 
     Nsocket                         m_serverSocket;
     Nmutex                          m_serverSocketOwner;
+    NobjectPool<THREAD_CONTEXT>     m_contextPool;
     std::vector<THREAD_CONTEXT*>    m_clientList;
     Nmutex                          m_clientListOwner;
     Nevent                          m_collectGarbage;
     NTCPSERVER_THREAD_PROC          m_clientProcess;
+    Nthread::THREAD_ATTRIBUTES      m_clientThreadAttributes;
     Nthread*                        m_garbageCollector;
 
 
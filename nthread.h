@@ -1,21 +1,29 @@
 #ifndef NTHREAD_H
 #define NTHREAD_H
 
-// nthread v1.3 by Neil Cooper 18th Nov 2019
+// nthread v1.4 by Neil Cooper 18th Nov 2019
 // Implements an easy-to-use pthread-based thread object.
+// v1.4 18th October 2026: Creation attributes (stack, guard, affinity, scheduling) applied
+// before the thread starts. The thread's name is set before the thread process runs.
+// CORE_AFFINITY is an NcpuSet, so affinity isn't limited to 64 cores.
+// getStats() reports CPU time, context switches and migrations.
+// Threads can be asked to stop cooperatively with requestStop() (see nstopToken.h), which the
+// destructor also does before waiting for the thread to exit.
 
 #include <pthread.h>
+#include <stddef.h>
 
 #include <string>
 
-#include "nbinary.h"
+#include "ncpuSet.h"
 #include "nevent.h"
+#include "nstopToken.h"
 
 class Nthread
 {
 public:
 #ifndef __ANDROID__
-    typedef Nbinary CORE_AFFINITY;
+    typedef NcpuSet CORE_AFFINITY;
 
     static const CORE_AFFINITY CORE_AFFINITY_ALL;
 #endif
@@ -23,6 +31,9 @@ public:
     typedef void* ( *NTHREAD_THREAD_PROC )( void* );
     // type of function that will run as a thread
 
+    typedef void* ( *NTHREAD_STOPPABLE_PROC )( const NstopToken&, void* );
+    // type of function that will run as a thread and is given the thread's stop token
+
     typedef enum
         {
         // Time-sharing scheduling models
@@ -35,6 +46,39 @@ public:
         DEADLINE       // not fully supported by pthreads API (yet?)
         } SCHEDULING_MODEL;
 
+    typedef struct
+        {
+        unsigned long long  cpuTimeNs;            // CPU time used by the thread
+        unsigned long long  voluntarySwitches;    // Times it gave up the CPU (blocked, slept or yielded)
+        unsigned long long  involuntarySwitches;  // Times it was preempted
+        unsigned long long  migrations;           // Times moved to another CPU. 0 if the kernel doesn't say.
+        int                 lastCpu;              // CPU it is on, or last ran on
+        } THREAD_STATS;
+
+    static const size_t SYSTEM_DEFAULT = ~(size_t)0;
+
+    typedef struct
+        {
+        size_t              stackSize = 0;
+        // Bytes. 0 = system default (usually 8MB, from ulimit -s). Must be at least PTHREAD_STACK_MIN.
+        size_t              guardSize = SYSTEM_DEFAULT;
+        // Bytes of inaccessible memory below the stack to catch overflows. 0 = none.
+        void*               stack = NULL;
+        // Optional caller-owned stack of stackSize bytes, which must outlive the thread.
+        // No guard is added to a caller-owned stack.
+        bool                hugePageStack = false;
+        // Nthread maps the stack itself, 2MB aligned and rounded up to whole 2MB pages, and asks for
+        // transparent huge pages so deep stacks cost fewer TLB entries. Freed when the thread is joined.
+        // Not for detached threads, as Nthread can't know when the stack is no longer in use.
+#ifndef __ANDROID__
+        CORE_AFFINITY       affinity;
+        // Core(s) the thread starts on, so it never runs elsewhere first. Empty/0 = creating thread's.
+#endif
+        SCHEDULING_MODEL    schedulingModel = DEFAULT;
+        int                 schedulingPriority = 0;
+        // DEFAULT with priority 0 = the creating thread's scheduling. See setSchedulingModel().
+        } THREAD_ATTRIBUTES;
+
 
     Nthread( NTHREAD_THREAD_PROC  theProcess,
     void*                theParameter = NULL,
@@ -47,19 +91,42 @@ public:
     // theName: Unique name for this thread. Empty = use parent program name.
     // theCreateDetachedFlag: if true, creates the thread as 'detached'
 
+    Nthread( NTHREAD_THREAD_PROC      theProcess,
+             void*                    theParameter,
+             const THREAD_ATTRIBUTES& theAttributes,
+             const std::string        theName = "",
+             const bool               theCreateDetachedFlag = false );
+    // As above, but the thread is created with theAttributes rather than the defaults.
+
+    Nthread( NTHREAD_STOPPABLE_PROC   theProcess,
+             void*                    theParameter = NULL,
+             const std::string        theName = "",
+             const bool               theCreateDetachedFlag = false );
+    Nthread( NTHREAD_STOPPABLE_PROC   theProcess,
+             void*                    theParameter,
+             const THREAD_ATTRIBUTES& theAttributes,
+             const std::string        theName = "",
+             const bool               theCreateDetachedFlag = false );
+    // As above, for a thread process that is given the thread's stop token. It should return
+    // soon after a stop is requested, and pass the token to any long waits.
+
     virtual ~Nthread();
 
     pid_t getTid(); // Get TID of the thread. Blocks until thread is created.
 
+    void requestStop() { m_stopToken.requestStop(); }
+    // Asks the thread to stop, and wakes any waits it passed the stop token to. Doesn't wait for
+    // it to stop: getReturnValue() does that.
+
+    const NstopToken& getStopToken() const { return m_stopToken; }
+
     void setNice( int priority ); // -20 highest priority, 19 lowest priority
 
     int getNice();
 
 #ifndef __ANDROID__
     void setThreadAffinity( const CORE_AFFINITY enabledCores = CORE_AFFINITY_ALL );
-    // Sets which core(s) the thread will run on. 0 = all.
-    // Parameter is a bitmask, LSB = core0, MSB = highest in the current platform.
-    // 0 = do not use associated core, 1 = use associated core.
+    // Sets which core(s) the thread will run on. Empty = all.
 
     CORE_AFFINITY getThreadAffinity();
     // Returns currently set affinity.
@@ -72,6 +139,10 @@ public:
 
     SCHEDULING_MODEL getSchedulingModel();
 
+    THREAD_STATS getStats();
+    // Snapshot of what the scheduler has done with the thread so far, to see the effect of
+    // affinity and scheduling settings. The thread must not have exited.
+
 #ifndef __ANDROID__
     void setSchedulingPriority( const int thePriority = 0 );
     // Note: Scheduling priority is ignored and must be 0 for non-realtime scheduling
@@ -91,22 +162,41 @@ private:
     typedef struct
         {
         NTHREAD_THREAD_PROC  threadProc;
+        NTHREAD_STOPPABLE_PROC stoppableProc;
+        const NstopToken*    stopToken;
         void*                threadParams;
         pid_t*               tid;
         Nevent*              tidGot;
+        const char*          name;
+        int                  policy;    // Scheduling the thread sets for itself. -1 = none
+        int                  priority;
         } CallerParams;
 
+    Nthread( NTHREAD_THREAD_PROC      theProcess,
+             NTHREAD_STOPPABLE_PROC   theStoppableProcess,
+             void*                    theParameter,
+             const THREAD_ATTRIBUTES& theAttributes,
+             const std::string        theName,
+             const bool               theCreateDetachedFlag );
+
     static void* getTidAndCall( void* theParams );
 
     void killThread();
 
+    void setStack( pthread_attr_t& theAttributes, const THREAD_ATTRIBUTES& theRequested );
+    void freeStack();
+
     CallerParams m_callerParams;
+    std::string  m_name;
+    void*        m_stack;       // Stack mapped by Nthread for hugePageStack, including its guard
+    size_t       m_stackMapSize;
     pid_t        m_tid;
     pthread_t    m_threadId;
     bool         m_created;
     bool         m_detached;
     bool         m_joined;
     Nevent       m_tidGot;
+    NstopToken   m_stopToken;
 };
 
 #endif
@@ -1,30 +1,99 @@
 #ifndef NTHREADPOOL_H
 #define NTHREADPOOL_H
 
-// NthreadPool v1.5 by Neil Cooper 18th November 2019
+// NthreadPool v1.9 by Neil Cooper 19th October 2026
 // Implements a generic thread pool object.
 // Thread pools allow reuse of existing threads. In environments where multiple small work packages
 // such as transactions need to be performed, this approach provides better performance than
 // dynamically creating/destroying threads for each work package.
+// Pools may be fixed size, unbounded, or elastic. An elastic pool keeps between a minimum and
+// maximum number of threads: it grows when jobs have been kept waiting for longer than a given
+// spawn delay, and retires threads that have been idle for longer than a given retire time.
+// Idle threads are reused most-recently-idle first, so that surplus threads are the ones left
+// idle long enough to be retired.
+// Jobs may be given a priority and a deadline. When jobs are waiting for a thread, the next free
+// thread takes the highest priority one, and among equal priorities the earliest deadline
+// (jobs without a deadline last, then first come first served). A waiting job's priority is
+// raised one level for each aging interval it has waited, so low priority jobs can't starve.
+// getStats() reports how long jobs wait for a thread and run for, and what each worker thread
+// has done and how the scheduler has treated it. For percentiles, setLatencyHistograms() also
+// records every job's times into NconcurrentHistograms.
 
+#include <deque>
 #include <vector>
 #include <string>
 
+#include "nalloc.h"
 #include "nmutex.h"
+#include "nspinlock.h"
 #include "nevent.h"
 #include "nthread.h"
+#include "ntime.h"
 
+class NconcurrentHistogram;
 
 class NthreadPool
 {
 public:
 #ifndef __ANDROID__
-    static const Nthread::CORE_AFFINITY DEFAULT_AFFINITY; // Means "use current default".
+    static const Nthread::CORE_AFFINITY DEFAULT_AFFINITY; // Means "use current default". The empty set.
 #endif
 
     typedef void ( *THREAD_PROC )( void* );
     // Type of user-supplied function to be run as thread.
 
+    typedef enum
+        {
+        LOW_PRIORITY,       // e.g. bulk/batch work
+        NORMAL_PRIORITY,    // Default for jobs submitted without a priority
+        HIGH_PRIORITY,
+        CRITICAL_PRIORITY,  // e.g. latency-critical control work. Never waits for the spawn delay.
+        NUMBER_OF_PRIORITIES
+        } JOB_PRIORITY;
+
+    typedef struct
+        {
+        size_t              currentSize;      // Threads in the pool now (active and idle)
+        size_t              idleThreads;      // Threads waiting for a job now
+        size_t              queueDepth;       // Jobs waiting for a thread now
+        size_t              peakSize;         // Most threads the pool has ever had
+        size_t              peakQueueDepth;   // Most jobs ever waiting for a thread at once
+        unsigned long long  jobsSubmitted;    // Total jobs accepted by the pool
+        unsigned long long  jobsQueued;       // Jobs that had to wait for a thread
+        unsigned long long  threadsSpawned;   // Threads created (including initial threads)
+        unsigned long long  delayedSpawns;    // Threads created because a job waited longer than the spawn delay
+        unsigned long long  threadsRetired;   // Threads removed for being idle too long
+        unsigned long long  jobsAged;         // Waiting jobs that ran at a raised priority due to aging
+        unsigned long long  deadlinesMissed;  // Jobs that only got a thread after their deadline
+        } POOL_METRICS;
+
+    static const int HISTOGRAM_BUCKETS = 32;
+
+    typedef struct
+        {
+        unsigned long long  count;
+        unsigned long long  totalUs;
+        unsigned long long  maxUs;
+        unsigned long long  buckets[ HISTOGRAM_BUCKETS ];
+        // buckets[0]: under 1us. buckets[i]: 2^(i-1)us up to 2^i us. The last bucket also holds anything longer.
+        } DURATION_HISTOGRAM;
+
+    typedef struct
+        {
+        pid_t                   tid;
+        bool                    idle;
+        unsigned long long      jobsRun;
+        unsigned long long      busyUs;     // Time spent running jobs
+        Nthread::THREAD_STATS   thread;     // CPU time, context switches, migrations
+        } WORKER_STATS;
+
+    typedef struct
+        {
+        DURATION_HISTOGRAM          queueWait;  // Submission to a thread starting the job
+        DURATION_HISTOGRAM          runTime;    // Job start to finish
+        std::vector< WORKER_STATS > workers;    // Threads in the pool now
+        } POOL_STATS;
+
     NthreadPool(    const size_t                 thePoolSize = 0,
                     const std::string            threadNameRoot = ""
 #ifndef __ANDROID__
@@ -35,8 +104,24 @@ public:
     // Constructor.
     // thePoolSize constrains the pool to have no more than thePoolSize threads.
     // If 0, the pool will grow as needed (ad infinitum) and SubmitJob() will never block.
-    // defaultAffinity is used for SubmitJob() calls that do not explicitly provide affinity. 0 = all.
+    // defaultAffinity is used for SubmitJob() calls that do not explicitly provide affinity. Empty = all.
 
+    NthreadPool(    const size_t                 theMinSize,
+                    const size_t                 theMaxSize,
+                    const Ntime                  theIdleRetireTime,
+                    const Ntime                  theSpawnDelay = 0,
+                    const std::string            threadNameRoot = ""
+#ifndef __ANDROID__
+                    ,
+                    const Nthread::CORE_AFFINITY defaultAffinity = Nthread::CORE_AFFINITY_ALL
+#endif
+                );
+    // Constructor for an elastic pool.
+    // theMinSize:        Threads created up front and never retired.
+    // theMaxSize:        Most threads the pool may grow to. 0 = unbounded.
+    // theIdleRetireTime: Threads above theMinSize idle for this long exit. 0 = never retire.
+    // theSpawnDelay:     When no thread is idle, a job waits this long for one before the pool
+    //                    grows to run it. 0 = grow immediately.
 
     virtual ~NthreadPool();
     // Note: Destructor will wait for pool to be idle (i.e. user tasks to complete) before it completes.
@@ -54,14 +139,65 @@ public:
     // it as a parameter. This call may block until a pool thread is available, unless the
     // thread Pool was constructed with a pool size of 0 (meaning dynamic sizing).
 
+    void submitJob( THREAD_PROC                  theThreadProc,
+                    void*                        theThreadParam,
+                    const JOB_PRIORITY           thePriority,
+                    const Ntime                  theDeadline = 0
+#ifndef __ANDROID__
+                    ,
+                    const Nthread::CORE_AFFINITY affinity = NthreadPool::DEFAULT_AFFINITY
+#endif
+                   );
+    // As above, for a job with the given priority.
+    // theDeadline: Time from now by which the job should have started. Orders jobs of equal
+    //              priority that are waiting for a thread (earliest first). 0 = no deadline.
+
+    bool trySubmitJob( THREAD_PROC                  theThreadProc,
+                       void*                        theThreadParam = NULL
+#ifndef __ANDROID__
+                       ,
+                       const Nthread::CORE_AFFINITY affinity = NthreadPool::DEFAULT_AFFINITY
+#endif
+                     );
+    // As submitJob() but never blocks. The job is only submitted if a pool thread can take it
+    // immediately (an idle thread exists or the pool is allowed to grow without delay).
+    // Safe to call from inside a job running on this pool.
+    // Return: true = job submitted, false = no thread available or the pool is being destructed
+    // (job not submitted).
+
+    void setPriorityAging( const Ntime theAgingInterval = 1000 );
+    // Sets how long a job waits for a thread before its priority is raised by one level.
+    // 0 = never raise priorities (low priority jobs may then wait forever on a busy pool).
+
+    void setPriorityScheduling( const JOB_PRIORITY              thePriority,
+                                const Nthread::SCHEDULING_MODEL theModel,
+                                const int                       theSchedulingPriority = 0 );
+    // Pool threads will switch to the given scheduling model (see Nthread::setSchedulingModel())
+    // before running a job of the given priority. Priorities not set this way run under DEFAULT.
+    // Realtime models need the relevant privilege; if a thread can't switch, a warning is logged
+    // and the job runs under the thread's current model.
+    // Set these up before submitting jobs.
+
+    void setLatencyHistograms( NconcurrentHistogram* theQueueWait, NconcurrentHistogram* theRunTime = NULL );
+    // Records each job's wait for a thread and run time, in ns, into the given histograms as
+    // well as getStats()' coarser ones. NULL = don't record. Set these up before submitting jobs,
+    // and keep the histograms until the pool is destroyed.
+
     size_t getPoolSize();
     // Returns the total no. of threads in the pool (both active and not).
     // Always returns the same value unless the pool was created as dynamically sizing.
 
+    POOL_METRICS getMetrics();
+    // Returns a snapshot of the pool's sizing counters, e.g. for tuning elastic pool parameters.
+
+    POOL_STATS getStats();
+    // Returns job timings and per worker thread statistics. Reads /proc for each worker, so it
+    // costs more than getMetrics().
+
 #ifndef __ANDROID__
     void updatePoolAffinity( const Nthread::CORE_AFFINITY affinity = Nthread::CORE_AFFINITY_ALL );
     // Change the core affinity of all threads in the pool. Will switch threads currently running jobs too.
-    // Also updates what the pool knows as DEFAULT_AFFINITY. 0 = All cores.
+    // Also updates what the pool knows as DEFAULT_AFFINITY. Empty = All cores.
 #endif
 
     void waitForIdle();
@@ -77,30 +213,95 @@ private:
         THREAD_PROC             userProc;
         void*                   userParams;
         Nevent                  startThread;
-        Nevent*                 idleCountEvent;
+        NthreadPool*            pool;
         bool                    idle;
-        bool*                   closing;
-
+        JOB_PRIORITY            priority;          // Of the job being run
+        Nthread::SCHEDULING_MODEL schedulingModel; // Thread's current model, if setPriorityScheduling() used
+        int                     schedulingPriority;
+        unsigned long long      submitNs;          // When the job being run was submitted
+        unsigned long long      jobsRun;           // Owned by m_statsOwner, as are the pool's histograms
+        unsigned long long      busyUs;
         } THREAD_CONTEXT;
 
+    typedef struct
+        {
+        THREAD_PROC             userProc;
+        void*                   userParams;
+#ifndef __ANDROID__
+        Nthread:: CORE_AFFINITY affinity;
+#endif
+        Nevent*                 accepted;   // Signalled when a thread takes the job
+        JOB_PRIORITY            priority;
+        unsigned long long      submitNs;   // Monotonic, for aging and the queue wait histogram
+        unsigned long long      deadlineNs; // Monotonic. 0 = none.
+        } PENDING_JOB;
+
+    typedef struct
+        {
+        Nthread::SCHEDULING_MODEL model;
+        int                       priority;
+        bool                      warned;   // Only warn once if we aren't allowed to use it
+        } PRIORITY_SCHEDULING;
+
     static void* threadProc( void* theThreadContext );
+
+    void initialise( const size_t theInitialSize );
+
+    void submit( THREAD_PROC                  theThreadProc,
+                 void*                        theThreadParam,
+                 const JOB_PRIORITY           thePriority,
+                 const Ntime&                 theDeadline
+#ifndef __ANDROID__
+                 ,
+                 const Nthread::CORE_AFFINITY affinity
+#endif
+               );
+
     THREAD_CONTEXT* extendPool(
 #ifndef __ANDROID__
                                 const Nthread::CORE_AFFINITY affinity
 #endif
                                                                       );
 
-    THREAD_CONTEXT* getIdleThread(
+    THREAD_CONTEXT* claimIdleThread(
 #ifndef __ANDROID__
-                                   const Nthread::CORE_AFFINITY affinity
+                                     const Nthread::CORE_AFFINITY affinity
 #endif
-                                                                         );
+                                                                           );
+
+    bool canGrow();
+    void startJob( THREAD_CONTEXT* theThread, THREAD_PROC theThreadProc, void* theThreadParam, const JOB_PRIORITY thePriority,
+                   const unsigned long long theSubmitNs );
+    void jobDone( THREAD_CONTEXT* theThread, const unsigned long long theStartNs );
+    std::deque< PENDING_JOB >::iterator selectPendingJob();
+    bool takePendingJob( THREAD_CONTEXT* theThread );
+    void applyPriorityScheduling( THREAD_CONTEXT* theThread );
+    bool retireThread( THREAD_CONTEXT* theThread );
+    void reapRetiredThreads();
+    void jobStarted();
 
     bool                             m_closing;
-    const size_t                     m_poolMaxSize;
+    size_t                           m_poolMinSize;
+    size_t                           m_poolMaxSize;
+    Ntime                            m_idleRetireTime;
+    Ntime                            m_spawnDelay;
+    Ntime                            m_agingInterval;
+    PRIORITY_SCHEDULING              m_priorityScheduling[ NUMBER_OF_PRIORITIES ];
+    bool                             m_priorityScheduled;  // true once setPriorityScheduling() used
+    NobjectPool< THREAD_CONTEXT >    m_contextPool;
     std::vector< THREAD_CONTEXT* >   m_pool;
-    Nmutex                           m_poolOwner;
-    Nevent                           m_idleCountEvent;
+    std::vector< THREAD_CONTEXT* >   m_idleThreads;    // Used as a stack: most recently idle at the back
+    std::vector< THREAD_CONTEXT* >   m_retiredThreads; // Exited threads waiting to be joined
+    std::deque< PENDING_JOB >        m_pendingJobs;
+    size_t                           m_activeCount;
+    Nmutex                           m_poolOwner;      // Owns all of the above. Never held while blocking.
+    Nevent                           m_allIdle;        // Manual reset. Signalled when no jobs are active or pending.
+    POOL_METRICS                     m_metrics;
+    DURATION_HISTOGRAM               m_queueWait;
+    DURATION_HISTOGRAM               m_runTime;
+    Nspinlock                        m_statsOwner;     // Owns the histograms and per thread job counts
+    NconcurrentHistogram*            m_queueWaitHistogram;
+    NconcurrentHistogram*            m_runTimeHistogram;
 #ifndef __ANDROID__
     Nthread:: CORE_AFFINITY          m_defaultAffinity;
 #endif
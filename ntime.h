@@ -1,7 +1,7 @@
 #ifndef NTIME_H
 #define NTIME_H
 
-// Ntime v1.6 by Neil Cooper 11th Dec 2019
+// Ntime v1.7 by Neil Cooper 11th Dec 2019
 // Ntime is a helper class that encapulates a timespec struct.
 // It provides lots of useful functionality related to time
 // such as timespec/timeval conversions, math operators,
@@ -10,11 +10,16 @@
 // It also implements Win32-like GetTickCount() and Sleep().
 // ( Older versions of Linux sleep() gobble cpu time. Ntime's
 //  Sleep() doesn't ).
+// v1.7 19th October 2026: Added Ntimestamp, a cheap monotonic time in ns for timing code,
+//                         with coarse and TSC clocks.
 
 #include <time.h>     // for timespec
 #include <sys/time.h> // for timeval
+#include <stdint.h>   // for int64_t
 #include <string>     // for std::string
 
+class NstopToken;
+
 class Ntime
 {
 public:
@@ -35,6 +40,10 @@ public:
     // For Win32 compatability: If Sleep is called with 0 delay, the
     // thread's current timeslice is yielded.
 
+    static bool sleep( const Ntime& theDelay, const NstopToken& theStopToken );
+    // As above, but returns false as soon as a stop is requested through theStopToken.
+    // Signals don't end the sleep early.
+
     static Ntime getUptime();
     // Length of time that the system has been running. Resolution is 1 second.
 
@@ -111,4 +120,103 @@ private:
 };
 
 
+class Ndeadline
+{
+public:
+    // A point in time on the monotonic clock (which NTP and clock changes don't affect), for
+    // timeouts. Work out a deadline once and then pass it to repeated waits in a loop, so the
+    // loop as a whole times out rather than each wait starting the timeout again.
+
+    Ndeadline( const Ntime& theTimeout = 0 );
+    // Deadline theTimeout from now. A zero timeout means no deadline (waits forever), as elsewhere.
+
+    bool isInfinite() const;
+
+    bool hasExpired() const;
+
+    Ntime getRemaining() const;
+    // Returns time left before the deadline, or 0 if it has passed. Infinite deadlines return 0.
+
+    int getRemainingMs() const;
+    // As getRemaining() but rounded up to whole ms and in poll() timeout form: -1 for infinite,
+    // capped at INT_MAX.
+
+    const timespec& getAsTimespec() const;
+    // Returns the deadline as an absolute CLOCK_MONOTONIC time, e.g. for futexes or
+    // pthread_clockjoin_np(). Not meaningful for infinite deadlines.
+
+private:
+    timespec m_deadline;
+    bool     m_infinite;
+};
+
+
+class Ntimestamp
+{
+public:
+    // A time in nanoseconds in one 64 bit integer, for timing code where Ntime's cost shows up:
+    // reading a clock is one call with no object to construct, and arithmetic is on integers.
+    // Times from now() are points on the monotonic clock, so only differences between them mean
+    // anything. Like Ntime, an Ntimestamp also holds intervals.
+    // Clocks:
+    //   MONOTONIC:         clock_gettime( CLOCK_MONOTONIC ), through the vDSO. Around 20ns.
+    //   MONOTONIC_COARSE:  The monotonic time at the last timer tick, so only good to 1 to 10ms,
+    //                      but a few ns to read.
+    //   TSC:               The CPU's time stamp counter, scaled to the monotonic clock. Under
+    //                      10ns on most CPUs. Needs an invariant TSC ( one that runs at a constant
+    //                      rate in all power states ) and falls back to MONOTONIC without it.
+    // All three give times on the same scale, so they can be compared with each other, to the
+    // accuracy of the coarse clock's tick or the TSC's calibration.
+
+    typedef enum
+        {
+        MONOTONIC,
+        MONOTONIC_COARSE,
+        TSC
+        } CLOCK;
+
+    static Ntimestamp now( const CLOCK theClock = MONOTONIC );
+
+    static bool isTscAvailable();
+    // True on x86 CPUs with an invariant TSC.
+
+    static void calibrateTsc( const Ntime& theDuration = 10 );
+    // Measures the TSC's rate against the monotonic clock over theDuration. now( TSC ) does this
+    // for 10ms the first time it's called: call this at start up to keep that out of the first
+    // measurement, or with a longer duration for a more accurate rate.
+
+    explicit Ntimestamp( const int64_t theNs = 0 ) : m_ns( theNs ) {}
+    Ntimestamp( const Ntime& theTime );
+
+    Ntime getAsNtime() const;
+    // The same time as an Ntime, e.g. an interval to sleep for or print.
+
+    Ntime getAsLocalTime() const;
+    // A time from now() as the local time it was, as Ntime::getCurrentLocalTime() would have given.
+
+    int64_t getAsNs() const      { return m_ns; }
+    int64_t getAsUs() const      { return m_ns / 1000; }
+    int64_t getAsMs() const      { return m_ns / 1000000; }
+    double  getAsSeconds() const { return m_ns / 1e9; }
+
+    Ntimestamp getElapsed( const CLOCK theClock = MONOTONIC ) const { return now( theClock ) - *this; }
+    // Time since a time from now().
+
+    Ntimestamp& operator +=( const Ntimestamp& theTime )      { m_ns += theTime.m_ns; return *this; }
+    Ntimestamp& operator -=( const Ntimestamp& theTime )      { m_ns -= theTime.m_ns; return *this; }
+    Ntimestamp  operator  +( const Ntimestamp& theTime ) const { return Ntimestamp( m_ns + theTime.m_ns ); }
+    Ntimestamp  operator  -( const Ntimestamp& theTime ) const { return Ntimestamp( m_ns - theTime.m_ns ); }
+
+    bool operator ==( const Ntimestamp& theTime ) const { return m_ns == theTime.m_ns; }
+    bool operator !=( const Ntimestamp& theTime ) const { return m_ns != theTime.m_ns; }
+    bool operator  <( const Ntimestamp& theTime ) const { return m_ns < theTime.m_ns; }
+    bool operator  >( const Ntimestamp& theTime ) const { return m_ns > theTime.m_ns; }
+    bool operator <=( const Ntimestamp& theTime ) const { return m_ns <= theTime.m_ns; }
+    bool operator >=( const Ntimestamp& theTime ) const { return m_ns >= theTime.m_ns; }
+
+private:
+    int64_t m_ns;
+};
+
+
 #endif
@@ -0,0 +1,202 @@
+// nalloc.cxx by Neil Cooper. See nalloc.h for documentation
+#include "nalloc.h"
+
+#include <stdlib.h>     // for malloc()
+#include <string.h>     // for memset()
+#include <map>
+#include <pthread.h>
+
+#include "nerror.h"
+#include "nmutex.h"    // for NlockGuard
+
+using namespace std;
+
+namespace NALLOC
+{
+const size_t ALIGNMENT = alignof( max_align_t );
+
+inline size_t roundUp( const size_t theSize, const size_t theAlignment )
+{
+    return ( theSize + theAlignment - 1 ) & ~( theAlignment - 1 );
+}
+
+char* allocateChunk( const size_t theSize )
+{
+    char* chunk = static_cast< char* >( malloc( theSize ) );
+    if ( !chunk )
+        throw bad_alloc();
+    return chunk;
+}
+
+// Shared pools by block size. Never freed, so blocks can be freed back to them at any time.
+pthread_mutex_t                     sharedPoolsMutex = PTHREAD_MUTEX_INITIALIZER;
+map< size_t, NblockPool* >*         sharedPools = NULL;
+}
+using namespace NALLOC;
+
+
+Narena::Narena( const size_t theChunkSize ) : m_chunkSize( roundUp( theChunkSize, ALIGNMENT ) ),
+                                              m_firstChunkSize( 0 ),
+                                              m_next( NULL ),
+                                              m_end( NULL )
+{
+    memset( &m_metrics, 0, sizeof( m_metrics ) );
+}
+
+
+Narena::~Narena()
+{
+    for ( size_t i = 0; i < m_chunks.size(); i++ )
+        ::free( m_chunks[i] );
+}
+
+
+void* Narena::allocate( const size_t theSize, const size_t theAlignment )
+{
+    m_metrics.allocations++;
+
+    char* block = reinterpret_cast< char* >( roundUp( reinterpret_cast< size_t >( m_next ), theAlignment ) );
+    if ( !m_next || ( block + theSize > m_end ) )
+        {
+        newChunk( theSize + theAlignment );
+        block = reinterpret_cast< char* >( roundUp( reinterpret_cast< size_t >( m_next ), theAlignment ) );
+        }
+
+    m_metrics.bytesInUse += ( block + theSize ) - m_next;
+    m_next = block + theSize;
+    return block;
+}
+
+
+void Narena::reset()
+{
+    // Keep the first chunk so a steady cycle of use and reset doesn't touch the heap.
+    for ( size_t i = 1; i < m_chunks.size(); i++ )
+        ::free( m_chunks[i] );
+
+    if ( m_chunks.size() )
+        {
+        m_chunks.resize( 1 );
+        m_next = m_chunks[0];
+        m_end = m_next + m_firstChunkSize;
+        m_metrics.bytesReserved = m_firstChunkSize;
+        }
+    m_metrics.bytesInUse = 0;
+}
+
+
+void Narena::newChunk( const size_t theMinimumSize )
+{
+    size_t size = ( theMinimumSize > m_chunkSize ) ? theMinimumSize : m_chunkSize;
+    char* chunk = allocateChunk( size );
+
+    if ( m_chunks.empty() )
+        m_firstChunkSize = size;
+    m_chunks.push_back( chunk );
+    m_next = chunk;
+    m_end = chunk + size;
+    m_metrics.bytesReserved += size;
+    m_metrics.chunksAllocated++;
+}
+
+
+Narena& Narena::forThread()
+{
+    static thread_local Narena arena;
+    return arena;
+}
+
+
+NblockPool::NblockPool( const size_t theBlockSize, const size_t theBlocksPerChunk ) :
+                            m_blockSize( roundUp( theBlockSize < sizeof( FREE_BLOCK ) ? sizeof( FREE_BLOCK ) : theBlockSize, ALIGNMENT ) ),
+                            m_blocksPerChunk( theBlocksPerChunk ? theBlocksPerChunk : 1 ),
+                            m_freeList( NULL )
+{
+    memset( &m_metrics, 0, sizeof( m_metrics ) );
+}
+
+
+NblockPool::~NblockPool()
+{
+    for ( size_t i = 0; i < m_chunks.size(); i++ )
+        ::free( m_chunks[i] );
+}
+
+
+void* NblockPool::allocate()
+{
+    m_owner.lock();
+    m_metrics.allocations++;
+
+    if ( !m_freeList )
+        {
+        // Allocating a chunk under the spinlock is rare enough not to matter.
+        char* chunk;
+        try
+            {
+            chunk = allocateChunk( m_blockSize * m_blocksPerChunk );
+            m_chunks.push_back( chunk );
+            }
+        catch ( ... )
+            {
+            m_owner.unlock();
+            throw;
+            }
+
+        for ( size_t i = m_blocksPerChunk; i > 0; i-- )
+            {
+            FREE_BLOCK* block = reinterpret_cast< FREE_BLOCK* >( chunk + ( i - 1 ) * m_blockSize );
+            block->next = m_freeList;
+            m_freeList = block;
+            }
+        m_metrics.blocksFree += m_blocksPerChunk;
+        m_metrics.chunksAllocated++;
+        }
+
+    FREE_BLOCK* block = m_freeList;
+    m_freeList = block->next;
+    m_metrics.blocksFree--;
+    m_metrics.blocksInUse++;
+
+    m_owner.unlock();
+    return block;
+}
+
+
+void NblockPool::free( void* theBlock )
+{
+    if ( !theBlock )
+        return;
+
+    FREE_BLOCK* block = static_cast< FREE_BLOCK* >( theBlock );
+
+    m_owner.lock();
+    block->next = m_freeList;
+    m_freeList = block;
+    m_metrics.blocksFree++;
+    m_metrics.blocksInUse--;
+    m_owner.unlock();
+}
+
+
+NblockPool::POOL_METRICS NblockPool::getMetrics()
+{
+    NlockGuard< Nspinlock > owner( m_owner );
+    return m_metrics;
+}
+
+
+NblockPool& NblockPool::shared( const size_t theBlockSize )
+{
+    pthread_mutex_lock( &sharedPoolsMutex );
+    if ( !sharedPools )
+        sharedPools = new map< size_t, NblockPool* >;
+
+    // Take about 64k from the heap at a time, or a block at a time for big blocks.
+    NblockPool*& pool = ( *sharedPools )[ theBlockSize ];
+    if ( !pool )
+        pool = new NblockPool( theBlockSize, ( theBlockSize < 65536 ) ? 65536 / theBlockSize : 1 );
+    pthread_mutex_unlock( &sharedPoolsMutex );
+
+    return *pool;
+}
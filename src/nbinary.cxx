@@ -1,40 +1,72 @@
 // nbinary.cxx by Neil Cooper. See nbinary.h for documentation
 #include "nbinary.h"
-#include <string.h> // for ostringstream
 
-// Neil TODO:: reimplement using std::stoull?
-
-#include <cmath>    // for log2
+#include <sstream>  // for ostringstream
 
 #include "nerror.h"
 
 using namespace std;
 
+static const size_t WORD_BITS = 64;
+
+
+// Unless the whole library is built for a CPU with POPCNT, __builtin_popcountll() is a call to a
+// table-driven routine, so use the instruction when the CPU has it.
+static size_t countOnes( const uint64_t* theWords, const size_t theCount )
+{
+    size_t ones = 0;
+    for ( size_t i = 0; i < theCount; i++ )
+        ones += __builtin_popcountll( theWords[i] );
+    return ones;
+}
 
-Nbinary::Nbinary()
+#if defined( __x86_64__ ) || defined( __i386__ )
+__attribute__(( target( "popcnt" ) ))
+static size_t countOnesPopcnt( const uint64_t* theWords, const size_t theCount )
 {
+    size_t ones = 0;
+    for ( size_t i = 0; i < theCount; i++ )
+        ones += __builtin_popcountll( theWords[i] );
+    return ones;
 }
+#endif
 
 
-Nbinary::Nbinary( const Nbinary& other )
+NbinaryBit& NbinaryBit::operator = ( const char theBit )
 {
-    m_value = other.m_value;
+    if ( ( theBit == '1' ) || ( theBit == 1 ) )
+        *m_word |= m_mask;
+    else if ( ( theBit == '0' ) || ( theBit == 0 ) )
+        *m_word &= ~m_mask;
+    else
+        ERROR( "Nbinary: Bits can only be set to '0' or '1', not '", theBit, "'" );
+    return *this;
 }
 
 
-Nbinary::Nbinary( const string& value )
+Nbinary::Nbinary() : m_length( 0 )
+{
+}
+
+
+Nbinary::Nbinary( const Nbinary& other ) : m_words( other.m_words ), m_length( other.m_length )
+{
+}
+
+
+Nbinary::Nbinary( const string& value ) : m_length( 0 )
 {
     setByString( value );
 }
 
 
-Nbinary::Nbinary( const char* value )
+Nbinary::Nbinary( const char* value ) : m_length( 0 )
 {
     setByString( value );
 }
 
 
-Nbinary::Nbinary( const unsigned long long intValue, const size_t lengthInbits, const bool allowTruncate )
+Nbinary::Nbinary( const unsigned long long intValue, const size_t lengthInbits, const bool allowTruncate ) : m_length( 0 )
 {
     setByInt( intValue, lengthInbits, allowTruncate );
 }
@@ -61,19 +93,56 @@ Nbinary& Nbinary::operator = ( const unsigned long long value )
 
 bool Nbinary::operator == ( const Nbinary& other ) const
 {
-    return ( m_value == other.m_value );
+    // As when these were strings, "011" isn't "11".
+    return ( m_length == other.m_length ) && ( m_words == other.m_words );
+}
+
+
+char Nbinary::operator[] ( const int index ) const
+{
+    if ( ( index < 0 ) || ( (size_t)index >= m_length ) )
+        return '\0';
+    return getBit( m_length - 1 - index ) ? '1' : '0';
 }
 
 
-const char Nbinary::operator[] ( const int index ) const
+NbinaryBit Nbinary::operator[] ( const int index )
 {
-    return m_value[ index ];
+    if ( ( index < 0 ) || ( (size_t)index >= m_length ) )
+        ERROR( "Nbinary: Bit ", index, " is out of range for a ", m_length, " bit value" );
+    size_t position = m_length - 1 - index;
+    return NbinaryBit( m_words[ position / WORD_BITS ], 1ULL << ( position % WORD_BITS ) );
 }
 
 
-char& Nbinary::operator[] ( const int index )
+bool Nbinary::getBit( const size_t position ) const
 {
-    return m_value[ index ];
+    if ( position >= m_length )
+        ERROR( "Nbinary: Bit position ", position, " is out of range for a ", m_length, " bit value" );
+    return ( m_words[ position / WORD_BITS ] >> ( position % WORD_BITS ) ) & 1;
+}
+
+
+void Nbinary::setBit( const size_t position, const bool value )
+{
+    if ( position >= m_length )
+        ERROR( "Nbinary: Bit position ", position, " is out of range for a ", m_length, " bit value" );
+    uint64_t mask = 1ULL << ( position % WORD_BITS );
+    if ( value )
+        m_words[ position / WORD_BITS ] |= mask;
+    else
+        m_words[ position / WORD_BITS ] &= ~mask;
+}
+
+
+size_t Nbinary::countOnes() const
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+    static const bool popcnt = __builtin_cpu_supports( "popcnt" );
+    if ( popcnt )
+        return countOnesPopcnt( m_words.data(), m_words.size() );
+#endif
+    return ::countOnes( m_words.data(), m_words.size() );
 }
 
 
@@ -85,218 +154,344 @@ bool Nbinary::initialise( const unsigned long long value, const size_t lengthInb
 
 bool Nbinary::setBitLength( const size_t lengthInbits, const bool allowTruncate )
 {
+    // The value survives if nothing is set at or above the new length.
     bool valueRetained = true;
-    int change = lengthInbits - m_value.length();
-    string tempValue = m_value;
-
-    while ( change < 0 && tempValue.length() )
+    if ( lengthInbits < m_length )
         {
-        if ( tempValue[ 0 ] == '1' )
-            valueRetained = false;
-        tempValue = tempValue.substr( 1, tempValue.length() - 1 );
-        change++;
+        size_t word = lengthInbits / WORD_BITS;
+        uint64_t kept = ( lengthInbits % WORD_BITS ) ? ~0ULL >> ( WORD_BITS - ( lengthInbits % WORD_BITS ) ) : 0;
+        valueRetained = !( m_words[ word ] & ~kept );
+        for ( size_t i = word + 1; valueRetained && ( i < m_words.size() ); i++ )
+            valueRetained = !m_words[i];
         }
 
-    if ( change > 0 )
-        tempValue = string( change, '0' ) + tempValue;
-
     if ( !valueRetained && !allowTruncate )
-        {
         ERROR( "Given value cannot be stored in requested number of bits" );
-        }
-    else
-        m_value = tempValue;
 
+    resize( lengthInbits );
     return valueRetained;
 }
 
 
 size_t Nbinary::length() const
 {
-    return m_value.length();
+    return m_length;
 }
 
 
 string Nbinary::getAsBinary() const
 {
-    return m_value;
+    string binary( m_length, '0' );
+    for ( size_t i = 0; i < m_words.size(); i++ )
+        for ( uint64_t word = m_words[i]; word; word &= word - 1 )
+            binary[ m_length - 1 - ( ( i * WORD_BITS ) + __builtin_ctzll( word ) ) ] = '1';
+    return binary;
 }
 
 
 string Nbinary::getAsHex() const
 {
-    ostringstream ostr;
-    ostr << hex << uppercase << getAsInt();
-    return ostr.str();
+    // Without leading zeros, and "0" for zero
+    static const char digits[] = "0123456789ABCDEF";
+    string hex;
+    for ( size_t nibble = ( m_length + 3 ) / 4; nibble > 0; nibble-- )
+        {
+        size_t position = ( nibble - 1 ) * 4;
+        unsigned int digit = ( m_words[ position / WORD_BITS ] >> ( position % WORD_BITS ) ) & 0xF;
+        if ( digit || hex.size() )
+            hex += digits[ digit ];
+        }
+    return hex.size() ? hex : "0";
 }
 
 
-unsigned long long Nbinary::getAsInt() const
+unsigned long long Nbinary::getAsInt( const bool allowTruncate ) const
 {
-   unsigned long long b = 1;
-   unsigned long long r = 0;
+    if ( !allowTruncate )
+        for ( size_t i = 1; i < m_words.size(); i++ )
+            if ( m_words[i] )
+                ERROR( "Nbinary: Value 0x", getAsHex(), " is too large for an integer" );
+    return m_words.size() ? m_words[0] : 0;
+}
 
-   for ( int i = m_value.size() - 1; i >= 0; i-- )
-      {
-      if ( m_value[i] == '1' )
-         r = r + b;
-      b = b * 2;
-      }
 
-   return r;
+unsigned long long Nbinary::getBits( const size_t position, const unsigned int width ) const
+{
+    if ( ( width < 1 ) || ( width > WORD_BITS ) )
+        ERROR( "Nbinary: Bit fields read as integers are 1 to 64 bits, not ", width );
+    checkField( position, width );
+
+    // Within one word, or straddling two
+    size_t word = position / WORD_BITS;
+    size_t offset = position % WORD_BITS;
+    uint64_t value = m_words[ word ] >> offset;
+    if ( offset + width > WORD_BITS )
+        value |= m_words[ word + 1 ] << ( WORD_BITS - offset );
+    return ( width == WORD_BITS ) ? value : value & ( ( 1ULL << width ) - 1 );
 }
 
 
-void Nbinary::setByString( const string& value )
+void Nbinary::setBits( const size_t position, const unsigned int width, const unsigned long long value )
 {
-   if ( ( value.substr( 0, 2 )  == "0x" ) || ( value.substr( 0, 2 )  == "0X" ) )
-      setByHex( value.substr( 2, value.length() - 2 ) );
-   else
-      if ( ( value.substr( 0, 2 )  == "0b" ) || ( value.substr( 0, 2 )  == "0B" ) )
-         setByBinary( value.substr( 2, value.length() - 2 ) );
-      else
-         setByInt( stoull( value, NULL, 0 ) );
+    if ( ( width < 1 ) || ( width > WORD_BITS ) )
+        ERROR( "Nbinary: Bit fields set from integers are 1 to 64 bits, not ", width );
+    checkField( position, width );
+
+    size_t word = position / WORD_BITS;
+    size_t offset = position % WORD_BITS;
+    uint64_t mask = ( width == WORD_BITS ) ? ~0ULL : ( 1ULL << width ) - 1;
+    uint64_t bits = value & mask;
+    m_words[ word ] = ( m_words[ word ] & ~( mask << offset ) ) | ( bits << offset );
+    if ( offset + width > WORD_BITS )
+        m_words[ word + 1 ] = ( m_words[ word + 1 ] & ~( mask >> ( WORD_BITS - offset ) ) ) | ( bits >> ( WORD_BITS - offset ) );
 }
 
 
-void Nbinary::setByHex( const string& inHex )
+Nbinary Nbinary::getField( const size_t position, const size_t width ) const
 {
-   string in( inHex );
-   m_value.clear();
+    checkField( position, width );
+    Nbinary field;
+    field.resize( width );
+    for ( size_t done = 0; done < width; done += WORD_BITS )
+        field.m_words[ done / WORD_BITS ] = getBits( position + done, ( width - done < WORD_BITS ) ? width - done : WORD_BITS );
+    return field;
+}
 
-   while ( in.size() )
-      {
-      switch( in[0] )
-         {
-         case '0':
-            m_value += "0000";
-            break;
 
-         case '1':
-            m_value += "0001";
-            break;
+void Nbinary::setField( const size_t position, const Nbinary& value )
+{
+    checkField( position, value.m_length );
+    for ( size_t done = 0; done < value.m_length; done += WORD_BITS )
+        setBits( position + done, ( value.m_length - done < WORD_BITS ) ? value.m_length - done : WORD_BITS, value.m_words[ done / WORD_BITS ] );
+}
 
-         case '2':
-            m_value += "0010";
-            break;
 
-         case '3':
-            m_value += "0011";
-            break;
+int Nbinary::compare( const Nbinary& other ) const
+{
+    // From the top word down, with the shorter one's missing words taken as 0
+    size_t words = ( m_words.size() > other.m_words.size() ) ? m_words.size() : other.m_words.size();
+    for ( size_t i = words; i > 0; i-- )
+        {
+        uint64_t mine = ( i <= m_words.size() ) ? m_words[ i - 1 ] : 0;
+        uint64_t theirs = ( i <= other.m_words.size() ) ? other.m_words[ i - 1 ] : 0;
+        if ( mine != theirs )
+            return ( mine < theirs ) ? -1 : 1;
+        }
+    return 0;
+}
 
-         case '4':
-            m_value += "0100";
-            break;
 
-         case '5':
-            m_value += "0101";
-            break;
+Nbinary& Nbinary::operator &= ( const Nbinary& other )
+{
+    growTo( other.m_length );
+    for ( size_t i = 0; i < m_words.size(); i++ )
+        m_words[i] &= ( i < other.m_words.size() ) ? other.m_words[i] : 0;
+    return *this;
+}
 
-         case '6':
-            m_value += "0110";
-            break;
 
-         case '7':
-            m_value += "0111";
-            break;
+Nbinary& Nbinary::operator |= ( const Nbinary& other )
+{
+    growTo( other.m_length );
+    for ( size_t i = 0; i < other.m_words.size(); i++ )
+        m_words[i] |= other.m_words[i];
+    return *this;
+}
+
+
+Nbinary& Nbinary::operator ^= ( const Nbinary& other )
+{
+    growTo( other.m_length );
+    for ( size_t i = 0; i < other.m_words.size(); i++ )
+        m_words[i] ^= other.m_words[i];
+    return *this;
+}
 
-         case '8':
-            m_value += "1000";
-            break;
 
-         case '9':
-            m_value += "1001";
-            break;
+Nbinary& Nbinary::operator += ( const Nbinary& other )
+{
+    growTo( other.m_length );
+    uint64_t carry = 0;
+    for ( size_t i = 0; i < m_words.size(); i++ )
+        {
+        uint64_t addend = ( i < other.m_words.size() ) ? other.m_words[i] : 0;
+        if ( !addend && !carry )
+            {
+            if ( i >= other.m_words.size() )
+                break;
+            continue;
+            }
+        uint64_t sum = m_words[i] + addend;
+        uint64_t carried = sum < addend;
+        m_words[i] = sum + carry;
+        carry = carried | ( m_words[i] < carry );
+        }
+    resize( m_length );     // Drops the carry out of the top bit
+    return *this;
+}
 
-         case 'A':
-         case 'a':
-            m_value += "1010";
-            break;
 
-         case 'B':
-         case 'b':
-            m_value += "1011";
-            break;
+Nbinary& Nbinary::operator -= ( const Nbinary& other )
+{
+    growTo( other.m_length );
+    uint64_t borrow = 0;
+    for ( size_t i = 0; i < m_words.size(); i++ )
+        {
+        uint64_t subtrahend = ( i < other.m_words.size() ) ? other.m_words[i] : 0;
+        if ( !subtrahend && !borrow )
+            {
+            if ( i >= other.m_words.size() )
+                break;
+            continue;
+            }
+        uint64_t difference = m_words[i] - subtrahend;
+        uint64_t borrowed = m_words[i] < subtrahend;
+        m_words[i] = difference - borrow;
+        borrow = borrowed | ( difference < borrow );
+        }
+    resize( m_length );     // Wraps a borrow out of the top bit
+    return *this;
+}
 
-         case 'C':
-         case 'c':
-            m_value += "1100";
-            break;
 
-         case 'D':
-         case 'd':
-            m_value += "1101";
-            break;
+Nbinary Nbinary::operator & ( const Nbinary& other ) const
+{
+    Nbinary result( *this );
+    return result &= other;
+}
 
-         case 'E':
-         case 'e':
-            m_value += "1110";
-            break;
 
-         case 'F':
-         case 'f':
-            m_value += "1111";
-            break;
+Nbinary Nbinary::operator | ( const Nbinary& other ) const
+{
+    Nbinary result( *this );
+    return result |= other;
+}
 
-         case ' ':
-            break;
 
-         default:
-            ERROR( "Input string contains non-hex character '", inHex[0], "' (ignored)" );
-         }
-      in.erase( 0, 1 );
-      }
+Nbinary Nbinary::operator ^ ( const Nbinary& other ) const
+{
+    Nbinary result( *this );
+    return result ^= other;
 }
 
 
-void Nbinary::setByBinary( const string& inBinary )
+Nbinary Nbinary::operator + ( const Nbinary& other ) const
 {
-   string tempValue;
-   for ( size_t i=0; i < inBinary.length(); i++ )
-      {
-      unsigned char c = inBinary[i];
+    Nbinary result( *this );
+    return result += other;
+}
 
-      switch( c )
-         {
-         case '0':
-            tempValue += "0";
-            break;
 
-         case '1':
-            tempValue += "1";
-            break;
+Nbinary Nbinary::operator - ( const Nbinary& other ) const
+{
+    Nbinary result( *this );
+    return result -= other;
+}
 
-         case ' ':
-            break;
 
-         default:
-            ERROR( "Input string contains non-binary character '", c, "'" );
-         }
-      }
-   m_value = tempValue;
+Nbinary Nbinary::operator ~ () const
+{
+    Nbinary result( *this );
+    for ( size_t i = 0; i < result.m_words.size(); i++ )
+        result.m_words[i] = ~result.m_words[i];
+    result.resize( m_length );
+    return result;
 }
 
 
-bool Nbinary::setByInt( const unsigned long long intValue, const size_t lengthInbits, const bool allowTruncate )
+Nbinary& Nbinary::operator <<= ( const size_t bits )
 {
-    unsigned long long intVal = intValue;
-    size_t bitLen = lengthInbits ? lengthInbits : getMinBitLength( intValue );
-    string stringVal;
+    // Whole words then the bits within them, from the top down so each word is read before
+    // it is overwritten.
+    size_t words = bits / WORD_BITS;
+    size_t shift = bits % WORD_BITS;
+    for ( size_t i = m_words.size(); i > 0; i-- )
+        {
+        size_t to = i - 1;
+        uint64_t word = 0;
+        if ( to >= words )
+            {
+            word = m_words[ to - words ] << shift;
+            if ( shift && ( to > words ) )
+                word |= m_words[ to - words - 1 ] >> ( WORD_BITS - shift );
+            }
+        m_words[ to ] = word;
+        }
+    resize( m_length );
+    return *this;
+}
 
-    stringVal.resize( bitLen, '0' );
 
-    for ( int i = bitLen - 1; i >= 0; i-- )
+Nbinary& Nbinary::operator >>= ( const size_t bits )
+{
+    size_t words = bits / WORD_BITS;
+    size_t shift = bits % WORD_BITS;
+    for ( size_t to = 0; to < m_words.size(); to++ )
         {
-        ( intVal & 1 ) ? stringVal[ i ] = '1' : stringVal[ i ] = '0';
-        intVal = intVal >> 1;
+        size_t from = to + words;
+        uint64_t word = 0;
+        if ( from < m_words.size() )
+            {
+            word = m_words[ from ] >> shift;
+            if ( shift && ( from + 1 < m_words.size() ) )
+                word |= m_words[ from + 1 ] << ( WORD_BITS - shift );
+            }
+        m_words[ to ] = word;
         }
+    return *this;
+}
+
 
-    bool valueRetained = ( intVal == 0 );
+Nbinary Nbinary::operator << ( const size_t bits ) const
+{
+    Nbinary result( *this );
+    return result <<= bits;
+}
+
+
+Nbinary Nbinary::operator >> ( const size_t bits ) const
+{
+    Nbinary result( *this );
+    return result >>= bits;
+}
+
+
+void Nbinary::setByString( const string& value )
+{
+    if ( ( value.substr( 0, 2 ) == "0x" ) || ( value.substr( 0, 2 ) == "0X" ) )
+        setByHex( value.substr( 2, value.length() - 2 ) );
+    else if ( ( value.substr( 0, 2 ) == "0b" ) || ( value.substr( 0, 2 ) == "0B" ) )
+        setByBinary( value.substr( 2, value.length() - 2 ) );
+    else
+        setByInt( stoull( value, NULL, 0 ) );
+}
+
+
+void Nbinary::setByHex( const string& inHex )
+{
+    setByDigits( inHex, 4 );
+}
+
+
+void Nbinary::setByBinary( const string& inBinary )
+{
+    setByDigits( inBinary, 1 );
+}
+
+
+bool Nbinary::setByInt( const unsigned long long intValue, const size_t lengthInbits, const bool allowTruncate )
+{
+    size_t bitLen = lengthInbits ? lengthInbits : getMinBitLength( intValue );
+    bool valueRetained = ( bitLen >= WORD_BITS ) || !( intValue >> bitLen );
 
     if ( !valueRetained && !allowTruncate )
         ERROR( "Given value cannot be stored in requested number of bits" );
-    else
-        m_value = stringVal;
+
+    m_words.clear();
+    m_length = 0;
+    resize( bitLen );
+    if ( bitLen )
+        m_words[0] = ( bitLen >= WORD_BITS ) ? intValue : intValue & ( ( 1ULL << bitLen ) - 1 );
 
     return valueRetained;
 }
@@ -304,9 +499,62 @@ bool Nbinary::setByInt( const unsigned long long intValue, const size_t lengthIn
 
 size_t Nbinary::getMinBitLength( const unsigned long long value )
 {
-    size_t bitLen = 0;
-    if ( value != 0 )
-        bitLen = log2( value ) + 1;
-    return bitLen;
+    return value ? WORD_BITS - __builtin_clzll( value ) : 0;
 }
 
+
+void Nbinary::resize( const size_t lengthInbits )
+{
+    m_words.resize( ( lengthInbits + WORD_BITS - 1 ) / WORD_BITS, 0 );
+    m_length = lengthInbits;
+    if ( lengthInbits % WORD_BITS )
+        m_words.back() &= ~0ULL >> ( WORD_BITS - ( lengthInbits % WORD_BITS ) );
+}
+
+
+void Nbinary::growTo( const size_t lengthInbits )
+{
+    if ( lengthInbits > m_length )
+        resize( lengthInbits );
+}
+
+
+void Nbinary::checkField( const size_t position, const size_t width ) const
+{
+    if ( ( position > m_length ) || ( width > m_length - position ) )
+        ERROR( "Nbinary: Bits ", position, " to ", position + width, " are out of range for a ", m_length, " bit value" );
+}
+
+
+void Nbinary::setByDigits( const string& digits, const unsigned int bitsPerDigit )
+{
+    // Hex or binary digits, most significant first. Spaces are ignored.
+    vector< unsigned char > values;
+    values.reserve( digits.size() );
+    for ( size_t i = 0; i < digits.size(); i++ )
+        {
+        char c = digits[i];
+        unsigned int value;
+        if ( c == ' ' )
+            continue;
+        else if ( ( c >= '0' ) && ( c <= '9' ) )
+            value = c - '0';
+        else if ( ( c >= 'a' ) && ( c <= 'f' ) )
+            value = c - 'a' + 10;
+        else if ( ( c >= 'A' ) && ( c <= 'F' ) )
+            value = c - 'A' + 10;
+        else
+            value = 16;
+
+        if ( value >= ( 1U << bitsPerDigit ) )
+            ERROR( "Input string contains non-", ( bitsPerDigit == 4 ) ? "hex" : "binary", " character '", c, "'" );
+        values.push_back( value );
+        }
+
+    m_words.clear();
+    m_length = 0;
+    resize( values.size() * bitsPerDigit );
+    size_t position = 0;
+    for ( size_t i = values.size(); i > 0; i--, position += bitsPerDigit )
+        m_words[ position / WORD_BITS ] |= (uint64_t)values[ i - 1 ] << ( position % WORD_BITS );
+}
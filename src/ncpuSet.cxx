@@ -0,0 +1,335 @@
+// ncpuSet.cxx by Neil Cooper. See ncpuSet.h for documentation
+#include "ncpuSet.h"
+
+#include <errno.h>
+#include <stdlib.h>     // for strtoul()
+#include <unistd.h>     // for sysconf()
+
+#include <sstream>
+
+#include "nerror.h"
+
+using namespace std;
+
+namespace NCPUSET
+{
+// Far more than any system has, but small enough that a bad list can't take much memory.
+static const unsigned long MAX_CPU = ( 1 << 20 ) - 1;
+
+static unsigned long getCpuNumber( const char*& theNext, const string& theList )
+{
+    // strtoul() would take a sign or leading spaces, so insist on a digit first.
+    if ( ( *theNext < '0' ) || ( *theNext > '9' ) )
+        ERROR( "NcpuSet: Invalid CPU list: ", theList );
+
+    char* end;
+    errno = 0;
+    unsigned long cpu = strtoul( theNext, &end, 10 );
+    if ( ( errno == ERANGE ) || ( cpu > MAX_CPU ) )
+        ERROR( "NcpuSet: CPU number above ", MAX_CPU, " in list: ", theList );
+    theNext = end;
+    return cpu;
+}
+}
+
+using namespace NCPUSET;
+
+
+NcpuSet::NcpuSet() : m_words( 1, 0 )
+{
+}
+
+
+NcpuSet::NcpuSet( const unsigned long long theMask ) : m_words( 1, 0 )
+{
+    for ( unsigned int cpu = 0; cpu < 64; cpu++ )
+        if ( theMask & ( 1ULL << cpu ) )
+            set( cpu );
+}
+
+
+NcpuSet::NcpuSet( const string& theCpus ) : m_words( 1, 0 )
+{
+    if ( ( theCpus.compare( 0, 2, "0x" ) == 0 ) || ( theCpus.compare( 0, 2, "0X" ) == 0 ) )
+        setByBitmask( theCpus.substr( 2 ), 4 );
+    else if ( ( theCpus.compare( 0, 2, "0b" ) == 0 ) || ( theCpus.compare( 0, 2, "0B" ) == 0 ) )
+        setByBitmask( theCpus.substr( 2 ), 1 );
+    else
+        setByList( theCpus );
+}
+
+
+NcpuSet::NcpuSet( const char* theCpus ) : NcpuSet( string( theCpus ? theCpus : "" ) )
+{
+}
+
+
+NcpuSet NcpuSet::all()
+{
+    NcpuSet cpus;
+    unsigned int count = getCpuCount();
+    for ( unsigned int cpu = 0; cpu < count; cpu++ )
+        cpus.set( cpu );
+    return cpus;
+}
+
+
+NcpuSet NcpuSet::current()
+{
+    NcpuSet cpus;
+
+    // The kernel rejects a set smaller than its own, which may be bigger than the configured CPUs.
+    unsigned int size = getCpuCount();
+    while ( sched_getaffinity( 0, CPU_ALLOC_SIZE( size ), cpus.prepareNative( size ) ) )
+        {
+        if ( ( errno != EINVAL ) || ( size > 1024 * 1024 ) )
+            EERROR( "NcpuSet::current: sched_getaffinity() failed" );
+        size *= 2;
+        }
+    return cpus;
+}
+
+
+unsigned int NcpuSet::getCpuCount()
+{
+    long count = sysconf( _SC_NPROCESSORS_CONF );
+    return ( count > 0 ) ? count : 1;
+}
+
+
+void NcpuSet::set( const unsigned int theCpu )
+{
+    size_t word = theCpu / BITS_PER_WORD;
+    if ( word >= m_words.size() )
+        m_words.resize( word + 1, 0 );
+    m_words[ word ] |= 1UL << ( theCpu % BITS_PER_WORD );
+}
+
+
+void NcpuSet::clear( const unsigned int theCpu )
+{
+    size_t word = theCpu / BITS_PER_WORD;
+    if ( word < m_words.size() )
+        m_words[ word ] &= ~( 1UL << ( theCpu % BITS_PER_WORD ) );
+}
+
+
+void NcpuSet::clearAll()
+{
+    m_words.assign( 1, 0 );
+}
+
+
+bool NcpuSet::isSet( const unsigned int theCpu ) const
+{
+    size_t word = theCpu / BITS_PER_WORD;
+    return ( word < m_words.size() ) && ( m_words[ word ] & ( 1UL << ( theCpu % BITS_PER_WORD ) ) );
+}
+
+
+unsigned int NcpuSet::count() const
+{
+    unsigned int total = 0;
+    for ( size_t i = 0; i < m_words.size(); i++ )
+        total += __builtin_popcountl( m_words[i] );
+    return total;
+}
+
+
+bool NcpuSet::isEmpty() const
+{
+    for ( size_t i = 0; i < m_words.size(); i++ )
+        if ( m_words[i] )
+            return false;
+    return true;
+}
+
+
+int NcpuSet::first() const
+{
+    for ( size_t i = 0; i < m_words.size(); i++ )
+        if ( m_words[i] )
+            return ( i * BITS_PER_WORD ) + __builtin_ctzl( m_words[i] );
+    return -1;
+}
+
+
+int NcpuSet::next( const unsigned int theCpu ) const
+{
+    unsigned int cpu = theCpu + 1;
+    size_t i = cpu / BITS_PER_WORD;
+    if ( i >= m_words.size() )
+        return -1;
+
+    // Mask off the CPUs up to theCpu in its word, then carry on a word at a time.
+    unsigned long bits = m_words[i] & ( ~0UL << ( cpu % BITS_PER_WORD ) );
+    while ( !bits )
+        {
+        if ( ++i >= m_words.size() )
+            return -1;
+        bits = m_words[i];
+        }
+    return ( i * BITS_PER_WORD ) + __builtin_ctzl( bits );
+}
+
+
+NcpuSet& NcpuSet::operator |= ( const NcpuSet& theOther )
+{
+    if ( theOther.m_words.size() > m_words.size() )
+        m_words.resize( theOther.m_words.size(), 0 );
+    for ( size_t i = 0; i < theOther.m_words.size(); i++ )
+        m_words[i] |= theOther.m_words[i];
+    return *this;
+}
+
+
+NcpuSet& NcpuSet::operator &= ( const NcpuSet& theOther )
+{
+    for ( size_t i = 0; i < m_words.size(); i++ )
+        m_words[i] &= ( i < theOther.m_words.size() ) ? theOther.m_words[i] : 0;
+    return *this;
+}
+
+
+NcpuSet& NcpuSet::operator -= ( const NcpuSet& theOther )
+{
+    for ( size_t i = 0; ( i < m_words.size() ) && ( i < theOther.m_words.size() ); i++ )
+        m_words[i] &= ~theOther.m_words[i];
+    return *this;
+}
+
+
+NcpuSet NcpuSet::operator | ( const NcpuSet& theOther ) const
+{
+    NcpuSet result( *this );
+    return result |= theOther;
+}
+
+
+NcpuSet NcpuSet::operator & ( const NcpuSet& theOther ) const
+{
+    NcpuSet result( *this );
+    return result &= theOther;
+}
+
+
+NcpuSet NcpuSet::operator - ( const NcpuSet& theOther ) const
+{
+    NcpuSet result( *this );
+    return result -= theOther;
+}
+
+
+bool NcpuSet::operator == ( const NcpuSet& theOther ) const
+{
+    // Sets of different sizes are equal if the extra words are empty.
+    size_t common = ( m_words.size() < theOther.m_words.size() ) ? m_words.size() : theOther.m_words.size();
+    for ( size_t i = 0; i < common; i++ )
+        if ( m_words[i] != theOther.m_words[i] )
+            return false;
+    for ( size_t i = common; i < m_words.size(); i++ )
+        if ( m_words[i] )
+            return false;
+    for ( size_t i = common; i < theOther.m_words.size(); i++ )
+        if ( theOther.m_words[i] )
+            return false;
+    return true;
+}
+
+
+string NcpuSet::getAsString() const
+{
+    ostringstream list;
+
+    int cpu = first();
+    while ( cpu != -1 )
+        {
+        int last = cpu;
+        int following = next( cpu );
+        while ( following == last + 1 )
+            {
+            last = following;
+            following = next( following );
+            }
+
+        if ( list.tellp() > 0 )
+            list << ',';
+        list << cpu;
+        if ( last != cpu )
+            list << '-' << last;
+        cpu = following;
+        }
+    return list.str();
+}
+
+
+unsigned long long NcpuSet::getAsInt() const
+{
+    unsigned long long mask = 0;
+    for ( unsigned int cpu = 0; cpu < 64; cpu++ )
+        if ( isSet( cpu ) )
+            mask |= 1ULL << cpu;
+    return mask;
+}
+
+
+cpu_set_t* NcpuSet::prepareNative( const unsigned int theCpus )
+{
+    m_words.assign( CPU_ALLOC_SIZE( theCpus ? theCpus : 1 ) / sizeof( unsigned long ), 0 );
+    return reinterpret_cast< cpu_set_t* >( &m_words[0] );
+}
+
+
+void NcpuSet::setByBitmask( const string& theDigits, const unsigned int theBitsPerDigit )
+{
+    // The last digit holds the lowest CPUs.
+    unsigned int cpu = 0;
+    for ( size_t i = theDigits.size(); i > 0; i-- )
+        {
+        char digit = theDigits[ i - 1 ];
+        unsigned int value;
+        if ( ( digit >= '0' ) && ( digit <= '9' ) )
+            value = digit - '0';
+        else if ( ( digit >= 'a' ) && ( digit <= 'f' ) )
+            value = digit - 'a' + 10;
+        else if ( ( digit >= 'A' ) && ( digit <= 'F' ) )
+            value = digit - 'A' + 10;
+        else
+            value = 1 << theBitsPerDigit;   // Invalid
+
+        if ( value >= ( 1U << theBitsPerDigit ) )
+            ERROR( "NcpuSet: Invalid character '", digit, "' in CPU mask: ", theDigits );
+
+        for ( unsigned int bit = 0; bit < theBitsPerDigit; bit++, cpu++ )
+            if ( value & ( 1 << bit ) )
+                set( cpu );
+        }
+}
+
+
+void NcpuSet::setByList( const string& theList )
+{
+    // Comma separated CPUs and ranges of CPUs, e.g. "0-3,8,10-11"
+    const char* next = theList.c_str();
+    while ( *next )
+        {
+        unsigned long from = getCpuNumber( next, theList );
+        unsigned long to = from;
+
+        if ( *next == '-' )
+            {
+            next++;
+            to = getCpuNumber( next, theList );
+            if ( to < from )
+                ERROR( "NcpuSet: Invalid CPU range in list: ", theList );
+            }
+
+        for ( unsigned long cpu = from; cpu <= to; cpu++ )
+            set( cpu );
+
+        if ( *next == ',' )
+            next++;
+        else if ( *next )
+            ERROR( "NcpuSet: Invalid CPU list: ", theList );
+        }
+}
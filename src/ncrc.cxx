@@ -1,69 +1,835 @@
 // ncrc.cxx by Neil Cooper. See ncrc.h for documentation
 #include "ncrc.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>  // for FILE
+#include <stdlib.h> // for posix_memalign()
+#include <string.h> // for strcmp(), memcpy()
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>     // for pread()
 
-static void makeCrcTable( unsigned long* theTable );
+#include <atomic>
+#include <memory>     // for unique_ptr
 
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#define NCRC_X86
+#elif defined( __aarch64__ ) && defined( __linux__ )
+#include <arm_acle.h>
+#include <sys/auxv.h>   // for getauxval()
+#include <asm/hwcap.h>
+#define NCRC_ARM
+#endif
 
-unsigned long computeMemoryCrc32(   const unsigned char* theBuffer,
-                                    const size_t         theBufferLength,
-                                    const unsigned long  thePreviousCrc32 )
+#include "nevent.h"
+#include "nparallel.h"
+#include "nthread.h"
+
+using namespace std;
+
+namespace NCRC
+{
+template< typename REGISTER >
+struct IMPLEMENTATION
+    {
+    const char* name;
+    REGISTER    ( *kernel )( REGISTER theCrc, const unsigned char* theBuffer, size_t theLength );
+    bool        ( *supported )();
+    };
+// Kernels work on the CRC register, i.e. without the inversion before and after.
+
+const uint32_t CRC32_POLY = 0xEDB88320;             // These are all reflected
+const uint32_t CRC32C_POLY = 0x82F63B78;
+const uint64_t CRC64_POLY = 0xC96C5795D7870F42ULL;  // ECMA-182
+
+typedef struct
+    {
+    uint32_t    slice[ 16 ][ 256 ];
+    } CRC_TABLES;
+// slice[0] is the classic table for a byte at a time. slice[k][n] is the CRC register after
+// byte n followed by k zero bytes, so slicing-by-16 can look up 16 bytes independently.
+
+typedef struct
+    {
+    uint64_t    slice[ 8 ][ 256 ];
+    } CRC64_TABLES;
+
+
+// Generate a table for a byte-wise 32-bit CRC calculation on the polynomial:
+// x^32+x^26+x^23+x^22+x^16+x^12+x^11+x^10+x^8+x^7+x^5+x^4+x^2+x+1.
+//
+// Polynomials over GF(2) are represented in binary, one bit per coefficient,
+// with the lowest powers in the most significant bit.  Then adding polynomials
+// is just exclusive-or, and multiplying a polynomial by x is a right shift by
+// one.  If we call the above polynomial p, and represent a byte as the
+// polynomial q, also with the lowest power in the most significant bit (so the
+// byte 0xb1 is the polynomial x^7+x^3+x+1), then the CRC is (q*x^32) mod p,
+// where a mod b means the remainder after dividing a by b.
+//
+// This calculation is done using the shift-register method of multiplying and
+// taking the remainder.  The register is initialized to zero, and for each
+// incoming bit, x^32 is added mod p to the register if the bit is a one (where
+// x^32 mod p is p+x^32 = x^26+...+1), and the register is multiplied mod p by
+// x (which is shifting right by one and adding x^32 mod p if the bit shifted
+// out is a one).  We start with the highest power (least significant bit) of
+// q and repeat for all eight bits of q.
+//
+// The table is simply the CRC of all possible eight bit values.  This is all
+// the information needed to generate CRC's on data a byte at a time for all
+// combinations of CRC register values and incoming bytes.
+
+const CRC_TABLES* makeCrcTables( const uint32_t thePoly )
+{
+    CRC_TABLES* tables = new CRC_TABLES;
+    unsigned int n, k;
+
+    for ( n = 0; n < 256; n++ )
+        {
+        uint32_t c = n;
+        for ( k = 0; k < 8; k++ )
+            c =  ( c & 1 ) ? ( thePoly ^ ( c >> 1 ) ) : ( c >> 1 );
+        tables->slice[0][n] = c;
+        }
+
+    for ( n = 0; n < 256; n++ )
+        for ( k = 1; k < 16; k++ )
+            tables->slice[k][n] = ( tables->slice[k-1][n] >> 8 ) ^ tables->slice[0][ tables->slice[k-1][n] & 0xFF ];
+
+    return tables;
+}
+
+
+const CRC64_TABLES* makeCrc64Tables( const uint64_t thePoly )
+{
+    CRC64_TABLES* tables = new CRC64_TABLES;
+    unsigned int n, k;
+
+    for ( n = 0; n < 256; n++ )
+        {
+        uint64_t c = n;
+        for ( k = 0; k < 8; k++ )
+            c =  ( c & 1 ) ? ( thePoly ^ ( c >> 1 ) ) : ( c >> 1 );
+        tables->slice[0][n] = c;
+        }
+
+    for ( n = 0; n < 256; n++ )
+        for ( k = 1; k < 8; k++ )
+            tables->slice[k][n] = ( tables->slice[k-1][n] >> 8 ) ^ tables->slice[0][ tables->slice[k-1][n] & 0xFF ];
+
+    return tables;
+}
+
+
+// Built on first use. Initialisation of a function's static is thread safe.
+const CRC_TABLES& crc32Tables()
+{
+    static const CRC_TABLES* tables = makeCrcTables( CRC32_POLY );
+    return *tables;
+}
+
+
+const CRC_TABLES& crc32cTables()
+{
+    static const CRC_TABLES* tables = makeCrcTables( CRC32C_POLY );
+    return *tables;
+}
+
+
+const CRC64_TABLES& crc64Tables()
+{
+    static const CRC64_TABLES* tables = makeCrc64Tables( CRC64_POLY );
+    return *tables;
+}
+
+
+inline uint32_t load32( const unsigned char* theBytes )
+{
+    // Little endian whatever the host, which is the order a reflected CRC consumes bytes in.
+    // Compiles to a single load on little endian hosts.
+    return theBytes[0] | ( theBytes[1] << 8 ) | ( theBytes[2] << 16 ) | ( (uint32_t)theBytes[3] << 24 );
+}
+
+
+inline uint64_t load64( const unsigned char* theBytes )
+{
+    return load32( theBytes ) | ( (uint64_t)load32( theBytes + 4 ) << 32 );
+}
+
+
+uint32_t crcSlicing( const CRC_TABLES& t, uint32_t theCrc, const unsigned char* theBuffer, size_t theLength )
+{
+    while ( theLength >= 16 )
+        {
+        uint32_t a = theCrc ^ load32( theBuffer );
+        uint32_t b = load32( theBuffer + 4 );
+        uint32_t c = load32( theBuffer + 8 );
+        uint32_t d = load32( theBuffer + 12 );
+        theCrc = t.slice[15][ a & 0xFF ] ^ t.slice[14][ ( a >> 8 ) & 0xFF ] ^ t.slice[13][ ( a >> 16 ) & 0xFF ] ^ t.slice[12][ a >> 24 ] ^
+                 t.slice[11][ b & 0xFF ] ^ t.slice[10][ ( b >> 8 ) & 0xFF ] ^ t.slice[9][ ( b >> 16 ) & 0xFF ]  ^ t.slice[8][ b >> 24 ] ^
+                 t.slice[7][ c & 0xFF ]  ^ t.slice[6][ ( c >> 8 ) & 0xFF ]  ^ t.slice[5][ ( c >> 16 ) & 0xFF ]  ^ t.slice[4][ c >> 24 ] ^
+                 t.slice[3][ d & 0xFF ]  ^ t.slice[2][ ( d >> 8 ) & 0xFF ]  ^ t.slice[1][ ( d >> 16 ) & 0xFF ]  ^ t.slice[0][ d >> 24 ];
+        theBuffer += 16;
+        theLength -= 16;
+        }
+
+    if ( theLength >= 8 )
+        {
+        uint32_t a = theCrc ^ load32( theBuffer );
+        uint32_t b = load32( theBuffer + 4 );
+        theCrc = t.slice[7][ a & 0xFF ] ^ t.slice[6][ ( a >> 8 ) & 0xFF ] ^ t.slice[5][ ( a >> 16 ) & 0xFF ] ^ t.slice[4][ a >> 24 ] ^
+                 t.slice[3][ b & 0xFF ] ^ t.slice[2][ ( b >> 8 ) & 0xFF ] ^ t.slice[1][ ( b >> 16 ) & 0xFF ] ^ t.slice[0][ b >> 24 ];
+        theBuffer += 8;
+        theLength -= 8;
+        }
+
+    while ( theLength-- )
+        theCrc = ( theCrc >> 8 ) ^ t.slice[0][ ( theCrc ^ *theBuffer++ ) & 0xFF ];
+
+    return theCrc;
+}
+
+
+uint32_t crc32Slicing( uint32_t theCrc, const unsigned char* theBuffer, size_t theLength )
+{
+    return crcSlicing( crc32Tables(), theCrc, theBuffer, theLength );
+}
+
+
+uint32_t crc32cSlicing( uint32_t theCrc, const unsigned char* theBuffer, size_t theLength )
+{
+    return crcSlicing( crc32cTables(), theCrc, theBuffer, theLength );
+}
+
+
+uint64_t crc64Slicing( uint64_t theCrc, const unsigned char* theBuffer, size_t theLength )
+{
+    const CRC64_TABLES& t = crc64Tables();
+
+    for ( ; theLength >= 8; theBuffer += 8, theLength -= 8 )
+        {
+        uint64_t a = theCrc ^ load64( theBuffer );
+        theCrc = t.slice[7][ a & 0xFF ]         ^ t.slice[6][ ( a >> 8 ) & 0xFF ]  ^ t.slice[5][ ( a >> 16 ) & 0xFF ] ^ t.slice[4][ ( a >> 24 ) & 0xFF ] ^
+                 t.slice[3][ ( a >> 32 ) & 0xFF ] ^ t.slice[2][ ( a >> 40 ) & 0xFF ] ^ t.slice[1][ ( a >> 48 ) & 0xFF ] ^ t.slice[0][ a >> 56 ];
+        }
+
+    while ( theLength-- )
+        theCrc = ( theCrc >> 8 ) ^ t.slice[0][ ( theCrc ^ *theBuffer++ ) & 0xFF ];
+
+    return theCrc;
+}
+
+
+bool always()
+{
+    return true;
+}
+
+
+// Carry-less multiplication lets the CRC fold the data 16 bytes at a time, as in "Fast CRC
+// Computation for Generic Polynomials Using PCLMULQDQ Instruction" ( Gopal et al, Intel 2009 ).
+// Folding a block forward over n bits multiplies it by x^n mod P, so each constant is a pair of
+// those for its fold distance. They are worked out from the polynomial rather than written in.
+typedef struct
+    {
+    uint64_t    fold2048[2];    // Four 512 bit registers, 256 bytes at a time
+    uint64_t    fold512[2];     // Four 128 bit registers, or one 512 bit register, 64 bytes at a time
+    uint64_t    fold384[2];     // These two and fold128 fold the lanes of a 512 bit register together
+    uint64_t    fold256[2];
+    uint64_t    fold128[2];     // One 128 bit register, 16 bytes at a time
+    uint64_t    fold64[2];      // 128 bits down to 64
+    uint64_t    barrett[2];     // P and floor( x^64 / P ) ( or x^128 for CRC-64 ), to reduce to the CRC
+    } CLMUL_CONSTANTS;
+
+uint64_t multiplyModP( const uint64_t theA, const uint64_t theB, const uint64_t thePoly, const unsigned int theWidth )
+{
+    // Horner's rule on theB, highest power first: multiply by x, then add theA if the bit is set.
+    const uint64_t mask = ~0ULL >> ( 64 - theWidth );
+    uint64_t product = 0;
+    for ( int bit = theWidth - 1; bit >= 0; bit-- )
+        {
+        bool carry = ( product >> ( theWidth - 1 ) ) & 1;
+        product = ( ( product << 1 ) & mask ) ^ ( carry ? thePoly : 0 );
+        if ( ( theB >> bit ) & 1 )
+            product ^= theA;
+        }
+    return product;
+}
+
+
+uint64_t xPowerModP( const uint64_t thePower, const uint64_t thePoly, const unsigned int theWidth )
+{
+    // By squaring, so combining CRCs costs the same for a gigabyte as for a byte.
+    // x itself is x mod P, except for a 1 bit CRC where P is x + 1.
+    uint64_t result = 1;
+    uint64_t square = ( theWidth > 1 ) ? 2 : ( thePoly & 1 );
+    for ( uint64_t power = thePower; power; power >>= 1 )
+        {
+        if ( power & 1 )
+            result = multiplyModP( result, square, thePoly, theWidth );
+        square = multiplyModP( square, square, thePoly, theWidth );
+        }
+    return result;
+}
+
+
+uint64_t xPowerDivP( const unsigned int thePower, const uint64_t thePoly, const unsigned int theWidth )
+{
+    // floor( x^thePower / P ) by long division, for a quotient of up to 64 bits.
+    // The theWidth + 1 bits of the dividend being divided are top and remainder.
+    const uint64_t mask = ( theWidth == 64 ) ? ~0ULL : ( 1ULL << theWidth ) - 1;
+    uint64_t quotient = 0;
+    uint64_t remainder = 0;
+    bool top = true;
+    for ( int bit = thePower - theWidth; bit >= 0; bit-- )
+        {
+        if ( top )
+            {
+            quotient |= 1ULL << bit;
+            remainder ^= thePoly;
+            }
+        top = ( remainder >> ( theWidth - 1 ) ) & 1;
+        remainder = ( remainder << 1 ) & mask;
+        }
+    return quotient;
+}
+
+
+CLMUL_CONSTANTS makeClmulConstants32( const uint32_t theReflectedPoly )
+{
+    CLMUL_CONSTANTS k;
+    const uint64_t poly = reflect( theReflectedPoly, 32 );
+
+    // The data is reflected, so a product comes out a bit short. These are 33 bit, shifted to suit.
+    const unsigned int distances[] = { 2048, 512, 384, 256, 128 };
+    uint64_t* pairs[] = { k.fold2048, k.fold512, k.fold384, k.fold256, k.fold128 };
+    for ( unsigned int i = 0; i < sizeof( distances ) / sizeof( distances[0] ); i++ )
+        {
+        pairs[i][0] = reflect( xPowerModP( distances[i] + 32, poly, 32 ), 32 ) << 1;
+        pairs[i][1] = reflect( xPowerModP( distances[i] - 32, poly, 32 ), 32 ) << 1;
+        }
+    k.fold64[0] = reflect( xPowerModP( 64, poly, 32 ), 32 ) << 1;
+    k.fold64[1] = 0;
+
+    k.barrett[0] = reflect( poly | 0x100000000ULL, 33 );
+    k.barrett[1] = reflect( xPowerDivP( 64, poly, 32 ), 33 );
+    return k;
+}
+
+
+CLMUL_CONSTANTS makeClmulConstants64( const uint64_t theReflectedPoly )
+{
+    CLMUL_CONSTANTS k;
+    const uint64_t poly = reflect( theReflectedPoly, 64 );
+
+    // Multiplying by x^( n - 1 ) makes up for the product of reflected values coming out a bit short.
+    const unsigned int distances[] = { 2048, 512, 384, 256, 128 };
+    uint64_t* pairs[] = { k.fold2048, k.fold512, k.fold384, k.fold256, k.fold128 };
+    for ( unsigned int i = 0; i < sizeof( distances ) / sizeof( distances[0] ); i++ )
+        {
+        pairs[i][0] = reflect( xPowerModP( distances[i] + 63, poly, 64 ), 64 );
+        pairs[i][1] = reflect( xPowerModP( distances[i] - 1, poly, 64 ), 64 );
+        }
+    k.fold64[0] = reflect( xPowerModP( 127, poly, 64 ), 64 );
+    k.fold64[1] = 0;
+
+    // Without their x^64 terms, which the reduction allows for
+    k.barrett[0] = reflect( poly, 64 );
+    k.barrett[1] = reflect( xPowerDivP( 128, poly, 64 ), 64 );
+    return k;
+}
+
+
+const CLMUL_CONSTANTS& crc32ClmulConstants()
+{
+    static const CLMUL_CONSTANTS constants = makeClmulConstants32( CRC32_POLY );
+    return constants;
+}
+
+
+const CLMUL_CONSTANTS& crc32cClmulConstants()
+{
+    static const CLMUL_CONSTANTS constants = makeClmulConstants32( CRC32C_POLY );
+    return constants;
+}
+
+
+const CLMUL_CONSTANTS& crc64ClmulConstants()
+{
+    static const CLMUL_CONSTANTS constants = makeClmulConstants64( CRC64_POLY );
+    return constants;
+}
+
+
+#ifdef NCRC_X86
+__attribute__(( target( "pclmul,sse4.2" ) ))
+inline __m128i fold( const __m128i theBlock, const __m128i theConstants, const __m128i theNext )
+{
+    // theBlock moved forward by the distance theConstants are for, added to theNext.
+    __m128i low = _mm_clmulepi64_si128( theBlock, theConstants, 0x00 );
+    __m128i high = _mm_clmulepi64_si128( theBlock, theConstants, 0x11 );
+    return _mm_xor_si128( _mm_xor_si128( low, high ), theNext );
+}
+
+
+__attribute__(( target( "pclmul,sse4.2" ) ))
+inline __m128i loadConstants( const uint64_t* thePair )
+{
+    return _mm_loadu_si128( (const __m128i*)thePair );
+}
+
+
+__attribute__(( target( "pclmul,sse4.2" ) ))
+__m128i clmulFold( const __m128i theCrc, const unsigned char* theBuffer, size_t theLength, const CLMUL_CONSTANTS& k )
+{
+    // Folds theLength bytes, a multiple of 16 and at least 64, down to 128 bits still to be reduced.
+    __m128i x1 = _mm_xor_si128( _mm_loadu_si128( (const __m128i*)theBuffer ), theCrc );
+    __m128i x2 = _mm_loadu_si128( (const __m128i*)( theBuffer + 16 ) );
+    __m128i x3 = _mm_loadu_si128( (const __m128i*)( theBuffer + 32 ) );
+    __m128i x4 = _mm_loadu_si128( (const __m128i*)( theBuffer + 48 ) );
+    theBuffer += 64;
+    theLength -= 64;
+
+    // Four blocks in parallel to keep the multiplier busy
+    __m128i k512 = loadConstants( k.fold512 );
+    for ( ; theLength >= 64; theBuffer += 64, theLength -= 64 )
+        {
+        x1 = fold( x1, k512, _mm_loadu_si128( (const __m128i*)theBuffer ) );
+        x2 = fold( x2, k512, _mm_loadu_si128( (const __m128i*)( theBuffer + 16 ) ) );
+        x3 = fold( x3, k512, _mm_loadu_si128( (const __m128i*)( theBuffer + 32 ) ) );
+        x4 = fold( x4, k512, _mm_loadu_si128( (const __m128i*)( theBuffer + 48 ) ) );
+        }
+
+    __m128i k128 = loadConstants( k.fold128 );
+    x1 = fold( fold( fold( x1, k128, x2 ), k128, x3 ), k128, x4 );
+    for ( ; theLength >= 16; theBuffer += 16, theLength -= 16 )
+        x1 = fold( x1, k128, _mm_loadu_si128( (const __m128i*)theBuffer ) );
+    return x1;
+}
+
+
+__attribute__(( target( "avx512f,vpclmulqdq,pclmul,sse4.2" ) ))
+inline __m512i fold512( const __m512i theBlock, const __m512i theConstants, const __m512i theNext )
+{
+    __m512i low = _mm512_clmulepi64_epi128( theBlock, theConstants, 0x00 );
+    __m512i high = _mm512_clmulepi64_epi128( theBlock, theConstants, 0x11 );
+    return _mm512_ternarylogic_epi64( low, high, theNext, 0x96 );   // low ^ high ^ theNext
+}
+
+
+__attribute__(( target( "avx512f,vpclmulqdq,pclmul,sse4.2" ) ))
+inline __m512i loadConstants512( const uint64_t* thePair )
+{
+    // The same pair in each lane
+    return _mm512_set_epi64( thePair[1], thePair[0], thePair[1], thePair[0], thePair[1], thePair[0], thePair[1], thePair[0] );
+}
+
+
+__attribute__(( target( "avx512f,vpclmulqdq,pclmul,sse4.2" ) ))
+__m128i vclmulFold( const __m128i theCrc, const unsigned char* theBuffer, size_t theLength, const CLMUL_CONSTANTS& k )
+{
+    // As clmulFold(), for at least 256 bytes.
+    __m512i x1 = _mm512_xor_si512( _mm512_loadu_si512( theBuffer ), _mm512_zextsi128_si512( theCrc ) );
+    __m512i x2 = _mm512_loadu_si512( theBuffer + 64 );
+    __m512i x3 = _mm512_loadu_si512( theBuffer + 128 );
+    __m512i x4 = _mm512_loadu_si512( theBuffer + 192 );
+    theBuffer += 256;
+    theLength -= 256;
+
+    __m512i k2048 = loadConstants512( k.fold2048 );
+    for ( ; theLength >= 256; theBuffer += 256, theLength -= 256 )
+        {
+        x1 = fold512( x1, k2048, _mm512_loadu_si512( theBuffer ) );
+        x2 = fold512( x2, k2048, _mm512_loadu_si512( theBuffer + 64 ) );
+        x3 = fold512( x3, k2048, _mm512_loadu_si512( theBuffer + 128 ) );
+        x4 = fold512( x4, k2048, _mm512_loadu_si512( theBuffer + 192 ) );
+        }
+
+    __m512i k512 = loadConstants512( k.fold512 );
+    x1 = fold512( fold512( fold512( x1, k512, x2 ), k512, x3 ), k512, x4 );
+    for ( ; theLength >= 64; theBuffer += 64, theLength -= 64 )
+        x1 = fold512( x1, k512, _mm512_loadu_si512( theBuffer ) );
+
+    // Fold the four lanes into the last
+    __m128i lanes[4];
+    _mm512_storeu_si512( lanes, x1 );
+    __m128i k128 = loadConstants( k.fold128 );
+    __m128i x = fold( lanes[0], loadConstants( k.fold384 ), lanes[3] );
+    x = fold( lanes[1], loadConstants( k.fold256 ), x );
+    x = fold( lanes[2], k128, x );
+    for ( ; theLength >= 16; theBuffer += 16, theLength -= 16 )
+        x = fold( x, k128, _mm_loadu_si128( (const __m128i*)theBuffer ) );
+    return x;
+}
+
+
+__attribute__(( target( "pclmul,sse4.2" ) ))
+uint32_t reduce32( const __m128i theBlock, const CLMUL_CONSTANTS& k )
+{
+    // 128 bits to 64
+    const __m128i mask = _mm_setr_epi32( ~0, 0, ~0, 0 );
+    __m128i x = _mm_xor_si128( _mm_srli_si128( theBlock, 8 ), _mm_clmulepi64_si128( theBlock, loadConstants( k.fold128 ), 0x10 ) );
+    x = _mm_xor_si128( _mm_srli_si128( x, 4 ), _mm_clmulepi64_si128( _mm_and_si128( x, mask ), loadConstants( k.fold64 ), 0x00 ) );
+
+    // Barrett reduction to 32 bits
+    __m128i barrett = loadConstants( k.barrett );
+    __m128i t = _mm_and_si128( _mm_clmulepi64_si128( _mm_and_si128( x, mask ), barrett, 0x10 ), mask );
+    x = _mm_xor_si128( x, _mm_clmulepi64_si128( t, barrett, 0x00 ) );
+    return _mm_extract_epi32( x, 1 );
+}
+
+
+__attribute__(( target( "pclmul,sse4.2" ) ))
+uint64_t reduce64( const __m128i theBlock, const CLMUL_CONSTANTS& k )
+{
+    // The first 64 bits folded onto the rest leaves 128 bits, B, to be reduced modulo P
+    __m128i x = _mm_xor_si128( _mm_srli_si128( theBlock, 8 ), _mm_clmulepi64_si128( theBlock, loadConstants( k.fold64 ), 0x00 ) );
+
+    // Barrett: q = high half of B * floor( x^128 / P ), the CRC is low half of B - q * P.
+    // Both constants leave out their x^64 term, which for mu is added back in as B itself, and
+    // for P only affects the half thrown away. The reflected products come out a bit short,
+    // hence the shifts.
+    __m128i barrett = loadConstants( k.barrett );
+    __m128i t = _mm_clmulepi64_si128( x, barrett, 0x10 );
+    __m128i q = _mm_xor_si128( x, _mm_slli_epi64( t, 1 ) );
+    t = _mm_clmulepi64_si128( q, barrett, 0x00 );
+    t = _mm_or_si128( _mm_srli_epi64( t, 63 ), _mm_slli_epi64( _mm_srli_si128( t, 8 ), 1 ) );
+    x = _mm_xor_si128( _mm_srli_si128( x, 8 ), t );
+
+    uint64_t crc;
+    _mm_storel_epi64( (__m128i*)&crc, x );
+    return crc;
+}
+
+
+// Below this the set up for 512 bit registers costs more than it saves
+const size_t VPCLMUL_MINIMUM = 1024;
+
+// Each polynomial's kernels share these, with its own constants and a kernel for what's left
+// over after the 16 byte blocks.
+template< const CLMUL_CONSTANTS& ( *CONSTANTS )(), uint32_t ( *TAIL )( uint32_t, const unsigned char*, size_t ) >
+uint32_t pclmul32( uint32_t theCrc, const unsigned char* theBuffer, size_t theLength )
+{
+    if ( theLength >= 64 )
+        {
+        size_t folded = theLength & ~(size_t)15;
+        theCrc = reduce32( clmulFold( _mm_cvtsi32_si128( theCrc ), theBuffer, folded, CONSTANTS() ), CONSTANTS() );
+        theBuffer += folded;
+        theLength -= folded;
+        }
+    return TAIL( theCrc, theBuffer, theLength );
+}
+
+
+template< const CLMUL_CONSTANTS& ( *CONSTANTS )(), uint32_t ( *TAIL )( uint32_t, const unsigned char*, size_t ) >
+uint32_t vpclmul32( uint32_t theCrc, const unsigned char* theBuffer, size_t theLength )
+{
+    if ( theLength < VPCLMUL_MINIMUM )
+        return pclmul32< CONSTANTS, TAIL >( theCrc, theBuffer, theLength );
+
+    size_t folded = theLength & ~(size_t)15;
+    theCrc = reduce32( vclmulFold( _mm_cvtsi32_si128( theCrc ), theBuffer, folded, CONSTANTS() ), CONSTANTS() );
+    return TAIL( theCrc, theBuffer + folded, theLength - folded );
+}
+
+
+uint64_t crc64Pclmul( uint64_t theCrc, const unsigned char* theBuffer, size_t theLength )
+{
+    if ( theLength >= 64 )
+        {
+        size_t folded = theLength & ~(size_t)15;
+        theCrc = reduce64( clmulFold( _mm_set_epi64x( 0, theCrc ), theBuffer, folded, crc64ClmulConstants() ), crc64ClmulConstants() );
+        theBuffer += folded;
+        theLength -= folded;
+        }
+    return crc64Slicing( theCrc, theBuffer, theLength );
+}
+
+
+uint64_t crc64Vpclmul( uint64_t theCrc, const unsigned char* theBuffer, size_t theLength )
+{
+    if ( theLength < VPCLMUL_MINIMUM )
+        return crc64Pclmul( theCrc, theBuffer, theLength );
+
+    size_t folded = theLength & ~(size_t)15;
+    theCrc = reduce64( vclmulFold( _mm_set_epi64x( 0, theCrc ), theBuffer, folded, crc64ClmulConstants() ), crc64ClmulConstants() );
+    return crc64Slicing( theCrc, theBuffer + folded, theLength - folded );
+}
+
+
+// The SSE4.2 crc32 instruction computes CRC-32C directly. It takes 3 cycles but can start one
+// every cycle, so large buffers are done as three interleaved stripes whose CRCs are combined
+// by shifting each over the length of the stripes after it.
+const size_t LONG_STRIPE = 8192;
+const size_t SHORT_STRIPE = 256;
+
+typedef struct
+    {
+    uint32_t    longShift[ 4 ][ 256 ];  // CRC register moved over LONG_STRIPE zero bytes, a byte at a time
+    uint32_t    shortShift[ 4 ][ 256 ];
+    } CRC32C_SHIFT_TABLES;
+
+void makeShiftTable( uint32_t theTable[ 4 ][ 256 ], const size_t theZeros )
+{
+    // Moving the register over zeros is linear, so each entry is a sum of single bits moved.
+    const CRC_TABLES& t = crc32cTables();
+    uint32_t bits[ 32 ];
+    for ( unsigned int bit = 0; bit < 32; bit++ )
+        {
+        uint32_t crc = 1U << bit;
+        for ( size_t i = 0; i < theZeros; i++ )
+            crc = ( crc >> 8 ) ^ t.slice[0][ crc & 0xFF ];
+        bits[ bit ] = crc;
+        }
+
+    for ( unsigned int byte = 0; byte < 4; byte++ )
+        for ( unsigned int n = 0; n < 256; n++ )
+            {
+            theTable[ byte ][ n ] = 0;
+            for ( unsigned int bit = 0; bit < 8; bit++ )
+                if ( n & ( 1 << bit ) )
+                    theTable[ byte ][ n ] ^= bits[ ( byte * 8 ) + bit ];
+            }
+}
+
+
+const CRC32C_SHIFT_TABLES* makeShiftTables()
+{
+    CRC32C_SHIFT_TABLES* tables = new CRC32C_SHIFT_TABLES;
+    makeShiftTable( tables->longShift, LONG_STRIPE );
+    makeShiftTable( tables->shortShift, SHORT_STRIPE );
+    return tables;
+}
+
+
+const CRC32C_SHIFT_TABLES& crc32cShiftTables()
+{
+    static const CRC32C_SHIFT_TABLES* tables = makeShiftTables();
+    return *tables;
+}
+
+
+inline uint32_t shift( const uint32_t theTable[ 4 ][ 256 ], const uint32_t theCrc )
+{
+    return theTable[0][ theCrc & 0xFF ] ^ theTable[1][ ( theCrc >> 8 ) & 0xFF ] ^ theTable[2][ ( theCrc >> 16 ) & 0xFF ] ^ theTable[3][ theCrc >> 24 ];
+}
+
+
+__attribute__(( target( "sse4.2" ) ))
+inline uint32_t crc32cWord( const uint32_t theCrc, const unsigned char* theBytes )
+{
+#ifdef __x86_64__
+    uint64_t word;
+    memcpy( &word, theBytes, sizeof( word ) );
+    return _mm_crc32_u64( theCrc, word );
+#else
+    uint32_t words[2];
+    memcpy( words, theBytes, sizeof( words ) );
+    return _mm_crc32_u32( _mm_crc32_u32( theCrc, words[0] ), words[1] );
+#endif
+}
+
+
+__attribute__(( target( "sse4.2" ) ))
+uint32_t crc32cStripes( uint32_t theCrc, const unsigned char* theBuffer, const size_t theStripe, const uint32_t theShift[ 4 ][ 256 ] )
+{
+    uint32_t crc1 = 0;
+    uint32_t crc2 = 0;
+    for ( const unsigned char* end = theBuffer + theStripe; theBuffer < end; theBuffer += 8 )
+        {
+        theCrc = crc32cWord( theCrc, theBuffer );
+        crc1 = crc32cWord( crc1, theBuffer + theStripe );
+        crc2 = crc32cWord( crc2, theBuffer + ( 2 * theStripe ) );
+        }
+    theCrc = shift( theShift, theCrc ) ^ crc1;
+    return shift( theShift, theCrc ) ^ crc2;
+}
+
+
+__attribute__(( target( "sse4.2" ) ))
+uint32_t crc32cInstruction( uint32_t theCrc, const unsigned char* theBuffer, size_t theLength )
+{
+    for ( ; theLength >= 8; theBuffer += 8, theLength -= 8 )
+        theCrc = crc32cWord( theCrc, theBuffer );
+    for ( ; theLength; theLength-- )
+        theCrc = _mm_crc32_u8( theCrc, *theBuffer++ );
+    return theCrc;
+}
+
+
+uint32_t crc32cSse42( uint32_t theCrc, const unsigned char* theBuffer, size_t theLength )
+{
+    if ( theLength >= 3 * SHORT_STRIPE )
+        {
+        const CRC32C_SHIFT_TABLES& shifts = crc32cShiftTables();
+        for ( ; theLength >= 3 * LONG_STRIPE; theBuffer += 3 * LONG_STRIPE, theLength -= 3 * LONG_STRIPE )
+            theCrc = crc32cStripes( theCrc, theBuffer, LONG_STRIPE, shifts.longShift );
+        for ( ; theLength >= 3 * SHORT_STRIPE; theBuffer += 3 * SHORT_STRIPE, theLength -= 3 * SHORT_STRIPE )
+            theCrc = crc32cStripes( theCrc, theBuffer, SHORT_STRIPE, shifts.shortShift );
+        }
+    return crc32cInstruction( theCrc, theBuffer, theLength );
+}
+
+
+bool hasSse42()
 {
-    static unsigned long crcTable[ 256 ];
-    static bool tableBuilt = false;
+    return __builtin_cpu_supports( "sse4.2" );
+}
 
-    unsigned long crc32 = thePreviousCrc32 ^ 0xFFFFFFFF;
-    size_t i;
 
-    if ( !tableBuilt )
-        {
-        makeCrcTable( crcTable );
-        tableBuilt = true;
-        }
+bool hasPclmul()
+{
+    return __builtin_cpu_supports( "pclmul" ) && hasSse42();
+}
+
 
-    for ( i = 0; i < theBufferLength; i++ )
-        crc32 = ( crc32 >> 8 ) ^ crcTable[ ( crc32 ^ theBuffer[i] ) & 0xFF ];
-    return( crc32 ^ 0xFFFFFFFF );
+bool hasVpclmul()
+{
+    return hasPclmul() && __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "vpclmulqdq" );
 }
+#endif
 
 
-bool computeFileCrc32(  FILE* theFile,
-                        unsigned long* theCrc32,
-                        unsigned long  theChunkSize )
+#ifdef NCRC_ARM
+// The CRC32 instructions implement CRC-32 and CRC-32C directly, 8 bytes at a time.
+__attribute__(( target( "arch=armv8-a+crc" ) ))
+uint32_t crc32Armv8( uint32_t theCrc, const unsigned char* theBuffer, size_t theLength )
 {
-    unsigned char* chunk = new unsigned char[ theChunkSize ];
-    bool status = true;
-    size_t readLength = 0;
-    unsigned long runningTotal = 0;
+    for ( ; theLength && ( (uintptr_t)theBuffer & 7 ); theLength-- )
+        theCrc = __crc32b( theCrc, *theBuffer++ );
+    for ( ; theLength >= 8; theBuffer += 8, theLength -= 8 )
+        theCrc = __crc32d( theCrc, *(const uint64_t*)theBuffer );
+    for ( ; theLength; theLength-- )
+        theCrc = __crc32b( theCrc, *theBuffer++ );
+    return theCrc;
+}
 
-    do
+
+__attribute__(( target( "arch=armv8-a+crc" ) ))
+uint32_t crc32cArmv8( uint32_t theCrc, const unsigned char* theBuffer, size_t theLength )
+{
+    for ( ; theLength && ( (uintptr_t)theBuffer & 7 ); theLength-- )
+        theCrc = __crc32cb( theCrc, *theBuffer++ );
+    for ( ; theLength >= 8; theBuffer += 8, theLength -= 8 )
+        theCrc = __crc32cd( theCrc, *(const uint64_t*)theBuffer );
+    for ( ; theLength; theLength-- )
+        theCrc = __crc32cb( theCrc, *theBuffer++ );
+    return theCrc;
+}
+
+
+bool hasArmv8Crc()
+{
+    return getauxval( AT_HWCAP ) & HWCAP_CRC32;
+}
+#endif
+
+
+// Fastest first, ending with one that's always supported. The first one supported is used
+// unless another is chosen with set...Implementation().
+const IMPLEMENTATION< uint32_t > crc32Implementations[] =
+    {
+#ifdef NCRC_X86
+    { "vpclmul",        vpclmul32< crc32ClmulConstants, crc32Slicing >,    hasVpclmul  },
+    { "pclmul",         pclmul32< crc32ClmulConstants, crc32Slicing >,     hasPclmul   },
+#endif
+#ifdef NCRC_ARM
+    { "armv8-crc",      crc32Armv8,                                         hasArmv8Crc },
+#endif
+    { "slicing-by-16",  crc32Slicing,                                       always      }
+    };
+
+const IMPLEMENTATION< uint32_t > crc32cImplementations[] =
+    {
+#ifdef NCRC_X86
+    { "vpclmul",        vpclmul32< crc32cClmulConstants, crc32cInstruction >,  hasVpclmul  },
+    { "pclmul",         pclmul32< crc32cClmulConstants, crc32cInstruction >,   hasPclmul   },
+    { "sse4.2",         crc32cSse42,                                            hasSse42    },
+#endif
+#ifdef NCRC_ARM
+    { "armv8-crc",      crc32cArmv8,                                            hasArmv8Crc },
+#endif
+    { "slicing-by-16",  crc32cSlicing,                                          always      }
+    };
+
+const IMPLEMENTATION< uint64_t > crc64Implementations[] =
+    {
+#ifdef NCRC_X86
+    { "vpclmul",        crc64Vpclmul,   hasVpclmul  },
+    { "pclmul",         crc64Pclmul,    hasPclmul   },
+#endif
+    { "slicing-by-8",   crc64Slicing,   always      }
+    };
+
+atomic< const IMPLEMENTATION< uint32_t >* > crc32Implementation( NULL );
+atomic< const IMPLEMENTATION< uint32_t >* > crc32cImplementation( NULL );
+atomic< const IMPLEMENTATION< uint64_t >* > crc64Implementation( NULL );
+
+
+template< typename REGISTER, size_t COUNT >
+const IMPLEMENTATION< REGISTER >* getImplementation( const IMPLEMENTATION< REGISTER > ( &theImplementations )[ COUNT ],
+                                                     atomic< const IMPLEMENTATION< REGISTER >* >& theChosen )
+{
+    const IMPLEMENTATION< REGISTER >* implementation = theChosen.load( memory_order_acquire );
+    if ( !implementation )
         {
-        readLength = fread( chunk, 1, theChunkSize, theFile );
-        if ( readLength )
-            runningTotal = computeMemoryCrc32( chunk, readLength, runningTotal );
-        else
-            status = ( !ferror( theFile ) );
+        // Threads racing to get here all pick the same one.
+        implementation = &theImplementations[ COUNT - 1 ];
+        for ( size_t i = 0; i < COUNT; i++ )
+            if ( theImplementations[i].supported() )
+                {
+                implementation = &theImplementations[i];
+                break;
+                }
+        theChosen.store( implementation, memory_order_release );
         }
-    while ( status && readLength );
+    return implementation;
+}
 
-    if ( status )
-    *theCrc32 = runningTotal;
 
-    delete[] chunk;
+template< typename REGISTER, size_t COUNT >
+vector< string > getSupported( const IMPLEMENTATION< REGISTER > ( &theImplementations )[ COUNT ] )
+{
+    vector< string > names;
+    for ( size_t i = 0; i < COUNT; i++ )
+        if ( theImplementations[i].supported() )
+            names.push_back( theImplementations[i].name );
+    return names;
+}
 
-    return( status );
+
+template< typename REGISTER, size_t COUNT >
+bool setImplementation( const IMPLEMENTATION< REGISTER > ( &theImplementations )[ COUNT ],
+                        atomic< const IMPLEMENTATION< REGISTER >* >& theChosen,
+                        const char* theName )
+{
+    if ( !theName || !*theName )
+        {
+        theChosen.store( NULL, memory_order_release );
+        return true;
+        }
+
+    for ( size_t i = 0; i < COUNT; i++ )
+        if ( !strcmp( theImplementations[i].name, theName ) && theImplementations[i].supported() )
+            {
+            theChosen.store( &theImplementations[i], memory_order_release );
+            return true;
+            }
+    return false;
 }
 
 
-void computeCrc(  const Nbinary& data,
-                  const Nbinary& poly,
-                  const Nbinary& initial,
-                  Nbinary&       result   )
+void computeWideCrc( const Nbinary& data,
+                     const Nbinary& poly,
+                     const Nbinary& initial,
+                     Nbinary&       result   )
 {
+    // CRCs over 64 bits, a bit at a time in an array of bits.
     const unsigned int nbits = poly.length();
     char* crc = new char[ nbits - 1 ];
-    result.initialise( nbits - 1 );
+    result.initialise( 0, nbits - 1 );
     unsigned int i = 0;
 
     for ( i = 0; i < ( nbits-1 ); i++ )
@@ -91,49 +857,485 @@ void computeCrc(  const Nbinary& data,
 }
 
 
-// Generate a table for a byte-wise 32-bit CRC calculation on the polynomial:
-// x^32+x^26+x^23+x^22+x^16+x^12+x^11+x^10+x^8+x^7+x^5+x^4+x^2+x+1.
-//
-// Polynomials over GF(2) are represented in binary, one bit per coefficient,
-// with the lowest powers in the most significant bit.  Then adding polynomials
-// is just exclusive-or, and multiplying a polynomial by x is a right shift by
-// one.  If we call the above polynomial p, and represent a byte as the
-// polynomial q, also with the lowest power in the most significant bit (so the
-// byte 0xb1 is the polynomial x^7+x^3+x+1), then the CRC is (q*x^32) mod p,
-// where a mod b means the remainder after dividing a by b.
-//
-// This calculation is done using the shift-register method of multiplying and
-// taking the remainder.  The register is initialized to zero, and for each
-// incoming bit, x^32 is added mod p to the register if the bit is a one (where
-// x^32 mod p is p+x^32 = x^26+...+1), and the register is multiplied mod p by
-// x (which is shifting right by one and adding x^32 mod p if the bit shifted
-// out is a one).  We start with the highest power (least significant bit) of
-// q and repeat for all eight bits of q.
-//
-// The table is simply the CRC of all possible eight bit values.  This is all
-// the information needed to generate CRC's on data a byte at a time for all
-// combinations of CRC register values and incoming bytes.
+// The parallel versions hand out pieces of at least this much, and below twice it don't bother.
+const size_t PARALLEL_MINIMUM = 512 * 1024;
+
+template< typename VALUE >
+struct PIECE
+    {
+    VALUE       crc;
+    uint64_t    length;
+    };
 
-static void makeCrcTable( unsigned long* theTable )
+
+template< typename CRC, typename VALUE >
+VALUE computeParallel( NthreadPool&         thePool,
+                       VALUE                ( *theCompute )( const unsigned char*, const size_t, const VALUE ),
+                       const unsigned char* theBuffer,
+                       const size_t         theLength,
+                       const VALUE          thePrevious )
 {
-    // Terms of polynomial defining this crc (except x^32):
-    static const unsigned char p[] = { 0, 1, 2, 4, 5, 7, 8, 10, 11, 12, 16, 22, 23, 26 };
+    if ( theLength < 2 * PARALLEL_MINIMUM )
+        return theCompute( theBuffer, theLength, thePrevious );
 
-    unsigned long poly;  // Polynomial exclusive-or pattern
-    unsigned long c;
-    unsigned int n, k;
+    size_t pieces = Nparallel::getChunkCount( thePool, theLength );
+    size_t pieceSize = ( theLength + pieces - 1 ) / pieces;
+    if ( pieceSize < PARALLEL_MINIMUM )
+        pieceSize = PARALLEL_MINIMUM;
 
-    // Make exclusive-or pattern from polynomial ( 0xedb88320 )
-    poly = 0;
-    for ( n = 0; n < sizeof( p ) / sizeof( unsigned char ); n++ )
-        poly |= ( unsigned long )1 << ( 31 - p[n] );
+    // The CRC of nothing is 0, and combining with it changes nothing.
+    PIECE< VALUE > none = { 0, 0 };
+    PIECE< VALUE > all = Nparallel::parallelReduce( thePool, 0, theLength, none,
+        [&]( const size_t theBegin, const size_t theEnd, PIECE< VALUE > )
+            {
+            PIECE< VALUE > piece = { theCompute( theBuffer + theBegin, theEnd - theBegin, 0 ), theEnd - theBegin };
+            return piece;
+            },
+        []( const PIECE< VALUE >& theA, const PIECE< VALUE >& theB )
+            {
+            PIECE< VALUE > piece = { (VALUE)CRC::combine( theA.crc, theB.crc, theB.length ), theA.length + theB.length };
+            return piece;
+            },
+        pieceSize );
+    return CRC::combine( thePrevious, all.crc, all.length );
+}
 
-    for ( n = 0; n < 256; n++ )
+
+// computeFileCrc32 for a path or fd maps this much of a file at a time, or reads this much at a
+// time into each of two buffers.
+const size_t MAPPED_WINDOW = 64 * 1024 * 1024;
+const size_t READ_BUFFER = 4 * 1024 * 1024;
+const size_t DIRECT_ALIGNMENT = 4096;   // At least the logical block size of any disk
+
+typedef struct
+    {
+    int             fd;
+    bool            direct;
+    unsigned char*  buffer[2];
+    ssize_t         length[2];  // READ_BUFFER unless it's the last. -1 = error.
+    int             error;
+    Nevent          full[2];    // Each buffer passes back and forth between these
+    Nevent          empty[2];
+    } READ_AHEAD;
+
+
+// Returns the offset it got to: theEnd, or where a window couldn't be mapped.
+off_t crcFileMapped( const int theFd, const off_t theStart, const off_t theEnd, unsigned long& theCrc )
+{
+    const off_t page = sysconf( _SC_PAGESIZE );
+    off_t offset = theStart;
+    while ( offset < theEnd )
         {
-        c = n;
-        for ( k = 0; k < 8; k++ )
-            c =  ( c & 1 ) ? ( poly ^ ( c >> 1 ) ) : ( c >> 1 );
-        theTable[ n ] = c;
+        off_t base = offset - ( offset % page );
+        size_t length = ( theEnd - base < (off_t)MAPPED_WINDOW ) ? theEnd - base : MAPPED_WINDOW;
+        unsigned char* window = (unsigned char*)mmap( NULL, length, PROT_READ, MAP_SHARED, theFd, base );
+        if ( window == MAP_FAILED )
+            break;
+
+        // Faulting the pages in all at once, rather than one at a time while they're CRCed,
+        // is a good deal quicker.
+        madvise( window, length, MADV_SEQUENTIAL );
+#ifdef MADV_POPULATE_READ
+        madvise( window, length, MADV_POPULATE_READ );
+#endif
+        theCrc = computeMemoryCrc32( window + ( offset - base ), length - ( offset - base ), theCrc );
+        munmap( window, length );
+        offset = base + length;
+        }
+    return offset;
+}
+
+
+void* readAheadProc( void* theReadAhead )
+{
+    READ_AHEAD& r = *(READ_AHEAD*)theReadAhead;
+    for ( int b = 0; ; b ^= 1 )
+        {
+        r.empty[b].wait();
+
+        ssize_t got = 0;
+        while ( got < (ssize_t)READ_BUFFER )
+            {
+            ssize_t n = read( r.fd, r.buffer[b] + got, READ_BUFFER - got );
+            if ( ( n < 0 ) && ( errno == EINTR ) )
+                continue;
+            if ( n < 0 )
+                {
+                r.error = errno;
+                got = -1;
+                }
+            if ( n <= 0 )
+                break;
+            got += n;
+
+            // An O_DIRECT read short of a whole block is the end of the file, and reading on
+            // from there would be unaligned.
+            if ( r.direct && ( n % DIRECT_ALIGNMENT ) )
+                break;
+            }
+
+        r.length[b] = got;
+        r.full[b].signal();
+        if ( got < (ssize_t)READ_BUFFER )
+            return NULL;
+        }
+}
+
+
+bool crcFileReadAhead( const int theFd, size_t theSkip, const bool theDirect, unsigned long& theCrc )
+{
+    void* memory;
+    if ( posix_memalign( &memory, DIRECT_ALIGNMENT, 2 * READ_BUFFER ) )
+        return false;
+    // Freed after the reader has been joined, or if it can't be started.
+    unique_ptr< void, decltype( &free ) > buffers( memory, free );
+
+    READ_AHEAD r;
+    r.fd = theFd;
+    r.direct = theDirect;
+    r.buffer[0] = (unsigned char*)memory;
+    r.buffer[1] = r.buffer[0] + READ_BUFFER;
+    r.error = 0;
+    r.empty[0].signal();
+    r.empty[1].signal();
+
+    Nthread reader( readAheadProc, &r );
+    ssize_t length = READ_BUFFER;
+    for ( int b = 0; length == (ssize_t)READ_BUFFER; b ^= 1 )
+        {
+        r.full[b].wait();
+        length = r.length[b];
+        if ( length > (ssize_t)theSkip )
+            theCrc = computeMemoryCrc32( r.buffer[b] + theSkip, length - theSkip, theCrc );
+        theSkip = ( length > (ssize_t)theSkip ) ? 0 : theSkip - length;
+        r.empty[b].signal();
+        }
+    reader.getReturnValue();
+
+    if ( length < 0 )
+        errno = r.error;
+    return length >= 0;
+}
+}
+using namespace NCRC;
+
+
+unsigned long computeMemoryCrc32(   const unsigned char* theBuffer,
+                                    const size_t         theBufferLength,
+                                    const unsigned long  thePreviousCrc32 )
+{
+    uint32_t crc32 = (uint32_t)thePreviousCrc32 ^ 0xFFFFFFFF;
+    return getImplementation( crc32Implementations, crc32Implementation )->kernel( crc32, theBuffer, theBufferLength ) ^ 0xFFFFFFFF;
+}
+
+
+unsigned long computeMemoryCrc32c(  const unsigned char* theBuffer,
+                                    const size_t         theBufferLength,
+                                    const unsigned long  thePreviousCrc32c )
+{
+    uint32_t crc32c = (uint32_t)thePreviousCrc32c ^ 0xFFFFFFFF;
+    return getImplementation( crc32cImplementations, crc32cImplementation )->kernel( crc32c, theBuffer, theBufferLength ) ^ 0xFFFFFFFF;
+}
+
+
+unsigned long long computeMemoryCrc64(  const unsigned char*     theBuffer,
+                                        const size_t             theBufferLength,
+                                        const unsigned long long thePreviousCrc64 )
+{
+    uint64_t crc64 = ~(uint64_t)thePreviousCrc64;
+    return ~getImplementation( crc64Implementations, crc64Implementation )->kernel( crc64, theBuffer, theBufferLength );
+}
+
+
+unsigned long combineCrc32( const unsigned long theCrc32A, const unsigned long theCrc32B, const unsigned long long theLengthB )
+{
+    return Ncrc32IsoHdlc::combine( theCrc32A, theCrc32B, theLengthB );
+}
+
+
+unsigned long combineCrc32c( const unsigned long theCrc32cA, const unsigned long theCrc32cB, const unsigned long long theLengthB )
+{
+    return Ncrc32Iscsi::combine( theCrc32cA, theCrc32cB, theLengthB );
+}
+
+
+unsigned long long combineCrc64( const unsigned long long theCrc64A, const unsigned long long theCrc64B, const unsigned long long theLengthB )
+{
+    return Ncrc64Xz::combine( theCrc64A, theCrc64B, theLengthB );
+}
+
+
+unsigned long computeMemoryCrc32(   const unsigned char* theBuffer,
+                                    const size_t         theBufferLength,
+                                    NthreadPool&         thePool,
+                                    const unsigned long  thePreviousCrc32 )
+{
+    return computeParallel< Ncrc32IsoHdlc, unsigned long >( thePool, computeMemoryCrc32, theBuffer, theBufferLength, thePreviousCrc32 );
+}
+
+
+unsigned long computeMemoryCrc32c(  const unsigned char* theBuffer,
+                                    const size_t         theBufferLength,
+                                    NthreadPool&         thePool,
+                                    const unsigned long  thePreviousCrc32c )
+{
+    return computeParallel< Ncrc32Iscsi, unsigned long >( thePool, computeMemoryCrc32c, theBuffer, theBufferLength, thePreviousCrc32c );
+}
+
+
+unsigned long long computeMemoryCrc64(  const unsigned char*     theBuffer,
+                                        const size_t             theBufferLength,
+                                        NthreadPool&             thePool,
+                                        const unsigned long long thePreviousCrc64 )
+{
+    return computeParallel< Ncrc64Xz, unsigned long long >( thePool, computeMemoryCrc64, theBuffer, theBufferLength, thePreviousCrc64 );
+}
+
+
+const char* getCrc32Implementation()
+{
+    return getImplementation( crc32Implementations, crc32Implementation )->name;
+}
+
+
+vector< string > getCrc32Implementations()
+{
+    return getSupported( crc32Implementations );
+}
+
+
+bool setCrc32Implementation( const char* theName )
+{
+    return setImplementation( crc32Implementations, crc32Implementation, theName );
+}
+
+
+const char* getCrc32cImplementation()
+{
+    return getImplementation( crc32cImplementations, crc32cImplementation )->name;
+}
+
+
+vector< string > getCrc32cImplementations()
+{
+    return getSupported( crc32cImplementations );
+}
+
+
+bool setCrc32cImplementation( const char* theName )
+{
+    return setImplementation( crc32cImplementations, crc32cImplementation, theName );
+}
+
+
+const char* getCrc64Implementation()
+{
+    return getImplementation( crc64Implementations, crc64Implementation )->name;
+}
+
+
+vector< string > getCrc64Implementations()
+{
+    return getSupported( crc64Implementations );
+}
+
+
+bool setCrc64Implementation( const char* theName )
+{
+    return setImplementation( crc64Implementations, crc64Implementation, theName );
+}
+
+
+bool computeFileCrc32(  FILE* theFile,
+                        unsigned long* theCrc32,
+                        unsigned long  theChunkSize )
+{
+    unsigned char* chunk = new unsigned char[ theChunkSize ];
+    bool status = true;
+    size_t readLength = 0;
+    unsigned long runningTotal = 0;
+
+    do
+        {
+        readLength = fread( chunk, 1, theChunkSize, theFile );
+        if ( readLength )
+            runningTotal = computeMemoryCrc32( chunk, readLength, runningTotal );
+        else
+            status = ( !ferror( theFile ) );
+        }
+    while ( status && readLength );
+
+    if ( status )
+    *theCrc32 = runningTotal;
+
+    delete[] chunk;
+
+    return( status );
+}
+
+
+bool computeFileCrc32(  FILE*                theFile,
+                        unsigned long*       theCrc32,
+                        NthreadPool&         thePool,
+                        const unsigned long  theChunkSize )
+{
+    int fd = fileno( theFile );
+    struct stat status;
+    off_t start = ftello( theFile );
+    // Files in /proc and /sys are regular but have no size until they're read.
+    if ( ( fd < 0 ) || fstat( fd, &status ) || !S_ISREG( status.st_mode ) || !status.st_size || ( start < 0 ) || !theChunkSize )
+        return computeFileCrc32( theFile, theCrc32, theChunkSize ? theChunkSize : 8192 );
+
+    // Chunks are shared out between the threads a run of them at a time. Each thread reads its
+    // own with pread(), so the reading is done in parallel too.
+    const uint64_t length = ( status.st_size > start ) ? status.st_size - start : 0;
+    const size_t chunks = ( length + theChunkSize - 1 ) / theChunkSize;
+    atomic< bool > failed( false );
+
+    PIECE< unsigned long > none = { 0, 0 };
+    PIECE< unsigned long > all = Nparallel::parallelReduce( thePool, 0, chunks, none,
+        [&]( const size_t theBegin, const size_t theEnd, PIECE< unsigned long > thePiece )
+            {
+            vector< unsigned char > chunk( theChunkSize );
+            for ( size_t c = theBegin; ( c < theEnd ) && !failed; c++ )
+                {
+                off_t offset = start + ( c * (uint64_t)theChunkSize );
+                size_t wanted = ( ( c + 1 ) * (uint64_t)theChunkSize <= length ) ? theChunkSize : length - ( c * (uint64_t)theChunkSize );
+                size_t got = 0;
+                while ( got < wanted )
+                    {
+                    ssize_t n = pread( fd, &chunk[ got ], wanted - got, offset + got );
+                    if ( n <= 0 )
+                        {
+                        // An error, or the file has been truncated under us
+                        if ( ( n < 0 ) && ( errno == EINTR ) )
+                            continue;
+                        failed = true;
+                        break;
+                        }
+                    got += n;
+                    }
+                thePiece.crc = computeMemoryCrc32( &chunk[0], got, thePiece.crc );
+                thePiece.length += got;
+                }
+            return thePiece;
+            },
+        []( const PIECE< unsigned long >& theA, const PIECE< unsigned long >& theB )
+            {
+            PIECE< unsigned long > piece = { combineCrc32( theA.crc, theB.crc, theB.length ), theA.length + theB.length };
+            return piece;
+            },
+        0 );
+
+    if ( failed || fseeko( theFile, 0, SEEK_END ) )
+        return false;
+
+    *theCrc32 = all.crc;
+    return true;
+}
+
+
+bool computeFileCrc32(  const char*           thePath,
+                        unsigned long*        theCrc32,
+                        const CRC_FILE_ACCESS theAccess )
+{
+    // Not every file system can do O_DIRECT
+    int fd = ( theAccess == CRC_FILE_DIRECT ) ? open( thePath, O_RDONLY | O_DIRECT ) : -1;
+    if ( fd < 0 )
+        fd = open( thePath, O_RDONLY );
+    if ( fd < 0 )
+        return false;
+
+    bool status = computeFileCrc32( fd, theCrc32, theAccess );
+    int error = errno;
+    close( fd );
+    errno = error;
+    return status;
+}
+
+
+bool computeFileCrc32(  const int             theFd,
+                        unsigned long*        theCrc32,
+                        const CRC_FILE_ACCESS theAccess )
+{
+    struct stat status;
+    if ( fstat( theFd, &status ) )
+        return false;
+
+    off_t start = lseek( theFd, 0, SEEK_CUR );
+    bool regular = S_ISREG( status.st_mode ) && ( start >= 0 );
+    unsigned long crc = 0;
+    bool ok;
+
+    // Files in /proc and /sys have no size until they're read, and often can't be mapped or
+    // seeked to the end, so are read instead. So is the rest of any file that stops mapping.
+    if ( regular && ( theAccess == CRC_FILE_MAPPED ) && status.st_size && ( lseek( theFd, 0, SEEK_END ) >= 0 ) )
+        {
+        off_t mappedTo = crcFileMapped( theFd, start, status.st_size, crc );
+        ok = ( mappedTo >= status.st_size ) ||
+             ( ( lseek( theFd, mappedTo, SEEK_SET ) >= 0 ) && crcFileReadAhead( theFd, 0, false, crc ) );
+        }
+    else
+        {
+        // O_DIRECT reads have to start on a block boundary, so start on the one before.
+        int flags = fcntl( theFd, F_GETFL );
+        bool direct = regular && ( theAccess == CRC_FILE_DIRECT ) && ( flags != -1 ) &&
+                      ( ( flags & O_DIRECT ) || !fcntl( theFd, F_SETFL, flags | O_DIRECT ) );
+        size_t skip = direct ? start % DIRECT_ALIGNMENT : 0;
+        ok = ( !skip || ( lseek( theFd, start - skip, SEEK_SET ) >= 0 ) ) && crcFileReadAhead( theFd, skip, direct, crc );
+
+        if ( direct && !( flags & O_DIRECT ) )
+            {
+            int error = errno;
+            fcntl( theFd, F_SETFL, flags );
+            errno = error;
+            }
         }
+
+    if ( ok )
+        *theCrc32 = crc;
+    return ok;
 }
 
+
+void computeCrc(  const Nbinary& data,
+                  const Nbinary& poly,
+                  const Nbinary& initial,
+                  Nbinary&       result   )
+{
+    const unsigned int nbits = poly.length();
+    if ( ( nbits < 2 ) || ( nbits - 1 > 64 ) )
+        {
+        computeWideCrc( data, poly, initial, result );
+        return;
+        }
+
+    // Bit i of the register and the polynomial is x^i. As below, x^0 is always taken to be set.
+    const unsigned int width = nbits - 1;
+    const uint64_t top = 1ULL << ( width - 1 );
+    const uint64_t mask = ~0ULL >> ( 64 - width );
+    uint64_t polyBits = 1;
+    uint64_t crc = 0;
+    unsigned int i;
+
+    for ( i = 1; i < width; i++ )
+        if ( poly[ ( nbits - i ) - 1 ] == '1' )
+            polyBits |= 1ULL << i;
+
+    for ( i = 0; i < width; i++ )
+        if ( initial[ ( nbits - 2 ) - i ] == '1' )
+            crc |= 1ULL << i;
+
+    // The data's most significant bit first, straight from its words
+    const vector< uint64_t >& words = data.getWords();
+    for ( size_t position = data.length(); position > 0; position-- )
+        {
+        bool bit = ( words[ ( position - 1 ) / 64 ] >> ( ( position - 1 ) % 64 ) ) & 1;
+        bool doInvert = bit ^ ( ( crc & top ) != 0 );
+        crc = ( crc << 1 ) & mask;
+        if ( doInvert )
+            crc ^= polyBits;
+        }
+
+    result.initialise( crc, width );
+}
@@ -37,6 +37,40 @@ bool Nerror::isUsingSysLog()
 }
 
 
+// Here rather than in Compose() so every instantiation of it shares the one stream per thread.
+static thread_local bool composeBufferInUse = false;
+
+static ostringstream& getComposeBuffer()
+{
+   static thread_local ostringstream buffer;
+   return buffer;
+}
+
+
+ostringstream* Nerror::claimComposeBuffer()
+{
+   if ( composeBufferInUse )
+      return NULL;
+
+   composeBufferInUse = true;
+   return &getComposeBuffer();
+}
+
+
+void Nerror::releaseComposeBuffer()
+{
+   // Clear the text and any formatting a message left behind (e.g. std::hex).
+   ostringstream& buffer = getComposeBuffer();
+   buffer.str( string() );
+   buffer.clear();
+   buffer.flags( ios_base::dec | ios_base::skipws );
+   buffer.precision( 6 );
+   buffer.width( 0 );
+   buffer.fill( ' ' );
+   composeBufferInUse = false;
+}
+
+
 static std::string getErrnoMessage(const int theErrno)
 {
    // The GNU C Library uses a buffer of 1024 characters for strerror()
@@ -1,270 +1,588 @@
-// nevent.cxx by Neil Cooper. See nevent.h for documentation
-#include "nevent.h"
-
-#include <errno.h>   // for ETIMEDOUT
-#include <pthread.h>
-
-#include "nerror.h"
-
-using namespace std;
-
-Nevent::Nevent( const bool           theCountingEventFlag,
-                const unsigned long  theInitialState,
-                const bool           theManualResetFlag   ) :
-                    m_isCountingEvent( theCountingEventFlag ),
-                    m_isManualReset( theManualResetFlag         )
-{
-    if  ( m_isCountingEvent )
-        m_eventUnion.m_countingEvent = theInitialState;
-    else
-        m_eventUnion.m_boolEvent = ( theInitialState > 0 );
-
-    // Set up the attributes of our mutex
-    pthread_mutexattr_t attributes;
-    if ( pthread_mutexattr_init( &attributes ) )
-        ERROR( "Nevent: Can't create pthread mutex atributes" );
-
-    // The mutex kind determines what happens if a thread attempts to lock
-    // a mutex it already owns by calling pthread_mutex_lock().
-    // PTHREAD_MUTEX_FAST_NP simply suspends the calling thread forever.
-    // PTHREAD_MUTEX_ERRORCHECK_NP  returns immediately with the error code EDEADLK.
-    // PTHREAD_MUTEX_RECURSIVE_NP returns immediately with a success return code.
-    // The number of times the thread owning the mutex has locked it is recorded in the mutex.
-    // The owning thread must call pthread_mutex_unlock the same number of times before
-    // the mutex returns to the unlocked state.
-    // PTHREAD_MUTEX_RECURSIVE_NP best approximates WIN32 behaviour
-
-#if defined ( __CYGWIN__ ) || defined ( __ANDROID__ )
-    if ( pthread_mutexattr_settype( &attributes, PTHREAD_MUTEX_NORMAL ) ) // Still need to confirm this is really functionally identical to PTHREAD_MUTEX_FAST_NP
-#else
-    if ( pthread_mutexattr_settype( &attributes, PTHREAD_MUTEX_FAST_NP ) )
-#endif
-        ERROR( "Nevent: Can't set pthread mutex type attribute" );
-
-    if ( pthread_mutex_init( &m_accessMutex, &attributes ) )
-        ERROR( "Nevent: Can't initialise pthread mutex attributes" );
-
-    // pthread_mutexattr_destroy currently does nothing in Linux Pthreads
-    // but we'll do it anyway here for future-proofing and portability.
-    if ( pthread_mutexattr_destroy( &attributes ) )
-        ERROR( "Nevent: Can't destroy pthread mutex attributes" );
-
-    if ( pthread_cond_init( &m_condition, NULL ) )
-        ERROR( "Nevent: Can't initialise pthread condition" );
-}
-
-
-Nevent::~Nevent()
-{
-    // Destroying a pthread condition that someone is waiting on returns EBUSY
-    // but we're already in the destructor.
-    int status = pthread_cond_destroy( &m_condition );
-    if ( status )
-        NWARN( status, "Nevent::~Nevent: Can't destroy pthread condition" );
-
-    status = pthread_mutex_destroy( &m_accessMutex ); // Not currently necessary in Linux
-
-    if ( status )
-        NWARN( status, "Nevent::~Nevent: Can't destroy pthread mutex" );
-}
-
-
-void Nevent::signal()
-// If bool event: Set the event to the signalled state.
-// If counting event: Increment the event towards the signalled state.
-{
-    if ( m_isCountingEvent )
-        changeCountingEventState( 1 );
-    else
-        changeBoolEventState( true );
-}
-
-
-void Nevent::unsignal()
-// Only needed for manual reset events.
-// If bool event: set the event to the unsignalled state.
-// If counting event: decrement event towards unsignalled state.
-{
-    if ( m_isCountingEvent )
-        changeCountingEventState( -1 );
-    else
-        changeBoolEventState( false );
-}
-
-
-void Nevent::reset()
-{
-    if ( m_isCountingEvent )
-        resetCountingEventState();
-    else
-        changeBoolEventState( false );
-}
-
-
-unsigned long Nevent::currentState()
-// Returns current state of event.
-// No guarantees about whether it is still accurate by the time the function returns.
-{
-    unsigned long state = 0;
-    if ( m_isCountingEvent )
-        state = m_eventUnion.m_countingEvent;
-    else
-        state = m_eventUnion.m_boolEvent ? 1 : 0;
-
-    return state;
-}
-
-
-bool Nevent::wait( const Ntime theTimeout )
-{
-    struct timespec endTime;
-    bool mutexLocked = false;
-    bool timedOut = false;
-    bool eventClear = false;
-    bool timedWait =  !theTimeout.isZeroTime();
-
-    if ( timedWait )
-        {
-        Ntime timeSum = Ntime::getCurrentLocalTime();
-        timeSum += theTimeout;
-        endTime = timeSum.getAsTimespec();
-        }
-
-    int lockStatus = pthread_mutex_lock( &m_accessMutex );
-
-    if ( 0 == lockStatus )
-        mutexLocked = true;
-    else
-        NERROR( lockStatus, "Nevent::Wait: Error locking access mutex." );
-
-    // Wait until the event is signalled, we time out or a mutex error occurs
-    // (mutex is unlocked implicitly while we wait)
-
-    eventClear = m_isCountingEvent ?
-                            ( 0 == m_eventUnion.m_countingEvent ) :
-                            ( !m_eventUnion.m_boolEvent );
-
-    while( eventClear && ( !timedOut ) )
-        {
-        if ( timedWait )
-            {
-            int retVal = pthread_cond_timedwait( &m_condition, &m_accessMutex, &endTime );
-            if ( retVal )
-                {
-                if  ( retVal == ETIMEDOUT )
-                    timedOut = true;
-                else
-                    NERROR( retVal, "Nevent::Wait: pthread_cond_timedwait failed." );
-                }
-            }
-        else
-            {
-            int retVal = pthread_cond_wait( &m_condition, &m_accessMutex );
-            if ( retVal )
-                NERROR( retVal, "Nevent::Wait: pthread_cond_wait failed." );
-            }
-
-        eventClear = m_isCountingEvent ?
-                            ( 0 == m_eventUnion.m_countingEvent ) :
-                            ( !m_eventUnion.m_boolEvent );
-        }
-
-    // If wait was successful, reset the event unless manual mode
-    if( !timedOut )
-        {
-        if ( m_isManualReset )
-            pthread_cond_signal( &m_condition );  // Explicitly let anyone else through
-        else
-            {
-            if ( m_isCountingEvent )
-                --m_eventUnion.m_countingEvent;
-            else
-                m_eventUnion.m_boolEvent = false; // Just this being false when we unlock will let anyone else through due to eventClear test above
-            }
-        }
-
-    if( mutexLocked )
-        {
-        lockStatus = pthread_mutex_unlock( &m_accessMutex );
-        if ( lockStatus )
-            NERROR( lockStatus, "Nevent::Wait: Error unlocking access mutex." );
-        }
-
-    return ( !timedOut );
-}
-
-// ---------------------------------------------------------------------------
-// Private methods
-// ---------------------------------------------------------------------------
-
-void Nevent::changeBoolEventState( const bool   theState )
-{
-    int signalVal = 0;
-    int retVal = pthread_mutex_lock( &m_accessMutex );
-
-    if ( retVal )
-        NERROR( retVal, "Nevent::ChangeBoolEventState: Error locking access mutex." );
-
-    m_eventUnion.m_boolEvent = theState;
-
-    // Only want to signal if the event is set to signalled
-    if( theState )
-        signalVal = pthread_cond_signal( &m_condition );
-
-    retVal = pthread_mutex_unlock( &m_accessMutex );
-    if ( retVal )
-        NERROR( retVal, "Nevent::ChangeBoolEventState: Error unlocking access mutex." );
-
-    // Delay throwing of exception until after we unlocked mutex just so we dont leave a locked mutex around
-    if ( signalVal )
-        NERROR( signalVal, "Nevent::ChangeBoolEventState: Can't signal condition." );
-}
-
-
-
-void Nevent::changeCountingEventState( const long  theChange )
-{
-    int signalVal = 0;
-    int retVal = pthread_mutex_lock( &m_accessMutex );
-
-    if ( retVal )
-        NERROR( retVal, "Nevent::ChangeCountingEventState: Error locking access mutex." );
-
-    if ( ( theChange > 0 ) || ( m_eventUnion.m_countingEvent >= labs( theChange ) ) ) // Ensure change wont leave counter < 0
-        {
-        m_eventUnion.m_countingEvent += theChange;
-
-        // Only want to signal the condition if the event is being signalled
-        if( theChange > 0 ) // here we can also assume event must be > 0 if theChange is > 0
-            signalVal =  pthread_cond_signal( &m_condition );
-        }
-
-    retVal = pthread_mutex_unlock( &m_accessMutex );
-    if ( retVal )
-        NERROR( retVal, "Nevent::ChangeCountingEventState: Error unlocking access mutex." );
-
-    // Delay throwing of exception until after we unlocked mutex just so we dont leave a locked mutex around
-    if ( signalVal )
-        NERROR( signalVal, "Nevent::ChangeBoolEventState: Can't signal condition." );
-}
-
-
-void Nevent::resetCountingEventState()
-{
-    int signalVal = 0;
-    int retVal = pthread_mutex_lock( &m_accessMutex );
-
-    if ( retVal )
-        NERROR( retVal, "Nevent::ResetCountingEventState: Error locking access mutex." );
-
-    m_eventUnion.m_countingEvent = 0;
-
-    retVal = pthread_mutex_unlock( &m_accessMutex );
-    if ( retVal )
-        NERROR( retVal, "Nevent::ResetCountingEventState: Error unlocking access mutex." );
-
-    // Delay throwing of exception until after we unlocked mutex just so we dont leave a locked mutex around
-    if ( signalVal )
-        NERROR( signalVal, "Nevent::ResetCountingEventState: Can't signal condition." );
-}
-
+// nevent.cxx by Neil Cooper. See nevent.h for documentation
+#include "nevent.h"
+
+#include <errno.h>   // for ETIMEDOUT, EAGAIN, EINTR
+#include <limits.h>  // for INT_MAX
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#else
+#include <time.h>
+#endif
+
+#include "nerror.h"
+#include "nstopToken.h"
+
+using namespace std;
+
+namespace NEVENT
+{
+const uint64_t VALUE_MASK = 0xFFFFFFFFULL;
+const uint64_t ONE_WAITER = 1ULL << 32;
+const uint64_t ONE_WATCHER = 1ULL << 48;
+
+// Protects all events' watcher lists. Signals that need to notify watchers hold it while they
+// change the state, so a watcher can't register or leave part way through.
+pthread_mutex_t watcherMutex = PTHREAD_MUTEX_INITIALIZER;
+
+inline uint32_t getValue( const uint64_t theState )
+{
+    return (uint32_t)( theState & VALUE_MASK );
+}
+
+inline uint32_t getWaiters( const uint64_t theState )
+{
+    return (uint32_t)( ( theState >> 32 ) & 0xFFFF );
+}
+
+inline uint32_t getWatchers( const uint64_t theState )
+{
+    return (uint32_t)( theState >> 48 );
+}
+
+
+void drainFd( const int theFd )
+{
+    uint64_t count;
+    while ( read( theFd, &count, sizeof( count ) ) == sizeof( count ) )
+        ;
+}
+
+
+void notifyFd( const int theFd )
+{
+    uint64_t one = 1;
+    if ( write( theFd, &one, sizeof( one ) ) != sizeof( one ) )
+        EWARN( "Nevent: Can't write to eventfd" );
+}
+
+#ifdef __linux__
+
+bool futexWait( uint32_t* theWord, const uint32_t theExpected, const timespec* theDeadline )
+{
+    // Sleeps while *theWord == theExpected, until woken or the (absolute CLOCK_MONOTONIC)
+    // deadline passes. Return: false = deadline passed.
+    long status = syscall( SYS_futex, theWord, FUTEX_WAIT_BITSET_PRIVATE,
+                           theExpected, theDeadline, NULL, FUTEX_BITSET_MATCH_ANY );
+
+    if ( ( status == -1 ) && ( errno != EAGAIN ) && ( errno != EINTR ) )
+        {
+        if ( errno == ETIMEDOUT )
+            return false;
+        EERROR( "Nevent: futex wait failed" );
+        }
+
+    return true;
+}
+
+
+void futexWake( uint32_t* theWord, const int theCount )
+{
+    // May be called just after a waiter has seen the new state, returned and destroyed the event.
+    // The kernel only uses the address, so at worst that wakes someone else spuriously.
+    syscall( SYS_futex, theWord, FUTEX_WAKE_PRIVATE, theCount, NULL, NULL, 0 );
+}
+
+#else   // No futexes (e.g. Cygwin). All events share one mutex and condition.
+
+pthread_mutex_t sharedMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t  sharedCondition;
+pthread_once_t  sharedConditionOnce = PTHREAD_ONCE_INIT;
+
+void initSharedCondition()
+{
+    // Deadlines are on the monotonic clock
+    pthread_condattr_t attributes;
+    pthread_condattr_init( &attributes );
+    pthread_condattr_setclock( &attributes, CLOCK_MONOTONIC );
+    pthread_cond_init( &sharedCondition, &attributes );
+    pthread_condattr_destroy( &attributes );
+}
+
+
+bool futexWait( uint32_t* theWord, const uint32_t theExpected, const timespec* theDeadline )
+{
+    bool timedOut = false;
+
+    pthread_once( &sharedConditionOnce, initSharedCondition );
+    pthread_mutex_lock( &sharedMutex );
+
+    // Wakers take the mutex after changing the word, so they can't slip in between this test and the wait.
+    if ( __atomic_load_n( theWord, __ATOMIC_SEQ_CST ) == theExpected )
+        {
+        int status = theDeadline ? pthread_cond_timedwait( &sharedCondition, &sharedMutex, theDeadline )
+                                 : pthread_cond_wait( &sharedCondition, &sharedMutex );
+        if ( status == ETIMEDOUT )
+            timedOut = true;
+        else
+            if ( status )
+                {
+                pthread_mutex_unlock( &sharedMutex );
+                NERROR( status, "Nevent: Condition wait failed" );
+                }
+        }
+
+    pthread_mutex_unlock( &sharedMutex );
+    return !timedOut;
+}
+
+
+void futexWake( uint32_t* theWord, const int theCount )
+{
+    // Can't wake waiters on one event selectively, so wake them all to recheck.
+    pthread_once( &sharedConditionOnce, initSharedCondition );
+    pthread_mutex_lock( &sharedMutex );
+    pthread_cond_broadcast( &sharedCondition );
+    pthread_mutex_unlock( &sharedMutex );
+}
+
+#endif
+}
+
+using namespace NEVENT;
+
+
+Nevent::Nevent( const bool           theCountingEventFlag,
+                const unsigned long  theInitialState,
+                const bool           theManualResetFlag,
+                const std::string&   theName                ) :
+                    m_state( 0 ),
+                    m_isCountingEvent( theCountingEventFlag ),
+                    m_isManualReset( theManualResetFlag         ),
+                    m_fd( -1 )
+#ifdef NLIB_LOCK_PROFILING
+                    ,
+                    m_profile( "Nevent", this, theName )
+#endif
+{
+    if  ( m_isCountingEvent )
+        {
+        if ( theInitialState > VALUE_MASK )
+            ERROR( "Nevent: Initial count ", theInitialState, " is too large" );
+        m_state = theInitialState;
+        }
+    else
+        m_state = ( theInitialState > 0 ) ? 1 : 0;
+}
+
+
+Nevent::~Nevent()
+{
+    uint64_t state = m_state.load();
+    if ( getWaiters( state ) || ( getWatchers( state ) > ( ( m_fd == -1 ) ? 0 : 1 ) ) )
+        WARN( "Nevent::~Nevent: Destroying event that threads are waiting on" );
+
+    if ( m_fd != -1 )
+        close( m_fd );
+}
+
+
+void Nevent::signal()
+// If bool event: Set the event to the signalled state.
+// If counting event: Increment the event towards the signalled state.
+{
+    // Read before the state changes, as the event may be gone by the time it has.
+    const int wakeCount = m_isManualReset ? INT_MAX : 1;
+    uint64_t previous = m_state.load();
+    uint64_t signalled;
+
+    do
+        {
+        if ( getWatchers( previous ) )
+            {
+            signalWatched();
+            return;
+            }
+
+        if ( !getSignalledState( previous, &signalled ) )
+            ERROR( "Nevent::signal: Counting event overflow" );
+
+        if ( signalled == previous ) // Already signalled, so anyone waiting has been woken already
+            return;
+        }
+    while ( !m_state.compare_exchange_weak( previous, signalled ) );
+
+    // Waking is the only thing we may do after the state changes: once it has, a waiter may
+    // return and destroy the event. getFutexWord() only works out the address.
+    if ( getWaiters( previous ) )
+        futexWake( getFutexWord(), wakeCount );
+}
+
+
+void Nevent::unsignal()
+// Only needed for manual reset events.
+// If bool event: set the event to the unsignalled state.
+// If counting event: decrement event towards unsignalled state.
+{
+    if ( m_isCountingEvent )
+        {
+        uint64_t state = m_state.load();
+        while ( getValue( state ) && !m_state.compare_exchange_weak( state, state - 1 ) )
+            ;
+        }
+    else
+        m_state.fetch_and( ~VALUE_MASK );
+}
+
+
+void Nevent::reset()
+{
+    m_state.fetch_and( ~VALUE_MASK );
+}
+
+
+unsigned long Nevent::currentState()
+// Returns current state of event.
+// No guarantees about whether it is still accurate by the time the function returns.
+{
+    return getValue( m_state.load() );
+}
+
+
+bool Nevent::wait( const Ntime theTimeout )
+{
+    if ( tryConsume() )
+        {
+        profileTaken( 0 );
+        return true;
+        }
+
+    return wait( Ndeadline( theTimeout ) );
+}
+
+
+bool Nevent::wait( const Ndeadline& theDeadline )
+{
+    if ( tryConsume() )
+        {
+        profileTaken( 0 );
+        return true;
+        }
+
+    const timespec* deadline = theDeadline.isInfinite() ? NULL : &theDeadline.getAsTimespec();
+    unsigned long long waitStart = profileNow();
+    bool signalled = false;
+
+    // Registering as a waiter changes the same word signal() changes, so a signal() either sees
+    // us and wakes us or happens before we look at the state below.
+    m_state.fetch_add( ONE_WAITER );
+
+    while ( !signalled )
+        {
+        signalled = tryConsume();
+
+        if ( !signalled && !futexWait( getFutexWord(), 0, deadline ) )
+            {
+            signalled = tryConsume(); // Last chance, in case it was signalled as we timed out
+            break;
+            }
+        }
+
+    m_state.fetch_sub( ONE_WAITER );
+
+    if ( signalled )
+        profileTaken( waitStart );
+
+    return signalled;
+}
+
+bool Nevent::wait( const Ntime theTimeout, const NstopToken& theStopToken )
+{
+    return wait( Ndeadline( theTimeout ), theStopToken );
+}
+
+
+bool Nevent::wait( const Ndeadline& theDeadline, const NstopToken& theStopToken )
+{
+    if ( theStopToken.stopRequested() )
+        return false;
+
+    std::vector< Nevent* > events( 2 );
+    events[0] = this;
+    events[1] = &theStopToken.getEvent();
+    return ( waitAny( events, theDeadline ) == 0 );
+}
+
+
+bool Nevent::tryWait()
+{
+    if ( m_fd == -1 )
+        {
+        bool signalled = tryConsume();
+        if ( signalled )
+            profileTaken( 0 );
+        return signalled;
+        }
+
+    // Clear the fd before looking at the state, so a signal from now on makes it readable again.
+    drainFd( m_fd );
+    bool signalled = tryConsume();
+    if ( signalled )
+        profileTaken( 0 );
+
+    if ( currentState() )  // Still signalled (e.g. counting or manual reset), so keep it readable
+        notifyFd( m_fd );
+
+    return signalled;
+}
+
+
+int Nevent::getFd()
+{
+    pthread_mutex_lock( &watcherMutex );
+
+    if ( m_fd == -1 )
+        {
+        int fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+        if ( fd == -1 )
+            {
+            pthread_mutex_unlock( &watcherMutex );
+            EERROR( "Nevent::getFd: Can't create eventfd" );
+            }
+
+        // The fd watches the event for as long as it exists.
+        m_fd = fd;
+        if ( getValue( m_state.fetch_add( ONE_WATCHER ) ) )
+            notifyFd( fd );
+        }
+
+    pthread_mutex_unlock( &watcherMutex );
+    return m_fd;
+}
+
+
+int Nevent::waitAny( const std::vector< Nevent* >& theEvents, const Ntime theTimeout )
+{
+    for ( size_t i = 0; i < theEvents.size(); i++ )
+        if ( theEvents[i]->tryConsume() )
+            {
+            theEvents[i]->profileTaken( 0 );
+            return i;
+            }
+
+    return waitAny( theEvents, Ndeadline( theTimeout ) );
+}
+
+
+int Nevent::waitAny( const std::vector< Nevent* >& theEvents, const Ndeadline& theDeadline )
+{
+    const timespec* deadline = theDeadline.isInfinite() ? NULL : &theDeadline.getAsTimespec();
+    WATCHER watcher( 0 );
+    unsigned long long waitStart = profileNow();
+    int fired = -1;
+    bool timedOut = false;
+
+    addWatcher( theEvents, &watcher );
+
+    while ( ( fired < 0 ) && !timedOut )
+        {
+        // Any signal after this changes the watcher, so we can't sleep through it.
+        uint32_t sequence = watcher.load();
+
+        for ( size_t i = 0; ( fired < 0 ) && ( i < theEvents.size() ); i++ )
+            if ( theEvents[i]->tryConsume() )
+                fired = i;
+
+        if ( ( fired < 0 ) && !futexWait( reinterpret_cast< uint32_t* >( &watcher ), sequence, deadline ) )
+            {
+            timedOut = true;
+            for ( size_t i = 0; ( fired < 0 ) && ( i < theEvents.size() ); i++ ) // Last chance
+                if ( theEvents[i]->tryConsume() )
+                    fired = i;
+            }
+        }
+
+    removeWatcher( theEvents, &watcher );
+
+    if ( fired >= 0 )
+        theEvents[ fired ]->profileTaken( waitStart );
+
+    return fired;
+}
+
+
+bool Nevent::waitAll( const std::vector< Nevent* >& theEvents, const Ntime theTimeout )
+{
+    if ( tryConsumeAll( theEvents ) )
+        {
+        for ( size_t i = 0; i < theEvents.size(); i++ )
+            theEvents[i]->profileTaken( 0 );
+        return true;
+        }
+
+    return waitAll( theEvents, Ndeadline( theTimeout ) );
+}
+
+
+bool Nevent::waitAll( const std::vector< Nevent* >& theEvents, const Ndeadline& theDeadline )
+{
+    const timespec* deadline = theDeadline.isInfinite() ? NULL : &theDeadline.getAsTimespec();
+    WATCHER watcher( 0 );
+    unsigned long long waitStart = profileNow();
+    bool signalled = false;
+    bool timedOut = false;
+
+    addWatcher( theEvents, &watcher );
+
+    while ( !signalled && !timedOut )
+        {
+        uint32_t sequence = watcher.load();
+        signalled = tryConsumeAll( theEvents );
+
+        if ( !signalled && !futexWait( reinterpret_cast< uint32_t* >( &watcher ), sequence, deadline ) )
+            {
+            timedOut = true;
+            signalled = tryConsumeAll( theEvents ); // Last chance
+            }
+        }
+
+    removeWatcher( theEvents, &watcher );
+
+    if ( signalled )
+        for ( size_t i = 0; i < theEvents.size(); i++ )
+            theEvents[i]->profileTaken( waitStart );
+
+    return signalled;
+}
+
+// ---------------------------------------------------------------------------
+// Private methods
+// ---------------------------------------------------------------------------
+
+bool Nevent::tryConsume()
+{
+    // Returns true if the event is signalled, resetting it (or decrementing the count) unless it is manual reset.
+    uint64_t state = m_state.load();
+
+    while ( getValue( state ) )
+        {
+        if ( m_isManualReset )
+            return true;
+
+        uint64_t consumed = m_isCountingEvent ? ( state - 1 ) : ( state & ~VALUE_MASK );
+        if ( m_state.compare_exchange_weak( state, consumed ) )
+            return true;
+        }
+
+    return false;
+}
+
+
+bool Nevent::tryConsumeAll( const std::vector< Nevent* >& theEvents )
+{
+    for ( size_t i = 0; i < theEvents.size(); i++ )
+        if ( !theEvents[i]->currentState() )
+            return false;
+
+    for ( size_t i = 0; i < theEvents.size(); i++ )
+        if ( !theEvents[i]->tryConsume() )
+            {
+            // Someone else got in first. Put back what we took.
+            while ( i-- > 0 )
+                if ( !theEvents[i]->m_isManualReset )
+                    theEvents[i]->signal();
+            return false;
+            }
+
+    return true;
+}
+
+
+bool Nevent::getSignalledState( const uint64_t theState, uint64_t* theSignalledState )
+{
+    // Works out what theState becomes when signalled. Return: false if a count would overflow.
+    if ( !m_isCountingEvent )
+        *theSignalledState = theState | 1;
+    else
+        {
+        if ( getValue( theState ) == VALUE_MASK )
+            return false;
+        *theSignalledState = theState + 1;
+        }
+
+    return true;
+}
+
+
+void Nevent::signalWatched()
+{
+    // signal() for when multiple waits or an eventfd are watching. Holding the watcher lock
+    // stops them leaving (and the event being destroyed) while we notify them.
+    const int wakeCount = m_isManualReset ? INT_MAX : 1;
+    pthread_mutex_lock( &watcherMutex );
+
+    uint64_t previous = m_state.load();
+    uint64_t signalled;
+    do
+        if ( !getSignalledState( previous, &signalled ) )
+            {
+            pthread_mutex_unlock( &watcherMutex );
+            ERROR( "Nevent::signal: Counting event overflow" );
+            }
+    while ( ( signalled != previous ) && !m_state.compare_exchange_weak( previous, signalled ) );
+
+    if ( signalled != previous )
+        {
+        for ( size_t i = 0; i < m_watchers.size(); i++ )
+            {
+            m_watchers[i]->fetch_add( 1 );
+            futexWake( reinterpret_cast< uint32_t* >( m_watchers[i] ), 1 );
+            }
+
+        if ( m_fd != -1 )
+            notifyFd( m_fd );
+        }
+
+    pthread_mutex_unlock( &watcherMutex );
+
+    // Only the locals once the lock is dropped, as for signal().
+    if ( ( signalled != previous ) && getWaiters( previous ) )
+        futexWake( getFutexWord(), wakeCount );
+}
+
+
+void Nevent::addWatcher( const std::vector< Nevent* >& theEvents, WATCHER* theWatcher )
+{
+    pthread_mutex_lock( &watcherMutex );
+    for ( size_t i = 0; i < theEvents.size(); i++ )
+        {
+        theEvents[i]->m_watchers.push_back( theWatcher );
+        theEvents[i]->m_state.fetch_add( ONE_WATCHER );  // From now on, signal() notifies us
+        }
+    pthread_mutex_unlock( &watcherMutex );
+}
+
+
+void Nevent::removeWatcher( const std::vector< Nevent* >& theEvents, WATCHER* theWatcher )
+{
+    pthread_mutex_lock( &watcherMutex );
+    for ( size_t i = 0; i < theEvents.size(); i++ )
+        {
+        std::vector< WATCHER* >& watchers = theEvents[i]->m_watchers;
+        for ( size_t w = 0; w < watchers.size(); w++ )
+            if ( watchers[w] == theWatcher )
+                {
+                watchers[w] = watchers.back();
+                watchers.pop_back();
+                break;
+                }
+        theEvents[i]->m_state.fetch_sub( ONE_WATCHER );
+        }
+    pthread_mutex_unlock( &watcherMutex );
+}
+
+
+uint32_t* Nevent::getFutexWord()
+{
+    // The state half of m_state
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return reinterpret_cast< uint32_t* >( &m_state ) + 1;
+#else
+    return reinterpret_cast< uint32_t* >( &m_state );
+#endif
+}
@@ -0,0 +1,331 @@
+// nhistogram.cxx by Neil Cooper. See nhistogram.h for documentation
+#include "nhistogram.h"
+
+#include <math.h>       // for ceil()
+
+#include <algorithm>    // for std::fill()
+
+#include "nerror.h"
+
+using namespace std;
+
+namespace NHISTOGRAM
+{
+static const char           MAGIC[] = { 'N', 'H' };
+static const unsigned char  VERSION = 1;
+
+typedef struct
+    {
+    uint64_t    id;
+    void*       shard;
+    } CACHED_SHARD;
+
+// Each thread's shards for the last few NconcurrentHistograms it recorded into. Plain data, so
+// using it needs no thread_local initialisation guard.
+static const unsigned int           CACHED_SHARDS = 8;
+static thread_local CACHED_SHARD    cachedShards[ CACHED_SHARDS ];
+static thread_local unsigned int    nextCachedShard;
+
+static std::atomic< uint64_t >      nextId( 1 );   // 0 is an empty cache entry
+
+static void putVarint( string& theData, uint64_t theValue )
+{
+    while ( theValue >= 0x80 )
+        {
+        theData += (char)( ( theValue & 0x7F ) | 0x80 );
+        theValue >>= 7;
+        }
+    theData += (char)theValue;
+}
+
+static uint64_t getVarint( const string& theData, size_t& thePosition )
+{
+    uint64_t value = 0;
+    for ( unsigned int shift = 0; shift < 64; shift += 7 )
+        {
+        if ( thePosition >= theData.size() )
+            ERROR( "Nhistogram::deserialise: Data is truncated" );
+        unsigned char byte = theData[ thePosition++ ];
+        value |= (uint64_t)( byte & 0x7F ) << shift;
+        if ( !( byte & 0x80 ) )
+            return value;
+        }
+    ERROR( "Nhistogram::deserialise: Bad varint at byte ", thePosition );
+}
+
+static size_t getBucketCount( const unsigned int thePrecision )
+{
+    return (size_t)( 65 - thePrecision ) << thePrecision;
+}
+}
+
+using namespace NHISTOGRAM;
+
+
+//----------------------------------------------------------------------------
+// Nhistogram
+//----------------------------------------------------------------------------
+
+const unsigned int Nhistogram::DEFAULT_PRECISION;
+const unsigned int Nhistogram::MAX_PRECISION;
+
+Nhistogram::Nhistogram( const unsigned int thePrecision ) : m_precision( thePrecision )
+{
+    if ( ( thePrecision < 1 ) || ( thePrecision > MAX_PRECISION ) )
+        ERROR( "Nhistogram: Precision must be 1 to ", MAX_PRECISION, " bits, not ", thePrecision );
+    m_counts.resize( getBucketCount( m_precision ) );
+    reset();
+}
+
+
+void Nhistogram::reset()
+{
+    fill( m_counts.begin(), m_counts.end(), 0 );
+    m_count = 0;
+    m_min = ~0ULL;
+    m_max = 0;
+}
+
+
+uint64_t Nhistogram::getLowestValue( const size_t theIndex, const unsigned int thePrecision )
+{
+    size_t half = theIndex >> thePrecision;
+    if ( half <= 1 )
+        return theIndex;    // One value per bucket
+    unsigned int shift = half - 1;
+    return (uint64_t)( theIndex - ( (size_t)shift << thePrecision ) ) << shift;
+}
+
+
+uint64_t Nhistogram::getHighestValue( const size_t theIndex, const unsigned int thePrecision )
+{
+    size_t half = theIndex >> thePrecision;
+    if ( half <= 1 )
+        return theIndex;
+    return getLowestValue( theIndex, thePrecision ) + ( ( 1ULL << ( half - 1 ) ) - 1 );
+}
+
+
+void Nhistogram::merge( const Nhistogram& theHistogram )
+{
+    if ( theHistogram.m_precision < m_precision )
+        {
+        // Down to the other's precision. Its buckets are whole numbers of ours, so recording
+        // each of ours at its lowest value moves its whole count to the right one.
+        Nhistogram lower( theHistogram.m_precision );
+        lower.merge( *this );
+        *this = lower;
+        }
+
+    if ( theHistogram.m_precision == m_precision )
+        for ( size_t i = 0; i < m_counts.size(); i++ )
+            m_counts[i] += theHistogram.m_counts[i];
+    else
+        for ( size_t i = 0; i < theHistogram.m_counts.size(); i++ )
+            if ( theHistogram.m_counts[i] )
+                m_counts[ getIndex( getLowestValue( i, theHistogram.m_precision ), m_precision ) ] += theHistogram.m_counts[i];
+
+    m_count += theHistogram.m_count;
+    if ( theHistogram.m_min < m_min )
+        m_min = theHistogram.m_min;
+    if ( theHistogram.m_max > m_max )
+        m_max = theHistogram.m_max;
+}
+
+
+double Nhistogram::getMean() const
+{
+    if ( !m_count )
+        return 0;
+
+    double total = 0;
+    for ( size_t i = 0; i < m_counts.size(); i++ )
+        if ( m_counts[i] )
+            total += m_counts[i] * ( ( getLowestValue( i, m_precision ) / 2.0 ) + ( getHighestValue( i, m_precision ) / 2.0 ) );
+    return total / m_count;
+}
+
+
+uint64_t Nhistogram::getPercentile( const double thePercentile ) const
+{
+    if ( !m_count )
+        return 0;
+
+    // The value of the rank'th smallest recorded value's bucket
+    double rank = ceil( ( thePercentile / 100.0 ) * m_count );
+    uint64_t target = ( rank < 1 ) ? 1 : ( rank > m_count ) ? m_count : (uint64_t)rank;
+    uint64_t seen = 0;
+    for ( size_t i = 0; i < m_counts.size(); i++ )
+        {
+        seen += m_counts[i];
+        if ( seen >= target )
+            {
+            uint64_t value = getHighestValue( i, m_precision );
+            return ( value < m_min ) ? m_min : ( value > m_max ) ? m_max : value;
+            }
+        }
+    return m_max;
+}
+
+
+void Nhistogram::dump( ostream& theStream ) const
+{
+    theStream << "count=" << m_count << " min=" << getMin() << " mean=" << (uint64_t)getMean() << " p50=" << getPercentile( 50 )
+              << " p90=" << getPercentile( 90 ) << " p99=" << getPercentile( 99 ) << " p99.9=" << getPercentile( 99.9 )
+              << " max=" << m_max << endl;
+}
+
+
+string Nhistogram::serialise() const
+{
+    string data( MAGIC, sizeof( MAGIC ) );
+    data += (char)VERSION;
+    data += (char)m_precision;
+    putVarint( data, m_count );
+    putVarint( data, getMin() );
+    putVarint( data, m_max );
+
+    size_t next = 0;
+    for ( size_t i = 0; i < m_counts.size(); i++ )
+        if ( m_counts[i] )
+            {
+            putVarint( data, i - next );
+            putVarint( data, m_counts[i] );
+            next = i + 1;
+            }
+    return data;
+}
+
+
+void Nhistogram::deserialise( const string& theData )
+{
+    if ( ( theData.size() < 4 ) || ( theData.compare( 0, sizeof( MAGIC ), MAGIC, sizeof( MAGIC ) ) != 0 ) )
+        ERROR( "Nhistogram::deserialise: Not a serialised histogram" );
+    if ( theData[2] != VERSION )
+        ERROR( "Nhistogram::deserialise: Unknown version ", (int)theData[2] );
+
+    Nhistogram histogram( (unsigned char)theData[3] );
+    size_t position = 4;
+    uint64_t count = getVarint( theData, position );
+    histogram.m_min = getVarint( theData, position );
+    histogram.m_max = getVarint( theData, position );
+
+    size_t next = 0;
+    while ( position < theData.size() )
+        {
+        uint64_t gap = getVarint( theData, position );
+        if ( gap >= histogram.m_counts.size() - next )
+            ERROR( "Nhistogram::deserialise: Bucket out of range" );
+        next += gap;
+        histogram.m_counts[ next++ ] = getVarint( theData, position );
+        histogram.m_count += histogram.m_counts[ next - 1 ];
+        }
+    if ( histogram.m_count != count )
+        ERROR( "Nhistogram::deserialise: Bucket counts add up to ", histogram.m_count, " not ", count );
+    if ( !count )
+        histogram.m_min = ~0ULL;
+
+    *this = histogram;
+}
+
+
+//----------------------------------------------------------------------------
+// NconcurrentHistogram
+//----------------------------------------------------------------------------
+
+NconcurrentHistogram::NconcurrentHistogram( const unsigned int thePrecision ) :
+                            m_precision( thePrecision ),
+                            m_id( nextId++ )
+{
+    Nhistogram check( thePrecision );   // Throws if thePrecision is bad
+}
+
+
+NconcurrentHistogram::~NconcurrentHistogram()
+{
+    for ( size_t i = 0; i < m_shards.size(); i++ )
+        {
+        delete[] m_shards[i]->counts;
+        delete m_shards[i];
+        }
+}
+
+
+void NconcurrentHistogram::record( const uint64_t theValue )
+{
+    // Only this thread writes to its shard, so plain increments rather than locked ones. The
+    // count is released after min and max, so a snapshot that sees it sees them too.
+    SHARD* shard = getShard();
+    if ( theValue < shard->min.load( std::memory_order_relaxed ) )
+        shard->min.store( theValue, std::memory_order_relaxed );
+    if ( theValue > shard->max.load( std::memory_order_relaxed ) )
+        shard->max.store( theValue, std::memory_order_relaxed );
+    std::atomic< uint64_t >& bucket = shard->counts[ Nhistogram::getIndex( theValue, m_precision ) ];
+    bucket.store( bucket.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+}
+
+
+NconcurrentHistogram::SHARD* NconcurrentHistogram::getShard()
+{
+    for ( unsigned int i = 0; i < CACHED_SHARDS; i++ )
+        if ( cachedShards[i].id == m_id )
+            return (SHARD*)cachedShards[i].shard;
+
+    SHARD* shard = findShard();
+    CACHED_SHARD& cached = cachedShards[ nextCachedShard++ % CACHED_SHARDS ];
+    cached.id = m_id;
+    cached.shard = shard;
+    return shard;
+}
+
+
+NconcurrentHistogram::SHARD* NconcurrentHistogram::findShard()
+{
+    // Once per thread, or when the thread has used too many other histograms since
+    pthread_t self = pthread_self();
+    m_shardsOwner.lock();
+    for ( size_t i = 0; i < m_shards.size(); i++ )
+        if ( pthread_equal( m_shards[i]->thread, self ) )
+            {
+            SHARD* shard = m_shards[i];
+            m_shardsOwner.unlock();
+            return shard;
+            }
+    m_shardsOwner.unlock();
+
+    SHARD* shard = new SHARD;
+    shard->thread = self;
+    shard->counts = new std::atomic< uint64_t >[ getBucketCount( m_precision ) ]();
+    shard->min.store( ~0ULL );
+    shard->max.store( 0 );
+
+    m_shardsOwner.lock();
+    m_shards.push_back( shard );
+    m_shardsOwner.unlock();
+    return shard;
+}
+
+
+Nhistogram NconcurrentHistogram::getSnapshot() const
+{
+    Nhistogram snapshot( m_precision );
+    m_shardsOwner.lock();
+    for ( size_t s = 0; s < m_shards.size(); s++ )
+        {
+        const SHARD* shard = m_shards[s];
+        for ( size_t i = 0; i < snapshot.m_counts.size(); i++ )
+            {
+            uint64_t count = shard->counts[i].load( std::memory_order_acquire );
+            snapshot.m_counts[i] += count;
+            snapshot.m_count += count;
+            }
+        uint64_t min = shard->min.load( std::memory_order_relaxed );
+        uint64_t max = shard->max.load( std::memory_order_relaxed );
+        if ( min < snapshot.m_min )
+            snapshot.m_min = min;
+        if ( max > snapshot.m_max )
+            snapshot.m_max = max;
+        }
+    m_shardsOwner.unlock();
+    return snapshot;
+}
@@ -0,0 +1,216 @@
+// nlockProfile.cxx by Neil Cooper. See nlockProfile.h for documentation
+#include "nlockProfile.h"
+
+#include <algorithm>    // for std::sort()
+#include <errno.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nerror.h"
+
+using namespace std;
+
+namespace NLOCKPROFILE
+{
+// Plain pthread mutex rather than an Nmutex, which would profile itself. The registry is created
+// on first use and never destroyed, so locks with static storage can register and deregister
+// in any order.
+pthread_mutex_t             registryMutex = PTHREAD_MUTEX_INITIALIZER;
+vector< NlockProfile* >*    registry = NULL;
+
+int                         signalPipe[2] = { -1, -1 };
+size_t                      signalDumpCount = 10;
+
+
+bool moreContended( const NlockProfile::LOCK_STATS& theFirst, const NlockProfile::LOCK_STATS& theSecond )
+{
+    if ( theFirst.contentions != theSecond.contentions )
+        return theFirst.contentions > theSecond.contentions;
+    return theFirst.totalWaitNs > theSecond.totalWaitNs;
+}
+}
+using namespace NLOCKPROFILE;
+
+
+NlockProfile::NlockProfile( const char* theKind, const void* theLock, const std::string& theName ) :
+                            m_name( theName ),
+                            m_acquisitions( 0 ),
+                            m_contentions( 0 ),
+                            m_totalWaitNs( 0 ),
+                            m_maxWaitNs( 0 ),
+                            m_totalHoldNs( 0 ),
+                            m_holdStartNs( 0 ),
+                            m_holdDepth( 0 )
+{
+    if ( m_name.empty() )
+        {
+        ostringstream name;
+        name << theKind << "@" << theLock;
+        m_name = name.str();
+        }
+
+    pthread_mutex_lock( &registryMutex );
+    if ( registry == NULL )
+        registry = new vector< NlockProfile* >;
+    registry->push_back( this );
+    pthread_mutex_unlock( &registryMutex );
+}
+
+
+NlockProfile::~NlockProfile()
+{
+    pthread_mutex_lock( &registryMutex );
+    vector< NlockProfile* >::iterator it = find( registry->begin(), registry->end(), this );
+    if ( it != registry->end() )
+        {
+        *it = registry->back();
+        registry->pop_back();
+        }
+    pthread_mutex_unlock( &registryMutex );
+}
+
+
+void NlockProfile::acquired( const unsigned long long theWaitStartNs )
+{
+    m_acquisitions.fetch_add( 1, memory_order_relaxed );
+    if ( theWaitStartNs )
+        {
+        unsigned long long waitNs = now() - theWaitStartNs;
+        m_contentions.fetch_add( 1, memory_order_relaxed );
+        m_totalWaitNs.fetch_add( waitNs, memory_order_relaxed );
+
+        unsigned long long maxWaitNs = m_maxWaitNs.load( memory_order_relaxed );
+        while ( ( waitNs > maxWaitNs ) && !m_maxWaitNs.compare_exchange_weak( maxWaitNs, waitNs, memory_order_relaxed ) )
+            ;
+        }
+}
+
+
+void NlockProfile::held()
+{
+    if ( m_holdDepth++ == 0 )
+        m_holdStartNs = now();
+}
+
+
+void NlockProfile::released()
+{
+    if ( ( m_holdDepth > 0 ) && ( --m_holdDepth == 0 ) )
+        m_totalHoldNs.fetch_add( now() - m_holdStartNs, memory_order_relaxed );
+}
+
+
+unsigned long long NlockProfile::now()
+{
+    timespec t;
+    clock_gettime( CLOCK_MONOTONIC, &t );
+    return ( t.tv_sec * 1000000000ULL ) + t.tv_nsec;
+}
+
+
+std::vector< NlockProfile::LOCK_STATS > NlockProfile::getStats( const size_t theCount )
+{
+    vector< LOCK_STATS > stats;
+
+    pthread_mutex_lock( &registryMutex );
+    if ( registry != NULL )
+        for ( size_t i = 0; i < registry->size(); i++ )
+            {
+            NlockProfile* lock = ( *registry )[i];
+            LOCK_STATS s;
+            s.name = lock->m_name;
+            s.acquisitions = lock->m_acquisitions.load( memory_order_relaxed );
+            s.contentions = lock->m_contentions.load( memory_order_relaxed );
+            s.totalWaitNs = lock->m_totalWaitNs.load( memory_order_relaxed );
+            s.maxWaitNs = lock->m_maxWaitNs.load( memory_order_relaxed );
+            s.totalHoldNs = lock->m_totalHoldNs.load( memory_order_relaxed );
+            stats.push_back( s );
+            }
+    pthread_mutex_unlock( &registryMutex );
+
+    sort( stats.begin(), stats.end(), moreContended );
+    if ( theCount && ( stats.size() > theCount ) )
+        stats.resize( theCount );
+
+    return stats;
+}
+
+
+void NlockProfile::dump( std::ostream& theStream, const size_t theCount )
+{
+    vector< LOCK_STATS > stats = getStats( theCount );
+
+    // Put the caller's formatting back afterwards.
+    ios_base::fmtflags flags = theStream.flags();
+    streamsize precision = theStream.precision();
+
+    theStream << left << setw( 32 ) << "lock" << right << setw( 14 ) << "acquisitions" << setw( 12 ) << "contended"
+              << setw( 14 ) << "wait ms" << setw( 12 ) << "max wait ms" << setw( 14 ) << "held ms" << endl;
+
+    for ( size_t i = 0; i < stats.size(); i++ )
+        theStream << left << setw( 32 ) << stats[i].name << right
+                  << setw( 14 ) << stats[i].acquisitions
+                  << setw( 12 ) << stats[i].contentions
+                  << fixed << setprecision( 3 )
+                  << setw( 14 ) << stats[i].totalWaitNs / 1000000.0
+                  << setw( 12 ) << stats[i].maxWaitNs / 1000000.0
+                  << setw( 14 ) << stats[i].totalHoldNs / 1000000.0 << endl;
+
+    theStream.flags( flags );
+    theStream.precision( precision );
+}
+
+
+void NlockProfile::dumpOnSignal( const int theSignal, const size_t theCount )
+{
+    pthread_mutex_lock( &registryMutex );
+    signalDumpCount = theCount;
+    bool started = ( signalPipe[0] != -1 );
+    if ( !started && ( pipe( signalPipe ) == -1 ) )
+        {
+        pthread_mutex_unlock( &registryMutex );
+        EERROR( "NlockProfile::dumpOnSignal: Can't create pipe" );
+        }
+    pthread_mutex_unlock( &registryMutex );
+
+    if ( !started )
+        {
+        pthread_t thread;
+        int status = pthread_create( &thread, NULL, dumpThreadProc, NULL );
+        if ( status )
+            NERROR( status, "NlockProfile::dumpOnSignal: Can't create dump thread" );
+        pthread_detach( thread );
+        }
+
+    struct sigaction action;
+    action.sa_handler = signalHandler;
+    sigemptyset( &action.sa_mask );
+    action.sa_flags = SA_RESTART;
+    if ( sigaction( theSignal, &action, NULL ) == -1 )
+        EERROR( "NlockProfile::dumpOnSignal: Can't install signal handler" );
+}
+
+
+void* NlockProfile::dumpThreadProc( void* theParam )
+{
+    char signalled;
+    while ( read( signalPipe[0], &signalled, 1 ) == 1 )
+        dump( cerr, signalDumpCount );
+    return NULL;
+}
+
+
+void NlockProfile::signalHandler( int theSignal )
+{
+    // Only async-signal-safe calls in here: the dump thread does the work. write() may set
+    // errno, so put back the value of whatever the signal interrupted.
+    int error = errno;
+    char signalled = 1;
+    while ( ( write( signalPipe[1], &signalled, 1 ) == -1 ) && ( errno == EINTR ) )
+        ;
+    errno = error;
+}
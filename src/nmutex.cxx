@@ -10,7 +10,10 @@
 const unsigned long DESTROY_FAIL_RETRY_DELAY_MS = 10;
 
 
-Nmutex::Nmutex( MUTEX_TYPE theType )
+Nmutex::Nmutex( MUTEX_TYPE theType, const std::string& theName )
+#ifdef NLIB_LOCK_PROFILING
+                : m_profile( "Nmutex", this, theName )
+#endif
 {
     // Set up the attributes of our mutex
     pthread_mutexattr_t attributes;
@@ -43,9 +46,25 @@ Nmutex::~Nmutex()
 
 void Nmutex::lock()
 {
+#ifdef NLIB_LOCK_PROFILING
+    // Only time the wait if there is one, so an uncontended lock costs no clock reads.
+    unsigned long long waitStart = 0;
+    int retVal = pthread_mutex_trylock( &m_mutex );
+    if ( retVal == EBUSY )
+        {
+        waitStart = NlockProfile::now();
+        retVal = pthread_mutex_lock( &m_mutex );
+        }
+#else
     int retVal = pthread_mutex_lock( &m_mutex );
+#endif
     if ( retVal )
         NERROR( retVal, "Nmutex::Nmutex: Can't lock mutex" );
+
+#ifdef NLIB_LOCK_PROFILING
+    m_profile.acquired( waitStart );
+    m_profile.held();
+#endif
 }
 
 
@@ -55,12 +74,23 @@ bool Nmutex::tryLock()
     if ( ( retVal > 0 ) && ( retVal != EBUSY ) )
         NERROR( retVal, "Nmutex::Nmutex: Can't trylock mutex" );
 
+#ifdef NLIB_LOCK_PROFILING
+    if ( retVal == 0 )
+        {
+        m_profile.acquired( 0 );
+        m_profile.held();
+        }
+#endif
+
     return ( retVal != EBUSY );
 }
 
 
 void Nmutex::unlock()
 {
+#ifdef NLIB_LOCK_PROFILING
+    m_profile.released();
+#endif
     int retVal = pthread_mutex_unlock( &m_mutex );
     if ( retVal )
         NERROR( retVal, "Nmutex::Nmutex: Can't unlock mutex" );
@@ -0,0 +1,154 @@
+// nparallel.cxx by Neil Cooper. See nparallel.h for documentation
+#include "nparallel.h"
+
+#include <atomic>
+#include <exception>  // for std::exception_ptr
+#include <memory>     // for std::shared_ptr
+#include <thread>     // for std::thread::hardware_concurrency()
+
+#include "nerror.h"
+#include "nevent.h"
+#include "nmutex.h"
+
+using namespace std;
+
+// When choosing chunk sizes automatically, make this many chunks per thread so that
+// threads finishing early can pick up work from slower ones.
+static const size_t CHUNKS_PER_THREAD = 4;
+
+namespace NPARALLEL
+{
+// State shared between the caller of forChunks() and its helper jobs. Helpers hold a
+// reference to it so that it outlives the last helper even after the caller has returned.
+struct JOB
+    {
+    JOB() : helperDone( true ), failed( false ) {}
+
+    Nparallel::CHUNK_PROC  chunkProc;
+    void*                  param;
+    size_t                 begin;
+    size_t                 end;
+    size_t                 grainSize;
+    size_t                 chunkCount;
+    atomic<size_t>         nextChunk;
+    Nevent                 helperDone;  // Counting event, one signal per finished helper
+    Nmutex                 errorOwner;
+    exception_ptr          error;
+    atomic<bool>           failed;
+    };
+
+typedef shared_ptr<JOB> JOB_REF;
+
+
+static size_t getThreadCount( NthreadPool& thePool )
+{
+    size_t threads = thread::hardware_concurrency();
+    if ( thePool.getPoolSize() > threads )
+        threads = thePool.getPoolSize();
+    return threads ? threads : 1;
+}
+
+
+static void runChunks( JOB& theJob )
+{
+    while ( !theJob.failed )
+        {
+        size_t chunk = theJob.nextChunk++;
+        if ( chunk >= theJob.chunkCount )
+            break;
+
+        size_t chunkBegin = theJob.begin + ( chunk * theJob.grainSize );
+        size_t chunkEnd = chunkBegin + theJob.grainSize;
+        if ( chunkEnd > theJob.end )
+            chunkEnd = theJob.end;
+
+        try
+            {
+            theJob.chunkProc( chunkBegin, chunkEnd, theJob.param );
+            }
+        catch( ... )
+            {
+            theJob.errorOwner.lock();
+            if ( !theJob.error )
+                theJob.error = current_exception();
+            theJob.errorOwner.unlock();
+            theJob.failed = true;
+            }
+        }
+}
+
+
+static void helperProc( void* theParam )
+{
+    JOB_REF* job = (JOB_REF*)theParam;
+    runChunks( **job );
+    (*job)->helperDone.signal();
+    delete job;
+}
+}
+
+
+size_t Nparallel::getChunkCount( NthreadPool& thePool, const size_t theLength, const size_t theGrainSize )
+{
+    if ( theGrainSize )
+        return ( theLength + theGrainSize - 1 ) / theGrainSize;
+
+    size_t chunks = NPARALLEL::getThreadCount( thePool ) * CHUNKS_PER_THREAD;
+    return ( chunks < theLength ) ? chunks : theLength;
+}
+
+
+void Nparallel::forChunks( NthreadPool& thePool,
+                           const size_t theBegin,
+                           const size_t theEnd,
+                           CHUNK_PROC   theChunkProc,
+                           void*        theParam,
+                           const size_t theGrainSize )
+{
+    if ( theEnd <= theBegin )
+        return;
+
+    size_t length = theEnd - theBegin;
+    size_t grainSize = theGrainSize;
+    if ( !grainSize )
+        {
+        size_t chunks = getChunkCount( thePool, length );
+        grainSize = ( length + chunks - 1 ) / chunks;
+        }
+
+    NPARALLEL::JOB_REF job( new NPARALLEL::JOB );
+    job->chunkProc = theChunkProc;
+    job->param = theParam;
+    job->begin = theBegin;
+    job->end = theEnd;
+    job->grainSize = grainSize;
+    job->chunkCount = ( length + grainSize - 1 ) / grainSize;
+    job->nextChunk = 0;
+
+    // The caller works too, so only ask for helpers for the remaining chunks. Stop asking as
+    // soon as the pool has no free thread, or the chunks have all been taken already.
+    size_t maxHelpers = NPARALLEL::getThreadCount( thePool );
+    if ( maxHelpers > job->chunkCount - 1 )
+        maxHelpers = job->chunkCount - 1;
+
+    size_t helpers = 0;
+    bool poolAvailable = true;
+
+    while ( poolAvailable && ( helpers < maxHelpers ) && ( job->nextChunk < job->chunkCount ) )
+        {
+        NPARALLEL::JOB_REF* helperRef = new NPARALLEL::JOB_REF( job );
+        poolAvailable = thePool.trySubmitJob( NPARALLEL::helperProc, helperRef );
+        if ( poolAvailable )
+            helpers++;
+        else
+            delete helperRef;
+        }
+
+    NPARALLEL::runChunks( *job );
+
+    for ( size_t i = 0; i < helpers; i++ )
+        job->helperDone.wait();
+
+    if ( job->error )
+        rethrow_exception( job->error );
+}
@@ -118,24 +118,10 @@ pid_t Nprocess::getPid( char* const theProcName )
 #ifndef __ANDROID__
 void Nprocess::setOurAffinity( const Nthread::CORE_AFFINITY allowedCores )
 {
-   unsigned long long flags = allowedCores.getAsInt();
-   if ( flags == 0 )
-      flags = Nthread::CORE_AFFINITY_ALL.getAsInt();
-   cpu_set_t cpus;
-   CPU_ZERO( &cpus );
-   unsigned short core = 0;
-
-   while ( flags )
-      {
-      if ( flags & 1 )
-         CPU_SET( core, &cpus );
-      flags = flags >> 1;
-      core++;
-      }
+    const Nthread::CORE_AFFINITY& cpus = allowedCores.isEmpty() ? Nthread::CORE_AFFINITY_ALL : allowedCores;
 
     pid_t ourPid = getpid();
-    int status = sched_setaffinity( ourPid, sizeof(cpu_set_t), &cpus);
-    if ( status )
-        NERROR( status, "Nprocess: Could not set affinity for our pid (", ourPid, ")" );
+    if ( sched_setaffinity( ourPid, cpus.getNativeSize(), cpus.getNative() ) )
+        EERROR( "Nprocess: Could not set affinity for our pid (", ourPid, ")" );
 }
 #endif
@@ -8,6 +8,7 @@
 
 #include "npsqlResult.h"
 #include "nerror.h"
+#include "nhistogram.h"
 #include "ntime.h"
 
 using namespace std;
@@ -50,7 +51,8 @@ Npsql::Npsql(   const char*       theDbName,
                 const bool        theHostIsAnIpNo ) : m_db( NULL ),
                                                       m_notices( NULL ),
                                                       m_initialised( false ),
-                                                      m_noticesEnabled( true )
+                                                      m_noticesEnabled( true ),
+                                                      m_histogram( NULL )
 {
     // Compose the parameters into a string for PQconnectdb()
     string params = "dbname=";
@@ -107,6 +109,7 @@ bool Npsql::query(  const char*   theQuery,
     if (!m_initialised)
         return false;
 
+    Ntimestamp start = m_histogram ? Ntimestamp::now() : Ntimestamp();
     PGresult* result = PQexec( m_db, theQuery );
 
     if ( theResults )
@@ -161,6 +164,9 @@ bool Npsql::query(  const char*   theQuery,
             }
         } while ( repeat );
 
+    if ( m_histogram )
+        m_histogram->recordElapsed( start );
+
     if ( !theResults )
         PQclear( result );
 
@@ -212,6 +218,12 @@ FILE* Npsql::getNoticeStream()
 }
 
 
+void Npsql::setLatencyHistogram( NconcurrentHistogram* theHistogram )
+{
+    m_histogram = theHistogram;
+}
+
+
 bool Npsql::waitForDb( string* theMessage )
 {
     // Wait until db is open or definately bad
@@ -0,0 +1,86 @@
+// nrwLock.cxx by Neil Cooper. See nrwLock.h for documentation
+#include "nrwLock.h"
+
+#include <errno.h>	// for EBUSY
+
+#include "nerror.h"	// for Nlib error handlers
+#include "ntime.h"	// for Sleep()
+
+// Some arbitrarary amount of time before we retry pthread_rwlock_destroy
+const unsigned long RWLOCK_DESTROY_FAIL_RETRY_DELAY_MS = 10;
+
+
+NrwLock::NrwLock()
+{
+    pthread_rwlockattr_t attributes;
+    int retVal = pthread_rwlockattr_init( &attributes );
+    if ( retVal )
+        NERROR( retVal, "NrwLock::NrwLock: Can't init lock attributes" );
+
+#if defined( __GLIBC__ )
+    // glibc prefers readers by default, which lets a busy set of readers starve writers.
+    retVal = pthread_rwlockattr_setkind_np( &attributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP );
+    if ( retVal )
+        NERROR( retVal, "NrwLock::NrwLock: Can't make lock prefer writers" );
+#endif
+
+    retVal = pthread_rwlock_init( &m_lock, &attributes );
+    if ( retVal )
+        NERROR( retVal, "NrwLock::NrwLock: Can't init lock" );
+
+    retVal = pthread_rwlockattr_destroy( &attributes );
+    if ( retVal )
+        NERROR( retVal, "NrwLock::NrwLock: Can't destroy lock attributes" );
+}
+
+
+NrwLock::~NrwLock()
+{
+    // We can't destroy a lock that is in use by another thread, so wait until we can.
+    while ( pthread_rwlock_destroy( &m_lock ) == EBUSY )
+        Ntime::sleep( RWLOCK_DESTROY_FAIL_RETRY_DELAY_MS );
+}
+
+
+void NrwLock::readLock()
+{
+    int retVal = pthread_rwlock_rdlock( &m_lock );
+    if ( retVal )
+        NERROR( retVal, "NrwLock::readLock: Can't lock for reading" );
+}
+
+
+bool NrwLock::tryReadLock()
+{
+    int retVal = pthread_rwlock_tryrdlock( &m_lock );
+    if ( retVal && ( retVal != EBUSY ) )
+        NERROR( retVal, "NrwLock::tryReadLock: Can't trylock for reading" );
+
+    return ( retVal == 0 );
+}
+
+
+void NrwLock::writeLock()
+{
+    int retVal = pthread_rwlock_wrlock( &m_lock );
+    if ( retVal )
+        NERROR( retVal, "NrwLock::writeLock: Can't lock for writing" );
+}
+
+
+bool NrwLock::tryWriteLock()
+{
+    int retVal = pthread_rwlock_trywrlock( &m_lock );
+    if ( retVal && ( retVal != EBUSY ) )
+        NERROR( retVal, "NrwLock::tryWriteLock: Can't trylock for writing" );
+
+    return ( retVal == 0 );
+}
+
+
+void NrwLock::unlock()
+{
+    int retVal = pthread_rwlock_unlock( &m_lock );
+    if ( retVal )
+        NERROR( retVal, "NrwLock::unlock: Can't unlock" );
+}
@@ -0,0 +1,551 @@
+// nscheduler.cxx by Neil Cooper. See nscheduler.h for documentation
+#include "nscheduler.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>      // for memset()
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "nerror.h"
+
+using namespace std;
+
+namespace NSCHEDULER
+{
+const unsigned long long NS_IN_1_SEC = 1000000000ULL;
+const unsigned long long NO_TICK = ~0ULL;
+
+unsigned long long toNs( const timespec& theTime )
+{
+    return ( theTime.tv_sec * NS_IN_1_SEC ) + theTime.tv_nsec;
+}
+}
+
+using namespace NSCHEDULER;
+
+
+Nscheduler::Nscheduler( NthreadPool&      thePool,
+                        const Ntime       theResolution,
+                        const std::string theName ) : m_pool( thePool ),
+                                                      m_resolutionNs( toNs( theResolution.getAsTimespec() ) ),
+                                                      m_currentTick( 0 ),
+                                                      m_armedTick( NO_TICK ),
+                                                      m_freeNodes( NULL ),
+                                                      m_owner( Nmutex::FAST, "Nscheduler" ),
+                                                      m_noneRunning( false, 1, true, "Nscheduler none running" ),
+                                                      m_timerFd( -1 ),
+                                                      m_stopFd( -1 ),
+                                                      m_thread( NULL )
+{
+    if ( !m_resolutionNs )
+        ERROR( "Nscheduler: Resolution must be more than 0" );
+
+    memset( &m_metrics, 0, sizeof( m_metrics ) );
+    memset( m_occupied, 0, sizeof( m_occupied ) );
+    memset( m_levelCount, 0, sizeof( m_levelCount ) );
+
+    for ( unsigned int level = 0; level < LEVELS; level++ )
+        for ( unsigned int slot = 0; slot < SLOTS; slot++ )
+            m_wheel[ level ][ slot ].prev = m_wheel[ level ][ slot ].next = &m_wheel[ level ][ slot ];
+
+    if ( clock_gettime( CLOCK_MONOTONIC, &m_start ) == -1 )
+        EERROR( "Nscheduler: Can't read monotonic clock" );
+
+    m_timerFd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+    if ( m_timerFd == -1 )
+        EERROR( "Nscheduler: Can't create timerfd" );
+
+    m_stopFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if ( m_stopFd == -1 )
+        {
+        close( m_timerFd );
+        EERROR( "Nscheduler: Can't create eventfd" );
+        }
+
+    m_thread = new Nthread( timerThreadProc, this, theName );
+}
+
+
+Nscheduler::~Nscheduler()
+{
+    uint64_t stop = 1;
+    if ( write( m_stopFd, &stop, sizeof( stop ) ) != sizeof( stop ) )
+        EWARN( "Nscheduler: Can't signal timer thread to stop" );
+
+    m_thread->getReturnValue();
+    delete m_thread;
+
+    // Nothing can be dispatched now, so once the wheel is emptied only runs already on the pool remain.
+    m_owner.lock();
+    for ( unsigned int level = 0; level < LEVELS; level++ )
+        for ( unsigned int slot = 0; slot < SLOTS; slot++ )
+            while ( m_wheel[ level ][ slot ].next != &m_wheel[ level ][ slot ] )
+                {
+                JOB_NODE* node = m_wheel[ level ][ slot ].next;
+                unlink( node );
+                node->cancelled = true;
+                }
+    m_owner.unlock();
+
+    m_noneRunning.wait();
+    m_owner.lock();    // Make sure the last run has finished with the lock before it goes
+    m_owner.unlock();
+
+    for ( size_t i = 0; i < m_blocks.size(); i++ )
+        delete [] m_blocks[i];
+
+    close( m_timerFd );
+    close( m_stopFd );
+}
+
+
+Nscheduler::JOB_ID Nscheduler::scheduleOnce( NthreadPool::THREAD_PROC        theJobProc,
+                                             void*                           theJobParam,
+                                             const Ntime                     theDelay,
+                                             const NthreadPool::JOB_PRIORITY thePriority )
+{
+    return schedule( theJobProc, theJobParam, toNs( theDelay.getAsTimespec() ), 0, thePriority );
+}
+
+
+Nscheduler::JOB_ID Nscheduler::schedulePeriodic( NthreadPool::THREAD_PROC        theJobProc,
+                                                 void*                           theJobParam,
+                                                 const Ntime                     thePeriod,
+                                                 const bool                      theRunNowFlag,
+                                                 const NthreadPool::JOB_PRIORITY thePriority )
+{
+    unsigned long long periodNs = toNs( thePeriod.getAsTimespec() );
+    unsigned long long periodTicks = ( periodNs + m_resolutionNs - 1 ) / m_resolutionNs;
+
+    if ( !periodTicks )
+        ERROR( "Nscheduler: Period must be more than 0" );
+
+    return schedule( theJobProc, theJobParam, theRunNowFlag ? 0 : periodNs, periodTicks, thePriority );
+}
+
+
+Nscheduler::JOB_ID Nscheduler::schedule( NthreadPool::THREAD_PROC        theJobProc,
+                                         void*                           theJobParam,
+                                         const unsigned long long        theDelayNs,
+                                         const unsigned long long        thePeriodTicks,
+                                         const NthreadPool::JOB_PRIORITY thePriority )
+{
+    if ( !theJobProc )
+        ERROR( "Nscheduler: No job procedure given" );
+
+    // Round up so the job never runs early.
+    unsigned long long expiry = ( getNowNs() + theDelayNs + m_resolutionNs - 1 ) / m_resolutionNs;
+
+    m_owner.lock();
+
+    JOB_NODE* node = allocNode();
+    node->proc = theJobProc;
+    node->param = theJobParam;
+    node->period = thePeriodTicks;
+    node->priority = thePriority;
+    node->expiry = ( expiry < m_currentTick ) ? m_currentTick : expiry;
+    insert( node );
+
+    m_metrics.scheduledJobs++;
+    m_metrics.jobsScheduled++;
+
+    // Wake the timer thread sooner if this job is now the first thing it needs to do.
+    unsigned long long next = nextEventTick();
+    if ( next < m_armedTick )
+        armTimer( next );
+
+    JOB_ID id = ( (JOB_ID)node->generation << 32 ) | node->index;
+
+    m_owner.unlock();
+    return id;
+}
+
+
+bool Nscheduler::cancel( const JOB_ID theJob )
+{
+    unsigned int index = (unsigned int)( theJob & 0xFFFFFFFF );
+    unsigned int generation = (unsigned int)( theJob >> 32 );
+    bool cancelled = false;
+
+    m_owner.lock();
+
+    if ( index < ( m_blocks.size() * NODES_PER_BLOCK ) )
+        {
+        JOB_NODE* node = &m_blocks[ index / NODES_PER_BLOCK ][ index % NODES_PER_BLOCK ];
+
+        // Only jobs in the wheel can run again. Periodic jobs are always put back before being dispatched.
+        if ( ( node->generation == generation ) && node->inWheel )
+            {
+            unlink( node );
+            node->cancelled = true;
+            m_metrics.scheduledJobs--;
+
+            if ( !node->running )  // Otherwise the run frees it when it finishes
+                freeNode( node );
+
+            cancelled = true;
+            }
+        }
+
+    m_owner.unlock();
+    return cancelled;
+}
+
+
+Nscheduler::SCHEDULER_METRICS Nscheduler::getMetrics()
+{
+    m_owner.lock();
+    SCHEDULER_METRICS metrics = m_metrics;
+    m_owner.unlock();
+    return metrics;
+}
+
+
+void* Nscheduler::timerThreadProc( void* theScheduler )
+{
+    ( (Nscheduler*)theScheduler )->runTimers();
+    return NULL;
+}
+
+
+void Nscheduler::runTimers()
+{
+    pollfd fds[2];
+    fds[0].fd = m_timerFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_stopFd;
+    fds[1].events = POLLIN;
+
+    std::vector< JOB_NODE* > due;
+
+    while ( true )
+        {
+        if ( poll( fds, 2, -1 ) == -1 )
+            {
+            if ( errno == EINTR )
+                continue;
+            EERROR( "Nscheduler: poll() failed" );
+            }
+
+        if ( fds[1].revents )
+            break;
+
+        uint64_t expirations;
+        if ( ( read( m_timerFd, &expirations, sizeof( expirations ) ) == -1 ) && ( errno != EAGAIN ) )
+            EERROR( "Nscheduler: Can't read timerfd" );
+
+        m_owner.lock();
+        m_metrics.wakeups++;
+        m_armedTick = NO_TICK;  // It has fired, so will need setting again even for the same tick
+        advance( getNowNs() / m_resolutionNs, due );
+        armTimer( nextEventTick() );
+        m_owner.unlock();
+
+        // Dispatch without the lock, as submitJob() may block and jobs take it when they finish.
+        for ( size_t i = 0; i < due.size(); i++ )
+            m_pool.submitJob( runJob, due[i], due[i]->priority );
+        due.clear();
+        }
+}
+
+
+void Nscheduler::runJob( void* theNode )
+{
+    JOB_NODE* node = (JOB_NODE*)theNode;
+    Nscheduler& us = *( node->scheduler );
+
+    us.m_owner.lock();
+    bool run = !node->cancelled;  // Cancelled between being dispatched and starting
+    us.m_owner.unlock();
+
+    if ( run )
+        node->proc( node->param );
+
+    us.m_owner.lock();
+    node->running = false;
+
+    if ( node->cancelled || !node->period )
+        us.freeNode( node );
+
+    if ( --us.m_metrics.runningJobs == 0 )
+        us.m_noneRunning.signal();
+    us.m_owner.unlock();
+}
+
+
+Nscheduler::JOB_NODE* Nscheduler::allocNode() // Caller must own m_owner
+{
+    if ( !m_freeNodes )
+        {
+        JOB_NODE* block = new JOB_NODE[ NODES_PER_BLOCK ];
+        unsigned int base = m_blocks.size() * NODES_PER_BLOCK;
+        m_blocks.push_back( block );
+
+        for ( unsigned int i = NODES_PER_BLOCK; i-- > 0; )
+            {
+            block[i].scheduler = this;
+            block[i].index = base + i;
+            block[i].generation = 1;
+            block[i].next = m_freeNodes;
+            m_freeNodes = &block[i];
+            }
+        }
+
+    JOB_NODE* node = m_freeNodes;
+    m_freeNodes = node->next;
+
+    node->inWheel = false;
+    node->running = false;
+    node->cancelled = false;
+    return node;
+}
+
+
+void Nscheduler::freeNode( JOB_NODE* theNode ) // Caller must own m_owner
+{
+    if ( ++theNode->generation == 0 )  // Keep JOB_IDs non-zero
+        theNode->generation = 1;
+
+    theNode->inWheel = false;
+    theNode->next = m_freeNodes;
+    m_freeNodes = theNode;
+}
+
+
+void Nscheduler::insert( JOB_NODE* theNode ) // Caller must own m_owner
+{
+    // Jobs are placed by how far off they are: level 0 holds the next 256 ticks one tick per
+    // slot, level 1 the next 65536 ticks 256 ticks per slot, and so on. Higher level slots are
+    // cascaded down a level as the wheel reaches them.
+    unsigned long long expiry = theNode->expiry;
+    unsigned long long distance = expiry - m_currentTick;  // Expiry is never before current tick
+    unsigned int level = 0;
+
+    while ( ( level < LEVELS - 1 ) && ( distance >= ( 1ULL << ( ( level + 1 ) * SLOT_BITS ) ) ) )
+        level++;
+
+    // Anything beyond the top level waits in the furthest top level slot and is cascaded
+    // (and put back there) until it comes into range.
+    if ( distance >= ( 1ULL << ( LEVELS * SLOT_BITS ) ) )
+        expiry = m_currentTick + ( 1ULL << ( LEVELS * SLOT_BITS ) ) - 1;
+
+    unsigned int slot = ( expiry >> ( level * SLOT_BITS ) ) & SLOT_MASK;
+    JOB_NODE& head = m_wheel[ level ][ slot ];
+
+    theNode->prev = head.prev;
+    theNode->next = &head;
+    head.prev->next = theNode;
+    head.prev = theNode;
+
+    theNode->slot = ( level * SLOTS ) + slot;
+    theNode->inWheel = true;
+    m_occupied[ level ][ slot / 64 ] |= 1ULL << ( slot % 64 );
+    m_levelCount[ level ]++;
+}
+
+
+void Nscheduler::unlink( JOB_NODE* theNode ) // Caller must own m_owner
+{
+    unsigned int level = theNode->slot / SLOTS;
+    unsigned int slot = theNode->slot % SLOTS;
+
+    theNode->prev->next = theNode->next;
+    theNode->next->prev = theNode->prev;
+    theNode->inWheel = false;
+
+    if ( m_wheel[ level ][ slot ].next == &m_wheel[ level ][ slot ] )
+        m_occupied[ level ][ slot / 64 ] &= ~( 1ULL << ( slot % 64 ) );
+    m_levelCount[ level ]--;
+}
+
+
+void Nscheduler::advance( const unsigned long long theNow, std::vector< JOB_NODE* >& theDue ) // Caller must own m_owner
+{
+    // Processes every tick up to and including theNow.
+    while ( m_currentTick <= theNow )
+        {
+        unsigned int lowest = 0;
+        while ( ( lowest < LEVELS ) && !m_levelCount[ lowest ] )
+            lowest++;
+
+        if ( lowest == LEVELS )  // Nothing scheduled
+            {
+            m_currentTick = theNow + 1;
+            break;
+            }
+
+        if ( lowest > 0 )
+            {
+            // Nothing can happen until the next tick that cascades the lowest occupied level.
+            unsigned long long mask = ( 1ULL << ( lowest * SLOT_BITS ) ) - 1;
+            unsigned long long boundary = ( m_currentTick + mask ) & ~mask;
+
+            if ( boundary > theNow )
+                {
+                m_currentTick = theNow + 1;
+                break;
+                }
+            m_currentTick = boundary;
+            }
+
+        // Each time a level's index wraps to 0, the next level's current slot moves down.
+        for ( unsigned int level = 1; level < LEVELS; level++ )
+            {
+            if ( ( m_currentTick >> ( ( level - 1 ) * SLOT_BITS ) ) & SLOT_MASK )
+                break;
+            cascade( level, ( m_currentTick >> ( level * SLOT_BITS ) ) & SLOT_MASK );
+            }
+
+        expire( m_currentTick & SLOT_MASK, theDue );
+        m_currentTick++;
+        }
+}
+
+
+void Nscheduler::cascade( const unsigned int theLevel, const unsigned int theSlot ) // Caller must own m_owner
+{
+    JOB_NODE& head = m_wheel[ theLevel ][ theSlot ];
+
+    // Detach the whole slot first, so nothing can be put back in it while we are emptying it.
+    std::vector< JOB_NODE* > cascaded;
+    while ( head.next != &head )
+        {
+        JOB_NODE* node = head.next;
+        unlink( node );
+        cascaded.push_back( node );
+        }
+
+    for ( size_t i = 0; i < cascaded.size(); i++ )
+        insert( cascaded[i] );
+}
+
+
+void Nscheduler::expire( const unsigned int theSlot, std::vector< JOB_NODE* >& theDue ) // Caller must own m_owner
+{
+    JOB_NODE& head = m_wheel[ 0 ][ theSlot ];
+
+    // Detach the whole slot first, as periodic jobs may be put straight back into the wheel.
+    std::vector< JOB_NODE* > expired;
+    while ( head.next != &head )
+        {
+        JOB_NODE* node = head.next;
+        unlink( node );
+        expired.push_back( node );
+        }
+
+    for ( size_t i = 0; i < expired.size(); i++ )
+        fire( expired[i], theDue );
+}
+
+
+void Nscheduler::fire( JOB_NODE* theNode, std::vector< JOB_NODE* >& theDue ) // Caller must own m_owner
+{
+    if ( theNode->period )
+        {
+        // Next run is a whole number of periods after the first, however late this one is.
+        theNode->expiry += theNode->period;
+        if ( theNode->expiry <= m_currentTick )
+            {
+            unsigned long long missed = ( ( m_currentTick - theNode->expiry ) / theNode->period ) + 1;
+            theNode->expiry += missed * theNode->period;
+            m_metrics.missedRuns += missed;
+            }
+        insert( theNode );
+        }
+    else
+        m_metrics.scheduledJobs--;
+
+    if ( theNode->running )
+        {
+        m_metrics.overruns++;
+        return;
+        }
+
+    theNode->running = true;
+    if ( m_metrics.runningJobs++ == 0 )
+        m_noneRunning.reset();
+    m_metrics.runsStarted++;
+    theDue.push_back( theNode );
+}
+
+
+unsigned int Nscheduler::nextOccupiedSlot( const unsigned int theLevel, const unsigned int theStart ) // Caller must own m_owner
+{
+    // Returns how many slots on from theStart the first occupied slot of theLevel is, wrapping
+    // round. theLevel must have at least one job.
+    for ( unsigned int i = 0; i <= SLOT_WORDS; i++ )
+        {
+        unsigned int word = ( ( theStart / 64 ) + i ) % SLOT_WORDS;
+        unsigned long long bits = m_occupied[ theLevel ][ word ];
+
+        if ( i == 0 )
+            bits &= ~0ULL << ( theStart % 64 );              // At or after theStart
+        else
+            if ( i == SLOT_WORDS )
+                bits &= ( 1ULL << ( theStart % 64 ) ) - 1;   // Wrapped back round to before theStart
+
+        if ( bits )
+            return ( ( word * 64 ) + __builtin_ctzll( bits ) - theStart ) & SLOT_MASK;
+        }
+
+    return 0;
+}
+
+
+unsigned long long Nscheduler::nextEventTick() // Caller must own m_owner
+{
+    // Level 0 slots expire as the wheel reaches them. A higher level slot needs cascading when
+    // the level below it wraps round to that slot.
+    unsigned long long next = NO_TICK;
+
+    if ( m_levelCount[0] )
+        next = m_currentTick + nextOccupiedSlot( 0, m_currentTick & SLOT_MASK );
+
+    for ( unsigned int level = 1; level < LEVELS; level++ )
+        if ( m_levelCount[ level ] )
+            {
+            unsigned long long mask = ( 1ULL << ( level * SLOT_BITS ) ) - 1;
+            unsigned long long boundary = ( m_currentTick + mask ) & ~mask;
+            unsigned int slot = ( boundary >> ( level * SLOT_BITS ) ) & SLOT_MASK;
+            unsigned long long tick = boundary + ( (unsigned long long)nextOccupiedSlot( level, slot ) << ( level * SLOT_BITS ) );
+
+            if ( tick < next )
+                next = tick;
+            }
+
+    return next;
+}
+
+
+void Nscheduler::armTimer( const unsigned long long theTick ) // Caller must own m_owner
+{
+    if ( theTick == m_armedTick )
+        return;
+
+    itimerspec setting;
+    memset( &setting, 0, sizeof( setting ) );  // All zero disarms it
+
+    if ( theTick != NO_TICK )
+        {
+        unsigned long long when = toNs( m_start ) + ( theTick * m_resolutionNs );
+        setting.it_value.tv_sec = when / NS_IN_1_SEC;
+        setting.it_value.tv_nsec = when % NS_IN_1_SEC;
+        }
+
+    if ( timerfd_settime( m_timerFd, TFD_TIMER_ABSTIME, &setting, NULL ) == -1 )
+        EERROR( "Nscheduler: Can't set timerfd" );
+
+    m_armedTick = theTick;
+}
+
+
+unsigned long long Nscheduler::getNowNs()
+{
+    // Time since tick 0
+    timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return toNs( now ) - toNs( m_start );
+}
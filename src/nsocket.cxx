@@ -12,6 +12,7 @@
 #include <errno.h>		// for errno
 
 #include "nerror.h"
+#include "nhistogram.h"
 
 using namespace std;
 
@@ -50,7 +51,9 @@ Nsocket::Nsocket(): m_status( CLOSED ),
                     m_socketReadBufferSize( 0 ),
                     m_autoBufferThread( NULL ),
                     m_threadDoneUpdate( true ), // true = make it manually resetting
-                    m_closePipeCreatedFlag( false )
+                    m_closePipeCreatedFlag( false ),
+                    m_readHistogram( NULL ),
+                    m_writeHistogram( NULL )
 {
 }
 
@@ -326,6 +329,7 @@ unsigned long Nsocket::read(    void*				theBuffer,
 {
     bool timedOut = false;
     unsigned long length = 0;     // the length we've read
+    Ntimestamp start = m_readHistogram ? Ntimestamp::now() : Ntimestamp();
 
     if ( m_status == LISTENING )  // Prevent misuse
         ERROR( "Nsocket::Read: Attempt to read from socket in listening state" );
@@ -395,6 +399,9 @@ unsigned long Nsocket::read(    void*				theBuffer,
     if ( theTimedOutFlag )
         *theTimedOutFlag = timedOut;
 
+    if ( m_readHistogram )
+        m_readHistogram->recordElapsed( start );
+
     return length;
 }
 
@@ -407,6 +414,7 @@ unsigned long Nsocket::write(   const void*         theBuffer,
 
     unsigned long totalWritten = 0;
     int bytesWritten = 0;
+    Ntimestamp start = m_writeHistogram ? Ntimestamp::now() : Ntimestamp();
 
     do
         {
@@ -425,6 +433,9 @@ unsigned long Nsocket::write(   const void*         theBuffer,
         }
         while ( ( totalWritten < theBufferLength ) && ( bytesWritten >= 0 ) );    // bytesRead < 0 == network error
 
+    if ( m_writeHistogram )
+        m_writeHistogram->recordElapsed( start );
+
     return totalWritten;
 }
 
@@ -462,7 +473,7 @@ void Nsocket::closeSocket()
         if ( m_socketReadBuffer )
             {
             m_socketReadbufferOwner.lock();
-            delete m_socketReadBuffer;
+            delete[] m_socketReadBuffer;
             m_socketReadBuffer = NULL;
             m_socketReadbufferOwner.unlock();
             }
@@ -539,7 +550,25 @@ void Nsocket::waitForSocketEvent( bool* theTimedOutFlag, const Ntime theTimeout
         if ( m_autoBufferThread )
             timedOut = !m_threadDoneUpdate.wait( theTimeout );
         else
-            waitForRawSocketEvent( &timedOut, theTimeout );
+            waitForRawSocketEvent( &timedOut, Ndeadline( theTimeout ) );
+
+    if ( theTimedOutFlag )
+        *theTimedOutFlag = timedOut;
+}
+
+
+void Nsocket::waitForSocketEvent( bool* theTimedOutFlag, const Ntime theTimeout, const NstopToken& theStopToken )
+{
+    if ( m_status == CLOSED )
+        ERROR( "Nsocket::WaitForSocketEvent: Socket is in closed state." );
+
+    bool timedOut = false;
+
+    if ( m_readBuffer.size() == 0 ) // only block if we dont have buffered data to read
+        if ( m_autoBufferThread )
+            timedOut = !m_threadDoneUpdate.wait( theTimeout, theStopToken ) && !theStopToken.stopRequested();
+        else
+            waitForRawSocketEvent( &timedOut, Ndeadline( theTimeout ), &theStopToken );
 
     if ( theTimedOutFlag )
         *theTimedOutFlag = timedOut;
@@ -614,6 +643,13 @@ unsigned long Nsocket::getBufferedDataLength()
 }
 
 
+void Nsocket::setLatencyHistograms( NconcurrentHistogram* theReadHistogram, NconcurrentHistogram* theWriteHistogram )
+{
+    m_readHistogram = theReadHistogram;
+    m_writeHistogram = theWriteHistogram;
+}
+
+
 // ---------- PRIVATE METHODS --------------
 
 void* Nsocket::autoBufferProc( void* theParam )
@@ -653,7 +689,7 @@ void Nsocket::rawRead(  void*			    theBuffer,
             ( !theJustReadAvailableFlag || socketDataAvailable() ) )
         {
         if ( !( theJustReadAvailableFlag || socketDataAvailable() ) )
-            waitForRawSocketEvent( &timedOut, theTimeout );
+            waitForRawSocketEvent( &timedOut, Ndeadline( theTimeout ) );
 
         long readLength = 0;
         if ( !timedOut )
@@ -718,8 +754,6 @@ void Nsocket::createSocketReadBuffer()
         }
 
     m_socketReadBuffer = new char[ m_socketReadBufferSize ];
-    if ( !m_socketReadBuffer )
-        EERROR( "Nsocket::CreateSocketReadBuffer: Can't create socket read buffer" );
 
     m_socketReadbufferOwner.unlock();
 }
@@ -727,12 +761,12 @@ void Nsocket::createSocketReadBuffer()
 
 // Wait for socket event from socket itself.
 // NB:  It doesn't differentiate between remote end closing and data arriving
-void Nsocket::waitForRawSocketEvent( bool* theTimedOutFlag, const Ntime theTimeout )
+void Nsocket::waitForRawSocketEvent( bool* theTimedOutFlag, const Ndeadline& theDeadline, const NstopToken* theStopToken )
 {
     if ( !m_closePipeCreatedFlag )
         createClosePipe();
 
-    struct pollfd ufds[2];
+    struct pollfd ufds[3];
 
     ufds[0].fd = m_socket;
     ufds[0].events = POLLIN | POLLPRI;
@@ -741,17 +775,22 @@ void Nsocket::waitForRawSocketEvent( bool* theTimedOutFlag, const Ntime theTimeo
     ufds[1].events = POLLIN | POLLPRI;
     ufds[1].revents = 0;
 
-    long long timeout = theTimeout.getAsMs();
-    if ( timeout > INT_MAX )
-        timeout = INT_MAX;    // Best we can do. Its still a long wait :-)
-
-    if (timeout == 0 )
-        timeout = -1;
+    // A stop token's eventfd becomes readable when a stop is requested, and stays that way.
+    nfds_t fds = 2;
+    if ( theStopToken )
+        {
+        ufds[2].fd = theStopToken->getEvent().getFd();
+        ufds[2].events = POLLIN;
+        ufds[2].revents = 0;
+        fds = 3;
+        }
 
+    // Retries after signals only wait for what is left of the timeout.
+    // (Remaining time is capped at INT_MAX ms, but that's still a long wait :-)
     int retVal = 0;
     do
         {
-        retVal = poll( ufds, 2, timeout );
+        retVal = poll( ufds, fds, theDeadline.getRemainingMs() );
         } while ( ( retVal == -1 ) && ( errno == EINTR ) ); // ignore failures because of signals
 
     if ( retVal == -1 )
@@ -778,7 +817,7 @@ void Nsocket::updateReadBuffer( const bool theWaitForDataFlag, const Ntime& theT
     if ( theWaitForDataFlag )
         while ( ( m_status == CONNECTED ) && ( !length ) && ( !timedOut ) )
             {
-            waitForRawSocketEvent( &timedOut, theTimeout );
+            waitForRawSocketEvent( &timedOut, Ndeadline( theTimeout ) );
             rawRead( m_socketReadBuffer, m_socketReadBufferSize, &length, true );
             }
     else
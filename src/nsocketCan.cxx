@@ -138,6 +138,16 @@ void NsocketCan::tx( const CAN_DATA      data,
 
 
 NsocketCan::CAN_ID NsocketCan::rx( CAN_DATA& data )
+{
+    uint8_t received[ MAX_DATA_LENGTH ];
+    size_t length;
+    CAN_ID id = rx( received, length );
+    data.assign( received, received + length );
+    return id;
+}
+
+
+NsocketCan::CAN_ID NsocketCan::rx( uint8_t* data, size_t& length )
 {
     struct can_frame frame;
     size_t frameSize = sizeof( frame );
@@ -152,9 +162,8 @@ NsocketCan::CAN_ID NsocketCan::rx( CAN_DATA& data )
     if ( (size_t)readLen != frameSize )
         ERROR("Read from CAN device ", m_device, " was short: (", readLen, " bytes instead of ", frameSize, ")" );
 
-    data.clear();
-    for ( size_t i = 0; i < frame.can_dlc; i++ )
-        data.push_back( frame.data[i] );
+    length = ( frame.can_dlc < MAX_DATA_LENGTH ) ? frame.can_dlc : MAX_DATA_LENGTH;
+    memcpy( data, frame.data, length );
 
     return frame.can_id;
 }
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include "nerror.h"
+#include "nhistogram.h"
 #include "ntime.h"
 
 using namespace std;
@@ -10,7 +11,7 @@ using namespace std;
 
 static const Ntime BUSY_RETRY_DELAY_MS = 1;
 
-Nsqlite::Nsqlite( const char* theDbFile )
+Nsqlite::Nsqlite( const char* theDbFile ) : m_histogram( NULL )
 {
     if ( sqlite3_open( theDbFile, &m_db ) != SQLITE_OK )
         {
@@ -41,6 +42,7 @@ bool Nsqlite::query(  const char*     theQuery,
 {
     char* errMsg = NULL;
     int status;
+    Ntimestamp start = m_histogram ? Ntimestamp::now() : Ntimestamp();
 
     if ( theResults )
         theResults->clear();
@@ -57,6 +59,9 @@ bool Nsqlite::query(  const char*     theQuery,
 
         } while ( status == SQLITE_BUSY );
 
+    if ( m_histogram )
+        m_histogram->recordElapsed( start );
+
     if ( theResults )
         theResults->setRowsAffectedCount( sqlite3_changes( m_db ) );
 
@@ -80,3 +85,8 @@ bool Nsqlite::query(  const char*     theQuery,
     return ( status ==  SQLITE_OK );
     }
 
+
+void Nsqlite::setLatencyHistogram( NconcurrentHistogram* theHistogram )
+{
+    m_histogram = theHistogram;
+}
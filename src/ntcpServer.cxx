@@ -5,13 +5,16 @@
 
 using namespace std;
 
+static const size_t GARBAGE_COLLECTOR_STACK_SIZE = 128 * 1024;
+
 
 NtcpServer::NtcpServer( NTCPSERVER_THREAD_PROC  theClientProcess,
                         const unsigned short    thePort,
                         const char*             theIpAddress,
-                        void*                   theUserParam )
+                        void*                   theUserParam,
+                        const Nthread::THREAD_ATTRIBUTES& theClientThreadAttributes )
 {
-   start( theClientProcess, thePort, theIpAddress, theUserParam );
+   start( theClientProcess, thePort, theIpAddress, theUserParam, theClientThreadAttributes );
 }
 
 
@@ -45,7 +48,7 @@ void NtcpServer::safeGarbageCollector( void* theParam )
 				// Wait for thread to terminate
             us.m_clientList[i]->clientThread->getReturnValue();
 				delete us.m_clientList[i]->clientThread;
-				delete us.m_clientList[i];
+				us.m_contextPool.destroy( us.m_clientList[i] );
 				us.m_clientList.erase( us.m_clientList.begin() + i );
 				}
 			}
@@ -88,18 +91,28 @@ void* NtcpServer::clientThread( void* theParam )
 void NtcpServer::start( NTCPSERVER_THREAD_PROC  theClientProcess,
                         const unsigned short    thePort,
                         const char*             theIpAddress,
-                        void*                   theUserParam      )
+                        void*                   theUserParam,
+                        const Nthread::THREAD_ATTRIBUTES& theClientThreadAttributes )
 {
+	// Every client thread is created with these, and they can't share one stack.
+	if ( theClientThreadAttributes.stack )
+		ERROR( "NtcpServer: Client threads can't be given a caller-owned stack" );
+
 	m_serverSocket.listen( thePort, theIpAddress );
   	m_clientProcess = theClientProcess;
-	m_garbageCollector = new Nthread( garbageCollector, this );
+	m_clientThreadAttributes = theClientThreadAttributes;
+
+	// The garbage collector only joins and deletes, so doesn't need a full size stack.
+	Nthread::THREAD_ATTRIBUTES collectorAttributes;
+	collectorAttributes.stackSize = GARBAGE_COLLECTOR_STACK_SIZE;
+	m_garbageCollector = new Nthread( garbageCollector, this, collectorAttributes );
 
 	do
 		{
 		m_serverSocket.waitForSocketEvent();
 		if ( m_serverSocket.acceptIsAvailable() )
 			{
-			THREAD_CONTEXT* context = new THREAD_CONTEXT;
+			THREAD_CONTEXT* context = m_contextPool.create();
 			context->imDoneFlag = false;
 			context->params.userParam = theUserParam;
 			context->us = this; // used by static methods for member access
@@ -123,7 +136,7 @@ void NtcpServer::start( NTCPSERVER_THREAD_PROC  theClientProcess,
 			m_clientListOwner.lock();
 			// Create the thread inside the lock so that it can't delete itself from
 			// the client list before it has been added because the list is locked.
-			context->clientThread = new Nthread( clientThread, context  );
+			context->clientThread = new Nthread( clientThread, context, m_clientThreadAttributes );
 			m_clientList.push_back( context );
 			m_clientListOwner.unlock();
 			}
@@ -3,13 +3,17 @@
 
 #include <errno.h>    // for ESRCH
 #include <sched.h>
+#include <stdlib.h>   // for strtoull()
+#include <string.h>   // for memset()
+#include <time.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/mman.h>
 
-#include <thread>
+#include <fstream>
 #include <sstream>
 
 #include "nerror.h"
@@ -18,10 +22,52 @@
 using namespace std;
 
 #ifndef __ANDROID__
-const Nthread::CORE_AFFINITY Nthread::CORE_AFFINITY_ALL = "0b" + string( std::thread::hardware_concurrency(), '1' );
+const Nthread::CORE_AFFINITY Nthread::CORE_AFFINITY_ALL = NcpuSet::all();
 #endif
 
-static const Ntime DEATH_WAIT_TIME_MS( 1000 );   // Time (in ms) we allow thread to terminate
+namespace NTHREAD
+{
+const Ntime     DEATH_WAIT_TIME_MS( 1000 );   // Time (in ms) we allow thread to terminate
+const size_t    HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+const size_t    MAX_NAME_LENGTH = 15;         // Linux limit, not including the terminator
+
+inline size_t roundUp( const size_t theSize, const size_t theMultiple )
+{
+    return ( ( theSize + theMultiple - 1 ) / theMultiple ) * theMultiple;
+}
+
+int getPolicy( const Nthread::SCHEDULING_MODEL theModel, int& thePriority )
+{
+    switch( theModel )
+        {
+        case Nthread::DEFAULT:
+            thePriority = 0;  // pthread_setschedparam requires this to be 0 for this model
+            return SCHED_OTHER;
+
+        case Nthread::BATCH:
+            thePriority = 0;  // pthread_setschedparam requires this to be 0 for this model
+            return SCHED_BATCH;
+
+        case Nthread::IDLE:
+            thePriority = 0;  // pthread_setschedparam requires this to be 0 for this model
+            return SCHED_IDLE;
+
+        case Nthread::FIFO:
+            return SCHED_FIFO;
+
+        case Nthread::ROUND_ROBIN:
+            return SCHED_RR;
+
+        case Nthread::DEADLINE:
+            return SCHED_DEADLINE;
+
+        default:
+            ERROR( "Nthread: Unknown scheduling model: ", theModel );
+      }
+    return SCHED_OTHER;
+}
+}
+using namespace NTHREAD;
 
 
 void* Nthread::getTidAndCall( void* theParams )
@@ -32,9 +78,27 @@ void* Nthread::getTidAndCall( void* theParams )
     if ( tid == -1 )
         EERROR("Nthread: syscall(SYS_gettid) failed.");
 
+    // Name ourselves, so the name is in place before anything can see the thread run.
+    if ( params->name[0] )
+        {
+        int status = pthread_setname_np( pthread_self(), params->name );
+        if ( status )
+            NWARN( status, "Nthread: pthread_setname_np() failed." );
+        }
+
+    if ( params->policy != -1 )
+        {
+        struct sched_param param;
+        param.sched_priority = params->priority;
+        int status = pthread_setschedparam( pthread_self(), params->policy, &param );
+        if ( status )
+            NWARN( status, "Nthread: pthread_setschedparam() failed." );
+        }
+
     *(params->tid) = tid;
     params->tidGot->signal();
-    void* retVal = params->threadProc( params->threadParams );
+    void* retVal = params->stoppableProc ? params->stoppableProc( *params->stopToken, params->threadParams )
+                                         : params->threadProc( params->threadParams );
     return retVal;
 }
 
@@ -42,31 +106,135 @@ void* Nthread::getTidAndCall( void* theParams )
 Nthread::Nthread( NTHREAD_THREAD_PROC  theProcess,
                   void*                theParameter,
                   const string         theName,
-                  const bool           theCreateDetachedFlag ) :  m_created( false ),
-                                                                  m_detached( theCreateDetachedFlag ),
-                                                                  m_joined( false ),
-                                                                  m_tidGot( false, 0, true )
+                  const bool           theCreateDetachedFlag ) : Nthread( theProcess, theParameter, THREAD_ATTRIBUTES(),
+                                                                          theName, theCreateDetachedFlag )
+{
+}
+
+
+Nthread::Nthread( NTHREAD_THREAD_PROC      theProcess,
+                  void*                    theParameter,
+                  const THREAD_ATTRIBUTES& theAttributes,
+                  const string             theName,
+                  const bool               theCreateDetachedFlag ) : Nthread( theProcess, NULL, theParameter, theAttributes,
+                                                                              theName, theCreateDetachedFlag )
+{
+}
+
+
+Nthread::Nthread( NTHREAD_STOPPABLE_PROC   theProcess,
+                  void*                    theParameter,
+                  const string             theName,
+                  const bool               theCreateDetachedFlag ) : Nthread( NULL, theProcess, theParameter, THREAD_ATTRIBUTES(),
+                                                                              theName, theCreateDetachedFlag )
+{
+}
+
 
+Nthread::Nthread( NTHREAD_STOPPABLE_PROC   theProcess,
+                  void*                    theParameter,
+                  const THREAD_ATTRIBUTES& theAttributes,
+                  const string             theName,
+                  const bool               theCreateDetachedFlag ) : Nthread( NULL, theProcess, theParameter, theAttributes,
+                                                                              theName, theCreateDetachedFlag )
 {
+}
+
+
+Nthread::Nthread( NTHREAD_THREAD_PROC      theProcess,
+                  NTHREAD_STOPPABLE_PROC   theStoppableProcess,
+                  void*                    theParameter,
+                  const THREAD_ATTRIBUTES& theAttributes,
+                  const string             theName,
+                  const bool               theCreateDetachedFlag ) :  m_name( theName ),
+                                                                      m_stack( NULL ),
+                                                                      m_stackMapSize( 0 ),
+                                                                      m_created( false ),
+                                                                      m_detached( theCreateDetachedFlag ),
+                                                                      m_joined( false ),
+                                                                      m_tidGot( false, 0, true )
+
+{
+    // The thread names itself, so catch names it can't have here where we can still throw.
+    if ( m_name.length() > MAX_NAME_LENGTH )
+        ERROR( "Nthread::Nthread: Thread name '", m_name, "' is longer than ", MAX_NAME_LENGTH, " characters" );
+
+    if ( theAttributes.hugePageStack && m_detached )
+        ERROR( "Nthread::Nthread: A hugePageStack can't be used with a detached thread" );
+
     pthread_attr_t  attributes;
 
     int status = pthread_attr_init( &attributes );
     if ( status )
         NERROR( status, "Nthread::Nthread Can't set default thread attributes" );
 
-    status = pthread_attr_setdetachstate( &attributes, m_detached );
-    if ( status )
-        NERROR( status, "Nthread::Nthread Can't set Detach state" );
+    try
+        {
+        status = pthread_attr_setdetachstate( &attributes, m_detached );
+        if ( status )
+            NERROR( status, "Nthread::Nthread Can't set Detach state" );
 
-    m_callerParams.threadProc = theProcess;
-    m_callerParams.threadParams = theParameter;
-    m_callerParams.tid = &m_tid;
-    m_callerParams.tidGot = &m_tidGot;
+        setStack( attributes, theAttributes );
 
-    status = pthread_create( &m_threadId, &attributes, getTidAndCall, (void*)&m_callerParams );
+#ifndef __ANDROID__
+        if ( !theAttributes.affinity.isEmpty() )
+            {
+            status = pthread_attr_setaffinity_np( &attributes, theAttributes.affinity.getNativeSize(),
+                                                  theAttributes.affinity.getNative() );
+            if ( status )
+                NERROR( status, "Nthread::Nthread Can't set thread affinity" );
+            }
+#endif
 
-    if ( status )
-        NERROR( status, "Nthread::Nthread pthread_create() failed." );
+        m_callerParams.policy = -1;
+        if ( ( theAttributes.schedulingModel != DEFAULT ) || theAttributes.schedulingPriority )
+            {
+            struct sched_param param;
+            param.sched_priority = theAttributes.schedulingPriority;
+            int policy = getPolicy( theAttributes.schedulingModel, param.sched_priority );
+
+            if ( ( policy == SCHED_OTHER ) || ( policy == SCHED_FIFO ) || ( policy == SCHED_RR ) )
+                {
+                status = pthread_attr_setinheritsched( &attributes, PTHREAD_EXPLICIT_SCHED );
+                if ( status )
+                    NERROR( status, "Nthread::Nthread Can't set explicit scheduling" );
+
+                status = pthread_attr_setschedpolicy( &attributes, policy );
+                if ( status )
+                    NERROR( status, "Nthread::Nthread Can't set scheduling model" );
+
+                status = pthread_attr_setschedparam( &attributes, &param );
+                if ( status )
+                    NERROR( status, "Nthread::Nthread Can't set scheduling priority" );
+                }
+            else
+                {
+                // pthread attributes can't carry the other models, so the thread sets its own
+                // before the thread process runs.
+                m_callerParams.policy = policy;
+                m_callerParams.priority = param.sched_priority;
+                }
+            }
+
+        m_callerParams.threadProc = theProcess;
+        m_callerParams.stoppableProc = theStoppableProcess;
+        m_callerParams.stopToken = &m_stopToken;
+        m_callerParams.threadParams = theParameter;
+        m_callerParams.tid = &m_tid;
+        m_callerParams.tidGot = &m_tidGot;
+        m_callerParams.name = m_name.c_str();
+
+        status = pthread_create( &m_threadId, &attributes, getTidAndCall, (void*)&m_callerParams );
+
+        if ( status )
+            NERROR( status, "Nthread::Nthread pthread_create() failed." );
+        }
+    catch ( ... )
+        {
+        pthread_attr_destroy( &attributes );
+        freeStack();
+        throw;
+        }
 
     m_created = true;
 
@@ -76,12 +244,6 @@ Nthread::Nthread( NTHREAD_THREAD_PROC  theProcess,
       NERROR( status, "Nthread::Nthread pthread_setcanceltype() failed." );
 */
 
-    if ( theName.length() )
-        status = pthread_setname_np( m_threadId, theName.c_str() );
-
-    if ( status )
-        NERROR( status, "Nthread::Nthread pthread_setname_np() failed." );
-
     // Destroy the attributes. Only for portability/future-proofing,
     // ( currently does nothing in Linux Pthreads ).
     status = pthread_attr_destroy( &attributes );
@@ -90,10 +252,88 @@ Nthread::Nthread( NTHREAD_THREAD_PROC  theProcess,
 }
 
 
+void Nthread::setStack( pthread_attr_t& theAttributes, const THREAD_ATTRIBUTES& theRequested )
+{
+    int status = 0;
+
+    if ( theRequested.hugePageStack )
+        {
+        // Map the stack 2MB aligned so that the kernel can back it with huge pages, with the guard
+        // (if any) just below it. Reserve an extra 2MB to align in, then give back what isn't used.
+        size_t pageSize = sysconf( _SC_PAGESIZE );
+        size_t stackSize = roundUp( theRequested.stackSize ? theRequested.stackSize : HUGE_PAGE_SIZE, HUGE_PAGE_SIZE );
+        size_t guardSize = roundUp( ( theRequested.guardSize == SYSTEM_DEFAULT ) ? pageSize : theRequested.guardSize, pageSize );
+        size_t reserved = guardSize + stackSize + HUGE_PAGE_SIZE;
+
+        char* base = (char*)mmap( NULL, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0 );
+        if ( base == MAP_FAILED )
+            EERROR( "Nthread::Nthread Can't map a ", stackSize, " byte stack" );
+
+        char* stack = (char*)roundUp( (size_t)( base + guardSize ), HUGE_PAGE_SIZE );
+        char* start = stack - guardSize;
+        char* end = stack + stackSize;
+        if ( start > base )
+            munmap( base, start - base );
+        if ( base + reserved > end )
+            munmap( end, ( base + reserved ) - end );
+        m_stack = start;
+        m_stackMapSize = guardSize + stackSize;
+
+        if ( guardSize && mprotect( start, guardSize, PROT_NONE ) )
+            EERROR( "Nthread::Nthread Can't protect the stack guard" );
+
+#ifdef MADV_HUGEPAGE
+        // Only a hint: fails harmlessly where transparent huge pages aren't available.
+        madvise( stack, stackSize, MADV_HUGEPAGE );
+#endif
+        status = pthread_attr_setstack( &theAttributes, stack, stackSize );
+        if ( status )
+            NERROR( status, "Nthread::Nthread Can't set thread stack" );
+        }
+    else if ( theRequested.stack )
+        {
+        status = pthread_attr_setstack( &theAttributes, theRequested.stack, theRequested.stackSize );
+        if ( status )
+            NERROR( status, "Nthread::Nthread Can't set thread stack" );
+        }
+    else
+        {
+        if ( theRequested.stackSize )
+            {
+            status = pthread_attr_setstacksize( &theAttributes, theRequested.stackSize );
+            if ( status )
+                NERROR( status, "Nthread::Nthread Can't set stack size to ", theRequested.stackSize );
+            }
+
+        if ( theRequested.guardSize != SYSTEM_DEFAULT )
+            {
+            status = pthread_attr_setguardsize( &theAttributes, theRequested.guardSize );
+            if ( status )
+                NERROR( status, "Nthread::Nthread Can't set guard size to ", theRequested.guardSize );
+            }
+        }
+}
+
+
+void Nthread::freeStack()
+{
+    if ( m_stack )
+        {
+        if ( munmap( m_stack, m_stackMapSize ) )
+            EWARN( "Nthread: Can't unmap thread stack" );
+        m_stack = NULL;
+        }
+}
+
+
 Nthread::~Nthread()
 {
     if ( m_created )
         killThread();
+
+    // A thread that couldn't be joined may still be running on its stack, so that has to leak.
+    if ( m_joined )
+        freeStack();
 }
 
 
@@ -148,22 +388,9 @@ int Nthread::getSchedulingPriority()
 #ifndef __ANDROID__
 void Nthread::setThreadAffinity( const CORE_AFFINITY allowedCores )
 {
-    unsigned long long flags = allowedCores.getAsInt();
-    if ( flags == 0 )
-        flags = CORE_AFFINITY_ALL.getAsInt();
-    cpu_set_t cpus;
-    CPU_ZERO( &cpus );
-    unsigned short core = 0;
-
-    while ( flags )
-        {
-        if ( flags & 1 )
-            CPU_SET( core, &cpus );
-        flags = flags >> 1;
-        core++;
-        }
+    const CORE_AFFINITY& cpus = allowedCores.isEmpty() ? CORE_AFFINITY_ALL : allowedCores;
 
-    int status = pthread_setaffinity_np( m_threadId, sizeof(cpu_set_t), &cpus);
+    int status = pthread_setaffinity_np( m_threadId, cpus.getNativeSize(), cpus.getNative() );
     if ( status )
         NERROR( status, "Nthread: Could not set thread affinity" );
 }
@@ -171,68 +398,27 @@ void Nthread::setThreadAffinity( const CORE_AFFINITY allowedCores )
 
 Nthread::CORE_AFFINITY Nthread::getThreadAffinity()
 {
-    cpu_set_t cpus;
-    CPU_ZERO( &cpus );
+    CORE_AFFINITY cpus;
+
+    // The kernel rejects a set smaller than its own, which may be bigger than the configured CPUs.
+    unsigned int size = NcpuSet::getCpuCount();
+    int status;
+    while ( ( ( status = pthread_getaffinity_np( m_threadId, CPU_ALLOC_SIZE( size ), cpus.prepareNative( size ) ) ) == EINVAL ) &&
+            ( size <= 1024 * 1024 ) )
+        size *= 2;
 
-    int status = pthread_getaffinity_np( m_threadId, sizeof(cpu_set_t), &cpus);
     if ( status )
         NERROR( status, "Nthread: Could not get thread affinity" );
 
-    ostringstream cores;
-
-   int core = CPU_SETSIZE;
-
-    while ( core > 0 )
-        {
-        core--;
-        cores << ( CPU_ISSET( core, &cpus ) ? "1" : "0" );
-        }
-
-    CORE_AFFINITY retVal;
-    retVal.setByBinary( cores.str() );
-
-    return retVal;
+    return cpus;
 }
 #endif
 
 
 void Nthread::setSchedulingModel( const SCHEDULING_MODEL theModel, const int thePriority  )
 {
-    int policy = 0;
     int priority = thePriority;
-
-    switch( theModel )
-        {
-        case DEFAULT:
-            policy = SCHED_OTHER;
-            priority = 0;  // pthread_setschedparam requires this to be 0 for this model
-            break;
-
-        case BATCH:
-            policy = SCHED_BATCH;
-            priority = 0;  // pthread_setschedparam requires this to be 0 for this model
-            break;
-
-        case IDLE:
-            policy = SCHED_IDLE;
-            priority = 0;  // pthread_setschedparam requires this to be 0 for this model
-            break;
-
-        case FIFO:
-            policy = SCHED_FIFO;
-            break;
-
-        case ROUND_ROBIN:
-            policy = SCHED_RR;
-            break;
-
-        case DEADLINE:
-            policy = SCHED_DEADLINE;
-            break;
-
-        default:
-            ERROR( "Nthread::setSchedulingModel: Unknown scheduling model: ", theModel );
-      }
+    int policy = getPolicy( theModel, priority );
 
     struct sched_param param;
     param.sched_priority = priority;
@@ -287,6 +473,61 @@ Nthread::SCHEDULING_MODEL Nthread::getSchedulingModel()
 }
 
 
+Nthread::THREAD_STATS Nthread::getStats()
+{
+    THREAD_STATS stats;
+    memset( &stats, 0, sizeof( stats ) );
+
+    clockid_t clock;
+    int status = pthread_getcpuclockid( m_threadId, &clock );
+    if ( status )
+        NERROR( status, "Nthread::getStats: pthread_getcpuclockid() failed" );
+
+    struct timespec cpuTime;
+    if ( clock_gettime( clock, &cpuTime ) )
+        EERROR( "Nthread::getStats: clock_gettime() failed" );
+    stats.cpuTimeNs = ( cpuTime.tv_sec * 1000000000ULL ) + cpuTime.tv_nsec;
+
+    ostringstream task;
+    task << "/proc/self/task/" << getTid() << "/";
+
+    ifstream statusFile( task.str() + "status" );
+    if ( !statusFile )
+        ERROR( "Nthread::getStats: Can't open ", task.str(), "status" );
+    string line;
+    while ( getline( statusFile, line ) )
+        {
+        if ( line.compare( 0, 24, "voluntary_ctxt_switches:" ) == 0 )
+            stats.voluntarySwitches = strtoull( line.c_str() + 24, NULL, 10 );
+        else if ( line.compare( 0, 27, "nonvoluntary_ctxt_switches:" ) == 0 )
+            stats.involuntarySwitches = strtoull( line.c_str() + 27, NULL, 10 );
+        }
+
+    // The CPU is the 39th field of stat. Count from the end of the name, which may contain spaces.
+    ifstream stat( task.str() + "stat" );
+    if ( !getline( stat, line ) || ( line.rfind( ')' ) == string::npos ) )
+        ERROR( "Nthread::getStats: Can't read ", task.str(), "stat" );
+    istringstream fields( line.substr( line.rfind( ')' ) + 1 ) );
+    string field;
+    for ( int i = 3; ( i <= 39 ) && ( fields >> field ); i++ )
+        if ( i == 39 )
+            stats.lastCpu = atoi( field.c_str() );
+
+    // Only there if the kernel has scheduler debugging.
+    ifstream sched( task.str() + "sched" );
+    while ( getline( sched, line ) )
+        if ( line.compare( 0, 16, "se.nr_migrations" ) == 0 )
+            {
+            size_t colon = line.find( ':' );
+            if ( colon != string::npos )
+                stats.migrations = strtoull( line.c_str() + colon + 1, NULL, 10 );
+            break;
+            }
+
+    return stats;
+}
+
+
 void Nthread::getReturnValue( void** theReturnParam )
 {
     // Can't get return value for detached threads
@@ -301,6 +542,9 @@ void Nthread::getReturnValue( void** theReturnParam )
 
 void Nthread::killThread()
 {
+    // Ask first. A thread that checks its stop token will exit well within the join timeout below.
+    m_stopToken.requestStop();
+
     // Give thread a chance to shut down nicely, but it will only work if the user
     // hasn't set the cancel state to DISABLED ( i.e. with pthread_setcancelstate() )
     // or if the user has made calls to functions with cancellation points or calls
@@ -311,7 +555,6 @@ void Nthread::killThread()
     // process, not just the thread it is called on.
 
 #ifndef __ANDROID__
-    bool status = false;
     bool found = true;
 #endif
 
@@ -338,10 +581,17 @@ void Nthread::killThread()
     // Can't join detached or previously joined threads though.
     if ( found && !m_joined && !m_detached )
         {
-        Ntime delay = Ntime::getCurrentLocalTime() + DEATH_WAIT_TIME_MS;
+        Ndeadline deadline( DEATH_WAIT_TIME_MS );
+
+#if defined( __GLIBC__ ) && __GLIBC_PREREQ( 2, 31 )
+        int joinStatus = pthread_clockjoin_np( m_threadId, NULL, CLOCK_MONOTONIC, &deadline.getAsTimespec() );
+#else
+        // No monotonic join, so convert what's left to a CLOCK_REALTIME deadline
+        Ntime delay = Ntime::getCurrentLocalTime() + deadline.getRemaining();
         struct timespec timeout = delay.getAsTimespec();
 
         int joinStatus = pthread_timedjoin_np( m_threadId, NULL, &timeout );
+#endif
         switch ( joinStatus )
             {
             case 0:           // Joined OK
@@ -389,7 +639,7 @@ void Nthread::killThread()
                 break;
 
             default:
-                NERROR( status, "Nthread::KillThread: pthread_timedjoin_np() failed." );
+                NERROR( joinStatus, "Nthread::KillThread: pthread_timedjoin_np() failed." );
                 break;
             }
         }
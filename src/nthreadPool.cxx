@@ -1,235 +1,775 @@
-// nthreadPool.cxx by Neil Cooper. See nthreadPool.h for documentation
-#include "nthreadPool.h"
-
-#include "nerror.h"
-#include "nmutex.h"
-
-#ifndef __ANDROID__
-const Nthread::CORE_AFFINITY NthreadPool::DEFAULT_AFFINITY(-1);
-// DEFAULT_AFFINITY is a magic number not an actual affinity.
-// It is used with SubmitJob() to mean use the default (set by calling UpdatePoolAffinity() ).
-// If UpdatePoolAffinity has never been called, it is equivalent to Nthread::CORE_AFFINITY_ALL.
-#endif
-
-NthreadPool::NthreadPool( const size_t                 thePoolSize,
-                          const std::string            threadNameRoot
-#ifndef __ANDROID__
-                          ,
-                          const Nthread::CORE_AFFINITY defaultAffinity
-#endif
-                                                                       ) : m_closing( false ),
-                                                                           m_poolMaxSize( thePoolSize ),
-                                                                           m_idleCountEvent( true ),
-#ifndef __ANDROID__
-                                                                           m_defaultAffinity( defaultAffinity ),
-#endif
-                                                                           m_threadNameRoot( threadNameRoot )
-{
-#ifndef __ANDROID__
-    // 0 explicitly means all cores. Default affinity starts out as all cores.
-    if ( m_defaultAffinity == DEFAULT_AFFINITY )
-        m_defaultAffinity = Nthread::CORE_AFFINITY_ALL;
-#endif
-
-    // Initialise worker threads.
-    // Doing this rather than on demand front-loads the performance hit, and also avoids
-    // a corner case problem with calling WaitForIdle() before SubmitJob() has ever been called,
-    // so m_pool.size() would be zero.
-    for ( size_t i = 0; i < thePoolSize; i++ )
-        {
-        THREAD_CONTEXT* idleThread = extendPool(
-#ifndef __ANDROID__
-                                                m_defaultAffinity
-#endif
-                                                                   );
-        if ( idleThread )
-            {
-            idleThread->idle = true;   // ExtendPool() Also atomically marks the thread as not
-            m_idleCountEvent.signal(); // idle. Mark it as idle and increment the idle thread count.
-            }
-        }
-}
-
-
-NthreadPool::~NthreadPool()
-{
-    m_closing = true;
-    waitForIdle(); // wait for all user jobs to end
-
-    size_t poolSize = m_pool.size();
-
-    // Don't leave any thread blocked on event otherwise we can't delete it.
-    // Since m_closing is true, they will skip starting client jobs.
-    for ( size_t i = 0; i < poolSize; i++ )
-        m_pool[i]->startThread.signal();
-
-    for ( size_t i = 0; i < poolSize; i++ )
-        {
-        THREAD_CONTEXT* context = m_pool[i];
-        context->thread->getReturnValue();
-        delete context->thread;
-        delete context;
-        }
-}
-
-
-void* NthreadPool::threadProc( void* theThreadContext )
-{
-    THREAD_CONTEXT* context = (THREAD_CONTEXT*)theThreadContext;
-
-    while( ! *( context->closing ) )
-        {
-        context->startThread.wait();
-
-        if ( ! *( context->closing ) )
-            context->userProc( context->userParams );
-
-        context->idle = true;
-        context->idleCountEvent->signal();
-        }
-
-    return NULL; // Nthread takes a void* (*)(void*) type, but we don't allow worker threads to return values
-}
-
-
-NthreadPool::THREAD_CONTEXT* NthreadPool::extendPool( 
-#ifndef __ANDROID__
-                                                      const Nthread::CORE_AFFINITY theAffinity
-#endif
-                                                                                               )
-{
-    // Add a thread to the pool. Assumes thread is going to be used so returns it already
-    // marked as not idle, so that it can't be found and used by another thread doing a SubmitJob.
-
-    THREAD_CONTEXT* context = new THREAD_CONTEXT;
-    context->idle = false; // Don't allow a preempting thread to also find this one
-    context->idleCountEvent = &m_idleCountEvent;
-    context->closing = &m_closing;
-    std::ostringstream threadName;
-
-    if (  m_threadNameRoot.size() > 0 )
-        threadName << m_threadNameRoot << m_pool.size();
-
-    context->thread = new Nthread( NthreadPool::threadProc, (void*)context, threadName.str() );
-
-#ifndef __ANDROID__
-    if ( theAffinity.getAsInt() != Nthread::CORE_AFFINITY_ALL.getAsInt() )
-        context->thread->setThreadAffinity( theAffinity );
-#endif
-
-    m_pool.push_back( context );
-
-    return context;
-}
-
-
-NthreadPool::THREAD_CONTEXT* NthreadPool::getIdleThread(
-#ifndef __ANDROID__ 
-                                                         const Nthread::CORE_AFFINITY theAffinity
-#endif
-                                                        ) // Returns NULL if we cant grow and no idle thread found
-{
-    THREAD_CONTEXT* idleThread = NULL;
-
-    m_poolOwner.lock();
-    // find out if theres a idle thread
-    if ( !m_idleCountEvent.currentState() )
-    // No idle thread. If pool size is unbounded or smaller than max we can make one
-        if ( !m_poolMaxSize || ( m_pool.size() < m_poolMaxSize ) )
-            idleThread = extendPool(
-#ifndef __ANDROID__ 
-                                     theAffinity
-#endif
-                                                 );
-
-    if ( !idleThread )  // Wait for thread to become idle
-        {
-        size_t poolSize = m_pool.size();
-
-        m_idleCountEvent.wait();
-
-        for ( size_t i = 0; ( i < poolSize ) && ( !idleThread ); i++ )
-            if ( m_pool[i]->idle )
-                {
-                idleThread = m_pool[i];
-                idleThread->idle = false;  // Don't allow a preempting thread to also find this one
-#ifndef __ANDROID__
-                if ( idleThread->affinity.getAsInt() != theAffinity.getAsInt() )
-                    {
-                    idleThread->thread->setThreadAffinity( theAffinity );
-                    idleThread->affinity = theAffinity;
-                    }
-#endif
-                }
-        }
-    m_poolOwner.unlock();
-    return idleThread;
-}
-
-
-void NthreadPool::submitJob( THREAD_PROC                  theThreadProc,
-                             void*                        theThreadParam
-#ifndef __ANDROID__
-                             ,
-                             const Nthread::CORE_AFFINITY affinity
-#endif
-                                                                          )
-{
-#ifndef __ANDROID__
-    Nthread::CORE_AFFINITY useAffinity = affinity;
-    if ( useAffinity == DEFAULT_AFFINITY )
-        useAffinity = m_defaultAffinity;
-#endif
-
-    if ( m_closing )
-        ERROR( "NthreadPool: SubmitJob called on NthreadPool object being destructed." );
-    else
-        {
-        THREAD_CONTEXT* idleThread = getIdleThread(
-#ifndef __ANDROID__
-                                                    useAffinity
-#endif
-                                                                );
-
-        if ( !idleThread )
-            ERROR( "NthreadPool: No idle thread to submit job to." );
-
-        idleThread->userProc = theThreadProc;
-        idleThread->userParams = theThreadParam;
-        idleThread->startThread.signal();
-        }
-}
-
-
-size_t NthreadPool::getPoolSize()
-{
-    return m_pool.size();
-}
-
-
-#ifndef __ANDROID__
-void NthreadPool::updatePoolAffinity( const Nthread::CORE_AFFINITY theAffinity )
-{
-    m_defaultAffinity = theAffinity;
-
-    for ( size_t i = 0; i < m_pool.size(); i++ )
-        if ( m_pool[i]->affinity.getAsInt() != m_defaultAffinity.getAsInt() )
-            {
-            m_pool[i]->thread->setThreadAffinity( m_defaultAffinity );
-            m_pool[i]->affinity = m_defaultAffinity;
-            }
-}
-#endif
-
-
-void NthreadPool::waitForIdle() // Wait for all work threads to finish and be idle
-{
-    m_poolOwner.lock();
-
-    for ( size_t i = 0; i < m_pool.size(); i++ )
-        {
-        m_idleCountEvent.wait();
-        m_idleCountEvent.signal(); // Don't consune the event
-        }
-    m_poolOwner.unlock();
-}
+// nthreadPool.cxx by Neil Cooper. See nthreadPool.h for documentation
+#include "nthreadPool.h"
+
+#include <string.h> // for memset()
+
+#include <time.h>
+
+#include <algorithm> // for std::find()
+
+#include "nerror.h"
+#include "nhistogram.h"
+#include "nmutex.h"
+
+namespace NTHREADPOOL
+{
+inline unsigned long long nowNs()
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( now.tv_sec * 1000000000ULL ) + now.tv_nsec;
+}
+
+void addToHistogram( NthreadPool::DURATION_HISTOGRAM& theHistogram, const unsigned long long theNs )
+{
+    unsigned long long us = theNs / 1000;
+    int bucket = us ? 64 - __builtin_clzll( us ) : 0;
+    if ( bucket >= NthreadPool::HISTOGRAM_BUCKETS )
+        bucket = NthreadPool::HISTOGRAM_BUCKETS - 1;
+
+    theHistogram.buckets[ bucket ]++;
+    theHistogram.count++;
+    theHistogram.totalUs += us;
+    if ( us > theHistogram.maxUs )
+        theHistogram.maxUs = us;
+}
+}
+using namespace NTHREADPOOL;
+
+#ifndef __ANDROID__
+const Nthread::CORE_AFFINITY NthreadPool::DEFAULT_AFFINITY;
+// DEFAULT_AFFINITY is the empty set, which can't be a real affinity, so any set of cores given
+// to SubmitJob() is used as it is. It means use the default (set by calling UpdatePoolAffinity() ).
+// If UpdatePoolAffinity has never been called, it is equivalent to Nthread::CORE_AFFINITY_ALL.
+#endif
+
+NthreadPool::NthreadPool( const size_t                 thePoolSize,
+                          const std::string            threadNameRoot
+#ifndef __ANDROID__
+                          ,
+                          const Nthread::CORE_AFFINITY defaultAffinity
+#endif
+                                                                       ) : m_closing( false ),
+                                                                           m_poolMinSize( thePoolSize ),
+                                                                           m_poolMaxSize( thePoolSize ),
+                                                                           m_idleRetireTime( 0 ),
+                                                                           m_spawnDelay( 0 ),
+                                                                           m_agingInterval( 1000 ),
+                                                                           m_priorityScheduled( false ),
+                                                                           m_activeCount( 0 ),
+                                                                           m_poolOwner( Nmutex::FAST, "NthreadPool" ),
+                                                                           m_allIdle( false, 1, true, "NthreadPool idle" ),
+#ifndef __ANDROID__
+                                                                           m_defaultAffinity( defaultAffinity ),
+#endif
+                                                                           m_threadNameRoot( threadNameRoot )
+{
+    initialise( thePoolSize );
+}
+
+
+NthreadPool::NthreadPool( const size_t                 theMinSize,
+                          const size_t                 theMaxSize,
+                          const Ntime                  theIdleRetireTime,
+                          const Ntime                  theSpawnDelay,
+                          const std::string            threadNameRoot
+#ifndef __ANDROID__
+                          ,
+                          const Nthread::CORE_AFFINITY defaultAffinity
+#endif
+                                                                       ) : m_closing( false ),
+                                                                           m_poolMinSize( theMinSize ),
+                                                                           m_poolMaxSize( theMaxSize ),
+                                                                           m_idleRetireTime( theIdleRetireTime ),
+                                                                           m_spawnDelay( theSpawnDelay ),
+                                                                           m_agingInterval( 1000 ),
+                                                                           m_priorityScheduled( false ),
+                                                                           m_activeCount( 0 ),
+                                                                           m_poolOwner( Nmutex::FAST, "NthreadPool" ),
+                                                                           m_allIdle( false, 1, true, "NthreadPool idle" ),
+#ifndef __ANDROID__
+                                                                           m_defaultAffinity( defaultAffinity ),
+#endif
+                                                                           m_threadNameRoot( threadNameRoot )
+{
+    if ( m_poolMaxSize && ( m_poolMinSize > m_poolMaxSize ) )
+        ERROR( "NthreadPool: Minimum pool size (", m_poolMinSize, ") is larger than maximum (", m_poolMaxSize, ")" );
+
+    initialise( theMinSize );
+}
+
+
+void NthreadPool::initialise( const size_t theInitialSize )
+{
+#ifndef __ANDROID__
+    // Empty explicitly means all cores. Default affinity starts out as all cores.
+    if ( m_defaultAffinity.isEmpty() )
+        m_defaultAffinity = Nthread::CORE_AFFINITY_ALL;
+#endif
+
+    memset( &m_metrics, 0, sizeof( m_metrics ) );
+    memset( &m_queueWait, 0, sizeof( m_queueWait ) );
+    memset( &m_runTime, 0, sizeof( m_runTime ) );
+    m_queueWaitHistogram = NULL;
+    m_runTimeHistogram = NULL;
+
+    for ( int i = 0; i < NUMBER_OF_PRIORITIES; i++ )
+        {
+        m_priorityScheduling[i].model = Nthread::DEFAULT;
+        m_priorityScheduling[i].priority = 0;
+        m_priorityScheduling[i].warned = false;
+        }
+
+    // Initialise worker threads.
+    // Doing this rather than on demand front-loads the performance hit.
+    m_poolOwner.lock();
+    for ( size_t i = 0; i < theInitialSize; i++ )
+        {
+        THREAD_CONTEXT* idleThread = extendPool(
+#ifndef __ANDROID__
+                                                m_defaultAffinity
+#endif
+                                                                   );
+        idleThread->idle = true;   // ExtendPool() marks the thread as not idle.
+        m_idleThreads.push_back( idleThread );
+        }
+    m_poolOwner.unlock();
+}
+
+
+NthreadPool::~NthreadPool()
+{
+    m_closing = true;
+    waitForIdle(); // wait for all user jobs to end
+
+    m_poolOwner.lock();
+    std::vector< THREAD_CONTEXT* > threads;
+    threads.swap( m_pool );
+    m_idleThreads.clear();
+    m_poolOwner.unlock();
+
+    // Don't leave any thread blocked on event otherwise we can't delete it.
+    // A start with no user process tells the thread to exit.
+    for ( size_t i = 0; i < threads.size(); i++ )
+        {
+        threads[i]->userProc = NULL;
+        threads[i]->startThread.signal();
+        }
+
+    for ( size_t i = 0; i < threads.size(); i++ )
+        {
+        THREAD_CONTEXT* context = threads[i];
+        context->thread->getReturnValue();
+        delete context->thread;
+        m_contextPool.destroy( context );
+        }
+
+    reapRetiredThreads();
+}
+
+
+void* NthreadPool::threadProc( void* theThreadContext )
+{
+    THREAD_CONTEXT* context = (THREAD_CONTEXT*)theThreadContext;
+    NthreadPool& us = *( context->pool );
+    bool running = true;
+
+    while( running )
+        {
+        // A timeout here means we've been idle for the retire time (never, if it is 0).
+        if ( !context->startThread.wait( us.m_idleRetireTime ) )
+            running = !us.retireThread( context );
+        else
+            if ( !context->userProc )  // Destructor is shutting us down
+                running = false;
+            else
+                do
+                    {
+                    if ( us.m_priorityScheduled )
+                        us.applyPriorityScheduling( context );
+
+                    unsigned long long startNs = nowNs();
+                    context->userProc( context->userParams );
+                    us.jobDone( context, startNs );
+                    }
+                while( us.takePendingJob( context ) );
+        }
+
+    return NULL; // Nthread takes a void* (*)(void*) type, but we don't allow worker threads to return values
+}
+
+
+NthreadPool::THREAD_CONTEXT* NthreadPool::extendPool(
+#ifndef __ANDROID__
+                                                      const Nthread::CORE_AFFINITY theAffinity
+#endif
+                                                                                               )
+{
+    // Add a thread to the pool. Assumes thread is going to be used so returns it already
+    // marked as not idle, so that it can't be found and used by another thread doing a SubmitJob.
+    // Caller must own m_poolOwner.
+
+    THREAD_CONTEXT* context = m_contextPool.create();
+    context->idle = false; // Don't allow a preempting thread to also find this one
+    context->pool = this;
+    context->userProc = NULL;
+    context->userParams = NULL;
+    context->priority = NORMAL_PRIORITY;
+    context->schedulingModel = Nthread::DEFAULT;
+    context->schedulingPriority = 0;
+    context->submitNs = 0;
+    context->jobsRun = 0;
+    context->busyUs = 0;
+    std::ostringstream threadName;
+
+    if (  m_threadNameRoot.size() > 0 )
+        threadName << m_threadNameRoot << m_metrics.threadsSpawned;
+
+    // Pin the thread as it is created, so it never starts on the wrong core and migrates.
+    Nthread::THREAD_ATTRIBUTES attributes;
+#ifndef __ANDROID__
+    context->affinity = theAffinity;
+    if ( theAffinity != Nthread::CORE_AFFINITY_ALL )
+        attributes.affinity = theAffinity;
+#endif
+
+    context->thread = new Nthread( NthreadPool::threadProc, (void*)context, attributes, threadName.str() );
+
+    m_pool.push_back( context );
+
+    m_metrics.threadsSpawned++;
+    if ( m_pool.size() > m_metrics.peakSize )
+        m_metrics.peakSize = m_pool.size();
+
+    return context;
+}
+
+
+NthreadPool::THREAD_CONTEXT* NthreadPool::claimIdleThread(
+#ifndef __ANDROID__
+                                                           const Nthread::CORE_AFFINITY theAffinity
+#endif
+                                                          ) // Caller must own m_poolOwner and m_idleThreads must not be empty
+{
+    THREAD_CONTEXT* idleThread = m_idleThreads.back();
+    m_idleThreads.pop_back();
+    idleThread->idle = false;  // Don't allow a preempting thread to also find this one
+
+#ifndef __ANDROID__
+    if ( idleThread->affinity != theAffinity )
+        {
+        idleThread->thread->setThreadAffinity( theAffinity );
+        idleThread->affinity = theAffinity;
+        }
+#endif
+
+    return idleThread;
+}
+
+
+bool NthreadPool::canGrow() // Caller must own m_poolOwner
+{
+    return ( !m_poolMaxSize || ( m_pool.size() < m_poolMaxSize ) );
+}
+
+
+void NthreadPool::jobStarted() // Caller must own m_poolOwner
+{
+    // Active count includes jobs still waiting for a thread, so it only reaches 0 when
+    // there is nothing running and nothing queued.
+    if ( m_activeCount++ == 0 )
+        m_allIdle.reset();
+
+    m_metrics.jobsSubmitted++;
+}
+
+
+void NthreadPool::startJob( THREAD_CONTEXT* theThread, THREAD_PROC theThreadProc, void* theThreadParam, const JOB_PRIORITY thePriority,
+                            const unsigned long long theSubmitNs )
+{
+    theThread->priority = thePriority;
+    theThread->submitNs = theSubmitNs;
+    theThread->userProc = theThreadProc;
+    theThread->userParams = theThreadParam;
+    theThread->startThread.signal();
+}
+
+
+void NthreadPool::jobDone( THREAD_CONTEXT* theThread, const unsigned long long theStartNs )
+{
+    // Called by a pool thread when its job returns.
+    unsigned long long endNs = nowNs();
+
+    m_statsOwner.lock();
+    addToHistogram( m_queueWait, theStartNs - theThread->submitNs );
+    addToHistogram( m_runTime, endNs - theStartNs );
+    theThread->jobsRun++;
+    theThread->busyUs += ( endNs - theStartNs ) / 1000;
+    m_statsOwner.unlock();
+
+    if ( m_queueWaitHistogram )
+        m_queueWaitHistogram->record( theStartNs - theThread->submitNs );
+    if ( m_runTimeHistogram )
+        m_runTimeHistogram->record( endNs - theStartNs );
+}
+
+
+std::deque< NthreadPool::PENDING_JOB >::iterator NthreadPool::selectPendingJob()
+{
+    // Picks the waiting job to run next: highest priority (after aging), then earliest deadline,
+    // then longest waiting. The queue only holds jobs whose submitters are blocked waiting for a
+    // thread, so it is short and a linear scan beats keeping it ordered as priorities age.
+    // Caller must own m_poolOwner and m_pendingJobs must not be empty.
+    // On the monotonic clock, so setting the system time can't age or expire jobs.
+    unsigned long long now = nowNs();
+    long long agingMs = m_agingInterval.getAsMs();
+
+    std::deque< PENDING_JOB >::iterator best = m_pendingJobs.end();
+    int bestPriority = -1;
+    bool bestAged = false;
+
+    for ( std::deque< PENDING_JOB >::iterator it = m_pendingJobs.begin(); it != m_pendingJobs.end(); ++it )
+        {
+        int priority = it->priority;
+        if ( agingMs > 0 )
+            {
+            priority += (int)( ( ( now - it->submitNs ) / 1000000 ) / agingMs );
+            if ( priority > CRITICAL_PRIORITY )
+                priority = CRITICAL_PRIORITY;
+            }
+
+        bool better = ( priority > bestPriority );
+        if ( !better && ( priority == bestPriority ) && it->deadlineNs )  // Equal priority: EDF
+            better = ( !best->deadlineNs || ( it->deadlineNs < best->deadlineNs ) );
+
+        if ( better )  // Strictly better only, so equals stay first come first served
+            {
+            best = it;
+            bestPriority = priority;
+            bestAged = ( priority != it->priority );
+            }
+        }
+
+    if ( bestAged )
+        m_metrics.jobsAged++;
+
+    if ( best->deadlineNs && ( now > best->deadlineNs ) )
+        m_metrics.deadlinesMissed++;
+
+    return best;
+}
+
+
+void NthreadPool::applyPriorityScheduling( THREAD_CONTEXT* theThread )
+{
+    // Called by a pool thread to switch itself to the scheduling model set for its job's priority.
+    const PRIORITY_SCHEDULING& wanted = m_priorityScheduling[ theThread->priority ];
+
+    if ( ( wanted.model == theThread->schedulingModel ) && ( wanted.priority == theThread->schedulingPriority ) )
+        return;
+
+    try
+        {
+        theThread->thread->setSchedulingModel( wanted.model, wanted.priority );
+        theThread->schedulingModel = wanted.model;
+        theThread->schedulingPriority = wanted.priority;
+        }
+    catch( NerrorException& e )
+        {
+        // Typically no privilege for a realtime model. Carry on under the current model.
+        m_poolOwner.lock();
+        bool warn = !m_priorityScheduling[ theThread->priority ].warned;
+        m_priorityScheduling[ theThread->priority ].warned = true;
+        m_poolOwner.unlock();
+
+        if ( warn )
+            WARN( "NthreadPool: Can't apply scheduling model for job priority ", theThread->priority, ": ", e.what() );
+        }
+}
+
+
+bool NthreadPool::takePendingJob( THREAD_CONTEXT* theThread )
+{
+    // Called by a pool thread when its job has finished. Either hands it the next waiting job
+    // (returns true) or puts it back on the idle stack (returns false).
+    bool taken = false;
+
+    m_poolOwner.lock();
+
+    if ( --m_activeCount == 0 )
+        m_allIdle.signal();
+
+    if ( m_pendingJobs.size() )
+        {
+        std::deque< PENDING_JOB >::iterator it = selectPendingJob();
+        PENDING_JOB job = *it;
+        m_pendingJobs.erase( it );
+
+#ifndef __ANDROID__
+        if ( theThread->affinity != job.affinity )
+            {
+            theThread->thread->setThreadAffinity( job.affinity );
+            theThread->affinity = job.affinity;
+            }
+#endif
+        theThread->priority = job.priority;
+        theThread->submitNs = job.submitNs;
+        theThread->userProc = job.userProc;
+        theThread->userParams = job.userParams;
+        job.accepted->signal(); // Done while we own the pool so the submitter can't destroy it under us
+        taken = true;
+        }
+    else
+        {
+        theThread->idle = true;
+        m_idleThreads.push_back( theThread );
+        }
+
+    m_poolOwner.unlock();
+    return taken;
+}
+
+
+bool NthreadPool::retireThread( THREAD_CONTEXT* theThread )
+{
+    // Called by a pool thread that has been idle for the retire time.
+    // Returns true if it has been removed from the pool and should exit.
+    m_poolOwner.lock();
+
+    // If we're no longer idle, a submitter claimed us just as we timed out and is about to start us.
+    bool retire = ( !m_closing && theThread->idle && ( m_pool.size() > m_poolMinSize ) );
+
+    if ( retire )
+        {
+        m_idleThreads.erase( std::find( m_idleThreads.begin(), m_idleThreads.end(), theThread ) );
+        m_pool.erase( std::find( m_pool.begin(), m_pool.end(), theThread ) );
+        m_retiredThreads.push_back( theThread ); // Can't join ourself, so leave it to someone else.
+        m_metrics.threadsRetired++;
+        }
+
+    m_poolOwner.unlock();
+    return retire;
+}
+
+
+void NthreadPool::reapRetiredThreads()
+{
+    std::vector< THREAD_CONTEXT* > retired;
+
+    m_poolOwner.lock();
+    retired.swap( m_retiredThreads );
+    m_poolOwner.unlock();
+
+    for ( size_t i = 0; i < retired.size(); i++ )
+        {
+        retired[i]->thread->getReturnValue();
+        delete retired[i]->thread;
+        m_contextPool.destroy( retired[i] );
+        }
+}
+
+
+void NthreadPool::submitJob( THREAD_PROC                  theThreadProc,
+                             void*                        theThreadParam
+#ifndef __ANDROID__
+                             ,
+                             const Nthread::CORE_AFFINITY affinity
+#endif
+                                                                          )
+{
+    submit( theThreadProc, theThreadParam, NORMAL_PRIORITY, 0
+#ifndef __ANDROID__
+            , affinity
+#endif
+                      );
+}
+
+
+void NthreadPool::submitJob( THREAD_PROC                  theThreadProc,
+                             void*                        theThreadParam,
+                             const JOB_PRIORITY           thePriority,
+                             const Ntime                  theDeadline
+#ifndef __ANDROID__
+                             ,
+                             const Nthread::CORE_AFFINITY affinity
+#endif
+                                                                          )
+{
+    if ( ( thePriority < LOW_PRIORITY ) || ( thePriority >= NUMBER_OF_PRIORITIES ) )
+        ERROR( "NthreadPool: SubmitJob called with invalid priority: ", thePriority );
+
+    submit( theThreadProc, theThreadParam, thePriority, theDeadline
+#ifndef __ANDROID__
+            , affinity
+#endif
+                      );
+}
+
+
+void NthreadPool::submit( THREAD_PROC                  theThreadProc,
+                          void*                        theThreadParam,
+                          const JOB_PRIORITY           thePriority,
+                          const Ntime&                 theDeadline
+#ifndef __ANDROID__
+                          ,
+                          const Nthread::CORE_AFFINITY affinity
+#endif
+                                                                       )
+{
+    unsigned long long submitNs = nowNs();
+
+#ifndef __ANDROID__
+    Nthread::CORE_AFFINITY useAffinity = affinity;
+    if ( useAffinity.isEmpty() )     // DEFAULT_AFFINITY
+        useAffinity = m_defaultAffinity;
+#endif
+
+    if ( m_closing )
+        ERROR( "NthreadPool: SubmitJob called on NthreadPool object being destructed." );
+
+    reapRetiredThreads();
+
+    THREAD_CONTEXT* thread = NULL;
+
+    m_poolOwner.lock();
+
+    if ( m_idleThreads.size() )
+        thread = claimIdleThread(
+#ifndef __ANDROID__
+                                  useAffinity
+#endif
+                                              );
+    else
+        if ( canGrow() && ( m_spawnDelay.isZeroTime() || ( thePriority == CRITICAL_PRIORITY ) ) )
+            thread = extendPool(
+#ifndef __ANDROID__
+                                 useAffinity
+#endif
+                                             );
+    jobStarted();
+
+    if ( !thread )
+        {
+        // No thread available. Queue the job and wait for a thread to finish and take it,
+        // or (if we are allowed to grow) for the spawn delay to pass.
+        Nevent accepted;
+        PENDING_JOB job;
+        job.userProc = theThreadProc;
+        job.userParams = theThreadParam;
+#ifndef __ANDROID__
+        job.affinity = useAffinity;
+#endif
+        job.accepted = &accepted;
+        job.priority = thePriority;
+        job.submitNs = submitNs;
+        job.deadlineNs = 0;
+        if ( !theDeadline.isZeroTime() )
+            {
+            timespec deadline = theDeadline.getAsTimespec();
+            job.deadlineNs = submitNs + ( deadline.tv_sec * 1000000000ULL ) + deadline.tv_nsec;
+            }
+        m_pendingJobs.push_back( job );
+
+        m_metrics.jobsQueued++;
+        if ( m_pendingJobs.size() > m_metrics.peakQueueDepth )
+            m_metrics.peakQueueDepth = m_pendingJobs.size();
+
+        m_poolOwner.unlock();
+
+        bool taken = false;
+        while ( !taken )
+            {
+            taken = accepted.wait( m_spawnDelay );
+
+            m_poolOwner.lock(); // Also ensures a thread taking our job has finished signalling us.
+            if ( !taken && canGrow() )
+                {
+                std::deque< PENDING_JOB >::iterator it = m_pendingJobs.begin();
+                while ( ( it != m_pendingJobs.end() ) && ( it->accepted != &accepted ) )
+                    ++it;
+
+                if ( it != m_pendingJobs.end() ) // Otherwise it was taken just as we timed out
+                    {
+                    m_pendingJobs.erase( it );
+                    thread = extendPool(
+#ifndef __ANDROID__
+                                         useAffinity
+#endif
+                                                     );
+                    m_metrics.delayedSpawns++;
+                    taken = true;
+                    }
+                }
+            m_poolOwner.unlock();
+            }
+        }
+    else
+        m_poolOwner.unlock();
+
+    if ( thread )
+        startJob( thread, theThreadProc, theThreadParam, thePriority, submitNs );
+}
+
+
+bool NthreadPool::trySubmitJob( THREAD_PROC                  theThreadProc,
+                                void*                        theThreadParam
+#ifndef __ANDROID__
+                                ,
+                                const Nthread::CORE_AFFINITY affinity
+#endif
+                                                                             )
+{
+    unsigned long long submitNs = nowNs();
+
+#ifndef __ANDROID__
+    Nthread::CORE_AFFINITY useAffinity = affinity;
+    if ( useAffinity.isEmpty() )     // DEFAULT_AFFINITY
+        useAffinity = m_defaultAffinity;
+#endif
+
+    // A job still running while the pool is destructed may try to share out its work with
+    // Nparallel, which then just does the work itself.
+    if ( m_closing )
+        return false;
+
+    THREAD_CONTEXT* thread = NULL;
+
+    m_poolOwner.lock();
+
+    if ( m_idleThreads.size() )
+        thread = claimIdleThread(
+#ifndef __ANDROID__
+                                  useAffinity
+#endif
+                                              );
+    else
+        if ( canGrow() && m_spawnDelay.isZeroTime() )
+            thread = extendPool(
+#ifndef __ANDROID__
+                                 useAffinity
+#endif
+                                             );
+    if ( thread )
+        jobStarted();
+
+    m_poolOwner.unlock();
+
+    if ( thread )
+        startJob( thread, theThreadProc, theThreadParam, NORMAL_PRIORITY, submitNs );
+
+    return ( thread != NULL );
+}
+
+
+void NthreadPool::setPriorityAging( const Ntime theAgingInterval )
+{
+    m_poolOwner.lock();
+    m_agingInterval = theAgingInterval;
+    m_poolOwner.unlock();
+}
+
+
+void NthreadPool::setPriorityScheduling( const JOB_PRIORITY              thePriority,
+                                         const Nthread::SCHEDULING_MODEL theModel,
+                                         const int                       theSchedulingPriority )
+{
+    if ( ( thePriority < LOW_PRIORITY ) || ( thePriority >= NUMBER_OF_PRIORITIES ) )
+        ERROR( "NthreadPool: setPriorityScheduling called with invalid priority: ", thePriority );
+
+    m_poolOwner.lock();
+    m_priorityScheduling[ thePriority ].model = theModel;
+    m_priorityScheduling[ thePriority ].priority = theSchedulingPriority;
+    m_priorityScheduling[ thePriority ].warned = false;
+    m_priorityScheduled = true;
+    m_poolOwner.unlock();
+}
+
+
+void NthreadPool::setLatencyHistograms( NconcurrentHistogram* theQueueWait, NconcurrentHistogram* theRunTime )
+{
+    m_queueWaitHistogram = theQueueWait;
+    m_runTimeHistogram = theRunTime;
+}
+
+
+size_t NthreadPool::getPoolSize()
+{
+    m_poolOwner.lock();
+    size_t size = m_pool.size();
+    m_poolOwner.unlock();
+    return size;
+}
+
+
+NthreadPool::POOL_METRICS NthreadPool::getMetrics()
+{
+    m_poolOwner.lock();
+    POOL_METRICS metrics = m_metrics;
+    metrics.currentSize = m_pool.size();
+    metrics.idleThreads = m_idleThreads.size();
+    metrics.queueDepth = m_pendingJobs.size();
+    m_poolOwner.unlock();
+    return metrics;
+}
+
+
+NthreadPool::POOL_STATS NthreadPool::getStats()
+{
+    POOL_STATS stats;
+
+    // Hold the pool so that no worker can be retired and deleted while we read it. Reading /proc
+    // doesn't wait on anything, so this only briefly delays submitters.
+    m_poolOwner.lock();
+    try
+        {
+        for ( size_t i = 0; i < m_pool.size(); i++ )
+            {
+            WORKER_STATS worker;
+            worker.tid = m_pool[i]->thread->getTid();
+            worker.idle = m_pool[i]->idle;
+            worker.thread = m_pool[i]->thread->getStats();
+            stats.workers.push_back( worker );
+            }
+        }
+    catch ( ... )
+        {
+        m_poolOwner.unlock();
+        throw;
+        }
+
+    m_statsOwner.lock();
+    stats.queueWait = m_queueWait;
+    stats.runTime = m_runTime;
+    for ( size_t i = 0; i < m_pool.size(); i++ )
+        {
+        stats.workers[i].jobsRun = m_pool[i]->jobsRun;
+        stats.workers[i].busyUs = m_pool[i]->busyUs;
+        }
+    m_statsOwner.unlock();
+
+    m_poolOwner.unlock();
+    return stats;
+}
+
+
+#ifndef __ANDROID__
+void NthreadPool::updatePoolAffinity( const Nthread::CORE_AFFINITY theAffinity )
+{
+    m_poolOwner.lock();
+    m_defaultAffinity = theAffinity.isEmpty() ? Nthread::CORE_AFFINITY_ALL : theAffinity;
+
+    for ( size_t i = 0; i < m_pool.size(); i++ )
+        if ( m_pool[i]->affinity != m_defaultAffinity )
+            {
+            m_pool[i]->thread->setThreadAffinity( m_defaultAffinity );
+            m_pool[i]->affinity = m_defaultAffinity;
+            }
+    m_poolOwner.unlock();
+}
+#endif
+
+
+void NthreadPool::waitForIdle() // Wait for all work threads to finish and be idle
+{
+    m_allIdle.wait(); // Manual reset, so this doesn't consume it
+}
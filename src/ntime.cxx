@@ -6,8 +6,15 @@
 #include <sys/sysinfo.h>  // for sysinfo()
 #include <sched.h>        // for sched_yield()
 #include <errno.h>        // for EINTR
+#include <atomic>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <cpuid.h>        // for __get_cpuid()
+#include <x86intrin.h>    // for __rdtsc()
+#endif
 
 #include "nerror.h"
+#include "nstopToken.h"
 
 static const long  NS_IN_1_USEC        = 1000;        // Nanoseconds in 1 micreosecond
 static const long  NS_IN_1_MSEC        = 1000000;     // Nanoseconds in one millisecond
@@ -58,6 +65,19 @@ bool Ntime::sleep( const Ntime& theDelay, Ntime* theRemainingTime )
 }
 
 
+bool Ntime::sleep( const Ntime& theDelay, const NstopToken& theStopToken )
+{
+    if ( theStopToken.stopRequested() )
+        return false;
+
+    if ( theDelay.isZeroTime() )
+        return sleep( theDelay );
+
+    // The stop event only becomes signalled, so waiting on it is a sleep that a stop can end.
+    return !theStopToken.getEvent().wait( theDelay );
+}
+
+
 Ntime Ntime::getUptime()
 {
     struct sysinfo info;
@@ -373,3 +393,233 @@ void Ntime::rationalise()
         }
 }
 
+
+
+// ---------------------------------------------------------------------------
+// Ndeadline
+// ---------------------------------------------------------------------------
+
+Ndeadline::Ndeadline( const Ntime& theTimeout ) : m_infinite( theTimeout.isZeroTime() )
+{
+    m_deadline.tv_sec = 0;
+    m_deadline.tv_nsec = 0;
+
+    if ( !m_infinite )
+        {
+        if ( clock_gettime( CLOCK_MONOTONIC, &m_deadline ) != 0 )
+            EERROR( "Ndeadline: clock_gettime() failed." );
+
+        timespec timeout = theTimeout.getAsTimespec();
+        m_deadline.tv_sec += timeout.tv_sec;
+        m_deadline.tv_nsec += timeout.tv_nsec;
+        if ( m_deadline.tv_nsec >= NS_IN_1_SEC )
+            {
+            m_deadline.tv_sec += 1;
+            m_deadline.tv_nsec -= NS_IN_1_SEC;
+            }
+        }
+}
+
+
+bool Ndeadline::isInfinite() const
+{
+    return m_infinite;
+}
+
+
+bool Ndeadline::hasExpired() const
+{
+    return ( !m_infinite && getRemaining().isZeroTime() );
+}
+
+
+Ntime Ndeadline::getRemaining() const
+{
+    timespec remaining;
+    remaining.tv_sec = 0;
+    remaining.tv_nsec = 0;
+
+    if ( !m_infinite )
+        {
+        timespec now;
+        if ( clock_gettime( CLOCK_MONOTONIC, &now ) != 0 )
+            EERROR( "Ndeadline: clock_gettime() failed." );
+
+        if ( ( now.tv_sec < m_deadline.tv_sec ) ||
+             ( ( now.tv_sec == m_deadline.tv_sec ) && ( now.tv_nsec < m_deadline.tv_nsec ) ) )
+            {
+            remaining.tv_sec = m_deadline.tv_sec - now.tv_sec;
+            remaining.tv_nsec = m_deadline.tv_nsec - now.tv_nsec;
+            if ( remaining.tv_nsec < 0 )
+                {
+                remaining.tv_sec -= 1;
+                remaining.tv_nsec += NS_IN_1_SEC;
+                }
+            }
+        }
+
+    return Ntime( remaining );
+}
+
+
+int Ndeadline::getRemainingMs() const
+{
+    if ( m_infinite )
+        return -1;
+
+    timespec remaining = getRemaining().getAsTimespec();
+    long long ms = ( remaining.tv_sec * (long long)MS_IN_1_SEC ) + ( ( remaining.tv_nsec + NS_IN_1_MSEC - 1 ) / NS_IN_1_MSEC );
+
+    return ( ms > INT_MAX ) ? INT_MAX : (int)ms;
+}
+
+
+const timespec& Ndeadline::getAsTimespec() const
+{
+    return m_deadline;
+}
+
+
+//----------------------------------------------------------------------------
+// Ntimestamp
+//----------------------------------------------------------------------------
+
+namespace NTIME
+{
+typedef struct
+    {
+    int64_t     ns;         // Monotonic time at tsc
+    uint64_t    tsc;
+    uint64_t    nsPerTick;  // 32.32 fixed point
+    } TSC_CALIBRATION;
+
+// Replaced whole by calibrateTsc(), so a reader always sees one consistent calibration. Old
+// ones aren't freed, as a reader may still be using one: there are only ever a few.
+static std::atomic< const TSC_CALIBRATION* > tscCalibration( NULL );
+
+static int64_t getNs( const clockid_t theClock )
+{
+    timespec ts;
+    if ( clock_gettime( theClock, &ts ) != 0 )
+        EERROR( "Ntimestamp: clock_gettime() failed." );
+    return ( ts.tv_sec * (int64_t)NS_IN_1_SEC ) + ts.tv_nsec;
+}
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+static void sampleTsc( int64_t& theNs, uint64_t& theTsc )
+{
+    // The TSC at the middle of the tightest of a few monotonic clock reads
+    uint64_t best = ~0ULL;
+    for ( int i = 0; i < 5; i++ )
+        {
+        uint64_t before = __rdtsc();
+        int64_t ns = getNs( CLOCK_MONOTONIC );
+        uint64_t after = __rdtsc();
+        if ( after - before < best )
+            {
+            best = after - before;
+            theNs = ns;
+            theTsc = before + ( after - before ) / 2;
+            }
+        }
+}
+
+static int64_t readTsc()
+{
+    const TSC_CALIBRATION* calibration = tscCalibration.load( std::memory_order_acquire );
+    if ( !calibration )
+        {
+        Ntimestamp::calibrateTsc();
+        calibration = tscCalibration.load( std::memory_order_acquire );
+        }
+    uint64_t ticks = __rdtsc() - calibration->tsc;
+    return calibration->ns + (int64_t)( ( (unsigned __int128)ticks * calibration->nsPerTick ) >> 32 );
+}
+#endif
+}
+
+using namespace NTIME;
+
+
+Ntimestamp Ntimestamp::now( const CLOCK theClock )
+{
+    switch ( theClock )
+        {
+        case MONOTONIC_COARSE:
+#ifdef CLOCK_MONOTONIC_COARSE
+            return Ntimestamp( getNs( CLOCK_MONOTONIC_COARSE ) );
+#else
+            break;
+#endif
+        case TSC:
+#if defined( __x86_64__ ) || defined( __i386__ )
+            if ( isTscAvailable() )
+                return Ntimestamp( readTsc() );
+#endif
+            break;
+        case MONOTONIC:
+            break;
+        }
+    return Ntimestamp( getNs( CLOCK_MONOTONIC ) );
+}
+
+
+bool Ntimestamp::isTscAvailable()
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+    static const bool available = []()
+        {
+        unsigned int eax, ebx, ecx, edx;
+        return __get_cpuid( 0x80000007, &eax, &ebx, &ecx, &edx ) && ( edx & ( 1 << 8 ) );    // Invariant TSC
+        }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+
+void Ntimestamp::calibrateTsc( const Ntime& theDuration )
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+    if ( !isTscAvailable() )
+        return;
+
+    int64_t startNs = 0, endNs = 0;
+    uint64_t startTsc = 0, endTsc = 0;
+    sampleTsc( startNs, startTsc );
+    Ntime::sleep( theDuration.isZeroTime() ? Ntime( 1 ) : theDuration );
+    sampleTsc( endNs, endTsc );
+    if ( endTsc <= startTsc )
+        ERROR( "Ntimestamp::calibrateTsc: The TSC didn't advance" );
+
+    TSC_CALIBRATION* calibration = new TSC_CALIBRATION;
+    calibration->ns = endNs;
+    calibration->tsc = endTsc;
+    calibration->nsPerTick = (uint64_t)( ( (unsigned __int128)( endNs - startNs ) << 32 ) / ( endTsc - startTsc ) );
+    tscCalibration.store( calibration, std::memory_order_release );
+#endif
+}
+
+
+Ntimestamp::Ntimestamp( const Ntime& theTime )
+{
+    timespec ts = theTime.getAsTimespec();
+    m_ns = ( ts.tv_sec * (int64_t)NS_IN_1_SEC ) + ts.tv_nsec;
+}
+
+
+Ntime Ntimestamp::getAsNtime() const
+{
+    // Ntime keeps tv_sec and tv_nsec the same sign, as division does
+    timespec ts;
+    ts.tv_sec = m_ns / NS_IN_1_SEC;
+    ts.tv_nsec = m_ns % NS_IN_1_SEC;
+    return Ntime( ts );
+}
+
+
+Ntime Ntimestamp::getAsLocalTime() const
+{
+    return Ntime::getCurrentLocalTime() - ( now() - *this ).getAsNtime();
+}
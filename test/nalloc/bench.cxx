@@ -0,0 +1,158 @@
+// Heap allocations and time per operation, with and without the Nalloc allocators.
+// Counts every call to the global operator new, so the "heap allocs" columns show what each
+// approach costs the general purpose heap.
+// Build with: make TARGET=bench  (use the release CFLAGS in the makefile for meaningful numbers)
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <stdlib.h>
+
+#include "nalloc.h"
+#include "nerror.h"
+#include "nthreadPool.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static atomic< unsigned long long > heapAllocations( 0 );
+
+void* operator new( size_t theSize )
+{
+    heapAllocations++;
+    void* p = malloc( theSize ? theSize : 1 );
+    if ( !p )
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete( void* thePointer ) noexcept
+{
+    free( thePointer );
+}
+
+void operator delete( void* thePointer, size_t ) noexcept
+{
+    free( thePointer );
+}
+
+
+static const int OPERATIONS = 100000;
+
+typedef struct
+{
+    int     id;
+    char    payload[ 120 ];
+} MESSAGE;
+
+
+static void report( const char* theTest, const Ntime& theStart, const unsigned long long theAllocationsBefore, const int theOperations )
+{
+    double ns = elapsedNs( theStart ) / theOperations;
+    double allocations = (double)( heapAllocations - theAllocationsBefore ) / theOperations;
+    cout << setw( 36 ) << theTest << setw( 14 ) << allocations << setw( 12 ) << ns << endl;
+}
+
+
+// Nerror::Compose() as it was before it reused a stream per thread.
+template< typename ...Msgs >
+static string oldCompose( Msgs&&... msgs )
+{
+    ostringstream* buffer = new ostringstream;
+    int unused[] = { 0, ( ( *buffer << msgs ), 0 )... };
+    (void)unused;
+    string message = buffer->str();
+    delete buffer;
+    return message;
+}
+
+
+void jobProc( void* theParam )
+{
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    cout << fixed << setprecision( 2 );
+    cout << setw( 36 ) << "per operation" << setw( 14 ) << "heap allocs" << setw( 12 ) << "ns" << endl;
+
+    unsigned long long before = heapAllocations;
+    Ntime start = Ntime::getCurrentLocalTime();
+    for ( int i = 0; i < OPERATIONS; i++ )
+        {
+        MESSAGE* m = new MESSAGE;
+        m->id = i;
+        delete m;
+        }
+    report( "new/delete", start, before, OPERATIONS );
+
+    NobjectPool< MESSAGE > pool;
+    before = heapAllocations;
+    start = Ntime::getCurrentLocalTime();
+    for ( int i = 0; i < OPERATIONS; i++ )
+        {
+        MESSAGE* m = pool.create();
+        m->id = i;
+        pool.destroy( m );
+        }
+    report( "NobjectPool create/destroy", start, before, OPERATIONS );
+
+    before = heapAllocations;
+    start = Ntime::getCurrentLocalTime();
+    for ( int i = 0; i < OPERATIONS / 100; i++ )
+        {
+        vector< int > numbers;
+        for ( int n = 0; n < 100; n++ )
+            numbers.push_back( n );
+        }
+    report( "vector of 100 ints", start, before, OPERATIONS / 100 );
+
+    Narena& arena = Narena::forThread();
+    before = heapAllocations;
+    start = Ntime::getCurrentLocalTime();
+    for ( int i = 0; i < OPERATIONS / 100; i++ )
+        {
+            {
+            vector< int, NarenaAllocator< int > > numbers;
+            for ( int n = 0; n < 100; n++ )
+                numbers.push_back( n );
+            }
+        arena.reset();
+        }
+    report( "vector of 100 ints in Narena", start, before, OPERATIONS / 100 );
+
+    before = heapAllocations;
+    start = Ntime::getCurrentLocalTime();
+    for ( int i = 0; i < OPERATIONS; i++ )
+        oldCompose( "Nsocket::read: Timed out after ", i, "ms" );
+    report( "message, new ostringstream", start, before, OPERATIONS );
+
+    before = heapAllocations;
+    start = Ntime::getCurrentLocalTime();
+    for ( int i = 0; i < OPERATIONS; i++ )
+        Nerror::Compose( "Nsocket::read: Timed out after ", i, "ms" );
+    report( "message, Nerror::Compose", start, before, OPERATIONS );
+
+    // An elastic pool that keeps retiring and respawning threads. Each thread's context used to
+    // come from the heap; now it comes from the pool's NobjectPool.
+        {
+        NthreadPool threadPool( 0, 4, 1 );
+        before = heapAllocations;
+        start = Ntime::getCurrentLocalTime();
+        for ( int i = 0; i < 50; i++ )
+            {
+            threadPool.submitJob( jobProc, NULL );
+            threadPool.waitForIdle();
+            Ntime::sleep( 5 );  // Let the thread retire
+            }
+        report( "thread spawn (NthreadPool, 5ms idle)", start, before, 50 );
+        }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+// Checks the Nalloc allocators.
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "nalloc.h"
+#include "nerror.h"
+#include "nthread.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static int constructed = 0;
+static int destroyed = 0;
+
+class Widget
+{
+public:
+    Widget( int theValue, const string& theName ) : m_value( theValue ), m_name( theName ) { constructed++; }
+    ~Widget() { destroyed++; }
+
+    int     m_value;
+    string  m_name;
+};
+
+
+// Takes its argument by rvalue, so only builds if create() forwards it.
+class Owner
+{
+public:
+    explicit Owner( unique_ptr< int >&& theValue ) : m_value( std::move( theValue ) ) {}
+
+    unique_ptr< int >   m_value;
+};
+
+
+void* poolProc( void* theParam )
+{
+    NobjectPool< Widget >& pool = *(NobjectPool< Widget >*)theParam;
+    vector< Widget* > widgets;
+    for ( int round = 0; round < 100; round++ )
+        {
+        for ( int i = 0; i < 50; i++ )
+            widgets.push_back( pool.create( i, "w" ) );
+        for ( size_t i = 0; i < widgets.size(); i++ )
+            pool.destroy( widgets[i] );
+        widgets.clear();
+        }
+    return NULL;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+
+    Narena arena( 1024 );
+    char* a = (char*)arena.allocate( 10, 1 );
+    char* b = (char*)arena.allocate( 8, 8 );
+    ok &= check( "arena: bump and align", ( b >= a + 10 ) && ( ( (uintptr_t)b & 7 ) == 0 ) );
+    arena.allocate( 4000 );  // Bigger than a chunk
+    ok &= check( "arena: oversized allocation", arena.getMetrics().chunksAllocated == 2 );
+    arena.reset();
+    ok &= check( "arena: reset keeps first chunk", ( arena.allocate( 10, 1 ) == a ) && ( arena.getMetrics().bytesReserved == 1024 ) );
+
+    vector< int, NarenaAllocator< int > > numbers( ( NarenaAllocator< int >( arena ) ) );
+    for ( int i = 0; i < 1000; i++ )
+        numbers.push_back( i );
+    ok &= check( "arena allocator: vector", ( numbers[999] == 999 ) && ( arena.getMetrics().allocations > 2 ) );
+
+    map< int, int, less< int >, NarenaAllocator< pair< const int, int > > > squares;
+    for ( int i = 0; i < 100; i++ )
+        squares[i] = i * i;
+    ok &= check( "arena allocator: thread's own arena", ( squares[12] == 144 ) && ( Narena::forThread().getMetrics().allocations == 100 ) );
+
+    NobjectPool< Widget > pool( 16 );
+    Widget* w = pool.create( 42, "answer" );
+    ok &= check( "object pool: constructs", ( w->m_value == 42 ) && ( w->m_name == "answer" ) && ( constructed == 1 ) );
+    pool.destroy( w );
+    Widget* again = pool.create( 1, "again" );
+    ok &= check( "object pool: reuses freed block", ( again == w ) && ( destroyed == 1 ) && ( pool.getMetrics().chunksAllocated == 1 ) );
+    pool.destroy( again );
+
+    NobjectPool< Owner > owners;
+    unique_ptr< int > value( new int( 7 ) );
+    Owner* owner = owners.create( std::move( value ) );
+    ok &= check( "object pool: forwards arguments", ( *owner->m_value == 7 ) && !value );
+    owners.destroy( owner );
+
+    Nthread t1( poolProc, &pool );
+    Nthread t2( poolProc, &pool );
+    t1.getReturnValue();
+    t2.getReturnValue();
+    NblockPool::POOL_METRICS m = pool.getMetrics();
+    ok &= check( "object pool: threads", ( constructed == destroyed ) && ( m.blocksInUse == 0 ) && ( m.chunksAllocated <= 7 ) );
+
+    ok &= check( "shared block pool", ( &NblockPool::shared( 100 ) == &NblockPool::shared( 100 ) ) &&
+                                      ( &NblockPool::shared( 100 ) != &NblockPool::shared( 200 ) ) );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,175 @@
+// Time per operation for Nbinary against the '0'/'1' string it used to be stored as, at a few
+// lengths. The string versions of the operations Nbinary didn't have are done the way callers
+// had to, a character at a time.
+// Build with: make TARGET=bench  (use the release CFLAGS in the makefile for meaningful numbers)
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <stdlib.h>
+
+#include "nbinary.h"
+#include "nerror.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static volatile size_t sink;
+
+
+// Nbinary v1.1's setByHex(), getAsInt() and setBitLength(), and the string equivalents of the
+// operators.
+static string oldSetByHex( const string& theHex )
+{
+    static const char* nibbles[] = { "0000", "0001", "0010", "0011", "0100", "0101", "0110", "0111",
+                                     "1000", "1001", "1010", "1011", "1100", "1101", "1110", "1111" };
+    string in( theHex );
+    string value;
+    while ( in.size() )
+        {
+        char c = in[0];
+        value += nibbles[ ( c <= '9' ) ? c - '0' : c - 'A' + 10 ];
+        in.erase( 0, 1 );
+        }
+    return value;
+}
+
+
+static unsigned long long oldGetAsInt( const string& theValue )
+{
+    unsigned long long b = 1;
+    unsigned long long r = 0;
+    for ( int i = theValue.size() - 1; i >= 0; i-- )
+        {
+        if ( theValue[i] == '1' )
+            r = r + b;
+        b = b * 2;
+        }
+    return r;
+}
+
+
+static string oldSetBitLength( const string& theValue, const size_t theLength )
+{
+    int change = theLength - theValue.length();
+    string tempValue = theValue;
+    while ( change < 0 && tempValue.length() )
+        {
+        tempValue = tempValue.substr( 1, tempValue.length() - 1 );
+        change++;
+        }
+    if ( change > 0 )
+        tempValue = string( change, '0' ) + tempValue;
+    return tempValue;
+}
+
+
+static string oldXor( const string& theA, const string& theB )
+{
+    string result( theA.size(), '0' );
+    for ( size_t i = 0; i < theA.size(); i++ )
+        result[i] = ( theA[i] != theB[i] ) ? '1' : '0';
+    return result;
+}
+
+
+static string oldShiftLeft( const string& theValue, const size_t theBits )
+{
+    return theValue.substr( theBits ) + string( theBits, '0' );
+}
+
+
+static string oldAdd( const string& theA, const string& theB )
+{
+    string result( theA.size(), '0' );
+    int carry = 0;
+    for ( size_t i = theA.size(); i > 0; i-- )
+        {
+        int sum = ( theA[ i - 1 ] == '1' ) + ( theB[ i - 1 ] == '1' ) + carry;
+        result[ i - 1 ] = ( sum & 1 ) ? '1' : '0';
+        carry = sum >> 1;
+        }
+    return result;
+}
+
+
+static size_t oldCountOnes( const string& theValue )
+{
+    size_t ones = 0;
+    for ( size_t i = 0; i < theValue.size(); i++ )
+        ones += ( theValue[i] == '1' );
+    return ones;
+}
+
+
+static string oldGetField( const string& theValue, const size_t thePosition, const size_t theWidth )
+{
+    return theValue.substr( theValue.size() - thePosition - theWidth, theWidth );
+}
+
+
+static void report( const Ntime& theStart, const int theRepeats )
+{
+    cout << setw( 12 ) << elapsedNs( theStart ) / theRepeats;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    cout << fixed << setprecision( 1 ) << "ns per operation, string / Nbinary" << endl << setw( 16 ) << "";
+    const size_t lengths[] = { 64, 1024, 16384 };
+    for ( size_t l = 0; l < 3; l++ )
+        cout << setw( 18 ) << lengths[l] << " bits";
+    cout << endl;
+
+    static const char* operations[] = { "setByHex", "getAsInt", "setBitLength", "xor", "shift", "add", "countOnes", "field" };
+    for ( size_t op = 0; op < sizeof( operations ) / sizeof( operations[0] ); op++ )
+        {
+        cout << setw( 16 ) << operations[ op ];
+        for ( size_t l = 0; l < 3; l++ )
+            {
+            size_t bits = lengths[l];
+            string hex;
+            for ( size_t i = 0; i < bits / 4; i++ )
+                hex += "0123456789ABCDEF"[ rand() % 16 ];
+            string a = oldSetByHex( hex );
+            string b = oldSetByHex( string( hex.rbegin(), hex.rend() ) );
+            Nbinary na( "0x" + hex );
+            Nbinary nb( "0x" + string( hex.rbegin(), hex.rend() ) );
+            const int repeats = ( 4 * 1024 * 1024 ) / bits;
+
+            for ( int form = 0; form < 2; form++ )
+                {
+                Ntime start = Ntime::getCurrentLocalTime();
+                for ( int r = 0; r < repeats; r++ )
+                    switch ( op * 2 + form )
+                        {
+                        case 0:  sink = oldSetByHex( hex ).size(); break;
+                        case 1:  na.setByHex( hex ); sink = na.length(); break;
+                        case 2:  sink = oldGetAsInt( oldSetBitLength( a, 64 ) ); break;
+                        case 3:  sink = na.getAsInt( true ); break;
+                        case 4:  sink = oldSetBitLength( a, bits / 2 ).size(); break;
+                        case 5:  { Nbinary t( na ); t.setBitLength( bits / 2, true ); sink = t.length(); } break;
+                        case 6:  sink = oldXor( a, b ).size(); break;
+                        case 7:  sink = ( na ^ nb ).length(); break;
+                        case 8:  sink = oldShiftLeft( a, 13 ).size(); break;
+                        case 9:  sink = ( na << 13 ).length(); break;
+                        case 10: sink = oldAdd( a, b ).size(); break;
+                        case 11: sink = ( na + nb ).length(); break;
+                        case 12: sink = oldCountOnes( a ); break;
+                        case 13: sink = na.countOnes(); break;
+                        case 14: sink = oldGetAsInt( oldGetField( a, bits / 3, 40 ) ); break;
+                        case 15: sink = na.getBits( bits / 3, 40 ); break;
+                        }
+                if ( form )
+                    cout << " / ";
+                report( start, repeats );
+                }
+            }
+        cout << endl;
+        }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+// Checks Nbinary's packed storage against the string behaviour it replaced, including values
+// over 64 bits and assigning bits through operator[].
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+
+#include "nerror.h"
+#include "nbinary.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static bool throws( void ( *theTest )() )
+{
+    try
+        {
+        theTest();
+        }
+    catch ( NerrorException& e )
+        {
+        return true;
+        }
+    return false;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+
+    Nbinary max( ~0ULL );
+    ok &= check( "largest integer", ( max.length() == 64 ) && ( max.getAsInt() == ~0ULL ) && ( max.countOnes() == 64 ) &&
+                                    ( max.getAsHex() == "FFFFFFFFFFFFFFFF" ) );
+    ok &= check( "zero", ( Nbinary( 0ULL ).length() == 0 ) && ( Nbinary( 0ULL, 8 ).getAsBinary() == "00000000" ) &&
+                         ( Nbinary( 0ULL, 8 ).getAsHex() == "0" ) );
+
+    // 100 bits, across two words
+    string bits = "1011001110001111000011111000001111110000000111111110000000001111111111000000000001111111111110000001";
+    Nbinary wide( "0b" + bits );
+    ok &= check( "wide binary", ( wide.length() == 100 ) && ( wide.getAsBinary() == bits ) );
+    ok &= check( "wide hex", ( Nbinary( "0x" + wide.getAsHex() ).getAsBinary() == bits ) && ( wide.getAsHex() == "B38F0F83F01FE00FFC007FF81" ) );
+
+    size_t ones = 0;
+    bool same = true;
+    for ( size_t i = 0; i < bits.size(); i++ )
+        {
+        ones += ( bits[i] == '1' );
+        same &= ( wide[ i ] == bits[i] ) && ( wide.getBit( bits.size() - 1 - i ) == ( bits[i] == '1' ) );
+        }
+    ok &= check( "indexing", same && ( wide.countOnes() == ones ) );
+
+    Nbinary copy( wide );
+    copy[0] = '0';
+    copy[99] = '0';
+    copy[50] = copy[0];
+    copy.setBit( 1, false );
+    copy[ 60 ] = 1;
+    string expected = bits;
+    expected[0] = '0';
+    expected[99] = '0';
+    expected[50] = '0';
+    expected[98] = '0';
+    expected[60] = '1';
+    ok &= check( "assigning bits", ( copy.getAsBinary() == expected ) && !( copy == wide ) );
+
+    Nbinary grown( wide );
+    grown.setBitLength( 130 );
+    ok &= check( "lengthen", ( grown.getAsBinary() == string( 30, '0' ) + bits ) && ( grown.getAsHex() == wide.getAsHex() ) );
+    ok &= check( "shorten", grown.setBitLength( 100 ) && ( grown == wide ) );
+    ok &= check( "truncate", !grown.setBitLength( 64, true ) && ( grown.getAsBinary() == bits.substr( 36 ) ) );
+    ok &= check( "truncate without permission", throws( []() { Nbinary( "0b1100" ).setBitLength( 3 ); } ) );
+
+    ok &= check( "spaces ignored", Nbinary( "0b1010 0101" ).getAsBinary() == "10100101" && Nbinary( "0xA 5" ).getAsInt() == 0xA5 );
+    ok &= check( "bad hex", throws( []() { Nbinary( "0x12G4" ); } ) );
+    ok &= check( "bad binary", throws( []() { Nbinary( "0b1021" ); } ) );
+    ok &= check( "bad bit", throws( []() { Nbinary b( "0b1" ); b[0] = 'x'; } ) );
+    ok &= check( "bit out of range", throws( []() { Nbinary b( "0b1" ); b.setBit( 1 ); } ) );
+    ok &= check( "too big for its length", throws( []() { Nbinary( 256, 8 ); } ) && !Nbinary().setByInt( 256, 8, true ) );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,129 @@
+// Checks Nbinary's operators and bit fields against unsigned __int128 arithmetic, for random
+// values of random lengths up to 128 bits, and fields across word boundaries.
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+
+#include "nerror.h"
+#include "nbinary.h"
+#include "../ntest.h"
+
+using namespace std;
+
+typedef unsigned __int128 UINT128;
+
+static UINT128 mask( const size_t theBits )
+{
+    return ( theBits >= 128 ) ? ~(UINT128)0 : ( (UINT128)1 << theBits ) - 1;
+}
+
+
+static UINT128 random128( const size_t theBits )
+{
+    UINT128 value = 0;
+    for ( int i = 0; i < 8; i++ )
+        value = ( value << 16 ) | ( rand() & 0xFFFF );
+    return value & mask( theBits );
+}
+
+
+static Nbinary toNbinary( const UINT128 theValue, const size_t theBits )
+{
+    Nbinary value( (unsigned long long)theValue, theBits ? theBits : 1, true );
+    value.setBitLength( theBits, true );
+    if ( theBits > 64 )
+        value.setBits( 64, theBits - 64, (unsigned long long)( theValue >> 64 ) );
+    return value;
+}
+
+
+static bool is( const Nbinary& theValue, const UINT128 theExpected, const size_t theBits )
+{
+    return ( theValue.length() == theBits ) && ( theValue.getField( 0, theBits ) == toNbinary( theExpected, theBits ) ) &&
+           ( ( theBits <= 64 ) || ( theValue.getBits( 64, theBits - 64 ) == (unsigned long long)( theExpected >> 64 ) ) ) &&
+           ( (UINT128)theValue.getAsInt( true ) == ( theExpected & mask( 64 ) ) );
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+    bool bitwise = true, arithmetic = true, shifts = true, compares = true, fields = true;
+    srand( 1 );
+
+    for ( int test = 0; test < 20000; test++ )
+        {
+        size_t bitsA = 1 + rand() % 128;
+        size_t bitsB = 1 + rand() % 128;
+        size_t bits = ( bitsA > bitsB ) ? bitsA : bitsB;
+        UINT128 a = random128( bitsA );
+        UINT128 b = ( test % 4 ) ? random128( bitsB ) : a & mask( bitsB );  // Sometimes equal
+        Nbinary na = toNbinary( a, bitsA );
+        Nbinary nb = toNbinary( b, bitsB );
+
+        bitwise &= is( na & nb, a & b, bits ) && is( na | nb, a | b, bits ) && is( na ^ nb, a ^ b, bits ) &&
+                   is( ~na, ~a & mask( bitsA ), bitsA );
+        arithmetic &= is( na + nb, ( a + b ) & mask( bits ), bits ) && is( na - nb, ( a - b ) & mask( bits ), bits );
+
+        size_t shift = rand() % 140;
+        shifts &= is( na << shift, ( shift < 128 ) ? ( a << shift ) & mask( bitsA ) : 0, bitsA ) &&
+                  is( na >> shift, ( shift < 128 ) ? a >> shift : 0, bitsA );
+
+        compares &= ( ( na < nb ) == ( a < b ) ) && ( ( na > nb ) == ( a > b ) ) && ( ( na <= nb ) == ( a <= b ) ) &&
+                    ( ( na >= nb ) == ( a >= b ) ) && ( ( na.compare( nb ) == 0 ) == ( a == b ) );
+
+        size_t position = rand() % bitsA;
+        size_t width = 1 + rand() % ( bitsA - position );
+        UINT128 field = random128( width );
+        Nbinary set( na );
+        set.setField( position, toNbinary( field, width ) );
+        fields &= is( na.getField( position, width ), ( a >> position ) & mask( width ), width ) &&
+                  is( set, ( a & ~( mask( width ) << position ) ) | ( field << position ), bitsA );
+        if ( width <= 64 )
+            {
+            Nbinary setBits( na );
+            setBits.setBits( position, width, (unsigned long long)field | ( ( width < 64 ) ? ~0ULL << width : 0 ) );  // Bits above width ignored
+            fields &= ( na.getBits( position, width ) == (unsigned long long)( ( a >> position ) & mask( width ) ) ) &&
+                      is( setBits, ( a & ~( mask( width ) << position ) ) | ( field << position ), bitsA );
+            }
+        }
+
+    ok &= check( "bitwise", bitwise );
+    ok &= check( "add and subtract", arithmetic );
+    ok &= check( "shifts", shifts );
+    ok &= check( "compare", compares );
+    ok &= check( "bit fields", fields );
+
+    // Longer than anything native
+    Nbinary big( "0x" + string( 300, 'F' ) );
+    Nbinary one( 1ULL );
+    ok &= check( "carry through 1200 bits", ( ( big + one ).countOnes() == 0 ) && ( ( big + one ).length() == 1200 ) );
+    ok &= check( "borrow through 1200 bits", ( Nbinary( 0ULL, 1200 ) - one ) == big );
+    ok &= check( "long shifts", ( ( big << 1000 ) >> 1000 ).countOnes() == 200 && ( ( big >> 1199 ) == Nbinary( 1ULL, 1200 ) ) );
+
+    bool threw = false;
+    try
+        {
+        big.getAsInt();
+        }
+    catch ( NerrorException& e )
+        {
+        threw = true;
+        }
+    ok &= check( "getAsInt won't truncate", threw && ( big.getAsInt( true ) == ~0ULL ) && ( ( big >> 1136 ).getAsInt() == ~0ULL ) );
+
+    threw = false;
+    try
+        {
+        big.getBits( 1190, 11 );
+        }
+    catch ( NerrorException& e )
+        {
+        threw = true;
+        }
+    ok &= check( "field out of range", threw );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
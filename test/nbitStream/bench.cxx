@@ -0,0 +1,90 @@
+// ns per decoded CAN frame ( four fields from 8 bytes ) a bit at a time, through an Nbinary built
+// from the payload, with NbitStream and with NbitField, and the loop alone.
+// Build with: make TARGET=bench  (use the release CFLAGS in the makefile for meaningful numbers)
+#include <iostream>
+#include <iomanip>
+#include <stdlib.h>
+
+#include "nbinary.h"
+#include "nbitStream.h"
+#include "nerror.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static volatile uint64_t sink;
+
+typedef NbitField< 0, 16 > SPEED;
+typedef NbitField< 16, 4 > GEAR;
+typedef NbitField< 24, 12, NbitStream::MSB_FIRST, int16_t > TORQUE;
+typedef NbitField< 37, 27 > ODOMETER;
+
+
+static uint64_t bitwise( const uint8_t* theFrame, const size_t thePosition, const unsigned theWidth, const bool theMsbFirst )
+{
+    uint64_t value = 0;
+    for ( unsigned i = 0; i < theWidth; i++ )
+        {
+        size_t bit = thePosition + i;
+        if ( theMsbFirst )
+            value = ( value << 1 ) | ( ( theFrame[ bit / 8 ] >> ( 7 - bit % 8 ) ) & 1 );
+        else
+            value |= (uint64_t)( ( theFrame[ bit / 8 ] >> ( bit % 8 ) ) & 1 ) << i;
+        }
+    return value;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    const size_t frames = 4096;
+    static uint8_t data[ frames ][ 8 ];
+    for ( size_t f = 0; f < frames; f++ )
+        for ( int i = 0; i < 8; i++ )
+            data[f][i] = rand();
+    const int repeats = 200;
+
+    cout << fixed << setprecision( 2 ) << "ns per frame" << endl;
+    static const char* methods[] = { "bit at a time", "Nbinary", "NbitStream", "NbitField", "loop alone" };
+    for ( int method = 0; method < 5; method++ )
+        {
+        Ntime start = Ntime::getCurrentLocalTime();
+        for ( int r = 0; r < repeats; r++ )
+            for ( size_t f = 0; f < frames; f++ )
+                {
+                const uint8_t* frame = data[f];
+                switch ( method )
+                    {
+                    case 0:
+                        sink = bitwise( frame, 0, 16, false ) + bitwise( frame, 16, 4, false ) +
+                               bitwise( frame, 24, 12, true ) + bitwise( frame, 37, 27, false );
+                        break;
+                    case 1:
+                        {
+                        // Nbinary numbers bits from the least significant, so this is the little endian fields only
+                        Nbinary payload( 0ULL, 64 );
+                        for ( int i = 0; i < 8; i++ )
+                            payload.setBits( i * 8, 8, frame[i] );
+                        sink = payload.getBits( 0, 16 ) + payload.getBits( 16, 4 ) + payload.getBits( 37, 27 );
+                        }
+                        break;
+                    case 2:
+                        sink = NbitStream::read( frame, 8, 0, 16 ) + NbitStream::read( frame, 8, 16, 4 ) +
+                               NbitStream::read( frame, 8, 24, 12, NbitStream::MSB_FIRST ) + NbitStream::read( frame, 8, 37, 27 );
+                        break;
+                    case 3:
+                        sink = SPEED::read( data[f] ) + GEAR::read( data[f] ) + TORQUE::read( data[f] ) + ODOMETER::read( data[f] );
+                        break;
+                    case 4:
+                        sink = frame[0];
+                        break;
+                    }
+                }
+        cout << setw( 16 ) << methods[ method ] << setw( 10 ) << elapsedNs( start ) / ( repeats * frames ) << endl;
+        }
+
+    return EXIT_SUCCESS;
+}
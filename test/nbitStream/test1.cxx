@@ -0,0 +1,165 @@
+// Checks NbitStream against reading and writing a bit at a time, for random fields in both bit
+// orders, including fields at the end of the buffer and 64 bit fields straddling 9 bytes.
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nbitStream.h"
+#include "nerror.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static bool throws( void ( *theTest )() )
+{
+    try
+        {
+        theTest();
+        }
+    catch ( NerrorException& e )
+        {
+        return true;
+        }
+    return false;
+}
+
+
+static int getBit( const uint8_t* theBuffer, const size_t theBit, const NbitStream::BIT_ORDER theOrder )
+{
+    int shift = ( theOrder == NbitStream::LSB_FIRST ) ? theBit % 8 : 7 - theBit % 8;
+    return ( theBuffer[ theBit / 8 ] >> shift ) & 1;
+}
+
+
+static void setBit( uint8_t* theBuffer, const size_t theBit, const int theValue, const NbitStream::BIT_ORDER theOrder )
+{
+    int shift = ( theOrder == NbitStream::LSB_FIRST ) ? theBit % 8 : 7 - theBit % 8;
+    theBuffer[ theBit / 8 ] = ( theBuffer[ theBit / 8 ] & ~( 1 << shift ) ) | ( theValue << shift );
+}
+
+
+// A bit at a time: LSB_FIRST fields start with their least significant bit, MSB_FIRST with their most.
+static uint64_t referenceRead( const uint8_t* theBuffer, const size_t thePosition, const unsigned theWidth, const NbitStream::BIT_ORDER theOrder )
+{
+    uint64_t value = 0;
+    for ( unsigned i = 0; i < theWidth; i++ )
+        if ( theOrder == NbitStream::LSB_FIRST )
+            value |= (uint64_t)getBit( theBuffer, thePosition + i, theOrder ) << i;
+        else
+            value = ( value << 1 ) | getBit( theBuffer, thePosition + i, theOrder );
+    return value;
+}
+
+
+static void referenceWrite( uint8_t* theBuffer, const size_t thePosition, const unsigned theWidth, const uint64_t theValue, const NbitStream::BIT_ORDER theOrder )
+{
+    for ( unsigned i = 0; i < theWidth; i++ )
+        setBit( theBuffer, thePosition + i, ( theValue >> ( ( theOrder == NbitStream::LSB_FIRST ) ? i : theWidth - 1 - i ) ) & 1, theOrder );
+}
+
+
+static uint64_t random64()
+{
+    uint64_t value = 0;
+    for ( int i = 0; i < 4; i++ )
+        value = ( value << 16 ) | ( rand() & 0xFFFF );
+    return value;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+    srand( 1 );
+
+    for ( int order = NbitStream::LSB_FIRST; order <= NbitStream::MSB_FIRST; order++ )
+        {
+        NbitStream::BIT_ORDER bitOrder = (NbitStream::BIT_ORDER)order;
+        bool reads = true, writes = true, signedReads = true, ends = true;
+        for ( int test = 0; test < 100000; test++ )
+            {
+            uint8_t buffer[ 24 ];
+            size_t length = 1 + rand() % sizeof( buffer );
+            for ( size_t i = 0; i < sizeof( buffer ); i++ )
+                buffer[i] = rand();
+
+            unsigned width = 1 + rand() % ( ( length * 8 < 64 ) ? length * 8 : 64 );
+            if ( test % 8 == 0 )
+                width = ( length * 8 < 64 ) ? length * 8 : 64;
+            size_t position = rand() % ( length * 8 - width + 1 );
+            if ( test % 8 == 1 )
+                position = length * 8 - width;   // Up against the end
+
+            reads &= NbitStream::read( buffer, length, position, width, bitOrder ) == referenceRead( buffer, position, width, bitOrder );
+            int64_t expected = referenceRead( buffer, position, width, bitOrder );
+            if ( ( width < 64 ) && ( expected >> ( width - 1 ) ) )
+                expected -= (int64_t)1 << ( width - 1 ) << 1;
+            signedReads &= NbitStream::readSigned( buffer, length, position, width, bitOrder ) == expected;
+
+            uint8_t written[ 24 ];
+            uint8_t reference[ 24 ];
+            memcpy( written, buffer, sizeof( buffer ) );
+            memcpy( reference, buffer, sizeof( buffer ) );
+            uint64_t value = random64();
+            NbitStream::write( written, length, position, width, value, bitOrder );
+            referenceWrite( reference, position, width, value, bitOrder );
+            writes &= memcmp( written, reference, sizeof( buffer ) ) == 0;      // Including the bytes past length
+            if ( position + width == length * 8 )
+                ends &= ( memcmp( written, reference, sizeof( buffer ) ) == 0 );
+            }
+        string name = ( bitOrder == NbitStream::LSB_FIRST ) ? "LSB_FIRST " : "MSB_FIRST ";
+        ok &= check( name + "read", reads );
+        ok &= check( name + "readSigned", signedReads );
+        ok &= check( name + "write", writes );
+        ok &= check( name + "fields at the end", ends );
+        }
+
+    // Cursors: a field of every width from 1 to 64, one after another over 9 byte boundaries
+    uint8_t stream[ 300 ];
+    memset( stream, 0xA5, sizeof( stream ) );
+    bool cursors = true;
+    for ( int order = NbitStream::LSB_FIRST; order <= NbitStream::MSB_FIRST; order++ )
+        {
+        srand( 2 );
+        NbitWriter writer( stream, sizeof( stream ), (NbitStream::BIT_ORDER)order );
+        writer.skip( 3 );
+        for ( unsigned width = 1; width <= 64; width++ )
+            writer.write( width, random64() );
+        srand( 2 );
+        NbitReader reader( stream, sizeof( stream ), (NbitStream::BIT_ORDER)order );
+        reader.skip( 3 );
+        for ( unsigned width = 1; width <= 64; width++ )
+            cursors &= reader.read( width ) == ( random64() & ( ~0ULL >> ( 64 - width ) ) );
+        cursors &= ( reader.getPosition() == 3 + 64 * 65 / 2 ) && ( reader.getRemaining() == sizeof( stream ) * 8 - reader.getPosition() ) &&
+                   ( writer.getPosition() == reader.getPosition() );
+        }
+    ok &= check( "reader and writer", cursors );
+
+    // An example CAN frame: little endian 16 bit speed at bit 0, signed 12 bit Motorola torque
+    // from bit 24, a 4 bit gear and a flag
+    typedef NbitField< 0, 16 > SPEED;
+    typedef NbitField< 24, 12, NbitStream::MSB_FIRST, int16_t > TORQUE;
+    typedef NbitField< 16, 4, NbitStream::LSB_FIRST, uint8_t > GEAR;
+    typedef NbitField< 63, 1, NbitStream::LSB_FIRST, bool > FLAG;
+    uint8_t frame[ 8 ] = { 0x34, 0x12, 0x05, 0xF8, 0x30, 0x00, 0x00, 0x80 };
+    ok &= check( "NbitField read", ( SPEED::read( frame ) == 0x1234 ) && ( GEAR::read( frame ) == 5 ) && ( TORQUE::read( frame ) == -125 ) &&
+                                    FLAG::read( frame ) && ( SPEED::read( frame, 2 ) == 0x1234 ) );
+    TORQUE::write( frame, 1000 );
+    GEAR::write( frame, 9 );
+    FLAG::write( frame, false );
+    ok &= check( "NbitField write", ( TORQUE::read( frame ) == 1000 ) && ( GEAR::read( frame ) == 9 ) && !FLAG::read( frame ) &&
+                                     ( SPEED::read( frame ) == 0x1234 ) && ( frame[2] == 0x09 ) && ( frame[3] == 0x3E ) && ( frame[4] == 0x80 ) &&
+                                     ( frame[7] == 0x00 ) );
+
+    ok &= check( "past the end", throws( []() { uint8_t b[ 8 ]; NbitStream::read( b, 8, 60, 5 ); } ) &&
+                                 throws( []() { uint8_t b[ 8 ]; NbitStream::write( b, 8, 65, 0, 0 ); } ) &&
+                                 throws( []() { uint8_t b[ 8 ]; NbitReader r( b, 8 ); r.read( 64 ); r.read( 1 ); } ) &&
+                                 throws( []() { uint8_t b[ 2 ]; NbitField< 8, 9 >::read( b, 2 ); } ) );
+    ok &= check( "bad widths", throws( []() { uint8_t b[ 16 ]; NbitStream::read( b, 16, 0, 65 ); } ) &&
+                               throws( []() { uint8_t b[ 16 ]; NbitStream::read( b, 16, 0, 0 ); } ) );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
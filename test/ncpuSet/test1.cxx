@@ -0,0 +1,83 @@
+// Checks NcpuSet parsing, set algebra and use as thread and process affinity.
+#include <iostream>
+#include <string>
+
+#include "ncpuSet.h"
+#include "nerror.h"
+#include "nprocess.h"
+#include "nthread.h"
+#include "../ntest.h"
+
+using namespace std;
+
+void* affinityProc( void* theParam )
+{
+    *(NcpuSet*)theParam = NcpuSet::current();
+    return NULL;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+
+    NcpuSet list( "0-3,8,10-11,130" );
+    ok &= check( "list", ( list.count() == 8 ) && list.isSet( 130 ) && !list.isSet( 9 ) && ( list.getAsString() == "0-3,8,10-11,130" ) );
+    ok &= check( "above 64 cores", ( list.getNativeSize() == 3 * sizeof( unsigned long ) ) && CPU_ISSET_S( 130, list.getNativeSize(), list.getNative() ) );
+    ok &= check( "bitmasks", ( NcpuSet( "0x0F" ) == NcpuSet( "0-3" ) ) && ( NcpuSet( "0b1010" ) == NcpuSet( "1,3" ) ) &&
+                             ( NcpuSet( 0x101ULL ) == NcpuSet( "0,8" ) ) && ( NcpuSet( "0x1" + string( 32, '0' ) ) == NcpuSet( "128" ) ) );
+    ok &= check( "getAsInt", NcpuSet( "0,5,64" ).getAsInt() == 0x21 );
+
+    NcpuSet a( "0-7" );
+    NcpuSet b( "4-11,200" );
+    ok &= check( "union", ( a | b ) == NcpuSet( "0-11,200" ) );
+    ok &= check( "intersection", ( a & b ) == NcpuSet( "4-7" ) );
+    ok &= check( "difference", ( b - a ) == NcpuSet( "8-11,200" ) );
+    ok &= check( "equal with different sizes", ( ( b - NcpuSet( "200" ) ) == NcpuSet( "4-11" ) ) && ( NcpuSet() == NcpuSet( "" ) ) );
+
+    int visited = 0;
+    int sum = 0;
+    for ( int cpu = b.first(); cpu != -1; cpu = b.next( cpu ) )
+        {
+        visited++;
+        sum += cpu;
+        }
+    ok &= check( "iterate", ( visited == 9 ) && ( sum == 4 + 5 + 6 + 7 + 8 + 9 + 10 + 11 + 200 ) && ( NcpuSet().first() == -1 ) );
+
+    // Signs, numbers too big for a CPU and ranges that would never end
+    const char* badLists[] = { "1-x", "-1", "0--1", "+1", " 1", "4294967296", "0-18446744073709551615",
+                               "0-4000000000", "99999999999999999999999" };
+    int threw = 0;
+    for ( size_t i = 0; i < sizeof( badLists ) / sizeof( badLists[0] ); i++ )
+        try
+            {
+            NcpuSet bad( badLists[i] );
+            }
+        catch ( NerrorException& e )
+            {
+            threw++;
+            }
+    ok &= check( "bad list", threw == sizeof( badLists ) / sizeof( badLists[0] ) );
+    ok &= check( "highest CPU", NcpuSet( "1048575" ).isSet( 1048575 ) );
+
+    ok &= check( "all", ( NcpuSet::all().count() == NcpuSet::getCpuCount() ) && ( ( NcpuSet::current() - NcpuSet::all() ).isEmpty() ) );
+
+    NcpuSet seen;
+    Nthread::THREAD_ATTRIBUTES attributes;
+    attributes.affinity = NcpuSet( "0" );
+    Nthread pinned( affinityProc, &seen, attributes );
+    pinned.getReturnValue();
+    ok &= check( "thread affinity", seen == NcpuSet( "0" ) );
+
+    Nthread thread( affinityProc, &seen );
+    thread.setThreadAffinity( NcpuSet( "0" ) );
+    ok &= check( "get thread affinity", thread.getThreadAffinity() == NcpuSet( "0" ) );
+    thread.getReturnValue();
+
+    Nprocess::setOurAffinity();
+    ok &= check( "process affinity", NcpuSet::current() == NcpuSet::all() );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
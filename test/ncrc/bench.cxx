@@ -0,0 +1,117 @@
+// CRC-32, CRC-32C and CRC-64 throughput in GB/s for each implementation the CPU supports,
+// and for some Ncrc CRCs, from 64 bytes to 64MB. Then CRC-32 of large buffers in parallel, with
+// pools of 1 up to as many threads as there are CPUs.
+// Build with: make TARGET=bench  (use the release CFLAGS in the makefile for meaningful numbers)
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <thread>
+
+#include "ncrc.h"
+#include "nerror.h"
+#include "nthreadPool.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static const size_t BYTES_PER_TEST = 256 * 1024 * 1024;
+
+static vector< size_t > sizes;
+static vector< unsigned char > testData;
+static volatile unsigned long long sink;
+
+
+template< typename CRC >
+static void bench( const char* theName,
+                   CRC ( *theCompute )( const unsigned char*, const size_t, const CRC ),
+                   const vector< string >& theImplementations,
+                   bool ( *theSetImplementation )( const char* ) )
+{
+    cout << endl << setw( 10 ) << theName;
+    for ( size_t i = 0; i < theImplementations.size(); i++ )
+        cout << setw( 16 ) << theImplementations[i];
+    cout << endl;
+
+    for ( size_t s = 0; s < sizes.size(); s++ )
+        {
+        cout << setw( 10 ) << sizes[s];
+        size_t repeats = BYTES_PER_TEST / sizes[s];
+        for ( size_t i = 0; i < theImplementations.size(); i++ )
+            {
+            theSetImplementation( theImplementations[i].c_str() );
+            CRC crc = 0;
+            Ntime start = Ntime::getCurrentLocalTime();
+            for ( size_t r = 0; r < repeats; r++ )
+                crc = theCompute( &testData[0], sizes[s], crc );
+            cout << setw( 16 ) << ( repeats * sizes[s] ) / elapsedNs( start );
+            }
+        cout << endl;
+        }
+    theSetImplementation( "" );
+}
+
+
+template< typename CRC >
+static double benchNcrc( const size_t theSize )
+{
+    size_t repeats = BYTES_PER_TEST / theSize;
+    CRC crc;
+    Ntime start = Ntime::getCurrentLocalTime();
+    for ( size_t r = 0; r < repeats; r++ )
+        crc.update( &testData[0], theSize );
+    double gbps = ( repeats * theSize ) / elapsedNs( start );
+    sink = crc.getValue();  // So it isn't optimised away
+    return gbps;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    for ( size_t size = 64; size <= 64 * 1024 * 1024; size *= 4 )
+        sizes.push_back( size );
+
+    testData.resize( sizes.back() );
+    for ( size_t i = 0; i < testData.size(); i++ )
+        testData[i] = rand();
+
+    cout << fixed << setprecision( 2 ) << "GB/s" << endl;
+    bench( "CRC-32", computeMemoryCrc32, getCrc32Implementations(), setCrc32Implementation );
+    bench( "CRC-32C", computeMemoryCrc32c, getCrc32cImplementations(), setCrc32cImplementation );
+    bench( "CRC-64", computeMemoryCrc64, getCrc64Implementations(), setCrc64Implementation );
+
+    cout << endl << setw( 10 ) << "Ncrc" << setw( 16 ) << "CRC-8/SMBUS" << setw( 16 ) << "CRC-16/MODBUS" << setw( 16 ) << "CRC-21/CAN-FD" << endl;
+    for ( size_t s = 0; s < sizes.size(); s++ )
+        cout << setw( 10 ) << sizes[s] << setw( 16 ) << benchNcrc< Ncrc8Smbus >( sizes[s] )
+                                       << setw( 16 ) << benchNcrc< Ncrc16Modbus >( sizes[s] )
+                                       << setw( 16 ) << benchNcrc< Ncrc21CanFd >( sizes[s] ) << endl;
+
+    cout << endl << setw( 10 ) << "threads";
+    for ( size_t s = 0; s < sizes.size(); s++ )
+        if ( sizes[s] >= 1024 * 1024 )
+            cout << setw( 16 ) << sizes[s];
+    cout << endl;
+    for ( unsigned int threads = 1; threads <= std::thread::hardware_concurrency(); threads *= 2 )
+        {
+        NthreadPool pool( threads - 1 ? threads - 1 : 1 );    // The calling thread takes part too
+        cout << setw( 10 ) << threads;
+        for ( size_t s = 0; s < sizes.size(); s++ )
+            {
+            if ( sizes[s] < 1024 * 1024 )
+                continue;
+            size_t repeats = BYTES_PER_TEST / sizes[s];
+            unsigned long crc = 0;
+            Ntime start = Ntime::getCurrentLocalTime();
+            for ( size_t r = 0; r < repeats; r++ )
+                crc = ( threads > 1 ) ? computeMemoryCrc32( &testData[0], sizes[s], pool, crc ) : computeMemoryCrc32( &testData[0], sizes[s], crc );
+            cout << setw( 16 ) << ( repeats * sizes[s] ) / elapsedNs( start );
+            }
+        cout << endl;
+        }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+// computeFileCrc32 throughput in GB/s on a large file, through stdio, mapped and with O_DIRECT,
+// with the file in the page cache and with it dropped from the cache first.
+// Usage: benchFile [ size in MB ( default 1024 ) [ directory ( default /tmp ) ] ]
+// Build with: make TARGET=benchFile  (use the release CFLAGS in the makefile for meaningful numbers)
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ncrc.h"
+#include "nerror.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static string path;
+static size_t fileSize;
+
+
+static void dropFromCache()
+{
+    int fd = open( path.c_str(), O_RDONLY );
+    fdatasync( fd );
+    posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+    close( fd );
+}
+
+
+static double benchStdio( const bool theCold )
+{
+    if ( theCold )
+        dropFromCache();
+    unsigned long crc;
+    Ntime start = Ntime::getCurrentLocalTime();
+    FILE* file = fopen( path.c_str(), "rb" );
+    if ( !file || !computeFileCrc32( file, &crc ) )
+        EERROR( "benchFile: Can't read ", path );
+    fclose( file );
+    return fileSize / elapsedNs( start );
+}
+
+
+static double benchPath( const CRC_FILE_ACCESS theAccess, const bool theCold )
+{
+    if ( theCold )
+        dropFromCache();
+    unsigned long crc;
+    Ntime start = Ntime::getCurrentLocalTime();
+    if ( !computeFileCrc32( path.c_str(), &crc, theAccess ) )
+        EERROR( "benchFile: Can't read ", path );
+    return fileSize / elapsedNs( start );
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    fileSize = ( ( ac > 1 ) ? strtoul( av[1], NULL, 10 ) : 1024 ) * 1024 * 1024;
+    path = string( ( ac > 2 ) ? av[2] : "/tmp" ) + "/ncrcBenchXXXXXX";
+    int fd = mkstemp( &path[0] );
+    if ( fd < 0 )
+        EERROR( "benchFile: Can't create ", path );
+
+    vector< unsigned char > block( 1024 * 1024 );
+    for ( size_t i = 0; i < block.size(); i++ )
+        block[i] = rand();
+    for ( size_t written = 0; written < fileSize; written += block.size() )
+        if ( write( fd, &block[0], block.size() ) != (ssize_t)block.size() )
+            EERROR( "benchFile: Can't write ", path );
+    fsync( fd );    // Or O_DIRECT's first read waits for it to be written
+    close( fd );
+
+    cout << fixed << setprecision( 2 ) << "GB/s, " << fileSize / ( 1024 * 1024 ) << "MB" << endl;
+    cout << setw( 10 ) << "" << setw( 12 ) << "FILE*" << setw( 12 ) << "mapped" << setw( 12 ) << "O_DIRECT" << endl;
+    for ( int cold = 0; cold <= 1; cold++ )
+        cout << setw( 10 ) << ( cold ? "cold" : "cached" ) << setw( 12 ) << benchStdio( cold )
+                                                          << setw( 12 ) << benchPath( CRC_FILE_MAPPED, cold )
+                                                          << setw( 12 ) << benchPath( CRC_FILE_DIRECT, cold ) << endl;
+
+    unlink( path.c_str() );
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,212 @@
+// Checks that every CRC implementation the CPU supports gives the same results, and that
+// combining CRCs and computing them in parallel does too.
+#include <iostream>
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ncrc.h"
+#include "nerror.h"
+#include "nthreadPool.h"
+#include "../ntest.h"
+
+using namespace std;
+
+// A bit at a time, straight from the definition
+static uint64_t referenceCrc( const uint64_t thePoly, const unsigned int theBits, const unsigned char* theBuffer, const size_t theLength )
+{
+    const uint64_t mask = ~0ULL >> ( 64 - theBits );
+    uint64_t crc = mask;
+    for ( size_t i = 0; i < theLength; i++ )
+        {
+        crc ^= theBuffer[i];
+        for ( int bit = 0; bit < 8; bit++ )
+            crc = ( crc & 1 ) ? ( ( crc >> 1 ) ^ thePoly ) : ( crc >> 1 );
+        }
+    return crc ^ mask;
+}
+
+
+// Each of computeMemoryCrc32 etc, its implementations and its check value
+template< typename CRC >
+struct FAMILY
+    {
+    const char*         name;
+    CRC                 ( *compute )( const unsigned char*, const size_t, const CRC );
+    CRC                 ( *computeParallel )( const unsigned char*, const size_t, NthreadPool&, const CRC );
+    CRC                 ( *combine )( const CRC, const CRC, const unsigned long long );
+    vector< string >    ( *implementations )();
+    const char*         ( *implementation )();
+    bool                ( *setImplementation )( const char* );
+    unsigned int        bits;
+    CRC                 poly;
+    CRC                 checkValue;
+    };
+
+
+static vector< unsigned char > testData;
+static vector< unsigned char > bigData;
+static vector< size_t > lengths;
+
+
+template< typename CRC >
+static bool checkFamily( const FAMILY< CRC >& theFamily, NthreadPool& thePool )
+{
+    bool ok = true;
+    string family = theFamily.name;
+
+    vector< string > implementations = theFamily.implementations();
+    ok &= check( family + ": default is the fastest", implementations.size() && ( implementations[0] == theFamily.implementation() ) );
+
+    for ( size_t i = 0; i < implementations.size(); i++ )
+        {
+        const string name = family + " " + implementations[i];
+        theFamily.setImplementation( implementations[i].c_str() );
+
+        ok &= check( name + ": check value", theFamily.compute( (const unsigned char*)"123456789", 9, 0 ) == theFamily.checkValue );
+
+        bool same = true;
+        for ( size_t l = 0; l < lengths.size(); l++ )
+            for ( size_t offset = 0; offset < 16; offset++ )
+                same &= ( theFamily.compute( &testData[ offset ], lengths[l], 0 ) == referenceCrc( theFamily.poly, theFamily.bits, &testData[ offset ], lengths[l] ) );
+        ok &= check( name + ": matches reference", same );
+
+        bool chained = true;
+        CRC whole = theFamily.compute( &testData[0], testData.size(), 0 );
+        for ( size_t split = 0; split < testData.size(); split += 997 )
+            chained &= ( theFamily.compute( &testData[ split ], testData.size() - split, theFamily.compute( &testData[0], split, 0 ) ) == whole );
+        ok &= check( name + ": chaining", chained );
+        }
+
+    bool combined = true;
+    CRC whole = theFamily.compute( &testData[0], testData.size(), 0 );
+    for ( size_t split = 0; split <= testData.size(); split += 4999 )
+        combined &= ( theFamily.combine( theFamily.compute( &testData[0], split, 0 ),
+                                         theFamily.compute( &testData[ split ], testData.size() - split, 0 ),
+                                         testData.size() - split ) == whole );
+    combined &= ( theFamily.combine( whole, 0, 0 ) == whole );
+    ok &= check( family + ": combine", combined );
+
+    CRC big = theFamily.compute( &bigData[0], bigData.size(), 0 );
+    CRC previous = theFamily.compute( &testData[0], 100, 0 );
+    ok &= check( family + ": parallel", ( theFamily.computeParallel( &bigData[0], bigData.size(), thePool, 0 ) == big ) &&
+                                         ( theFamily.computeParallel( &bigData[0], 5555, thePool, 0 ) == theFamily.compute( &bigData[0], 5555, 0 ) ) &&
+                                         ( theFamily.computeParallel( &bigData[0], bigData.size(), thePool, previous ) ==
+                                           theFamily.compute( &bigData[0], bigData.size(), previous ) ) );
+
+    ok &= check( family + ": unsupported implementation", !theFamily.setImplementation( "abacus" ) );
+    theFamily.setImplementation( "" );
+    ok &= check( family + ": back to the fastest", implementations[0] == theFamily.implementation() );
+    return ok;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+
+    testData.resize( 70000 );
+    srand( 1 );
+    for ( size_t i = 0; i < testData.size(); i++ )
+        testData[i] = rand();
+
+    // Lengths either side of each kernel's block sizes, at every alignment
+    for ( size_t length = 0; length <= 1100; length++ )
+        lengths.push_back( length );
+    lengths.push_back( 4095 );
+    lengths.push_back( 3 * 8192 - 1 );
+    lengths.push_back( 3 * 8192 + 3 * 256 + 7 );
+    lengths.push_back( 65536 + 255 );
+
+    NthreadPool pool( 4 );
+    bigData.resize( 9 * 1024 * 1024 + 12345 );
+    for ( size_t i = 0; i < bigData.size(); i++ )
+        bigData[i] = rand();
+
+    FAMILY< unsigned long > crc32 = { "CRC-32", computeMemoryCrc32, computeMemoryCrc32, combineCrc32, getCrc32Implementations, getCrc32Implementation,
+                                      setCrc32Implementation, 32, 0xEDB88320, 0xCBF43926 };
+    ok &= checkFamily( crc32, pool );
+
+    FAMILY< unsigned long > crc32c = { "CRC-32C", computeMemoryCrc32c, computeMemoryCrc32c, combineCrc32c, getCrc32cImplementations, getCrc32cImplementation,
+                                       setCrc32cImplementation, 32, 0x82F63B78, 0xE3069283 };
+    ok &= checkFamily( crc32c, pool );
+
+    FAMILY< unsigned long long > crc64 = { "CRC-64", computeMemoryCrc64, computeMemoryCrc64, combineCrc64, getCrc64Implementations, getCrc64Implementation,
+                                           setCrc64Implementation, 64, 0xC96C5795D7870F42ULL, 0x995DC9BBDF1939FAULL };
+    ok &= checkFamily( crc64, pool );
+
+    // A file, whole and from part way through, in chunks that don't divide it
+    FILE* file = tmpfile();
+    fwrite( &bigData[0], 1, bigData.size(), file );
+    unsigned long serial = 0, parallel = 1;
+    rewind( file );
+    bool fileOk = computeFileCrc32( file, &serial ) && ( serial == computeMemoryCrc32( &bigData[0], bigData.size() ) );
+    rewind( file );
+    fileOk &= computeFileCrc32( file, &parallel, pool, 100000 ) && ( parallel == serial );
+    fileOk &= ( ftell( file ) == (long)bigData.size() );
+    fseek( file, 1000, SEEK_SET );
+    fileOk &= computeFileCrc32( file, &parallel, pool ) && ( parallel == computeMemoryCrc32( &bigData[1000], bigData.size() - 1000 ) );
+    fclose( file );
+
+    // /proc files are regular but have a size of 0
+    unsigned long procSerial = 0;
+    file = fopen( "/proc/version", "r" );
+    fileOk &= ( file != NULL ) && computeFileCrc32( file, &procSerial ) && !fseek( file, 0, SEEK_SET ) &&
+              computeFileCrc32( file, &parallel, pool ) && ( parallel == procSerial ) && ( procSerial != 0 );
+    if ( file )
+        fclose( file );
+    ok &= check( "CRC-32: file in parallel", fileOk );
+
+    // Can't be mapped, so is read instead
+    unsigned long procMapped = 1;
+    ok &= check( "CRC-32: /proc file by path", computeFileCrc32( "/proc/version", &procMapped, CRC_FILE_MAPPED ) && ( procMapped == procSerial ) );
+
+    // By path and fd, mapped and with O_DIRECT ( or without, where the file system can't )
+    char path[] = "/tmp/ncrcTestXXXXXX";
+    int fd = mkstemp( path );
+    fileOk = ( fd >= 0 ) && ( write( fd, &bigData[0], bigData.size() ) == (ssize_t)bigData.size() );
+    unsigned long mapped = 0, direct = 1;
+    fileOk &= computeFileCrc32( path, &mapped ) && ( mapped == serial );
+    fileOk &= computeFileCrc32( path, &direct, CRC_FILE_DIRECT ) && ( direct == serial );
+    ok &= check( "CRC-32: file by path", fileOk );
+
+    fileOk = true;
+    for ( int access = CRC_FILE_MAPPED; access <= CRC_FILE_DIRECT; access++ )
+        {
+        // From unaligned positions, ending exactly on and either side of a read buffer
+        size_t starts[] = { 0, 1, 5000, bigData.size() - 4 * 1024 * 1024, bigData.size() - 4 * 1024 * 1024 - 1,
+                            bigData.size() - 8 * 1024 * 1024 + 1, bigData.size() };
+        for ( size_t i = 0; i < sizeof( starts ) / sizeof( starts[0] ); i++ )
+            {
+            unsigned long crc = 1;
+            lseek( fd, starts[i], SEEK_SET );
+            fileOk &= computeFileCrc32( fd, &crc, (CRC_FILE_ACCESS)access ) &&
+                      ( crc == computeMemoryCrc32( &bigData[ starts[i] ], bigData.size() - starts[i] ) ) &&
+                      ( lseek( fd, 0, SEEK_CUR ) == (off_t)bigData.size() );
+            }
+        }
+    ok &= check( "CRC-32: file by fd", fileOk );
+    close( fd );
+    unlink( path );
+
+    int pipeFds[2];
+    fileOk = !pipe( pipeFds );
+    if ( fileOk && !fork() )
+        {
+        // A pipe can't be mapped, so is read instead
+        close( pipeFds[0] );
+        fileOk = write( pipeFds[1], &bigData[0], bigData.size() ) == (ssize_t)bigData.size();
+        _exit( 0 );
+        }
+    close( pipeFds[1] );
+    fileOk &= computeFileCrc32( pipeFds[0], &mapped ) && ( mapped == serial );
+    close( pipeFds[0] );
+    ok &= check( "CRC-32: pipe", fileOk );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
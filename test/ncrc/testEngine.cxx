@@ -0,0 +1,191 @@
+// Checks Ncrc against the CRC catalogue's check values and a bit at a time reference, and
+// computeCrc against Ncrc.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ncrc.h"
+#include "nerror.h"
+#include "../ntest.h"
+
+using namespace std;
+
+// Check values from reveng.sourceforge.io/crc-catalogue, checked by the compiler
+static_assert( Ncrc8Smbus::check()      == 0xF4,                  "CRC-8/SMBUS" );
+static_assert( Ncrc8SaeJ1850::check()   == 0x4B,                  "CRC-8/SAE-J1850" );
+static_assert( Ncrc8Autosar::check()    == 0xDF,                  "CRC-8/AUTOSAR" );
+static_assert( Ncrc8Maxim::check()      == 0xA1,                  "CRC-8/MAXIM-DOW" );
+static_assert( Ncrc15Can::check()       == 0x059E,                "CRC-15/CAN" );
+static_assert( Ncrc16Ibm3740::check()   == 0x29B1,                "CRC-16/IBM-3740" );
+static_assert( Ncrc16Xmodem::check()    == 0x31C3,                "CRC-16/XMODEM" );
+static_assert( Ncrc16Kermit::check()    == 0x2189,                "CRC-16/KERMIT" );
+static_assert( Ncrc16IbmSdlc::check()   == 0x906E,                "CRC-16/IBM-SDLC" );
+static_assert( Ncrc16Arc::check()       == 0xBB3D,                "CRC-16/ARC" );
+static_assert( Ncrc16Modbus::check()    == 0x4B37,                "CRC-16/MODBUS" );
+static_assert( Ncrc17CanFd::check()     == 0x04F03,               "CRC-17/CAN-FD" );
+static_assert( Ncrc21CanFd::check()     == 0x0ED841,              "CRC-21/CAN-FD" );
+static_assert( Ncrc24OpenPgp::check()   == 0x21CF02,              "CRC-24/OPENPGP" );
+static_assert( Ncrc32IsoHdlc::check()   == 0xCBF43926,            "CRC-32/ISO-HDLC" );
+static_assert( Ncrc32Bzip2::check()     == 0xFC891918,            "CRC-32/BZIP2" );
+static_assert( Ncrc32Iscsi::check()     == 0xE3069283,            "CRC-32/ISCSI" );
+static_assert( Ncrc64Ecma182::check()   == 0x6C40DF5F0B497347ULL, "CRC-64/ECMA-182" );
+static_assert( Ncrc64Xz::check()        == 0x995DC9BBDF1939FAULL, "CRC-64/XZ" );
+
+// Under a byte wide, both ways round
+typedef Ncrc< 3, 0x3,  0x7,  true,  true,  0x0 >  Ncrc3Rohc;
+typedef Ncrc< 5, 0x05, 0x1F, true,  true,  0x1F > Ncrc5Usb;
+typedef Ncrc< 6, 0x27, 0x3F, false, false, 0x00 > Ncrc6Cdma2000A;
+typedef Ncrc< 7, 0x09, 0x00, false, false, 0x00 > Ncrc7Mmc;
+static_assert( Ncrc3Rohc::check()       == 0x6,                   "CRC-3/ROHC" );
+static_assert( Ncrc5Usb::check()        == 0x19,                  "CRC-5/USB" );
+static_assert( Ncrc6Cdma2000A::check()  == 0x0D,                  "CRC-6/CDMA2000-A" );
+static_assert( Ncrc7Mmc::check()        == 0x75,                  "CRC-7/MMC" );
+
+
+static uint64_t reflect( uint64_t theValue, const unsigned int theBits )
+{
+    uint64_t reflected = 0;
+    for ( unsigned int i = 0; i < theBits; i++, theValue >>= 1 )
+        reflected = ( reflected << 1 ) | ( theValue & 1 );
+    return reflected;
+}
+
+
+// The Rocksoft model a bit at a time
+static uint64_t referenceCrc( const unsigned int theWidth, const uint64_t thePoly, const uint64_t theInit, const bool theRefIn,
+                              const bool theRefOut, const uint64_t theXorOut, const unsigned char* theBuffer, const size_t theLength )
+{
+    const uint64_t mask = ~0ULL >> ( 64 - theWidth );
+    uint64_t crc = theInit;
+    for ( size_t i = 0; i < theLength; i++ )
+        {
+        unsigned int byte = theRefIn ? reflect( theBuffer[i], 8 ) : theBuffer[i];
+        for ( int bit = 7; bit >= 0; bit-- )
+            {
+            bool feedback = ( ( crc >> ( theWidth - 1 ) ) & 1 ) ^ ( ( byte >> bit ) & 1 );
+            crc = ( crc << 1 ) & mask;
+            if ( feedback )
+                crc ^= thePoly;
+            }
+        }
+    if ( theRefOut )
+        crc = reflect( crc, theWidth );
+    return ( crc ^ theXorOut ) & mask;
+}
+
+
+static vector< unsigned char > testData;
+
+
+template< unsigned int WIDTH, uint64_t POLY, uint64_t INIT, bool REFIN, bool REFOUT, uint64_t XOROUT >
+static bool checkCrc( const string& theName, const uint64_t theCheck, Ncrc< WIDTH, POLY, INIT, REFIN, REFOUT, XOROUT >* = NULL )
+{
+    typedef Ncrc< WIDTH, POLY, INIT, REFIN, REFOUT, XOROUT > CRC;
+    bool ok = check( theName + ": check value", CRC::compute( "123456789", 9 ) == theCheck );
+
+    bool same = true;
+    for ( size_t length = 0; length < 300; length++ )
+        same &= ( CRC::compute( &testData[ length % 7 ], length ) ==
+                  referenceCrc( WIDTH, POLY, INIT, REFIN, REFOUT, XOROUT, &testData[ length % 7 ], length ) );
+    ok &= check( theName + ": matches reference", same );
+
+    CRC pieces;
+    for ( size_t done = 0, piece = 1; done < testData.size(); done += piece, piece = piece * 3 + 1 )
+        pieces.update( &testData[ done ], min( piece, testData.size() - done ) );
+    ok &= check( theName + ": in pieces", pieces.getValue() == CRC::compute( &testData[0], testData.size() ) );
+    pieces.reset();
+    pieces.update( "123456789", 9 );
+    ok &= check( theName + ": reset", pieces.getValue() == theCheck );
+
+    bool combined = true;
+    typename CRC::VALUE whole = CRC::compute( &testData[0], testData.size() );
+    for ( size_t split = 0; split <= testData.size(); split += 499 )
+        combined &= ( CRC::combine( CRC::compute( &testData[0], split ), CRC::compute( &testData[ split ], testData.size() - split ),
+                                    testData.size() - split ) == whole );
+    ok &= check( theName + ": combine", combined );
+    return ok;
+}
+
+
+static Nbinary bitsOf( const char* theBytes )
+{
+    string bits;
+    for ( const char* byte = theBytes; *byte; byte++ )
+        for ( int bit = 7; bit >= 0; bit-- )
+            bits += ( *byte & ( 1 << bit ) ) ? '1' : '0';
+    return Nbinary( "0b" + bits );
+}
+
+
+static Nbinary polynomial( const unsigned int theWidth, const string& theHex )
+{
+    // With its x^theWidth term, as computeCrc wants it
+    string bits;
+    for ( size_t i = 0; i < theHex.size(); i++ )
+        {
+        int digit = ( theHex[i] <= '9' ) ? theHex[i] - '0' : theHex[i] - 'A' + 10;
+        for ( int bit = 3; bit >= 0; bit-- )
+            bits += ( digit & ( 1 << bit ) ) ? '1' : '0';
+        }
+    return Nbinary( "0b1" + bits.substr( bits.size() - theWidth ) );
+}
+
+
+static bool residueIsZero( const Nbinary& theData, const Nbinary& thePoly )
+{
+    // A CRC computed over data with its own CRC appended is 0
+    Nbinary crc;
+    Nbinary zero( 0, thePoly.length() - 1 );
+    computeCrc( theData, thePoly, zero, crc );
+    Nbinary appended( "0b" + theData.getAsBinary() + crc.getAsBinary() );
+    computeCrc( appended, thePoly, zero, crc );
+    return crc == zero;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+
+    testData.resize( 5000 );
+    srand( 1 );
+    for ( size_t i = 0; i < testData.size(); i++ )
+        testData[i] = rand();
+
+    ok &= checkCrc( "CRC-3/ROHC", 0x6, (Ncrc3Rohc*)NULL );
+    ok &= checkCrc( "CRC-5/USB", 0x19, (Ncrc5Usb*)NULL );
+    ok &= checkCrc( "CRC-6/CDMA2000-A", 0x0D, (Ncrc6Cdma2000A*)NULL );
+    ok &= checkCrc( "CRC-7/MMC", 0x75, (Ncrc7Mmc*)NULL );
+    ok &= checkCrc( "CRC-8/SMBUS", 0xF4, (Ncrc8Smbus*)NULL );
+    ok &= checkCrc( "CRC-8/MAXIM-DOW", 0xA1, (Ncrc8Maxim*)NULL );
+    ok &= checkCrc( "CRC-15/CAN", 0x059E, (Ncrc15Can*)NULL );
+    ok &= checkCrc( "CRC-16/IBM-3740", 0x29B1, (Ncrc16Ibm3740*)NULL );
+    ok &= checkCrc( "CRC-16/MODBUS", 0x4B37, (Ncrc16Modbus*)NULL );
+    ok &= checkCrc( "CRC-17/CAN-FD", 0x04F03, (Ncrc17CanFd*)NULL );
+    ok &= checkCrc( "CRC-24/OPENPGP", 0x21CF02, (Ncrc24OpenPgp*)NULL );
+    ok &= checkCrc( "CRC-32/BZIP2", 0xFC891918, (Ncrc32Bzip2*)NULL );
+    ok &= checkCrc( "CRC-64/ECMA-182", 0x6C40DF5F0B497347ULL, (Ncrc64Ecma182*)NULL );
+    ok &= checkCrc( "CRC-64/XZ", 0x995DC9BBDF1939FAULL, (Ncrc64Xz*)NULL );
+
+    ok &= check( "Ncrc32IsoHdlc is computeMemoryCrc32", Ncrc32IsoHdlc::compute( &testData[0], testData.size() ) ==
+                                                        computeMemoryCrc32( &testData[0], testData.size() ) );
+
+    // computeCrc has no reflection or final xor
+    Nbinary result;
+    computeCrc( bitsOf( "123456789" ), polynomial( 15, "4599" ), Nbinary( 0, 15 ), result );
+    ok &= check( "computeCrc CRC-15/CAN", ( result.length() == 15 ) && ( result.getAsInt() == 0x059E ) );
+    computeCrc( bitsOf( "123456789" ), polynomial( 16, "1021" ), Nbinary( 0xFFFF, 16 ), result );
+    ok &= check( "computeCrc CRC-16/IBM-3740", ( result.length() == 16 ) && ( result.getAsInt() == 0x29B1 ) );
+    computeCrc( bitsOf( "123456789" ), polynomial( 64, "42F0E1EBA9EA3693" ), Nbinary( 0, 64 ), result );
+    ok &= check( "computeCrc CRC-64/ECMA-182", ( result.length() == 64 ) && ( result.getAsInt() == 0x6C40DF5F0B497347ULL ) );
+
+    ok &= check( "computeCrc residue, 13 bits of data", residueIsZero( Nbinary( "0b1011001110001" ), polynomial( 15, "4599" ) ) );
+    ok &= check( "computeCrc residue, 64 bit", residueIsZero( bitsOf( "123456789" ), polynomial( 64, "42F0E1EBA9EA3693" ) ) );
+    ok &= check( "computeCrc residue, 82 bit", residueIsZero( bitsOf( "123456789" ), polynomial( 82, "0308C0111011401440411" ) ) );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,125 @@
+// Nevent microbenchmarks, compared against the mutex + condition variable implementation
+// Nevent used before v3.0.
+// Build with: make TARGET=bench  (use the release CFLAGS in the makefile for meaningful numbers)
+#include <iostream>
+#include <iomanip>
+#include <pthread.h>
+
+#include "nerror.h"
+#include "nevent.h"
+#include "nthread.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+// Auto reset boolean event the way Nevent used to do it.
+class CondEvent
+{
+public:
+    CondEvent() : m_state( false )
+    {
+        pthread_mutex_init( &m_mutex, NULL );
+        pthread_cond_init( &m_condition, NULL );
+    }
+
+    ~CondEvent()
+    {
+        pthread_cond_destroy( &m_condition );
+        pthread_mutex_destroy( &m_mutex );
+    }
+
+    void signal()
+    {
+        pthread_mutex_lock( &m_mutex );
+        m_state = true;
+        pthread_cond_signal( &m_condition );
+        pthread_mutex_unlock( &m_mutex );
+    }
+
+    bool wait( const Ntime theTimeout = 0 )
+    {
+        pthread_mutex_lock( &m_mutex );
+        while ( !m_state )
+            pthread_cond_wait( &m_condition, &m_mutex );
+        m_state = false;
+        pthread_mutex_unlock( &m_mutex );
+        return true;
+    }
+
+private:
+    pthread_mutex_t m_mutex;
+    pthread_cond_t  m_condition;
+    bool            m_state;
+};
+
+
+template< typename EVENT > struct PING_PONG
+{
+    EVENT ping;
+    EVENT pong;
+    long  rounds;
+};
+
+template< typename EVENT > void* pongProc( void* theParam )
+{
+    PING_PONG< EVENT >& p = *(PING_PONG< EVENT >*)theParam;
+    for ( long i = 0; i < p.rounds; i++ )
+        {
+        p.ping.wait();
+        p.pong.signal();
+        }
+    return NULL;
+}
+
+
+template< typename EVENT > void runBenchmarks( const char* theName, const long theIterations )
+{
+    EVENT event;
+
+    // Uncontended: signal with nobody waiting.
+    Ntime start = Ntime::getCurrentLocalTime();
+    for ( long i = 0; i < theIterations; i++ )
+        event.signal();
+    double signalNs = elapsedNs( start ) / theIterations;
+
+    // Uncontended: wait on an already signalled event.
+    start = Ntime::getCurrentLocalTime();
+    for ( long i = 0; i < theIterations; i++ )
+        {
+        event.signal();
+        event.wait();
+        }
+    double signalWaitNs = elapsedNs( start ) / theIterations;
+
+    // Contended: two threads handing control back and forth, so every wait blocks.
+    PING_PONG< EVENT > p;
+    p.rounds = theIterations / 20;
+    Nthread pong( pongProc< EVENT >, &p );
+    start = Ntime::getCurrentLocalTime();
+    for ( long i = 0; i < p.rounds; i++ )
+        {
+        p.ping.signal();
+        p.pong.wait();
+        }
+    double roundTripNs = elapsedNs( start ) / p.rounds;
+    pong.getReturnValue();
+
+    cout << setw( 12 ) << theName << setw( 16 ) << signalNs << setw( 16 ) << signalWaitNs << setw( 16 ) << roundTripNs << endl;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    const long ITERATIONS = ( ac > 1 ) ? atol( av[1] ) : 10000000;
+
+    cout << fixed << setprecision( 1 );
+    cout << "ns per operation, " << ITERATIONS << " iterations" << endl;
+    cout << setw( 12 ) << "" << setw( 16 ) << "signal" << setw( 16 ) << "signal+wait" << setw( 16 ) << "ping-pong" << endl;
+    runBenchmarks< CondEvent >( "mutex+cond", ITERATIONS );
+    runBenchmarks< Nevent >( "Nevent", ITERATIONS );
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+// Checks waiting on several Nevents at once, and polling an Nevent's eventfd.
+// Build with: make TARGET=testMultiple
+#include <iostream>
+#include <vector>
+#include <poll.h>
+
+#include "nerror.h"
+#include "nevent.h"
+#include "nthread.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+typedef struct
+{
+    Nevent* event;
+    int     delay;
+} SIGNALLER;
+
+void* signallerProc( void* theParam )
+{
+    SIGNALLER* signaller = (SIGNALLER*)theParam;
+    Ntime::sleep( signaller->delay );
+    signaller->event->signal();
+    return NULL;
+}
+
+
+bool isReadable( const int theFd, const int theTimeout )
+{
+    pollfd fds;
+    fds.fd = theFd;
+    fds.events = POLLIN;
+    return ( poll( &fds, 1, theTimeout ) == 1 ) && ( fds.revents & POLLIN );
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+    Nevent a, b, c( true );
+    vector<Nevent*> events;
+    events.push_back( &a );
+    events.push_back( &b );
+    events.push_back( &c );
+
+    ok &= check( "waitAny: timeout", Nevent::waitAny( events, 100 ) == -1 );
+
+    b.signal();
+    ok &= check( "waitAny: already signalled", ( Nevent::waitAny( events, 100 ) == 1 ) && !b.currentState() );
+
+    SIGNALLER signaller = { &c, 100 };
+    Nthread* thread = new Nthread( signallerProc, &signaller );
+    ok &= check( "waitAny: woken", Nevent::waitAny( events, 2000 ) == 2 );
+    thread->getReturnValue();
+    delete thread;
+
+    a.signal();
+    ok &= check( "waitAll: not all signalled", !Nevent::waitAll( events, 100 ) && a.currentState() );
+
+    // Only the last event is missing, so the others are all taken when it arrives.
+    b.signal();
+    signaller.event = &c;
+    thread = new Nthread( signallerProc, &signaller );
+    ok &= check( "waitAll: woken", Nevent::waitAll( events, 2000 ) && !a.currentState() && !b.currentState() && !c.currentState() );
+    thread->getReturnValue();
+    delete thread;
+
+    Ndeadline deadline( 100 );
+    ok &= check( "waitAll: deadline", !Nevent::waitAll( events, deadline ) && deadline.hasExpired() );
+
+    Nevent polled;
+    int fd = polled.getFd();
+    ok &= check( "getFd: same fd each time", polled.getFd() == fd );
+    ok &= check( "getFd: unsignalled not readable", !isReadable( fd, 50 ) );
+
+    signaller.event = &polled;
+    thread = new Nthread( signallerProc, &signaller );
+    ok &= check( "getFd: readable when signalled", isReadable( fd, 2000 ) && polled.tryWait() );
+    thread->getReturnValue();
+    delete thread;
+    ok &= check( "getFd: not readable once taken", !isReadable( fd, 50 ) && !polled.tryWait() );
+
+    Nevent counted( true, 0 );
+    fd = counted.getFd();
+    counted.signal();
+    counted.signal();
+    ok &= check( "getFd: counting stays readable", counted.tryWait() && isReadable( fd, 50 ) && counted.tryWait() && !isReadable( fd, 50 ) );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,109 @@
+// Checks Nevent behaves the same for each kind of event.
+// Build with: make TARGET=testSemantics
+#include <iostream>
+#include <atomic>
+#include <vector>
+
+#include "nerror.h"
+#include "nevent.h"
+#include "nthread.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+typedef struct
+{
+    Nevent*      event;
+    atomic<int>* woken;
+} WAITER;
+
+void* waiterProc( void* theParam )
+{
+    WAITER* waiter = (WAITER*)theParam;
+    if ( waiter->event->wait( 2000 ) )
+        ( *waiter->woken )++;
+    return NULL;
+}
+
+
+// Starts theCount threads waiting on theEvent, signals it theSignals times and returns how many woke.
+int wakeWaiters( Nevent& theEvent, const int theCount, const int theSignals )
+{
+    atomic<int> woken( 0 );
+    WAITER waiter;
+    waiter.event = &theEvent;
+    waiter.woken = &woken;
+
+    vector<Nthread*> threads;
+    for ( int i = 0; i < theCount; i++ )
+        threads.push_back( new Nthread( waiterProc, &waiter ) );
+
+    Ntime::sleep( 200 );  // Let them all block
+    for ( int i = 0; i < theSignals; i++ )
+        theEvent.signal();
+
+    for ( int i = 0; i < theCount; i++ )
+        {
+        threads[i]->getReturnValue();
+        delete threads[i];
+        }
+
+    return woken;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+    bool ok = true;
+
+    Nevent autoEvent;
+    ok &= check( "auto: initially clear", !autoEvent.wait( 50 ) );
+    autoEvent.signal();
+    autoEvent.signal();
+    ok &= check( "auto: signals don't accumulate", autoEvent.wait( 50 ) && !autoEvent.wait( 50 ) );
+    ok &= check( "auto: one signal wakes one waiter", wakeWaiters( autoEvent, 3, 1 ) == 1 );
+
+    Nevent manualEvent( false, 0, true );
+    manualEvent.signal();
+    ok &= check( "manual: stays signalled", manualEvent.wait( 50 ) && manualEvent.wait( 50 ) && ( manualEvent.currentState() == 1 ) );
+    manualEvent.reset();
+    ok &= check( "manual: reset", !manualEvent.wait( 50 ) );
+    ok &= check( "manual: one signal wakes all waiters", wakeWaiters( manualEvent, 3, 1 ) == 3 );
+    manualEvent.unsignal();
+    ok &= check( "manual: unsignal", manualEvent.currentState() == 0 );
+
+    Nevent countingEvent( true, 2 );
+    ok &= check( "counting: initial count", countingEvent.wait( 50 ) && countingEvent.wait( 50 ) && !countingEvent.wait( 50 ) );
+    ok &= check( "counting: each signal wakes one waiter", wakeWaiters( countingEvent, 4, 3 ) == 3 );
+    countingEvent.signal();
+    countingEvent.signal();
+    countingEvent.unsignal();
+    ok &= check( "counting: unsignal", countingEvent.currentState() == 1 );
+    countingEvent.reset();
+    countingEvent.unsignal();  // Mustn't go below 0
+    ok &= check( "counting: reset", countingEvent.currentState() == 0 );
+
+    Nevent manualCounting( true, 0, true );
+    manualCounting.signal();
+    ok &= check( "manual counting: wait doesn't decrement", manualCounting.wait( 50 ) && ( manualCounting.currentState() == 1 ) );
+
+    Ntime start = Ntime::getCurrentLocalTime();
+    bool timedOut = !autoEvent.wait( 300 );
+    long long waited = start.getElapsed().getAsMs();
+    ok &= check( "timed wait", timedOut && ( waited >= 300 ) && ( waited < 400 ) );
+
+    // One deadline shared by repeated waits: the loop as a whole times out.
+    Ndeadline deadline( 300 );
+    start = Ntime::getCurrentLocalTime();
+    int waits = 0;
+    while ( !autoEvent.wait( deadline ) )
+        if ( ++waits > 1 || deadline.hasExpired() )
+            break;
+    waited = start.getElapsed().getAsMs();
+    ok &= check( "deadline", ( waits == 1 ) && deadline.hasExpired() && ( waited >= 300 ) && ( waited < 400 ) );
+    ok &= check( "infinite deadline", Ndeadline().isInfinite() && !Ndeadline().hasExpired() && ( Ndeadline().getRemainingMs() == -1 ) );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
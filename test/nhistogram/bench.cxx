@@ -0,0 +1,77 @@
+// ns per value recorded: pushing onto a vector of samples ( the way it was done by hand ),
+// Nhistogram, and NconcurrentHistogram from one thread and from several at once.
+// Build with: make TARGET=bench  (use the release CFLAGS in the makefile for meaningful numbers)
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <stdlib.h>
+
+#include "nerror.h"
+#include "nhistogram.h"
+#include "nthread.h"
+
+using namespace std;
+
+static const int REPEATS = 20000000;
+static const int THREADS = 4;
+static uint64_t values[ 4096 ];
+static NconcurrentHistogram shared;
+static volatile uint64_t sink;
+
+
+static void* recorder( void* theParam )
+{
+    for ( int r = 0; r < REPEATS; r++ )
+        shared.record( values[ r & 4095 ] );
+    return NULL;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    for ( int i = 0; i < 4096; i++ )
+        values[i] = 1000 + rand() % 1000000;
+
+    static const char* methods[] = { "vector", "Nhistogram", "NconcurrentHistogram", "NconcurrentHistogram x4" };
+    cout << fixed << setprecision( 2 ) << "ns per value" << endl;
+    for ( int method = 0; method < 4; method++ )
+        {
+        vector< uint64_t > samples;
+        Nhistogram histogram;
+        NconcurrentHistogram concurrent;
+        Ntimestamp start = Ntimestamp::now();
+        switch ( method )
+            {
+            case 0:
+                for ( int r = 0; r < REPEATS; r++ )
+                    samples.push_back( values[ r & 4095 ] );
+                break;
+            case 1:
+                for ( int r = 0; r < REPEATS; r++ )
+                    histogram.record( values[ r & 4095 ] );
+                break;
+            case 2:
+                for ( int r = 0; r < REPEATS; r++ )
+                    concurrent.record( values[ r & 4095 ] );
+                break;
+            case 3:
+                {
+                // Over all the values recorded, so cost per value with 1 core and throughput with more
+                vector< Nthread* > threads;
+                for ( int t = 0; t < THREADS; t++ )
+                    threads.push_back( new Nthread( recorder, NULL ) );
+                for ( int t = 0; t < THREADS; t++ )
+                    delete threads[t];
+                }
+                break;
+            }
+        double recorded = ( method == 3 ) ? (double)REPEATS * THREADS : REPEATS;
+        cout << setw( 26 ) << methods[ method ] << setw( 10 ) << start.getElapsed().getAsNs() / recorded << endl;
+        sink = histogram.getCount() + concurrent.getSnapshot().getCount() + samples.size();
+        }
+    shared.getSnapshot().dump( cout );
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+// Checks Nhistogram's percentiles against sorted samples, its merging and serialisation, and
+// NconcurrentHistogram recorded into by several threads and by an NthreadPool.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+
+#include "nerror.h"
+#include "nhistogram.h"
+#include "nthread.h"
+#include "nthreadPool.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static const int THREADS = 4;
+static const int VALUES_PER_THREAD = 200000;
+
+static bool throws( const string& theData )
+{
+    try
+        {
+        Nhistogram().deserialise( theData );
+        }
+    catch ( NerrorException& e )
+        {
+        return true;
+        }
+    return false;
+}
+
+
+static uint64_t randomValue()
+{
+    // Spread over all magnitudes, as latencies are
+    uint64_t value = ( (uint64_t)rand() << 31 ) | rand();
+    return value >> ( rand() % 63 );
+}
+
+
+static vector< uint64_t > values( THREADS * VALUES_PER_THREAD );
+static NconcurrentHistogram shared;
+
+static void* recorder( void* theParam )
+{
+    size_t first = (size_t)theParam * VALUES_PER_THREAD;
+    for ( size_t i = first; i < first + VALUES_PER_THREAD; i++ )
+        shared.record( values[i] );
+    return NULL;
+}
+
+
+static void job( void* theParam )
+{
+    Ntime::sleep( 2 );
+}
+
+
+static bool percentilesMatch( const Nhistogram& theHistogram, vector< uint64_t > theSorted )
+{
+    // Each percentile is at or above the sample's, by no more than the histogram's precision
+    sort( theSorted.begin(), theSorted.end() );
+    static const double percentiles[] = { 0, 1, 25, 50, 90, 99, 99.9, 99.99, 100 };
+    bool ok = true;
+    for ( size_t i = 0; i < sizeof( percentiles ) / sizeof( percentiles[0] ); i++ )
+        {
+        size_t rank = (size_t)ceil( percentiles[i] / 100 * theSorted.size() );
+        uint64_t exact = theSorted[ rank ? rank - 1 : 0 ];
+        uint64_t value = theHistogram.getPercentile( percentiles[i] );
+        ok &= ( value >= exact ) && ( value - exact <= ( exact >> theHistogram.getPrecision() ) );
+        }
+    return ok && ( theHistogram.getMin() == theSorted.front() ) && ( theHistogram.getMax() == theSorted.back() ) &&
+           ( theHistogram.getCount() == theSorted.size() );
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+    srand( 1 );
+
+    bool buckets = true;
+    for ( unsigned int precision = 1; precision <= Nhistogram::MAX_PRECISION; precision++ )
+        for ( int i = 0; i < 100000; i++ )
+            {
+            uint64_t value = ( i < 64 ) ? ~0ULL >> i : randomValue();
+            size_t index = Nhistogram::getIndex( value, precision );
+            uint64_t high = Nhistogram::getHighestValue( index, precision );
+            buckets &= ( Nhistogram::getLowestValue( index, precision ) <= value ) && ( value <= high ) &&
+                       ( ( high == ~0ULL ) || ( Nhistogram::getIndex( high + 1, precision ) == index + 1 ) ) &&
+                       ( ( value >> ( precision + 1 ) ) || ( high == value ) );
+            }
+    ok &= check( "buckets", buckets && ( Nhistogram::getIndex( ~0ULL, 7 ) == ( 65 - 7 ) * 128 - 1 ) );
+
+    for ( size_t i = 0; i < values.size(); i++ )
+        values[i] = randomValue();
+    Nhistogram all;
+    Nhistogram first, second;
+    for ( size_t i = 0; i < values.size(); i++ )
+        {
+        all.record( values[i] );
+        ( ( i % 2 ) ? first : second ).record( values[i] );
+        }
+    ok &= check( "percentiles", percentilesMatch( all, values ) );
+    ok &= check( "empty", ( Nhistogram().getPercentile( 50 ) == 0 ) && ( Nhistogram().getMin() == 0 ) && ( Nhistogram().getMean() == 0 ) );
+
+    Nhistogram merged( first );
+    merged.merge( second );
+    ok &= check( "merge", merged.serialise() == all.serialise() );
+
+    Nhistogram coarse( 3 );
+    coarse.merge( all );
+    Nhistogram fine( 10 );
+    fine.merge( coarse );
+    ok &= check( "merge to a lower precision", ( coarse.getPrecision() == 3 ) && percentilesMatch( coarse, values ) &&
+                                               ( fine.getPrecision() == 3 ) && ( fine.serialise() == coarse.serialise() ) );
+
+    string data = all.serialise();
+    Nhistogram copy;
+    copy.deserialise( data );
+    cout << "Serialised " << all.getCount() << " values in " << data.size() << " bytes" << endl;
+    ok &= check( "serialise", ( copy.serialise() == data ) && percentilesMatch( copy, values ) );
+    copy.deserialise( Nhistogram( 5 ).serialise() );
+    ok &= check( "serialise empty", ( copy.getCount() == 0 ) && ( copy.getPrecision() == 5 ) && ( copy.getMin() == 0 ) );
+    ok &= check( "bad data", throws( "" ) && throws( "XX" + data.substr( 2 ) ) && throws( data.substr( 0, data.size() - 1 ) ) &&
+                             throws( data + '\x01' ) );
+
+    // Threads record while snapshots are taken
+    vector< Nthread* > threads;
+    for ( size_t t = 0; t < THREADS; t++ )
+        threads.push_back( new Nthread( recorder, (void*)t ) );
+    bool snapshots = true;
+    for ( int i = 0; i < 20; i++ )
+        {
+        Nhistogram snapshot = shared.getSnapshot();
+        snapshots &= ( snapshot.getCount() <= values.size() ) && ( snapshot.getMax() <= all.getMax() ) &&
+                     ( !snapshot.getCount() || ( ( snapshot.getMin() >= all.getMin() ) && ( snapshot.getPercentile( 100 ) <= all.getMax() ) ) );
+        }
+    for ( size_t t = 0; t < THREADS; t++ )
+        delete threads[t];
+    ok &= check( "concurrent", snapshots && ( shared.getSnapshot().serialise() == all.serialise() ) );
+
+    NconcurrentHistogram queueWait;
+    NconcurrentHistogram runTime;
+    NthreadPool pool( 2 );
+    pool.setLatencyHistograms( &queueWait, &runTime );
+    for ( int i = 0; i < 20; i++ )
+        pool.submitJob( job );
+    pool.waitForIdle();
+    Nhistogram run = runTime.getSnapshot();
+    run.dump( cout );
+    ok &= check( "thread pool", ( run.getCount() == 20 ) && ( queueWait.getSnapshot().getCount() == 20 ) && ( run.getMin() >= 2000000 ) &&
+                                ( run.getPercentile( 50 ) < 50000000 ) );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,162 @@
+// Lock contention benchmarks for 1 to 64 threads: each thread repeatedly takes the lock for a
+// very short critical section. NrwLock and Nseqlock are also timed with 1 writer to 15 readers.
+// Build with: make TARGET=bench  (use the release CFLAGS in the makefile for meaningful numbers)
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include "nerror.h"
+#include "nmutex.h"
+#include "nrwLock.h"
+#include "nspinlock.h"
+#include "nthread.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static const int OPERATIONS = 2000000;  // Per test, shared between the threads
+
+template< class LOCK >
+struct SHARED
+{
+    SHARED() : counter( 0 ) {}
+    template< class TYPE > explicit SHARED( TYPE theType ) : lock( theType ), counter( 0 ) {}
+
+    LOCK                lock;
+    unsigned long long  counter;
+    int                 loops;
+};
+
+template< class LOCK >
+void* lockProc( void* theParam )
+{
+    SHARED< LOCK >* shared = (SHARED< LOCK >*)theParam;
+    for ( int i = 0; i < shared->loops; i++ )
+        {
+        NlockGuard< LOCK > guard( shared->lock );
+        shared->counter++;
+        }
+    return NULL;
+}
+
+
+typedef struct
+{
+    unsigned long long a;
+    unsigned long long b;
+} PAIR;
+
+typedef struct
+{
+    NrwLock             lock;
+    Nseqlock< PAIR >    seqlock;
+    PAIR                value;
+    int                 loops;
+} READ_MOSTLY;
+
+// Every 16th thread writes, the rest read.
+void* rwProc( void* theParam )
+{
+    READ_MOSTLY* shared = (READ_MOSTLY*)( (void**)theParam )[0];
+    bool writer = ( (long)( (void**)theParam )[1] % 16 ) == 0;
+    volatile unsigned long long sink = 0;
+
+    for ( int i = 0; i < shared->loops; i++ )
+        if ( writer )
+            {
+            NwriteGuard guard( shared->lock );
+            shared->value.a++;
+            }
+        else
+            {
+            NreadGuard guard( shared->lock );
+            sink += shared->value.a;
+            }
+    return NULL;
+}
+
+void* seqProc( void* theParam )
+{
+    READ_MOSTLY* shared = (READ_MOSTLY*)( (void**)theParam )[0];
+    bool writer = ( (long)( (void**)theParam )[1] % 16 ) == 0;
+    volatile unsigned long long sink = 0;
+    PAIR value = { 0, 0 };
+
+    for ( int i = 0; i < shared->loops; i++ )
+        if ( writer )
+            {
+            value.a++;
+            shared->seqlock.write( value );
+            }
+        else
+            sink += shared->seqlock.read().a;
+    return NULL;
+}
+
+
+// Returns ns per operation with theThreads threads sharing OPERATIONS operations.
+double runThreads( Nthread::NTHREAD_THREAD_PROC theProc, vector< void* >& theParams )
+{
+    vector< Nthread* > threads;
+    Ntime start = Ntime::getCurrentLocalTime();
+    for ( size_t i = 0; i < theParams.size(); i++ )
+        threads.push_back( new Nthread( theProc, theParams[i] ) );
+    for ( size_t i = 0; i < threads.size(); i++ )
+        {
+        threads[i]->getReturnValue();
+        delete threads[i];
+        }
+    return elapsedNs( start ) / OPERATIONS;
+}
+
+
+template< class LOCK >
+double timeLock( SHARED< LOCK >& theShared, const int theThreads )
+{
+    theShared.loops = OPERATIONS / theThreads;
+    vector< void* > params( theThreads, &theShared );
+    return runThreads( lockProc< LOCK >, params );
+}
+
+
+double timeReadMostly( Nthread::NTHREAD_THREAD_PROC theProc, READ_MOSTLY& theShared, const int theThreads )
+{
+    theShared.loops = OPERATIONS / theThreads;
+    vector< void* > pairs( theThreads * 2 );
+    vector< void* > params;
+    for ( int i = 0; i < theThreads; i++ )
+        {
+        pairs[ i * 2 ] = &theShared;
+        pairs[ i * 2 + 1 ] = (void*)(long)i;
+        params.push_back( &pairs[ i * 2 ] );
+        }
+    return runThreads( theProc, params );
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    cout << "ns per lock/unlock (read-mostly: 1 writer per 16 threads)" << endl;
+    cout << setw( 8 ) << "threads" << setw( 12 ) << "FAST" << setw( 12 ) << "ADAPTIVE" << setw( 12 ) << "spinlock"
+         << setw( 12 ) << "rwLock" << setw( 12 ) << "seqlock" << endl;
+
+    for ( int threads = 1; threads <= 64; threads *= 2 )
+        {
+        SHARED< Nmutex > fast;
+        SHARED< Nmutex > adaptive( Nmutex::ADAPTIVE );
+        SHARED< Nspinlock > spin;
+        READ_MOSTLY readMostly;
+
+        cout << fixed << setprecision( 1 ) << setw( 8 ) << threads
+             << setw( 12 ) << timeLock( fast, threads )
+             << setw( 12 ) << timeLock( adaptive, threads )
+             << setw( 12 ) << timeLock( spin, threads )
+             << setw( 12 ) << timeReadMostly( rwProc, readMostly, threads )
+             << setw( 12 ) << timeReadMostly( seqProc, readMostly, threads ) << endl;
+        }
+
+    return EXIT_SUCCESS;
+}
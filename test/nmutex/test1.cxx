@@ -0,0 +1,126 @@
+// Checks each lock type gives mutual exclusion, and NrwLock lets readers share.
+#include <iostream>
+#include <vector>
+#include <sched.h>
+
+#include "nerror.h"
+#include "nmutex.h"
+#include "nrwLock.h"
+#include "nspinlock.h"
+#include "nthread.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static const int THREADS = 8;
+static const int LOOPS = 20000;
+
+template< class LOCK >
+struct SHARED
+{
+    SHARED() : counter( 0 ) {}
+    template< class TYPE > explicit SHARED( TYPE theType ) : lock( theType ), counter( 0 ) {}
+
+    LOCK          lock;
+    unsigned long counter;
+};
+
+template< class LOCK >
+void* incrementProc( void* theParam )
+{
+    SHARED< LOCK >* shared = (SHARED< LOCK >*)theParam;
+    for ( int i = 0; i < LOOPS; i++ )
+        {
+        NlockGuard< LOCK > guard( shared->lock );
+        unsigned long value = shared->counter;
+        if ( ( i % 64 ) == 0 )
+            sched_yield();  // Give other threads a chance to break in if exclusion is broken
+        shared->counter = value + 1;
+        }
+    return NULL;
+}
+
+
+// Runs THREADS threads each incrementing a counter under the lock LOOPS times.
+template< class LOCK >
+bool excludes( SHARED< LOCK >& theShared )
+{
+    theShared.counter = 0;
+    vector< Nthread* > threads;
+    for ( int i = 0; i < THREADS; i++ )
+        threads.push_back( new Nthread( incrementProc< LOCK >, &theShared ) );
+    for ( int i = 0; i < THREADS; i++ )
+        {
+        threads[i]->getReturnValue();
+        delete threads[i];
+        }
+    return theShared.counter == (unsigned long)( THREADS * LOOPS );
+}
+
+
+typedef struct
+{
+    unsigned long long first;
+    unsigned long long second;
+    unsigned long long third;
+} TRIPLE;
+
+static Nseqlock< TRIPLE > triple;
+static volatile bool      stopWriting;
+
+void* seqlockWriterProc( void* theParam )
+{
+    for ( unsigned long long i = 1; !stopWriting; i++ )
+        {
+        TRIPLE value = { i, i * 2, i * 3 };
+        triple.write( value );
+        }
+    return NULL;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+
+    SHARED< Nmutex > fast;
+    ok &= check( "Nmutex FAST excludes", excludes( fast ) );
+
+    SHARED< Nmutex > adaptive( Nmutex::ADAPTIVE );
+    ok &= check( "Nmutex ADAPTIVE excludes", excludes( adaptive ) );
+
+    SHARED< Nspinlock > spin;
+    ok &= check( "Nspinlock excludes", excludes( spin ) );
+    ok &= check( "Nspinlock tryLock", spin.lock.tryLock() && !spin.lock.tryLock() );
+    spin.lock.unlock();
+
+    SHARED< NrwLock > rw;
+    ok &= check( "NrwLock writers exclude", excludes( rw ) );
+        {
+        NreadGuard reader( rw.lock );
+        ok &= check( "NrwLock readers share", rw.lock.tryReadLock() );
+        rw.lock.unlock();
+        ok &= check( "NrwLock readers exclude writers", !rw.lock.tryWriteLock() );
+        }
+        {
+        NwriteGuard writer( rw.lock );
+        ok &= check( "NrwLock writers exclude readers", !rw.lock.tryReadLock() );
+        }
+
+    stopWriting = false;
+    Nthread writer( seqlockWriterProc, NULL );
+    bool consistent = true;
+    for ( int i = 0; i < 200000; i++ )
+        {
+        TRIPLE value = triple.read();
+        consistent &= ( value.second == value.first * 2 ) && ( value.third == value.first * 3 );
+        }
+    stopWriting = true;
+    writer.getReturnValue();
+    ok &= check( "Nseqlock reads are consistent", consistent );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,81 @@
+// Checks lock contention profiling.
+// Needs the library and this test built with NLIB_LOCK_PROFILING:
+//   cmake -DLOCK_PROFILING=ON ...
+//   make TARGET=testProfile CFLAGS="-ggdb -I. -I../.. -DDEBUG -DNLIB_LOCK_PROFILING"
+#include <iostream>
+#include <sstream>
+#include <signal.h>
+#include <unistd.h>
+
+#include "nerror.h"
+#include "nevent.h"
+#include "nlockProfile.h"
+#include "nmutex.h"
+#include "nthread.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+#ifndef NLIB_LOCK_PROFILING
+#error Build with -DNLIB_LOCK_PROFILING
+#endif
+
+using namespace std;
+
+static Nmutex hot( Nmutex::FAST, "hot mutex" );
+static Nmutex cold( Nmutex::FAST, "cold mutex" );
+static Nevent ready( false, 0, false, "ready event" );
+
+void* holderProc( void* theParam )
+{
+    hot.lock();
+    ready.signal();
+    Ntime::sleep( 100 );
+    hot.unlock();
+
+    Ntime::sleep( 100 );
+    ready.signal();
+    return NULL;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+
+    cold.lock();
+    cold.unlock();
+
+    Nthread holder( holderProc, NULL );
+    ready.wait();       // May or may not have to wait, depending on scheduling
+    hot.lock();         // Has to wait about 100ms for the holder
+    hot.unlock();
+    ready.wait();       // Has to wait about 100ms
+    holder.getReturnValue();
+
+    vector< NlockProfile::LOCK_STATS > stats = NlockProfile::getStats();
+    ok &= check( "most contended first", ( stats.size() >= 3 ) && ( stats[0].contentions >= stats[1].contentions ) );
+
+    for ( size_t i = 0; i < stats.size(); i++ )
+        if ( stats[i].name == "hot mutex" )
+            ok &= check( "hot mutex", ( stats[i].acquisitions == 2 ) && ( stats[i].contentions == 1 ) &&
+                                      ( stats[i].maxWaitNs >= 50000000 ) && ( stats[i].totalHoldNs >= 100000000 ) );
+        else if ( stats[i].name == "cold mutex" )
+            ok &= check( "cold mutex", ( stats[i].acquisitions == 1 ) && ( stats[i].contentions == 0 ) && ( stats[i].totalWaitNs == 0 ) );
+        else if ( stats[i].name == "ready event" )
+            ok &= check( "ready event", ( stats[i].acquisitions == 2 ) && ( stats[i].contentions >= 1 ) && ( stats[i].maxWaitNs >= 50000000 ) );
+
+    ok &= check( "top N", NlockProfile::getStats( 2 ).size() == 2 );
+
+    ostringstream table;
+    table.precision( 9 );
+    NlockProfile::dump( table );
+    ok &= check( "dump keeps stream formatting", ( table.precision() == 9 ) && !( table.flags() & ( ios_base::fixed | ios_base::left ) ) );
+
+    NlockProfile::dumpOnSignal( SIGUSR1, 5 );
+    kill( getpid(), SIGUSR1 );
+    Ntime::sleep( 100 );    // Let the dump thread write the table to stderr
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
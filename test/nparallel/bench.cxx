@@ -0,0 +1,96 @@
+// Speed-up of the Nparallel algorithms versus pool thread count.
+// Build with: make TARGET=bench  (use the release CFLAGS in the makefile for meaningful numbers)
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <cmath>
+
+#include "nerror.h"
+#include "nparallel.h"
+#include "nrandom.h"
+#include "ntime.h"
+
+using namespace std;
+
+static double elapsedMs( const Ntime& theStart )
+{
+    timespec t = theStart.getElapsed().getAsTimespec();
+    return ( t.tv_sec * 1000.0 ) + ( t.tv_nsec / 1000000.0 );
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    const size_t SIZE = ( ac > 1 ) ? atol( av[1] ) : 10000000;
+    const size_t MAX_THREADS = 2 * ( thread::hardware_concurrency() ? thread::hardware_concurrency() : 1 );
+
+    vector<double> source( SIZE );
+    Nrandom rnd( 1 );
+    for ( size_t i = 0; i < SIZE; i++ )
+        source[i] = rnd.getRandomNumber( 0, 1000000 );
+
+    vector<double> work( SIZE );
+
+    // Serial baselines
+    Ntime start = Ntime::getCurrentLocalTime();
+    for ( size_t i = 0; i < SIZE; i++ )
+        work[i] = sqrt( source[i] ) * sin( source[i] );
+    double forBase = elapsedMs( start );
+
+    start = Ntime::getCurrentLocalTime();
+    volatile double sum = accumulate( source.begin(), source.end(), 0.0 );
+    double reduceBase = elapsedMs( start );
+
+    start = Ntime::getCurrentLocalTime();
+    partial_sum( source.begin(), source.end(), work.begin() );
+    double scanBase = elapsedMs( start );
+
+    work = source;
+    start = Ntime::getCurrentLocalTime();
+    sort( work.begin(), work.end() );
+    double sortBase = elapsedMs( start );
+
+    cout << "Elements: " << SIZE << endl;
+    cout << "Serial (ms):  for " << forBase << "  reduce " << reduceBase << "  scan " << scanBase << "  sort " << sortBase << endl;
+    cout << endl << "Speed-up vs serial" << endl;
+    cout << setw( 8 ) << "threads" << setw( 10 ) << "for" << setw( 10 ) << "reduce" << setw( 10 ) << "scan" << setw( 10 ) << "sort" << endl;
+
+    cout << fixed << setprecision( 2 );
+    for ( size_t threads = 1; threads <= MAX_THREADS; threads *= 2 )
+        {
+        NthreadPool pool( threads );
+
+        start = Ntime::getCurrentLocalTime();
+        Nparallel::parallelFor( pool, 0, SIZE, [&]( size_t i ) { work[i] = sqrt( source[i] ) * sin( source[i] ); } );
+        double forTime = elapsedMs( start );
+
+        start = Ntime::getCurrentLocalTime();
+        sum = Nparallel::parallelReduce( pool, 0, SIZE, 0.0,
+                                         [&]( size_t b, size_t e, double s ) { while ( b < e ) s += source[b++]; return s; },
+                                         []( double a, double b ) { return a + b; } );
+        double reduceTime = elapsedMs( start );
+
+        start = Ntime::getCurrentLocalTime();
+        Nparallel::parallelScan( pool, source.begin(), source.end(), work.begin(), []( double a, double b ) { return a + b; } );
+        double scanTime = elapsedMs( start );
+
+        work = source;
+        start = Ntime::getCurrentLocalTime();
+        Nparallel::parallelSort( pool, work.begin(), work.end() );
+        double sortTime = elapsedMs( start );
+
+        cout << setw( 8 ) << threads
+             << setw( 10 ) << forBase / forTime
+             << setw( 10 ) << reduceBase / reduceTime
+             << setw( 10 ) << scanBase / scanTime
+             << setw( 10 ) << sortBase / sortTime << endl;
+        }
+
+    (void)sum;
+    return EXIT_SUCCESS;
+}
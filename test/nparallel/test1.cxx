@@ -0,0 +1,100 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+
+#include "nerror.h"
+#include "nparallel.h"
+#include "nrandom.h"
+#include "../ntest.h"
+
+using namespace std;
+
+// Each pool job runs a parallelFor of its own on the same (small, bounded) pool.
+// This must complete rather than deadlock.
+typedef struct
+{
+    NthreadPool*          pool;
+    vector<unsigned int>* data;
+} NESTED_PARAMS;
+
+void nestedJob( void* theParam )
+{
+    NESTED_PARAMS& p = *(NESTED_PARAMS*)theParam;
+    Nparallel::parallelFor( *p.pool, 0, p.data->size(), [&]( size_t i ) { (*p.data)[i] += 1; } );
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    const size_t SIZE = 1000003; // Deliberately not a multiple of anything
+    NthreadPool pool( 4 );
+    Nrandom rnd( 1 );
+    bool ok = true;
+
+    vector<unsigned long long> v( SIZE );
+    Nparallel::parallelFor( pool, 0, SIZE, [&]( size_t i ) { v[i] = i; } );
+    bool forOk = true;
+    for ( size_t i = 0; i < SIZE; i++ )
+        forOk = forOk && ( v[i] == i );
+    ok &= check( "parallelFor", forOk );
+
+    unsigned long long sum = Nparallel::parallelReduce( pool, 0, SIZE, 0ULL,
+        [&]( size_t b, size_t e, unsigned long long s ) { while ( b < e ) s += v[b++]; return s; },
+        []( unsigned long long a, unsigned long long b ) { return a + b; } );
+    ok &= check( "parallelReduce", sum == ( (unsigned long long)SIZE * ( SIZE - 1 ) ) / 2 );
+
+    vector<unsigned long long> scanned( SIZE );
+    vector<unsigned long long> expected( SIZE );
+    partial_sum( v.begin(), v.end(), expected.begin() );
+    Nparallel::parallelScan( pool, v.begin(), v.end(), scanned.begin(),
+                             []( unsigned long long a, unsigned long long b ) { return a + b; } );
+    ok &= check( "parallelScan", scanned == expected );
+
+    vector<float> f( SIZE );
+    for ( size_t i = 0; i < SIZE; i++ )
+        f[i] = rnd.getRandomNumber( -1000, 1000 );
+    vector<float> sorted( f );
+    sort( sorted.begin(), sorted.end() );
+    Nparallel::parallelSort( pool, f.begin(), f.end() );
+    ok &= check( "parallelSort", f == sorted );
+
+    vector<float> a( sorted.begin(), sorted.begin() + SIZE / 3 );
+    vector<float> b( sorted.begin() + SIZE / 3, sorted.end() );
+    reverse( b.begin(), b.end() );
+    sort( b.begin(), b.end() );
+    vector<float> merged( a.size() + b.size() );
+    Nparallel::parallelMerge( pool, a.begin(), a.end(), b.begin(), b.end(), merged.begin() );
+    ok &= check( "parallelMerge", merged == sorted );
+
+    const int NESTED_JOBS = 8;
+    vector<unsigned int> nested[ NESTED_JOBS ];
+    NESTED_PARAMS params[ NESTED_JOBS ];
+    for ( int i = 0; i < NESTED_JOBS; i++ )
+        {
+        nested[i].resize( 10000, 0 );
+        params[i].pool = &pool;
+        params[i].data = &nested[i];
+        pool.submitJob( nestedJob, &params[i] );
+        }
+    pool.waitForIdle();
+    bool nestedOk = true;
+    for ( int i = 0; i < NESTED_JOBS; i++ )
+        nestedOk = nestedOk && ( count( nested[i].begin(), nested[i].end(), 1 ) == 10000 );
+    ok &= check( "nested parallelFor (no deadlock)", nestedOk );
+
+    bool caught = false;
+    try
+        {
+        Nparallel::parallelFor( pool, 0, SIZE, []( size_t i ) { if ( i == 12345 ) ERROR( "Deliberate error" ); } );
+        }
+    catch( NerrorException& e )
+        {
+        caught = true;
+        }
+    ok &= check( "exception propagation", caught );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,188 @@
+// Nqueue throughput and latency, compared against an Nmutex around a std::queue.
+// All queues are used through their blocking push()/pop(), as a pipeline would use them.
+// Build with: make TARGET=bench  (use the release CFLAGS in the makefile for meaningful numbers)
+#include <iostream>
+#include <iomanip>
+#include <queue>
+#include <vector>
+
+#include "nerror.h"
+#include "nmutex.h"
+#include "nqueue.h"
+#include "nthread.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static const unsigned long ITEMS = 1000000;
+static const unsigned long ROUND_TRIPS = 20000;
+
+// The way nlib handed items between threads before Nqueue.
+template< class T >
+class MutexQueue
+{
+public:
+    explicit MutexQueue( const size_t theCapacity = 0 ) : m_items( true, 0 ) {}
+
+    void push( const T& theItem )
+    {
+        m_owner.lock();
+        m_queue.push( theItem );
+        m_owner.unlock();
+        m_items.signal();
+    }
+
+    bool pop( T& theItem, const Ntime theTimeout = 0 )
+    {
+        m_items.wait();
+        m_owner.lock();
+        theItem = m_queue.front();
+        m_queue.pop();
+        m_owner.unlock();
+        return true;
+    }
+
+private:
+    Nmutex          m_owner;
+    std::queue< T > m_queue;
+    Nevent          m_items;
+};
+
+
+typedef struct : public NmpscQueue::NODE
+{
+    unsigned long value;
+} ITEM;
+
+// Lets the throughput and latency tests treat the intrusive queue like the others.
+class MpscQueue
+{
+public:
+    explicit MpscQueue( const size_t theCapacity = 0 ) : m_items( ITEMS ), m_next( 0 ) {}
+
+    void push( const unsigned long& theValue )
+    {
+        ITEM& item = m_items[ m_next++ % m_items.size() ];
+        item.value = theValue;
+        m_queue.push( &item );
+    }
+
+    bool pop( unsigned long& theValue, const Ntime theTimeout = 0 )
+    {
+        NmpscQueue::NODE* node;
+        m_queue.pop( node );
+        theValue = static_cast< ITEM* >( node )->value;
+        return true;
+    }
+
+private:
+    NblockingQueue< NmpscQueue, NmpscQueue::NODE* > m_queue;
+    vector< ITEM >                                  m_items;    // One per item pushed, as the queue is unbounded
+    std::atomic< unsigned long >                    m_next;
+};
+
+
+template< class QUEUE >
+struct PIPE
+{
+    QUEUE           forward;
+    QUEUE           back;
+    unsigned long   count;
+
+    PIPE() : forward( 256 ), back( 256 ), count( 0 ) {}
+};
+
+template< class QUEUE >
+void* producerProc( void* theParam )
+{
+    PIPE< QUEUE >* pipe = (PIPE< QUEUE >*)theParam;
+    for ( unsigned long i = 0; i < pipe->count; i++ )
+        pipe->forward.push( i );
+    return NULL;
+}
+
+template< class QUEUE >
+void* echoProc( void* theParam )
+{
+    PIPE< QUEUE >* pipe = (PIPE< QUEUE >*)theParam;
+    unsigned long value;
+    for ( unsigned long i = 0; i < pipe->count; i++ )
+        {
+        pipe->forward.pop( value );
+        pipe->back.push( value );
+        }
+    return NULL;
+}
+
+
+// Returns ns per item with theProducers threads pushing ITEMS between them and one consumer.
+template< class QUEUE >
+double throughput( const int theProducers )
+{
+    PIPE< QUEUE > pipe;
+    pipe.count = ITEMS / theProducers;
+
+    Ntime start = Ntime::getCurrentLocalTime();
+    vector< Nthread* > producers;
+    for ( int i = 0; i < theProducers; i++ )
+        producers.push_back( new Nthread( producerProc< QUEUE >, &pipe ) );
+
+    unsigned long value;
+    for ( unsigned long i = 0; i < pipe.count * theProducers; i++ )
+        pipe.forward.pop( value );
+
+    for ( int i = 0; i < theProducers; i++ )
+        {
+        producers[i]->getReturnValue();
+        delete producers[i];
+        }
+    return elapsedNs( start ) / ( pipe.count * theProducers );
+}
+
+
+// Returns ns for an item to go to another thread and come back.
+template< class QUEUE >
+double latency()
+{
+    PIPE< QUEUE > pipe;
+    pipe.count = ROUND_TRIPS;
+    Nthread echo( echoProc< QUEUE >, &pipe );
+
+    Ntime start = Ntime::getCurrentLocalTime();
+    unsigned long value;
+    for ( unsigned long i = 0; i < ROUND_TRIPS; i++ )
+        {
+        pipe.forward.push( i );
+        pipe.back.pop( value );
+        }
+    double ns = elapsedNs( start ) / ROUND_TRIPS;
+
+    echo.getReturnValue();
+    return ns;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    typedef MutexQueue< unsigned long >                                           MUTEX;
+    typedef NblockingQueue< NspscQueue< unsigned long >, unsigned long >          SPSC;
+    typedef NblockingQueue< NmpmcQueue< unsigned long >, unsigned long >          MPMC;
+
+    cout << fixed << setprecision( 1 );
+    cout << setw( 24 ) << "ns per item" << setw( 12 ) << "mutex" << setw( 12 ) << "spsc"
+         << setw( 12 ) << "mpmc" << setw( 12 ) << "mpsc" << endl;
+
+    cout << setw( 24 ) << "1 producer throughput" << setw( 12 ) << throughput< MUTEX >( 1 ) << setw( 12 ) << throughput< SPSC >( 1 )
+         << setw( 12 ) << throughput< MPMC >( 1 ) << setw( 12 ) << throughput< MpscQueue >( 1 ) << endl;
+
+    cout << setw( 24 ) << "4 producer throughput" << setw( 12 ) << throughput< MUTEX >( 4 ) << setw( 12 ) << "-"
+         << setw( 12 ) << throughput< MPMC >( 4 ) << setw( 12 ) << throughput< MpscQueue >( 4 ) << endl;
+
+    cout << setw( 24 ) << "round trip latency" << setw( 12 ) << latency< MUTEX >() << setw( 12 ) << latency< SPSC >()
+         << setw( 12 ) << latency< MPMC >() << setw( 12 ) << latency< MpscQueue >() << endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,153 @@
+// Checks the Nqueue queues deliver every item exactly once and in order per producer.
+#include <iostream>
+#include <vector>
+
+#include "nerror.h"
+#include "nqueue.h"
+#include "nthread.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static const unsigned long ITEMS = 200000;   // Per producer
+static const int PRODUCERS = 4;
+
+// Items carry producer << 32 | sequence, so consumers can check order per producer.
+typedef NblockingQueue< NmpmcQueue< unsigned long >, unsigned long > MPMC;
+
+typedef struct
+{
+    MPMC*           queue;
+    unsigned long   producer;
+} PRODUCER;
+
+void* mpmcProducerProc( void* theParam )
+{
+    PRODUCER* p = (PRODUCER*)theParam;
+    for ( unsigned long i = 0; i < ITEMS; i++ )
+        p->queue->push( ( p->producer << 32 ) | i );
+    return NULL;
+}
+
+void* mpmcConsumerProc( void* theParam )
+{
+    MPMC* queue = (MPMC*)theParam;
+    vector< unsigned long > next( PRODUCERS, 0 );
+    unsigned long item;
+    unsigned long count = 0;
+
+    while ( queue->pop( item, 500 ) )
+        {
+        unsigned long producer = item >> 32;
+        if ( ( item & 0xFFFFFFFF ) < next[ producer ] )
+            return (void*)-1;   // Out of order or repeated
+        next[ producer ] = ( item & 0xFFFFFFFF ) + 1;
+        count++;
+        }
+    return (void*)count;
+}
+
+
+typedef struct ITEM : public NmpscQueue::NODE
+{
+    unsigned long producer;
+    unsigned long sequence;
+} ITEM;
+
+typedef NblockingQueue< NmpscQueue, NmpscQueue::NODE* > MPSC;
+
+typedef struct
+{
+    MPSC*           queue;
+    unsigned long   producer;
+    vector< ITEM >  items;
+} MPSC_PRODUCER;
+
+void* mpscProducerProc( void* theParam )
+{
+    MPSC_PRODUCER* p = (MPSC_PRODUCER*)theParam;
+    for ( unsigned long i = 0; i < p->items.size(); i++ )
+        {
+        p->items[i].producer = p->producer;
+        p->items[i].sequence = i;
+        p->queue->push( &p->items[i] );
+        }
+    return NULL;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+
+    NspscQueue< int > spsc( 5 );
+    ok &= check( "spsc: capacity rounded up", spsc.capacity() == 8 );
+    int in[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    int out[10];
+    ok &= check( "spsc: batch push stops when full", spsc.pushBatch( in, 10 ) == 8 && !spsc.tryPush( 8 ) );
+    ok &= check( "spsc: batch pop in order", spsc.popBatch( out, 3 ) == 3 && out[0] == 0 && out[2] == 2 && spsc.size() == 5 );
+    int value;
+    ok &= check( "spsc: wraps around", spsc.pushBatch( in + 8, 2 ) == 2 && spsc.popBatch( out, 10 ) == 7 &&
+                                       out[6] == 9 && !spsc.tryPop( value ) );
+
+    NmpmcQueue< int > mpmc( 4 );
+    ok &= check( "mpmc: full and empty", mpmc.pushBatch( in, 10 ) == 4 && mpmc.popBatch( out, 10 ) == 4 &&
+                                         out[3] == 3 && !mpmc.tryPop( value ) );
+
+    MPMC blocking( 64 );
+    unsigned long item;
+    ok &= check( "blocking: pop times out", !blocking.pop( item, 50 ) );
+
+    vector< PRODUCER > producers( PRODUCERS );
+    vector< Nthread* > threads;
+    for ( int i = 0; i < PRODUCERS; i++ )
+        {
+        producers[i].queue = &blocking;
+        producers[i].producer = i;
+        threads.push_back( new Nthread( mpmcProducerProc, &producers[i] ) );
+        }
+    Nthread consumer1( mpmcConsumerProc, &blocking );
+    Nthread consumer2( mpmcConsumerProc, &blocking );
+    for ( int i = 0; i < PRODUCERS; i++ )
+        {
+        threads[i]->getReturnValue();
+        delete threads[i];
+        }
+    void* consumed;
+    consumer1.getReturnValue( &consumed );
+    long consumed1 = (long)consumed;
+    consumer2.getReturnValue( &consumed );
+    long consumed2 = (long)consumed;
+    ok &= check( "mpmc: 4 producers, 2 consumers", ( consumed1 >= 0 ) && ( consumed2 >= 0 ) &&
+                                                   ( consumed1 + consumed2 == (long)( PRODUCERS * ITEMS ) ) );
+
+    MPSC mpsc;
+    vector< MPSC_PRODUCER > mpscProducers( PRODUCERS );
+    threads.clear();
+    for ( int i = 0; i < PRODUCERS; i++ )
+        {
+        mpscProducers[i].queue = &mpsc;
+        mpscProducers[i].producer = i;
+        mpscProducers[i].items.resize( ITEMS );
+        threads.push_back( new Nthread( mpscProducerProc, &mpscProducers[i] ) );
+        }
+    vector< unsigned long > next( PRODUCERS, 0 );
+    bool inOrder = true;
+    NmpscQueue::NODE* node;
+    for ( unsigned long i = 0; i < PRODUCERS * ITEMS; i++ )
+        {
+        mpsc.pop( node );
+        ITEM* item = static_cast< ITEM* >( node );
+        inOrder &= ( item->sequence == next[ item->producer ]++ );
+        }
+    for ( int i = 0; i < PRODUCERS; i++ )
+        {
+        threads[i]->getReturnValue();
+        delete threads[i];
+        }
+    ok &= check( "mpsc: 4 producers in order", inOrder && !mpsc.tryPop( node ) );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,129 @@
+#include <iostream>
+#include <vector>
+#include <atomic>
+
+#include "nerror.h"
+#include "nscheduler.h"
+#include "nthreadPool.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+typedef struct
+{
+    atomic<int> runs;
+    Ntime       lastRun;
+} COUNTER;
+
+void countProc( void* theParam )
+{
+    COUNTER* counter = (COUNTER*)theParam;
+    counter->lastRun = Ntime::getCurrentLocalTime();
+    counter->runs++;
+}
+
+
+void slowProc( void* theParam )
+{
+    ( (COUNTER*)theParam )->runs++;
+    Ntime::sleep( 250 );
+}
+
+
+static double elapsedMs( const Ntime& theStart )
+{
+    timespec t = theStart.getElapsed().getAsTimespec();
+    return ( t.tv_sec * 1000.0 ) + ( t.tv_nsec / 1000000.0 );
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+    NthreadPool pool( 2, 0, 1000 );
+    Nscheduler scheduler( pool, 1, "timers" );
+
+    // One shot: runs once, and not early.
+    COUNTER once;
+    once.runs = 0;
+    Ntime start = Ntime::getCurrentLocalTime();
+    scheduler.scheduleOnce( countProc, &once, 100 );
+    Ntime::sleep( 300 );
+    ok &= check( "one shot runs once", once.runs == 1 );
+    ok &= check( "one shot not early", start.getDifference( once.lastRun ).getAsMs() >= 100 );
+
+    // Far enough off to start in a higher wheel level and be cascaded down.
+    COUNTER cascaded;
+    cascaded.runs = 0;
+    start = Ntime::getCurrentLocalTime();
+    scheduler.scheduleOnce( countProc, &cascaded, 700 );
+    Ntime::sleep( 650 );
+    ok &= check( "cascaded one shot not early", cascaded.runs == 0 );
+    Ntime::sleep( 150 );
+    ok &= check( "cascaded one shot runs", ( cascaded.runs == 1 ) && ( start.getDifference( cascaded.lastRun ).getAsMs() >= 700 ) );
+
+    // Cancelled one shot never runs, and can't be cancelled twice.
+    COUNTER cancelled;
+    cancelled.runs = 0;
+    Nscheduler::JOB_ID id = scheduler.scheduleOnce( countProc, &cancelled, 100 );
+    ok &= check( "cancel", scheduler.cancel( id ) );
+    ok &= check( "cancel twice", !scheduler.cancel( id ) );
+    Ntime::sleep( 200 );
+    ok &= check( "cancelled job doesn't run", cancelled.runs == 0 );
+
+    // Periodic: 20ms for 1s should run 50 times without drifting.
+    COUNTER periodic;
+    periodic.runs = 0;
+    id = scheduler.schedulePeriodic( countProc, &periodic, 20 );
+    Ntime::sleep( 1010 );
+    scheduler.cancel( id );
+    int runs = periodic.runs;
+    cout << "periodic runs in 1s: " << runs << endl;
+    ok &= check( "periodic", ( runs >= 49 ) && ( runs <= 51 ) );
+
+    // A periodic job slower than its period skips runs rather than overlapping.
+    COUNTER slow;
+    slow.runs = 0;
+    id = scheduler.schedulePeriodic( slowProc, &slow, 100, true );
+    Ntime::sleep( 1000 );
+    scheduler.cancel( id );
+    pool.waitForIdle();
+    ok &= check( "overrun skipped", ( slow.runs >= 3 ) && ( slow.runs <= 5 ) );
+
+    // Lots of timers. Times for scheduling and cancelling should grow linearly.
+    const int TIMERS = ( ac > 1 ) ? atoi( av[1] ) : 200000;
+    COUNTER many;
+    many.runs = 0;
+    vector<Nscheduler::JOB_ID> ids( TIMERS );
+
+    start = Ntime::getCurrentLocalTime();
+    for ( int i = 0; i < TIMERS; i++ )
+        ids[i] = scheduler.scheduleOnce( countProc, &many, 1000 + ( i % 100000 ) * 10 ); // Spread over 1000s
+    double scheduleMs = elapsedMs( start );
+
+    start = Ntime::getCurrentLocalTime();
+    bool allCancelled = true;
+    for ( int i = 0; i < TIMERS; i++ )
+        allCancelled &= scheduler.cancel( ids[i] );
+    double cancelMs = elapsedMs( start );
+
+    cout << TIMERS << " timers: schedule " << scheduleMs << "ms, cancel " << cancelMs << "ms" << endl;
+    ok &= check( "mass cancel", allCancelled && ( many.runs == 0 ) );
+
+    // Many short timers all fire.
+    const int SHORT_TIMERS = 10000;
+    for ( int i = 0; i < SHORT_TIMERS; i++ )
+        scheduler.scheduleOnce( countProc, &many, i % 500 );
+    Ntime::sleep( 1000 );
+    pool.waitForIdle();
+    ok &= check( "many short timers fire", many.runs == SHORT_TIMERS );
+
+    Nscheduler::SCHEDULER_METRICS m = scheduler.getMetrics();
+    cout << "scheduled " << m.jobsScheduled << " runs " << m.runsStarted << " overruns " << m.overruns
+         << " missed " << m.missedRuns << " wakeups " << m.wakeups << endl;
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
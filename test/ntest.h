@@ -0,0 +1,26 @@
+#ifndef NTEST_H
+#define NTEST_H
+
+// Helpers shared by the tests and benchmarks in test/*/. Include as "../ntest.h".
+
+#include <iostream>
+#include <string>
+#include <time.h>
+
+#include "ntime.h"
+
+inline bool check( const std::string& theTest, const bool thePassed )
+{
+    std::cout << theTest << ": " << ( thePassed ? "OK" : "FAIL" ) << std::endl;
+    return thePassed;
+}
+// Prints whether theTest passed, and returns thePassed so results can be and'ed together.
+
+inline double elapsedNs( const Ntime& theStart )
+{
+    timespec t = theStart.getElapsed().getAsTimespec();
+    return ( t.tv_sec * 1000000000.0 ) + t.tv_nsec;
+}
+// Nanoseconds since theStart, from Ntime::getCurrentLocalTime(), for timing benchmarks.
+
+#endif
@@ -0,0 +1,138 @@
+// Checks that Nthread creation attributes are in place when the thread process starts.
+#include <iostream>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+#include "nerror.h"
+#include "nthread.h"
+#include "../ntest.h"
+
+using namespace std;
+
+// What the thread sees of itself as soon as it runs
+typedef struct
+    {
+    char        name[ 16 ];
+    void*       local;          // Address of something on the thread's stack
+    void*       stackBase;      // Lowest address of the stack
+    size_t      stackSize;
+    size_t      guardSize;
+    cpu_set_t   cpus;
+    int         policy;
+    } SEEN;
+
+
+void* seeProc( void* theParam )
+{
+    SEEN& seen = *(SEEN*)theParam;
+    int local = 0;
+    seen.local = &local;
+
+    pthread_getname_np( pthread_self(), seen.name, sizeof( seen.name ) );
+    pthread_getaffinity_np( pthread_self(), sizeof( cpu_set_t ), &seen.cpus );
+
+    pthread_attr_t attributes;
+    pthread_getattr_np( pthread_self(), &attributes );
+    pthread_attr_getstack( &attributes, &seen.stackBase, &seen.stackSize );
+    pthread_attr_getguardsize( &attributes, &seen.guardSize );
+    pthread_attr_destroy( &attributes );
+
+    struct sched_param param;
+    pthread_getschedparam( pthread_self(), &seen.policy, &param );
+    return NULL;
+}
+
+
+static bool onStack( const SEEN& theSeen, const void* theStack, const size_t theSize )
+{
+    return ( theSeen.local >= theStack ) && ( theSeen.local < (char*)theStack + theSize );
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+    SEEN seen;
+
+        {
+        memset( &seen, 0, sizeof( seen ) );
+        Nthread thread( seeProc, &seen, "seer" );
+        thread.getReturnValue();
+        ok &= check( "name set before the process runs", string( seen.name ) == "seer" );
+        }
+
+        {
+        memset( &seen, 0, sizeof( seen ) );
+        Nthread::THREAD_ATTRIBUTES attributes;
+        attributes.stackSize = 256 * 1024;
+        attributes.guardSize = 0;
+        Nthread thread( seeProc, &seen, attributes );
+        thread.getReturnValue();
+        ok &= check( "stack size", ( seen.stackSize >= attributes.stackSize ) && ( seen.stackSize < 512 * 1024 ) );
+        ok &= check( "guard size", seen.guardSize == 0 );
+        }
+
+        {
+        memset( &seen, 0, sizeof( seen ) );
+        static char stack[ 128 * 1024 ] __attribute__(( aligned( 4096 ) ));
+        Nthread::THREAD_ATTRIBUTES attributes;
+        attributes.stack = stack;
+        attributes.stackSize = sizeof( stack );
+        Nthread thread( seeProc, &seen, attributes );
+        thread.getReturnValue();
+        ok &= check( "caller's stack", onStack( seen, stack, sizeof( stack ) ) );
+        }
+
+        {
+        memset( &seen, 0, sizeof( seen ) );
+        Nthread::THREAD_ATTRIBUTES attributes;
+        attributes.stackSize = 3 * 1024 * 1024;
+        attributes.hugePageStack = true;
+        Nthread thread( seeProc, &seen, attributes );
+        thread.getReturnValue();
+        ok &= check( "huge page stack", ( ( (uintptr_t)seen.stackBase & ( 2 * 1024 * 1024 - 1 ) ) == 0 ) &&
+                                        ( seen.stackSize == 4 * 1024 * 1024 ) &&
+                                        onStack( seen, seen.stackBase, seen.stackSize ) );
+        }
+
+        {
+        memset( &seen, 0, sizeof( seen ) );
+        Nthread::THREAD_ATTRIBUTES attributes;
+        attributes.affinity = string( "0b1" );
+        attributes.schedulingModel = Nthread::BATCH;
+        Nthread thread( seeProc, &seen, attributes );
+        thread.getReturnValue();
+        ok &= check( "pinned from the start", ( CPU_COUNT( &seen.cpus ) == 1 ) && CPU_ISSET( 0, &seen.cpus ) );
+        ok &= check( "scheduling model from the start", seen.policy == SCHED_BATCH );
+        }
+
+    bool threw = false;
+    try
+        {
+        Nthread thread( seeProc, &seen, "a name much too long" );
+        }
+    catch ( NerrorException& e )
+        {
+        threw = true;
+        }
+    ok &= check( "name too long", threw );
+
+    threw = false;
+    try
+        {
+        Nthread::THREAD_ATTRIBUTES attributes;
+        attributes.hugePageStack = true;
+        Nthread thread( seeProc, &seen, attributes, "", true );
+        }
+    catch ( NerrorException& e )
+        {
+        threw = true;
+        }
+    ok &= check( "no huge page stack for detached threads", threw );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
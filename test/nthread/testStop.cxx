@@ -0,0 +1,80 @@
+// Checks that a stop request ends a thread's waits promptly.
+#include <iostream>
+
+#include "nerror.h"
+#include "nevent.h"
+#include "nsocket.h"
+#include "nthread.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static bool woken = false;
+
+void* sleeperProc( const NstopToken& theStopToken, void* theParam )
+{
+    woken = !Ntime::sleep( 60000, theStopToken );
+    return NULL;
+}
+
+
+void* waiterProc( const NstopToken& theStopToken, void* theParam )
+{
+    Nevent& neverSignalled = *(Nevent*)theParam;
+    while ( !theStopToken.stopRequested() )
+        neverSignalled.wait( 0, theStopToken );
+    return NULL;
+}
+
+
+void* listenerProc( const NstopToken& theStopToken, void* theParam )
+{
+    Nsocket& socket = *(Nsocket*)theParam;
+    bool timedOut = false;
+    socket.waitForSocketEvent( &timedOut, 60000, theStopToken );
+    return theStopToken.stopRequested() && !timedOut ? theParam : NULL;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+
+    Ntime start = Ntime::getCurrentLocalTime();
+        {
+        Nthread sleeper( sleeperProc );
+        Ntime::sleep( 50 );
+        }   // Destructor requests the stop
+    ok &= check( "sleep ends on stop", woken && ( start.getElapsed().getAsMs() < 500 ) );
+
+    Nevent neverSignalled;
+    start = Ntime::getCurrentLocalTime();
+    Nthread waiter( waiterProc, &neverSignalled );
+    Ntime::sleep( 50 );
+    waiter.requestStop();
+    waiter.getReturnValue();
+    ok &= check( "event wait ends on stop", start.getElapsed().getAsMs() < 500 );
+
+    Nevent event;
+    NstopToken token;
+    event.signal();
+    bool taken = event.wait( 0, token );
+    token.requestStop();
+    event.signal();
+    ok &= check( "wait with a token", taken && !event.wait( 0, token ) && !Ntime::sleep( 0, token ) );
+
+    Nsocket server;
+    server.listen( 47123 );
+    start = Ntime::getCurrentLocalTime();
+    Nthread listener( listenerProc, &server );
+    Ntime::sleep( 50 );
+    listener.requestStop();
+    void* result = NULL;
+    listener.getReturnValue( &result );
+    ok &= check( "socket wait ends on stop", ( result == &server ) && ( start.getElapsed().getAsMs() < 500 ) );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,67 @@
+#include <iostream>
+#include "nerror.h"
+#include "nthreadPool.h"
+#include "ntime.h"
+
+using namespace std;
+
+
+void Threadproc( void* theParam )
+{
+    Ntime::sleep( *(int*)theParam );
+}
+
+
+// Still running when its pool is deleted, so can't share out any more work.
+NthreadPool* closingPool;
+bool submittedWhileClosing = true;
+
+void ClosingThreadproc( void* theParam )
+{
+    Ntime::sleep( 200 );
+    submittedWhileClosing = closingPool->trySubmitJob( Threadproc, theParam );
+}
+
+
+void printMetrics( const char* theWhen, NthreadPool& thePool )
+{
+    NthreadPool::POOL_METRICS m = thePool.getMetrics();
+    cout << theWhen << ": size " << m.currentSize << " idle " << m.idleThreads << " queued " << m.queueDepth
+         << " | peak size " << m.peakSize << " peak queue " << m.peakQueueDepth
+         << " | submitted " << m.jobsSubmitted << " queued " << m.jobsQueued
+         << " spawned " << m.threadsSpawned << " (delayed " << m.delayedSpawns << ")"
+         << " retired " << m.threadsRetired << endl;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    const int BURST = 12;
+    int jobTime = 300;
+
+    // Between 2 and 8 threads. Grow when a job has waited 50ms, retire after 200ms idle.
+    NthreadPool pool( 2, 8, 200, 50, "elastic" );
+    printMetrics( "start     ", pool );
+
+    for ( int i = 0; i < BURST; i++ )
+        pool.submitJob( Threadproc, &jobTime );
+    printMetrics( "burst     ", pool );
+
+    pool.waitForIdle();
+    printMetrics( "idle      ", pool );
+
+    Ntime::sleep( 500 );
+    printMetrics( "after 500 ", pool );
+
+    cout << ( ( pool.getPoolSize() == 2 ) ? "Retired back to minimum: OK" : "Retired back to minimum: FAIL" ) << endl;
+
+    int noTime = 0;
+    closingPool = new NthreadPool( 2 );
+    closingPool->submitJob( ClosingThreadproc, &noTime );
+    delete closingPool;
+    cout << ( submittedWhileClosing ? "trySubmitJob while closing: FAIL" : "trySubmitJob while closing: OK" ) << endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "nerror.h"
+#include "nmutex.h"
+#include "nthread.h"
+#include "nthreadPool.h"
+#include "ntime.h"
+
+using namespace std;
+
+// Build with: make TARGET=testPriority
+
+static Nmutex         runOrderOwner;
+static vector<string> runOrder;
+
+typedef struct
+{
+    NthreadPool*              pool;
+    string                    name;
+    NthreadPool::JOB_PRIORITY priority;
+    Ntime                     deadline;
+} JOB;
+
+
+void jobProc( void* theParam )
+{
+    runOrderOwner.lock();
+    runOrder.push_back( ( (JOB*)theParam )->name );
+    runOrderOwner.unlock();
+}
+
+
+void blockerProc( void* theParam )
+{
+    Ntime::sleep( *(int*)theParam );
+}
+
+
+void* submitterProc( void* theParam )
+{
+    // submitJob() blocks while the job waits for a thread, so each waiting job needs its own submitter.
+    JOB* job = (JOB*)theParam;
+    job->pool->submitJob( jobProc, job, job->priority, job->deadline );
+    return NULL;
+}
+
+
+bool runTest( const char* theTest, NthreadPool& thePool, vector<JOB>& theJobs, const string& theExpected, int theBlockTime, int theGap )
+{
+    runOrder.clear();
+
+    // Occupy the only thread so everything else has to queue.
+    thePool.submitJob( blockerProc, &theBlockTime );
+
+    vector<Nthread*> submitters;
+    for ( size_t i = 0; i < theJobs.size(); i++ )
+        {
+        theJobs[i].pool = &thePool;
+        submitters.push_back( new Nthread( submitterProc, &theJobs[i] ) );
+        Ntime::sleep( theGap );  // Make queuing order deterministic
+        }
+
+    for ( size_t i = 0; i < submitters.size(); i++ )
+        {
+        submitters[i]->getReturnValue();
+        delete submitters[i];
+        }
+    thePool.waitForIdle();
+
+    string actual;
+    for ( size_t i = 0; i < runOrder.size(); i++ )
+        actual += runOrder[i] + " ";
+
+    bool ok = ( actual == theExpected );
+    cout << theTest << ": " << actual << ( ok ? "OK" : "FAIL" ) << endl;
+    return ok;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+    NthreadPool pool( 1 );
+
+    // Without aging: priority first, then earliest deadline, then first come first served.
+    pool.setPriorityAging( 0 );
+    vector<JOB> jobs( 6 );
+    jobs[0].name = "low1";    jobs[0].priority = NthreadPool::LOW_PRIORITY;      jobs[0].deadline = 0;
+    jobs[1].name = "low2";    jobs[1].priority = NthreadPool::LOW_PRIORITY;      jobs[1].deadline = 0;
+    jobs[2].name = "normal";  jobs[2].priority = NthreadPool::NORMAL_PRIORITY;   jobs[2].deadline = 0;
+    jobs[3].name = "late";    jobs[3].priority = NthreadPool::NORMAL_PRIORITY;   jobs[3].deadline = 5000;
+    jobs[4].name = "soon";    jobs[4].priority = NthreadPool::NORMAL_PRIORITY;   jobs[4].deadline = 1000;
+    jobs[5].name = "control"; jobs[5].priority = NthreadPool::CRITICAL_PRIORITY; jobs[5].deadline = 0;
+    ok &= runTest( "priority/EDF", pool, jobs, "control soon late normal low1 low2 ", 300, 20 );
+
+    // With aging every 100ms, a low priority job that has waited 300ms outranks a new high priority one.
+    pool.setPriorityAging( 100 );
+    jobs.resize( 2 );
+    jobs[0].name = "aged";    jobs[0].priority = NthreadPool::LOW_PRIORITY;      jobs[0].deadline = 0;
+    jobs[1].name = "high";    jobs[1].priority = NthreadPool::HIGH_PRIORITY;     jobs[1].deadline = 0;
+    ok &= runTest( "aging", pool, jobs, "aged high ", 400, 300 );
+
+    NthreadPool::POOL_METRICS m = pool.getMetrics();
+    cout << "jobs aged " << m.jobsAged << ", deadlines missed " << m.deadlinesMissed << endl;
+
+    // Batch jobs run under SCHED_BATCH. Needs no privilege, so should apply without a warning.
+    pool.setPriorityScheduling( NthreadPool::LOW_PRIORITY, Nthread::BATCH );
+    jobs.resize( 1 );
+    jobs[0].name = "batch";   jobs[0].priority = NthreadPool::LOW_PRIORITY;      jobs[0].deadline = 0;
+    ok &= runTest( "scheduling model", pool, jobs, "batch ", 50, 10 );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,87 @@
+// Checks NthreadPool job timings and per worker statistics, and Nthread::getStats().
+#include <iostream>
+#include <sched.h>
+#include "nerror.h"
+#include "nthreadPool.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+void spinProc( void* theParam )
+{
+    // Burn about theParam ms of CPU
+    Ntime start = Ntime::getCurrentLocalTime();
+    while ( start.getElapsed().getAsMs() < *(int*)theParam )
+        ;
+}
+
+
+void* sleeperProc( void* theParam )
+{
+    for ( int i = 0; i < 5; i++ )
+        Ntime::sleep( 1 );
+    spinProc( theParam );
+    return NULL;
+}
+
+
+void printHistogram( const char* theName, const NthreadPool::DURATION_HISTOGRAM& theHistogram )
+{
+    cout << theName << ": count " << theHistogram.count << " mean " << ( theHistogram.count ? theHistogram.totalUs / theHistogram.count : 0 )
+         << "us max " << theHistogram.maxUs << "us |";
+    for ( int i = 0; i < NthreadPool::HISTOGRAM_BUCKETS; i++ )
+        if ( theHistogram.buckets[i] )
+            cout << " <" << ( 1ULL << i ) << "us:" << theHistogram.buckets[i];
+    cout << endl;
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+
+    int spinMs = 20;
+    Nthread thread( sleeperProc, &spinMs );
+    Ntime::sleep( 10 );
+    Nthread::THREAD_STATS stats = thread.getStats();
+    thread.getReturnValue();
+    cout << "thread: cpu " << stats.cpuTimeNs / 1000 << "us voluntary " << stats.voluntarySwitches
+         << " involuntary " << stats.involuntarySwitches << " migrations " << stats.migrations << " cpu " << stats.lastCpu << endl;
+    ok &= check( "thread stats", ( stats.voluntarySwitches >= 5 ) && ( stats.cpuTimeNs > 0 ) && ( stats.lastCpu >= 0 ) &&
+                                 CPU_ISSET( stats.lastCpu, NcpuSet::current().getNative() ) );
+
+    const int JOBS = 10;
+    NthreadPool pool( 2 );
+    int jobMs = 5;
+    for ( int i = 0; i < JOBS; i++ )
+        pool.submitJob( spinProc, &jobMs );
+    pool.waitForIdle();
+
+    NthreadPool::POOL_STATS poolStats = pool.getStats();
+    printHistogram( "queue wait", poolStats.queueWait );
+    printHistogram( "run time", poolStats.runTime );
+
+    unsigned long long jobsRun = 0;
+    unsigned long long cpuNs = 0;
+    unsigned long long busyUs = 0;
+    for ( size_t i = 0; i < poolStats.workers.size(); i++ )
+        {
+        const NthreadPool::WORKER_STATS& w = poolStats.workers[i];
+        cout << "worker " << w.tid << ( w.idle ? " idle" : " busy" ) << ": jobs " << w.jobsRun << " busy " << w.busyUs << "us cpu "
+             << w.thread.cpuTimeNs / 1000 << "us switches " << w.thread.voluntarySwitches << "/" << w.thread.involuntarySwitches << endl;
+        jobsRun += w.jobsRun;
+        cpuNs += w.thread.cpuTimeNs;
+        busyUs += w.busyUs;
+        }
+
+    ok &= check( "run time histogram", ( poolStats.runTime.count == JOBS ) && ( poolStats.runTime.totalUs >= JOBS * 5000ULL ) &&
+                                       ( poolStats.runTime.buckets[13] + poolStats.runTime.buckets[14] + poolStats.runTime.buckets[15] == JOBS ) );
+    // Only 2 threads for 10 jobs, so most had to wait for at least one job's run time.
+    ok &= check( "queue wait histogram", ( poolStats.queueWait.count == JOBS ) && ( poolStats.queueWait.maxUs >= 5000 ) );
+    ok &= check( "per worker stats", ( poolStats.workers.size() == 2 ) && ( jobsRun == JOBS ) && ( busyUs >= JOBS * 5000ULL ) && ( cpuNs > 0 ) );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,44 @@
+// ns to read the time with Ntime and with each Ntimestamp clock, and to time an interval.
+// Build with: make TARGET=bench  (use the release CFLAGS in the makefile for meaningful numbers)
+#include <iostream>
+#include <iomanip>
+#include <stdlib.h>
+
+#include "nerror.h"
+#include "ntime.h"
+
+using namespace std;
+
+static volatile int64_t sink;
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    Ntimestamp::calibrateTsc();
+    const int repeats = 2000000;
+    static const char* methods[] = { "Ntime::getCurrentLocalTime", "Ntime::getElapsed", "Ntimestamp MONOTONIC",
+                                     "Ntimestamp MONOTONIC_COARSE", "Ntimestamp TSC", "Ntimestamp TSC getElapsed" };
+
+    cout << fixed << setprecision( 1 ) << "ns per call" << endl;
+    for ( int method = 0; method < 6; method++ )
+        {
+        Ntime ntime = Ntime::getCurrentLocalTime();
+        Ntimestamp stamp = Ntimestamp::now( Ntimestamp::TSC );
+        Ntimestamp start = Ntimestamp::now();
+        for ( int r = 0; r < repeats; r++ )
+            switch ( method )
+                {
+                case 0: sink = Ntime::getCurrentLocalTime().getAsTimespec().tv_nsec; break;
+                case 1: sink = ntime.getElapsed().getAsTimespec().tv_nsec; break;
+                case 2: sink = Ntimestamp::now().getAsNs(); break;
+                case 3: sink = Ntimestamp::now( Ntimestamp::MONOTONIC_COARSE ).getAsNs(); break;
+                case 4: sink = Ntimestamp::now( Ntimestamp::TSC ).getAsNs(); break;
+                case 5: sink = stamp.getElapsed( Ntimestamp::TSC ).getAsNs(); break;
+                }
+        cout << setw( 30 ) << methods[ method ] << setw( 10 ) << (double)start.getElapsed().getAsNs() / repeats << endl;
+        }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+// Checks Ntimestamp's clocks agree with each other and with Ntime, and its conversions.
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+
+#include "nerror.h"
+#include "ntime.h"
+#include "../ntest.h"
+
+using namespace std;
+
+static int64_t distance( const Ntimestamp& theA, const Ntimestamp& theB )
+{
+    return llabs( ( theA - theB ).getAsNs() );
+}
+
+
+int main( int ac, char* av[] )
+{
+    HANDLE_NERRORS;
+
+    bool ok = true;
+    cout << "TSC " << ( Ntimestamp::isTscAvailable() ? "available" : "not available" ) << endl;
+    Ntimestamp::calibrateTsc( 50 );
+
+    bool ordered = true;
+    Ntimestamp last[ 3 ];
+    for ( int i = 0; i < 100000; i++ )
+        for ( int clock = Ntimestamp::MONOTONIC; clock <= Ntimestamp::TSC; clock++ )
+            {
+            Ntimestamp t = Ntimestamp::now( (Ntimestamp::CLOCK)clock );
+            ordered &= ( t >= last[ clock ] );
+            last[ clock ] = t;
+            }
+    ok &= check( "never go backwards", ordered );
+
+    // The TSC after calibration is within 100us of the monotonic clock, and the coarse clock within a tick
+    bool agree = true;
+    for ( int i = 0; i < 20; i++ )
+        {
+        Ntimestamp monotonic = Ntimestamp::now();
+        agree &= ( distance( Ntimestamp::now( Ntimestamp::TSC ), monotonic ) < 100000 ) &&
+                 ( distance( Ntimestamp::now( Ntimestamp::MONOTONIC_COARSE ), monotonic ) < 20000000 );
+        Ntime::sleep( 5 );
+        }
+    ok &= check( "clocks agree", agree );
+
+    Ntimestamp start = Ntimestamp::now( Ntimestamp::TSC );
+    Ntime::sleep( 50 );
+    Ntimestamp elapsed = start.getElapsed( Ntimestamp::TSC );
+    ok &= check( "elapsed", ( elapsed.getAsMs() >= 50 ) && ( elapsed.getAsMs() < 70 ) );
+
+    ok &= check( "to and from Ntime", ( Ntimestamp( Ntime( 1234567 ) ).getAsNs() == 1234567000000LL ) &&
+                                      ( Ntimestamp( 1500000001 ).getAsNtime().getAsMs() == 1500 ) &&
+                                      ( Ntimestamp( Ntimestamp( -1500000001 ).getAsNtime() ).getAsNs() == -1500000001 ) &&
+                                      ( Ntimestamp( Ntime( 3000 ) - Ntime( 4500 ) ).getAsMs() == -1500 ) );
+    ok &= check( "local time", llabs( ( Ntimestamp::now().getAsLocalTime() - Ntime::getCurrentLocalTime() ).getAsMs() ) < 5 );
+    ok &= check( "arithmetic", ( Ntimestamp( 5 ) + Ntimestamp( 7 ) == Ntimestamp( 12 ) ) && ( Ntimestamp( 5 ) - Ntimestamp( 7 ) < Ntimestamp() ) &&
+                               ( Ntimestamp( 2500000 ).getAsUs() == 2500 ) && ( Ntimestamp( 2500000000LL ).getAsSeconds() == 2.5 ) );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}